@@ -20,8 +20,12 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <cutils/properties.h>
 
 #include <log/log.h>
@@ -29,6 +33,7 @@
 #include "include/alsa_device_profile.h"
 #include "include/alsa_format.h"
 #include "include/alsa_logging.h"
+#include "alsa_device_profile_private.h"
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
@@ -53,7 +58,8 @@ extern int8_t const pcm_format_value_map[50];
    AudioPolicyManager may not respect this ordering when picking sample rates.
    Update MAX_PROFILE_SAMPLE_RATES after changing the array size.
 
-   TODO: remove 32000, 22050, 12000, 11025?  Each sample rate check
+   TODO: remove 32000, 22050, 12000, 11025?  Each sample rate check that is not
+   decided by the hardware parameters or the stream description of a USB device
    requires opening the device which may cause pops. */
 static const unsigned std_sample_rates[] =
     {96000, 88200, 192000, 176400, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000};
@@ -231,12 +237,255 @@ bool profile_is_channel_count_valid(const alsa_device_profile* profile, unsigned
     }
 }
 
-static bool profile_test_sample_rate(const alsa_device_profile* profile, unsigned rate)
+/*
+ * Card information
+ */
+static char proc_asound_dir[PATH_MAX] = "/proc/asound";
+static char sys_class_sound_dir[PATH_MAX] = "/sys/class/sound";
+
+void profile_set_card_info_dirs(const char* proc_asound, const char* sys_class_sound)
+{
+    strlcpy(proc_asound_dir, proc_asound, sizeof(proc_asound_dir));
+    strlcpy(sys_class_sound_dir, sys_class_sound, sizeof(sys_class_sound_dir));
+}
+
+#define MAX_USB_STREAM_FORMATS  16
+#define MAX_USB_STREAM_RATES    16
+
+/*
+ * A format of a stream of a USB device, as described by the USB audio driver in
+ * /proc/asound/card<N>/stream<M> for each altsetting of the interfaces:
+ *
+ *   Playback:
+ *     Status: Stop
+ *     Interface 1
+ *       Altset 1
+ *       Format: S16_LE S24_3LE
+ *       Channels: 2
+ *       Endpoint: 0x01 (1 OUT) (ADAPTIVE)
+ *       Rates: 44100, 48000, 96000
+ *
+ * with "Rates: 8000 - 96000 (continuous)" for a continuous range of rates.
+ */
+typedef struct {
+    unsigned formats;       /* bit mask of enum pcm_format */
+    unsigned channels;
+    bool continuous;        /* rates[0] to rates[1] */
+    bool truncated;         /* not all the rates were read */
+    unsigned num_rates;
+    unsigned rates[MAX_USB_STREAM_RATES];
+} usb_stream_format;
+
+typedef struct {
+    bool complete;          /* the description was read, and all its formats */
+    unsigned num_formats;
+    usb_stream_format formats[MAX_USB_STREAM_FORMATS];
+} usb_stream;
+
+typedef enum {
+    PROBE_UNSUPPORTED,
+    PROBE_SUPPORTED,
+    PROBE_UNKNOWN,          /* only opening the device tells, or the open failed */
+} probe_result;
+
+static const struct {
+    const char* name;
+    enum pcm_format format;
+} usb_format_names[] = {
+    { "S16_LE", PCM_FORMAT_S16_LE },
+    { "S32_LE", PCM_FORMAT_S32_LE },
+    { "S8", PCM_FORMAT_S8 },
+    { "S24_LE", PCM_FORMAT_S24_LE },
+    { "S24_3LE", PCM_FORMAT_S24_3LE },
+};
+
+static void usb_stream_parse_formats(usb_stream_format* format, char* names)
+{
+    char* saveptr;
+    for (const char* name = strtok_r(names, " \n", &saveptr); name != NULL;
+            name = strtok_r(NULL, " \n", &saveptr)) {
+        size_t index;
+        for (index = 0; index < ARRAY_SIZE(usb_format_names); index++) {
+            if (strcmp(name, usb_format_names[index].name) == 0) {
+                format->formats |= 1u << usb_format_names[index].format;
+            }
+        }
+    }
+}
+
+static void usb_stream_parse_rates(usb_stream_format* format, const char* rates, bool whole_line)
+{
+    if (strstr(rates, "continuous") != NULL) {
+        format->continuous = sscanf(rates, "%u - %u", &format->rates[0], &format->rates[1]) == 2;
+        format->truncated = !format->continuous;
+        return;
+    }
+    const char* next = rates;
+    for (;;) {
+        char* end;
+        unsigned long rate = strtoul(next, &end, 10);
+        if (end == next) {
+            break;
+        }
+        if (format->num_rates == ARRAY_SIZE(format->rates)) {
+            format->truncated = true;
+            return;
+        }
+        format->rates[format->num_rates++] = rate;
+        next = end + strspn(end, ", ");
+    }
+    /* the rest of the line is read as another one, and ignored */
+    format->truncated = !whole_line;
+}
+
+/*
+ * Reads the description of the stream of a USB device in the direction of the profile.
+ * The description is empty, and not complete, if the device is not a USB device.
+ */
+static void usb_stream_read(const alsa_device_profile* profile, usb_stream* stream)
+{
+    stream->complete = false;
+    stream->num_formats = 0;
+
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/card%d/stream%d",
+                 proc_asound_dir, profile->card, profile->device) >= (int)sizeof(path)) {
+        return;
+    }
+    FILE* file = fopen(path, "re");
+    if (file == NULL) {
+        return;
+    }
+
+    const char* direction = profile->direction == PCM_OUT ? "Playback:" : "Capture:";
+    bool in_direction = false;
+    usb_stream_format* format = NULL;
+    char line[256];
+    stream->complete = true;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        const bool whole_line = strchr(line, '\n') != NULL || feof(file);
+        char* text = line + strspn(line, " \t");
+        if (strncmp(text, "Playback:", 9) == 0 || strncmp(text, "Capture:", 8) == 0) {
+            in_direction = strncmp(text, direction, strlen(direction)) == 0;
+            format = NULL;
+        } else if (!in_direction) {
+            continue;
+        } else if (strncmp(text, "Altset", 6) == 0) {
+            if (stream->num_formats == ARRAY_SIZE(stream->formats)) {
+                stream->complete = false;
+                break;
+            }
+            format = &stream->formats[stream->num_formats++];
+            memset(format, 0, sizeof(*format));
+        } else if (format == NULL) {
+            continue;
+        } else if (strncmp(text, "Format:", 7) == 0) {
+            usb_stream_parse_formats(format, text + 7);
+        } else if (strncmp(text, "Channels:", 9) == 0) {
+            format->channels = strtoul(text + 9, NULL, 10);
+        } else if (strncmp(text, "Rates:", 6) == 0) {
+            usb_stream_parse_rates(format, text + 6, whole_line);
+        }
+    }
+    fclose(file);
+}
+
+/*
+ * Returns whether the USB audio driver accepts a configuration, which is the case if an
+ * altsetting of the stream lists its rate for its format and channel count.
+ */
+static probe_result usb_stream_test_config(const usb_stream* stream,
+                                           const struct pcm_config* config)
+{
+    if (config->format < 0 || config->format >= 32) {
+        return PROBE_UNKNOWN;
+    }
+    bool known = stream->complete;
+    bool matched = false;
+    size_t index;
+    for (index = 0; index < stream->num_formats; index++) {
+        const usb_stream_format* format = &stream->formats[index];
+        if ((format->formats & (1u << config->format)) == 0 ||
+                format->channels != config->channels) {
+            continue;
+        }
+        matched = true;
+        if (format->continuous) {
+            /* a range tells what the driver accepts, not what the device plays */
+            if (config->rate >= format->rates[0] && config->rate <= format->rates[1]) {
+                known = false;
+            }
+            continue;
+        }
+        size_t rate_index;
+        for (rate_index = 0; rate_index < format->num_rates; rate_index++) {
+            if (format->rates[rate_index] == config->rate) {
+                return PROBE_SUPPORTED;
+            }
+        }
+        if (format->truncated) {
+            known = false;
+        }
+    }
+    return matched && known ? PROBE_UNSUPPORTED : PROBE_UNKNOWN;
+}
+
+/*
+ * Tests a configuration from the stream description, or else by opening the device with the
+ * pcm_open() flags in addition to the direction of the profile. Returns PROBE_UNKNOWN if the
+ * open failed for another reason than the device rejecting the configuration, such as a
+ * device still settling after it was connected.
+ */
+static probe_result profile_probe_config(const alsa_device_profile* profile,
+                                         const usb_stream* stream,
+                                         const struct pcm_config* config,
+                                         unsigned flags)
+{
+    probe_result result = usb_stream_test_config(stream, config);
+    if (result != PROBE_UNKNOWN) {
+        return result;
+    }
+
+    struct pcm_config open_config = *config;
+    errno = 0;
+    struct pcm * pcm = pcm_open(profile->card, profile->device,
+                                profile->direction | flags, &open_config);
+    /* the hw_params ioctl fails with EINVAL for a configuration the device does not support */
+    const int open_errno = errno;
+
+    if (pcm != NULL && pcm_is_ready(pcm)) {
+        result = PROBE_SUPPORTED;
+    } else if (open_errno == EINVAL) {
+        result = PROBE_UNSUPPORTED;
+    } else {
+        ALOGW("probe of card %d device %d at %u Hz failed: %s", profile->card, profile->device,
+              config->rate, pcm != NULL ? pcm_get_error(pcm) : strerror(open_errno));
+    }
+    if (pcm != NULL) {
+        pcm_close(pcm);
+    }
+
+    return result;
+}
+
+bool profile_test_config(const alsa_device_profile* profile, const struct pcm_config* config,
+                         unsigned flags)
+{
+    if (!profile_is_initialized(profile)) {
+        return false;
+    }
+    usb_stream stream;
+    usb_stream_read(profile, &stream);
+    return profile_probe_config(profile, &stream, config, flags) == PROBE_SUPPORTED;
+}
+
+static probe_result profile_test_sample_rate(const alsa_device_profile* profile,
+                                             const usb_stream* stream, unsigned rate)
 {
     struct pcm_config config = profile->default_config;
     config.rate = rate;
-    // This method tests whether a sample rate is supported by the USB device
-    // by attempting to open it.
+    // This method tests whether a sample rate is supported by the USB device,
+    // from the description of its streams, or else by attempting to open it.
     //
     // The profile default_config currently contains the minimum channel count.
     // As some usb devices cannot sustain the sample rate across all its supported
@@ -259,29 +508,35 @@ static bool profile_test_sample_rate(const alsa_device_profile* profile, unsigne
         config.channels = profile->max_channel_count;
         if (config.channels > FCC_LIMIT) config.channels = FCC_LIMIT;
     }
-    bool works = false; /* let's be pessimistic */
-    struct pcm * pcm = pcm_open(profile->card, profile->device,
-                                profile->direction, &config);
-
-    if (pcm != NULL) {
-        works = pcm_is_ready(pcm);
-        pcm_close(pcm);
-    }
-
-    return works;
+    return profile_probe_config(profile, stream, &config, 0 /* flags */);
 }
 
-static unsigned profile_enum_sample_rates(alsa_device_profile* profile, unsigned min, unsigned max)
+/*
+ * Sets complete to false if a rate could not be tested, so that the rates are not kept in
+ * the probe cache.
+ */
+static unsigned profile_enum_sample_rates(alsa_device_profile* profile, unsigned min, unsigned max,
+                                          bool* complete)
 {
     unsigned num_entries = 0;
     unsigned index;
 
+    usb_stream stream;
+    usb_stream_read(profile, &stream);
+
     for (index = 0; index < ARRAY_SIZE(std_sample_rates) &&
                     num_entries < ARRAY_SIZE(profile->sample_rates) - 1;
          index++) {
-        if (std_sample_rates[index] >= min && std_sample_rates[index] <= max
-                && profile_test_sample_rate(profile, std_sample_rates[index])) {
+        if (std_sample_rates[index] < min || std_sample_rates[index] > max) {
+            continue;
+        }
+        /* the hardware parameters refined to a single rate need no test */
+        probe_result result = min == max ? PROBE_SUPPORTED :
+                profile_test_sample_rate(profile, &stream, std_sample_rates[index]);
+        if (result == PROBE_SUPPORTED) {
             profile->sample_rates[num_entries++] = std_sample_rates[index];
+        } else if (result == PROBE_UNKNOWN) {
+            *complete = false;
         }
     }
     profile->sample_rates[num_entries] = 0; /* terminate */
@@ -371,23 +626,15 @@ static unsigned profile_enum_channel_counts(alsa_device_profile* profile, unsign
 }
 
 /*
- * Reads and decodes configuration info from the specified ALSA card/device.
+ * Decodes configuration info from the hardware parameters of the specified ALSA card/device.
  */
-static int read_alsa_device_config(alsa_device_profile * profile, struct pcm_config * config)
+static int read_alsa_device_config(alsa_device_profile * profile,
+                                   struct pcm_params * alsa_hw_params,
+                                   struct pcm_config * config)
 {
     ALOGV("usb:audio_hw - read_alsa_device_config(c:%d d:%d t:0x%X)",
           profile->card, profile->device, profile->direction);
 
-    if (profile->card < 0 || profile->device < 0) {
-        return -EINVAL;
-    }
-
-    struct pcm_params * alsa_hw_params =
-        pcm_params_get(profile->card, profile->device, profile->direction);
-    if (alsa_hw_params == NULL) {
-        return -EINVAL;
-    }
-
     profile->min_period_size = pcm_params_get_min(alsa_hw_params, PCM_PARAM_PERIOD_SIZE);
     profile->max_period_size = pcm_params_get_max(alsa_hw_params, PCM_PARAM_PERIOD_SIZE);
 
@@ -429,8 +676,6 @@ static int read_alsa_device_config(alsa_device_profile * profile, struct pcm_con
         ret = -EINVAL;
     }
 
-    pcm_params_free(alsa_hw_params);
-
     return ret;
 }
 
@@ -465,18 +710,154 @@ bool profile_fill_builtin_device_info(alsa_device_profile* profile, struct pcm_c
     return true;
 }
 
+/*
+ * Probe cache
+ *
+ * Probing a USB device can take hundreds of milliseconds, so the capabilities read from
+ * it are kept for the next time it is connected. They are kept per model, firmware
+ * version and speed of the device, as read from sysfs, rather than per card, as the card
+ * number changes when the device is connected again.
+ */
+#define MAX_PROBE_CACHE_ENTRIES 16
+
+typedef struct {
+    unsigned vendor_id;
+    unsigned product_id;
+    unsigned firmware_version;  /* bcdDevice */
+    unsigned speed;             /* Mb/s */
+} usb_device_id;
+
+typedef struct {
+    usb_device_id usb_id;
+    int device;
+    int direction;
+    alsa_device_profile profile;
+} probe_cache_entry;
+
+static pthread_mutex_t probe_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static probe_cache_entry probe_cache[MAX_PROBE_CACHE_ENTRIES];
+static size_t probe_cache_size;
+static size_t probe_cache_next;     /* the entry replaced when the cache is full */
+
+static bool read_usb_device_attribute(int card, const char* name, int base, unsigned* value)
+{
+    char path[PATH_MAX];
+    /* the device of a card of a USB device is its interface */
+    if (snprintf(path, sizeof(path), "%s/card%d/device/../%s",
+                 sys_class_sound_dir, card, name) >= (int)sizeof(path)) {
+        return false;
+    }
+    FILE* file = fopen(path, "re");
+    if (file == NULL) {
+        return false;
+    }
+    char text[16];
+    bool read = fgets(text, sizeof(text), file) != NULL;
+    fclose(file);
+    if (read) {
+        char* end;
+        *value = strtoul(text, &end, base);
+        read = end != text;
+    }
+    return read;
+}
+
+/*
+ * Reads the identity of the USB device of a card. Returns false if the card is not that
+ * of a USB device.
+ */
+static bool read_usb_device_id(int card, usb_device_id* usb_id)
+{
+    return read_usb_device_attribute(card, "idVendor", 16, &usb_id->vendor_id) &&
+            read_usb_device_attribute(card, "idProduct", 16, &usb_id->product_id) &&
+            read_usb_device_attribute(card, "bcdDevice", 16, &usb_id->firmware_version) &&
+            read_usb_device_attribute(card, "speed", 10, &usb_id->speed);
+}
+
+/* Returns the entry of a device, or NULL. Called with probe_cache_lock held. */
+static probe_cache_entry* probe_cache_find(const usb_device_id* usb_id, int device,
+                                           int direction)
+{
+    size_t index;
+    for (index = 0; index < probe_cache_size; index++) {
+        probe_cache_entry* entry = &probe_cache[index];
+        if (entry->usb_id.vendor_id == usb_id->vendor_id &&
+                entry->usb_id.product_id == usb_id->product_id &&
+                entry->usb_id.firmware_version == usb_id->firmware_version &&
+                entry->usb_id.speed == usb_id->speed &&
+                entry->device == device && entry->direction == direction) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* Copies what profile_read_device_info() reads from the device */
+static void profile_copy_device_info(alsa_device_profile* dst, const alsa_device_profile* src)
+{
+    memcpy(dst->formats, src->formats, sizeof(dst->formats));
+    memcpy(dst->sample_rates, src->sample_rates, sizeof(dst->sample_rates));
+    memcpy(dst->channel_counts, src->channel_counts, sizeof(dst->channel_counts));
+    dst->default_config = src->default_config;
+    dst->min_period_size = src->min_period_size;
+    dst->max_period_size = src->max_period_size;
+    dst->min_channel_count = src->min_channel_count;
+    dst->max_channel_count = src->max_channel_count;
+    dst->is_valid = src->is_valid;
+}
+
+static bool probe_cache_get(const usb_device_id* usb_id, alsa_device_profile* profile)
+{
+    pthread_mutex_lock(&probe_cache_lock);
+    const probe_cache_entry* entry = probe_cache_find(usb_id, profile->device,
+                                                      profile->direction);
+    if (entry != NULL) {
+        profile_copy_device_info(profile, &entry->profile);
+    }
+    pthread_mutex_unlock(&probe_cache_lock);
+    return entry != NULL;
+}
+
+static void probe_cache_put(const usb_device_id* usb_id, const alsa_device_profile* profile)
+{
+    pthread_mutex_lock(&probe_cache_lock);
+    probe_cache_entry* entry = probe_cache_find(usb_id, profile->device, profile->direction);
+    if (entry == NULL) {
+        if (probe_cache_size < ARRAY_SIZE(probe_cache)) {
+            entry = &probe_cache[probe_cache_size++];
+        } else {
+            entry = &probe_cache[probe_cache_next];
+            probe_cache_next = (probe_cache_next + 1) % ARRAY_SIZE(probe_cache);
+        }
+    }
+    entry->usb_id = *usb_id;
+    entry->device = profile->device;
+    entry->direction = profile->direction;
+    entry->profile = *profile;
+    pthread_mutex_unlock(&probe_cache_lock);
+}
+
+void profile_clear_probe_cache(void)
+{
+    pthread_mutex_lock(&probe_cache_lock);
+    probe_cache_size = 0;
+    probe_cache_next = 0;
+    pthread_mutex_unlock(&probe_cache_lock);
+}
+
 bool profile_read_device_info(alsa_device_profile* profile)
 {
     if (!profile_is_initialized(profile)) {
         return false;
     }
 
-    /* let's get some defaults */
-    read_alsa_device_config(profile, &profile->default_config);
-    ALOGV("default_config chans:%d rate:%d format:%d count:%d size:%d",
-          profile->default_config.channels, profile->default_config.rate,
-          profile->default_config.format, profile->default_config.period_count,
-          profile->default_config.period_size);
+    usb_device_id usb_id;
+    const bool is_usb = read_usb_device_id(profile->card, &usb_id);
+    if (is_usb && probe_cache_get(&usb_id, profile)) {
+        ALOGV("usb device %04x:%04x rev %04x read from the probe cache",
+              usb_id.vendor_id, usb_id.product_id, usb_id.firmware_version);
+        return true;
+    }
 
     struct pcm_params * alsa_hw_params = pcm_params_get(profile->card,
                                                         profile->device,
@@ -485,6 +866,13 @@ bool profile_read_device_info(alsa_device_profile* profile)
         return false;
     }
 
+    /* let's get some defaults */
+    read_alsa_device_config(profile, alsa_hw_params, &profile->default_config);
+    ALOGV("default_config chans:%d rate:%d format:%d count:%d size:%d",
+          profile->default_config.channels, profile->default_config.rate,
+          profile->default_config.format, profile->default_config.period_count,
+          profile->default_config.period_size);
+
     /* Formats */
     const struct pcm_mask * format_mask = pcm_params_get_mask(alsa_hw_params, PCM_PARAM_FORMAT);
     profile_enum_sample_formats(profile, format_mask);
@@ -495,13 +883,20 @@ bool profile_read_device_info(alsa_device_profile* profile)
             pcm_params_get_max(alsa_hw_params, PCM_PARAM_CHANNELS));
 
     /* Sample Rates */
+    bool complete = true;
     profile_enum_sample_rates(
             profile, pcm_params_get_min(alsa_hw_params, PCM_PARAM_RATE),
-            pcm_params_get_max(alsa_hw_params, PCM_PARAM_RATE));
+            pcm_params_get_max(alsa_hw_params, PCM_PARAM_RATE), &complete);
 
     profile->is_valid = true;
 
     pcm_params_free(alsa_hw_params);
+
+    /* a failed probe is done again the next time the device is connected */
+    if (is_usb && complete && profile->formats[0] != PCM_FORMAT_INVALID &&
+            profile->sample_rates[0] != 0 && profile->channel_counts[0] != 0) {
+        probe_cache_put(&usb_id, profile);
+    }
     return true;
 }
 
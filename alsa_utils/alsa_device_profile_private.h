@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SYSTEM_MEDIA_ALSA_UTILS_ALSA_DEVICE_PROFILE_PRIVATE_H
+#define ANDROID_SYSTEM_MEDIA_ALSA_UTILS_ALSA_DEVICE_PROFILE_PRIVATE_H
+
+/*
+ * Not exported by libalsautils: for alsa_device_profile.c and the tests only.
+ */
+
+/*
+ * profile_read_device_info() keeps what it reads from a USB device for the next time the
+ * device is connected. Clears what was kept.
+ */
+void profile_clear_probe_cache(void);
+
+/*
+ * Sets the directories where the stream descriptions (/proc/asound) and the identity
+ * (/sys/class/sound) of the USB devices of the cards are read, for tests.
+ */
+void profile_set_card_info_dirs(const char* proc_asound, const char* sys_class_sound);
+
+#endif /* ANDROID_SYSTEM_MEDIA_ALSA_UTILS_ALSA_DEVICE_PROFILE_PRIVATE_H */
@@ -376,7 +376,6 @@ int proxy_scan_rates(alsa_device_proxy * proxy,
     struct pcm_config alsa_config;
     memcpy(&alsa_config, &proxy->alsa_config, sizeof(alsa_config));
 
-    struct pcm * alsa_pcm;
     int rate_index = 0;
     while (sample_rates[rate_index] != 0) {
         if (require_exact_match && alsa_config.rate != sample_rates[rate_index]) {
@@ -384,15 +383,8 @@ int proxy_scan_rates(alsa_device_proxy * proxy,
             continue;
         }
         alsa_config.rate = sample_rates[rate_index];
-        alsa_pcm = pcm_open(profile->card, profile->device,
-                profile->direction | ALSA_CLOCK_TYPE, &alsa_config);
-        if (alsa_pcm != NULL) {
-            if (pcm_is_ready(alsa_pcm)) {
-                pcm_close(alsa_pcm);
-                return rate_index;
-            }
-
-            pcm_close(alsa_pcm);
+        if (profile_test_config(profile, &alsa_config, ALSA_CLOCK_TYPE)) {
+            return rate_index;
         }
 
         rate_index++;
@@ -72,6 +72,14 @@ bool profile_fill_builtin_device_info(alsa_device_profile* profile, struct pcm_c
                                       unsigned buffer_frame_count);
 bool profile_read_device_info(alsa_device_profile* profile);
 
+/*
+ * Returns whether the device supports a configuration. This is decided from the description
+ * of the streams of a USB device when it lists the rate for the format and channel count,
+ * and else by opening the device, with the pcm_open() flags in addition to the direction.
+ */
+bool profile_test_config(const alsa_device_profile* profile, const struct pcm_config* config,
+                         unsigned flags);
+
 /* Audio Config Strings Methods */
 char * profile_get_sample_rate_strs(const alsa_device_profile* profile);
 char * profile_get_format_strs(const alsa_device_profile* profile);
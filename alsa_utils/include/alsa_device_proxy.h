@@ -55,7 +55,8 @@ unsigned proxy_get_latency(const alsa_device_proxy * proxy);
 /*
  * Scans the provided list of sample rates and finds the first one that works.
  *
- * returns the index of the first rate for which the ALSA device can be opened.
+ * returns the index of the first rate for which the ALSA device can be opened, as told by
+ * profile_test_config().
  * return negative value if none work or an error occurs.
  */
 int proxy_scan_rates(alsa_device_proxy * proxy, const unsigned sample_rates[],
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+extern "C" {
+#include <alsa_device_profile.h>
+#include <alsa_device_proxy.h>
+#include "alsa_device_profile_private.h"
+}
+#include <fake_pcm.h>
+
+#include <errno.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr int kCard = 1;
+
+constexpr char kStream[] =
+        "USB Audio DAC at usb-xhci-hcd.0-1, high speed : USB Audio\n"
+        "\n"
+        "Playback:\n"
+        "  Status: Stop\n"
+        "  Interface 1\n"
+        "    Altset 1\n"
+        "    Format: S16_LE\n"
+        "    Channels: 2\n"
+        "    Endpoint: 0x01 (1 OUT) (ADAPTIVE)\n"
+        "    Rates: 44100, 48000, 96000\n"
+        "    Data packet interval: 125 us\n"
+        "    Bits: 16\n"
+        "  Interface 1\n"
+        "    Altset 2\n"
+        "    Format: S24_3LE\n"
+        "    Channels: 2\n"
+        "    Endpoint: 0x01 (1 OUT) (ADAPTIVE)\n"
+        "    Rates: 44100, 48000, 96000, 192000\n"
+        "    Data packet interval: 125 us\n"
+        "    Bits: 24\n"
+        "\n"
+        "Capture:\n"
+        "  Status: Stop\n"
+        "  Interface 2\n"
+        "    Altset 1\n"
+        "    Format: S16_LE\n"
+        "    Channels: 1\n"
+        "    Endpoint: 0x82 (2 IN) (ASYNC)\n"
+        "    Rates: 48000\n";
+
+class AlsaDeviceProfileTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        fake_pcm_clear();
+        profile_clear_probe_cache();
+        mProcDir = std::string(mDir.path) + "/proc";
+        mSysDir = std::string(mDir.path) + "/sys";
+        ASSERT_EQ(0, mkdir(mProcDir.c_str(), 0700));
+        ASSERT_EQ(0, mkdir(mSysDir.c_str(), 0700));
+        profile_set_card_info_dirs(mProcDir.c_str(), mSysDir.c_str());
+
+        fake_pcm_add_format(PCM_FORMAT_S16_LE);
+        fake_pcm_set_interval(PCM_PARAM_CHANNELS, 1, 2);
+        fake_pcm_set_interval(PCM_PARAM_RATE, 44100, 96000);
+        fake_pcm_set_interval(PCM_PARAM_PERIOD_SIZE, 16, 8192);
+        fake_pcm_set_interval(PCM_PARAM_PERIODS, 2, 16);
+        fake_pcm_add_rate(44100);
+        fake_pcm_add_rate(48000);
+        fake_pcm_add_rate(96000);
+    }
+
+    void TearDown() override {
+        profile_set_card_info_dirs("/proc/asound", "/sys/class/sound");
+        profile_clear_probe_cache();
+        fake_pcm_clear();
+    }
+
+    void addCardDir(const std::string& dir, int card) {
+        const std::string cardDir = dir + "/card" + std::to_string(card);
+        mkdir(cardDir.c_str(), 0700);
+    }
+
+    void writeStream(int card, const char* stream) {
+        addCardDir(mProcDir, card);
+        ASSERT_TRUE(android::base::WriteStringToFile(
+                stream, mProcDir + "/card" + std::to_string(card) + "/stream0"));
+    }
+
+    // sysfs has the attributes of the USB device above the interface of the card.
+    void writeUsbDevice(int card, const char* firmwareVersion) {
+        addCardDir(mSysDir, card);
+        const std::string deviceDir = mSysDir + "/card" + std::to_string(card);
+        mkdir((deviceDir + "/device").c_str(), 0700);
+        ASSERT_TRUE(android::base::WriteStringToFile("18d1\n", deviceDir + "/idVendor"));
+        ASSERT_TRUE(android::base::WriteStringToFile("5034\n", deviceDir + "/idProduct"));
+        ASSERT_TRUE(android::base::WriteStringToFile(firmwareVersion, deviceDir + "/bcdDevice"));
+        ASSERT_TRUE(android::base::WriteStringToFile("480\n", deviceDir + "/speed"));
+    }
+
+    static std::vector<unsigned> readRates(int card) {
+        alsa_device_profile profile;
+        profile_init(&profile, PCM_OUT);
+        profile.card = card;
+        profile.device = 0;
+        EXPECT_TRUE(profile_read_device_info(&profile));
+        std::vector<unsigned> rates;
+        for (size_t i = 0; profile.sample_rates[i] != 0; i++) {
+            rates.push_back(profile.sample_rates[i]);
+        }
+        return rates;
+    }
+
+    TemporaryDir mDir;
+    std::string mProcDir;
+    std::string mSysDir;
+};
+
+TEST_F(AlsaDeviceProfileTest, OpensWithoutStreamDescription) {
+    EXPECT_EQ((std::vector<unsigned>{96000, 48000, 44100}), readRates(kCard));
+    // 96000, 88200, 48000 and 44100 are in the interval of the hardware parameters
+    EXPECT_EQ(4u, fake_pcm_get_opens());
+    EXPECT_EQ(1u, fake_pcm_get_params_reads());
+}
+
+TEST_F(AlsaDeviceProfileTest, SingleRateNeedsNoOpen) {
+    fake_pcm_set_interval(PCM_PARAM_RATE, 48000, 48000);
+    EXPECT_EQ((std::vector<unsigned>{48000}), readRates(kCard));
+    EXPECT_EQ(0u, fake_pcm_get_opens());
+}
+
+TEST_F(AlsaDeviceProfileTest, StreamDescriptionNeedsNoOpen) {
+    writeStream(kCard, kStream);
+    EXPECT_EQ((std::vector<unsigned>{96000, 48000, 44100}), readRates(kCard));
+    EXPECT_EQ(0u, fake_pcm_get_opens());
+}
+
+TEST_F(AlsaDeviceProfileTest, StreamDescriptionOfOtherFormat) {
+    // the rates of the S24_3LE altsetting are not those of S16_LE
+    writeStream(kCard,
+            "Playback:\n"
+            "  Interface 1\n"
+            "    Altset 1\n"
+            "    Format: S24_3LE\n"
+            "    Channels: 2\n"
+            "    Rates: 44100, 48000, 88200, 96000\n");
+    EXPECT_EQ((std::vector<unsigned>{96000, 48000, 44100}), readRates(kCard));
+    EXPECT_EQ(4u, fake_pcm_get_opens());
+}
+
+TEST_F(AlsaDeviceProfileTest, StreamDescriptionOfContinuousRates) {
+    writeStream(kCard,
+            "Playback:\n"
+            "  Interface 1\n"
+            "    Altset 1\n"
+            "    Format: S16_LE\n"
+            "    Channels: 2\n"
+            "    Rates: 8000 - 96000 (continuous)\n");
+    EXPECT_EQ((std::vector<unsigned>{96000, 48000, 44100}), readRates(kCard));
+    EXPECT_EQ(4u, fake_pcm_get_opens());
+}
+
+TEST_F(AlsaDeviceProfileTest, ProbeCacheOnReconnection) {
+    writeUsbDevice(kCard, "0100\n");
+    EXPECT_EQ((std::vector<unsigned>{96000, 48000, 44100}), readRates(kCard));
+    EXPECT_EQ(4u, fake_pcm_get_opens());
+    EXPECT_EQ(1u, fake_pcm_get_params_reads());
+
+    // the device is connected again as another card
+    writeUsbDevice(kCard + 1, "0100\n");
+    EXPECT_EQ((std::vector<unsigned>{96000, 48000, 44100}), readRates(kCard + 1));
+    EXPECT_EQ(4u, fake_pcm_get_opens());
+    EXPECT_EQ(1u, fake_pcm_get_params_reads());
+}
+
+TEST_F(AlsaDeviceProfileTest, ProbeCacheOfFirmwareVersion) {
+    writeUsbDevice(kCard, "0100\n");
+    EXPECT_EQ((std::vector<unsigned>{96000, 48000, 44100}), readRates(kCard));
+
+    // the firmware update of the device added 88200
+    fake_pcm_add_rate(88200);
+    writeUsbDevice(kCard + 1, "0101\n");
+    EXPECT_EQ((std::vector<unsigned>{96000, 88200, 48000, 44100}), readRates(kCard + 1));
+    EXPECT_EQ(8u, fake_pcm_get_opens());
+    EXPECT_EQ(2u, fake_pcm_get_params_reads());
+}
+
+TEST_F(AlsaDeviceProfileTest, ProbeCacheWithoutRates) {
+    // the device opens at no rate until it is ready
+    fake_pcm_clear();
+    fake_pcm_add_format(PCM_FORMAT_S16_LE);
+    fake_pcm_set_interval(PCM_PARAM_CHANNELS, 1, 2);
+    fake_pcm_set_interval(PCM_PARAM_RATE, 44100, 96000);
+    fake_pcm_set_interval(PCM_PARAM_PERIOD_SIZE, 16, 8192);
+    fake_pcm_set_interval(PCM_PARAM_PERIODS, 2, 16);
+    writeUsbDevice(kCard, "0100\n");
+    EXPECT_EQ((std::vector<unsigned>{}), readRates(kCard));
+
+    fake_pcm_add_rate(48000);
+    fake_pcm_add_rate(44100);
+    writeUsbDevice(kCard + 1, "0100\n");
+    EXPECT_EQ((std::vector<unsigned>{48000, 44100}), readRates(kCard + 1));
+}
+
+TEST_F(AlsaDeviceProfileTest, ProbeCacheAfterFailedOpen) {
+    // the device is busy at the first rate tested
+    fake_pcm_fail_opens(1, EBUSY);
+    writeUsbDevice(kCard, "0100\n");
+    EXPECT_EQ((std::vector<unsigned>{48000, 44100}), readRates(kCard));
+
+    writeUsbDevice(kCard + 1, "0100\n");
+    EXPECT_EQ((std::vector<unsigned>{96000, 48000, 44100}), readRates(kCard + 1));
+    EXPECT_EQ(8u, fake_pcm_get_opens());
+
+    // the complete probe is kept
+    writeUsbDevice(kCard + 2, "0100\n");
+    EXPECT_EQ((std::vector<unsigned>{96000, 48000, 44100}), readRates(kCard + 2));
+    EXPECT_EQ(8u, fake_pcm_get_opens());
+}
+
+TEST_F(AlsaDeviceProfileTest, ProbeCacheOnlyForUsbDevices) {
+    readRates(kCard);
+    readRates(kCard);
+    EXPECT_EQ(8u, fake_pcm_get_opens());
+}
+
+TEST_F(AlsaDeviceProfileTest, ProxyScanRates) {
+    alsa_device_profile profile;
+    profile_init(&profile, PCM_OUT);
+    profile.card = kCard;
+    profile.device = 0;
+    ASSERT_TRUE(profile_read_device_info(&profile));
+    const unsigned opens = fake_pcm_get_opens();
+
+    struct pcm_config config = profile.default_config;
+    config.rate = 96000;
+    alsa_device_proxy proxy;
+    EXPECT_EQ(0, proxy_prepare(&proxy, &profile, &config, false));
+    EXPECT_EQ(96000u, proxy.alsa_config.rate);
+    EXPECT_EQ(opens + 1, fake_pcm_get_opens());
+
+    writeStream(kCard, kStream);
+    EXPECT_EQ(0, proxy_prepare(&proxy, &profile, &config, false));
+    EXPECT_EQ(96000u, proxy.alsa_config.rate);
+    EXPECT_EQ(opens + 1, fake_pcm_get_opens());
+}
+
+}  // namespace
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fake_pcm.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#define MAX_FAKE_PCM_RATES 16
+
+struct pcm {
+    bool ready;
+    int error;
+};
+
+struct pcm_params {
+    struct pcm_mask format_mask;
+};
+
+static struct {
+    unsigned int min[PCM_PARAM_TICK_TIME + 1];
+    unsigned int max[PCM_PARAM_TICK_TIME + 1];
+    unsigned int formats;   /* bit mask of enum pcm_format */
+    unsigned int num_rates;
+    unsigned int rates[MAX_FAKE_PCM_RATES];
+    unsigned int failed_opens;
+    int failed_open_error;
+    unsigned int opens;
+    unsigned int params_reads;
+} fake_pcm;
+
+/* The bits of the pcm_mask of the formats, which are those of SNDRV_PCM_FORMAT_* */
+static const unsigned int format_mask_bits[] = {
+    [PCM_FORMAT_S16_LE] = 2,
+    [PCM_FORMAT_S32_LE] = 10,
+    [PCM_FORMAT_S8] = 0,
+    [PCM_FORMAT_S24_LE] = 6,
+    [PCM_FORMAT_S24_3LE] = 32,
+};
+
+void fake_pcm_clear(void)
+{
+    memset(&fake_pcm, 0, sizeof(fake_pcm));
+}
+
+void fake_pcm_set_interval(enum pcm_param param, unsigned int min, unsigned int max)
+{
+    fake_pcm.min[param] = min;
+    fake_pcm.max[param] = max;
+}
+
+void fake_pcm_add_format(enum pcm_format format)
+{
+    fake_pcm.formats |= 1u << format;
+}
+
+void fake_pcm_add_rate(unsigned int rate)
+{
+    if (fake_pcm.num_rates < ARRAY_SIZE(fake_pcm.rates)) {
+        fake_pcm.rates[fake_pcm.num_rates++] = rate;
+    }
+}
+
+void fake_pcm_fail_opens(unsigned int count, int err)
+{
+    fake_pcm.failed_opens = count;
+    fake_pcm.failed_open_error = err;
+}
+
+unsigned int fake_pcm_get_opens(void)
+{
+    return fake_pcm.opens;
+}
+
+unsigned int fake_pcm_get_params_reads(void)
+{
+    return fake_pcm.params_reads;
+}
+
+struct pcm_params *pcm_params_get(unsigned int card, unsigned int device,
+                                  unsigned int flags)
+{
+    fake_pcm.params_reads++;
+    if (fake_pcm.formats == 0) {
+        return NULL;
+    }
+    struct pcm_params * params = calloc(1, sizeof(struct pcm_params));
+    if (params == NULL) {
+        return NULL;
+    }
+    const unsigned int bits_per_slot = sizeof(params->format_mask.bits[0]) * 8;
+    size_t format;
+    for (format = 0; format < ARRAY_SIZE(format_mask_bits); format++) {
+        if ((fake_pcm.formats & (1u << format)) != 0) {
+            const unsigned int bit = format_mask_bits[format];
+            params->format_mask.bits[bit / bits_per_slot] |= 1u << (bit % bits_per_slot);
+        }
+    }
+    return params;
+}
+
+void pcm_params_free(struct pcm_params *pcm_params)
+{
+    free(pcm_params);
+}
+
+const struct pcm_mask *pcm_params_get_mask(const struct pcm_params *pcm_params,
+                                           enum pcm_param param)
+{
+    return param == PCM_PARAM_FORMAT ? &pcm_params->format_mask : NULL;
+}
+
+unsigned int pcm_params_get_min(const struct pcm_params *pcm_params,
+                                enum pcm_param param)
+{
+    return fake_pcm.min[param];
+}
+
+unsigned int pcm_params_get_max(const struct pcm_params *pcm_params,
+                                enum pcm_param param)
+{
+    return fake_pcm.max[param];
+}
+
+/*
+ * Like tinyalsa, returns a pcm which is not ready if the device does not open, with errno
+ * EINVAL if the device does not support the configuration.
+ */
+struct pcm *pcm_open(unsigned int card, unsigned int device,
+                     unsigned int flags, struct pcm_config *config)
+{
+    fake_pcm.opens++;
+    struct pcm * pcm = calloc(1, sizeof(struct pcm));
+    if (pcm == NULL) {
+        return NULL;
+    }
+    if (fake_pcm.failed_opens > 0) {
+        fake_pcm.failed_opens--;
+        pcm->error = errno = fake_pcm.failed_open_error;
+        return pcm;
+    }
+    pcm->error = EINVAL;
+    if (config->format >= 0 && (fake_pcm.formats & (1u << config->format)) != 0 &&
+            config->channels >= fake_pcm.min[PCM_PARAM_CHANNELS] &&
+            config->channels <= fake_pcm.max[PCM_PARAM_CHANNELS]) {
+        size_t index;
+        for (index = 0; index < fake_pcm.num_rates; index++) {
+            if (fake_pcm.rates[index] == config->rate) {
+                pcm->ready = true;
+                pcm->error = 0;
+            }
+        }
+    }
+    if (!pcm->ready) {
+        errno = pcm->error;
+    }
+    return pcm;
+}
+
+int pcm_is_ready(struct pcm *pcm)
+{
+    return pcm->ready;
+}
+
+const char *pcm_get_error(struct pcm *pcm)
+{
+    return strerror(pcm->error);
+}
+
+int pcm_close(struct pcm *pcm)
+{
+    free(pcm);
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SYSTEM_MEDIA_ALSA_UTILS_FAKE_PCM_H
+#define ANDROID_SYSTEM_MEDIA_ALSA_UTILS_FAKE_PCM_H
+
+#include <tinyalsa/asoundlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * A fake PCM device, which replaces the tinyalsa functions used to probe a device, so
+ * that alsa_utils can be tested without a sound card. The device has the hardware
+ * parameters it is given, opens at the rates it is given, and counts the accesses to it.
+ */
+
+/* Remove the parameters, rates and counts of the fake device */
+void fake_pcm_clear(void);
+
+/* Set the interval of a hardware parameter, such as PCM_PARAM_RATE */
+void fake_pcm_set_interval(enum pcm_param param, unsigned int min, unsigned int max);
+
+/* Add a format to the hardware parameters */
+void fake_pcm_add_format(enum pcm_format format);
+
+/*
+ * Add a rate at which the device opens, with a format and channel count of its
+ * hardware parameters.
+ */
+void fake_pcm_add_rate(unsigned int rate);
+
+/*
+ * Make the next count opens fail with the errno err, whatever their configuration, as when
+ * the device is not ready.
+ */
+void fake_pcm_fail_opens(unsigned int count, int err);
+
+/* Get the number of pcm_open() and pcm_params_get() calls */
+unsigned int fake_pcm_get_opens(void);
+unsigned int fake_pcm_get_params_reads(void);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif /* ANDROID_SYSTEM_MEDIA_ALSA_UTILS_FAKE_PCM_H */
@@ -20,9 +20,15 @@
 
 #include <errno.h>
 #include <expat.h>
+#include <fcntl.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <log/log.h>
 
@@ -31,6 +37,7 @@
 #define BUF_SIZE 1024
 #define MIXER_XML_PATH "/system/etc/mixer_paths.xml"
 #define INITIAL_MIXER_PATH_SIZE 8
+#define INITIAL_PATH_INDEX_SIZE 16
 
 enum update_direction {
     DIRECTION_FORWARD,
@@ -47,10 +54,15 @@ union ctl_values {
 
 struct mixer_state {
     struct mixer_ctl *ctl;
+    enum mixer_ctl_type type;
     unsigned int num_values;
+    size_t value_size; /* in bytes, of num_values values */
+    bool dirty; /* in the dirty set of the audio_route */
+    bool in_transaction; /* updated in the transaction of the audio_route */
     union ctl_values old_value;
     union ctl_values new_value;
     union ctl_values reset_value;
+    union ctl_values committed_value; /* in the mixer, if in the transaction */
     unsigned int active_count;
 };
 
@@ -76,6 +88,7 @@ struct mixer_value {
 
 struct mixer_path {
     char *name;
+    uint32_t name_hash;
     unsigned int size;
     unsigned int length;
     struct mixer_setting *setting;
@@ -89,12 +102,50 @@ struct audio_route {
     unsigned int mixer_path_size;
     unsigned int num_mixer_paths;
     struct mixer_path *mixer_path;
+
+    /*
+     * Hash table of the paths by name, open addressed with linear probing. Each
+     * slot holds 1 + the index of a path, or 0 if empty. It is at most half
+     * full, so that probe sequences stay short.
+     */
+    unsigned int path_index_size;
+    unsigned int *path_index;
+
+    /*
+     * Indexes of the controls whose new value may differ from their old value,
+     * the only ones that audio_route_update_mixer() needs to visit.
+     */
+    unsigned int num_dirty_ctls;
+    unsigned int *dirty_ctls;
+
+    /*
+     * In a transaction, the updates of the controls are not written to the
+     * mixer: the old values of the controls are the values they will have at
+     * the commit. Indexes of the controls updated in the transaction.
+     */
+    bool in_transaction;
+    unsigned int num_transaction_ctls;
+    unsigned int *transaction_ctls;
+
+    /*
+     * The cache the paths were loaded from, if any: their names and values
+     * point into it, and their settings into cache_settings.
+     */
+    void *cache;
+    size_t cache_size;
+    struct mixer_setting *cache_settings;
 };
 
 struct config_parse_state {
     struct audio_route *ar;
     struct mixer_path *path;
     int level;
+
+    /* the top level ctls, recorded for the cache */
+    bool record_initial_settings;
+    unsigned int num_initial_settings;
+    unsigned int initial_settings_size;
+    struct cache_setting *initial_settings;
 };
 
 /* path functions */
@@ -166,6 +217,16 @@ static void path_free(struct audio_route *ar)
 {
     unsigned int i;
 
+    if (ar->cache) {
+        /* the names and values of the paths are in the cache */
+        free(ar->cache_settings);
+        ar->cache_settings = NULL;
+        munmap(ar->cache, ar->cache_size);
+        ar->cache = NULL;
+        ar->cache_size = 0;
+        ar->num_mixer_paths = 0;
+    }
+
     for (i = 0; i < ar->num_mixer_paths; i++) {
         free(ar->mixer_path[i].name);
         if (ar->mixer_path[i].setting) {
@@ -183,18 +244,71 @@ static void path_free(struct audio_route *ar)
     ar->mixer_path = NULL;
     ar->mixer_path_size = 0;
     ar->num_mixer_paths = 0;
+    free(ar->path_index);
+    ar->path_index = NULL;
+    ar->path_index_size = 0;
 }
 
-static struct mixer_path *path_get_by_name(struct audio_route *ar,
-                                           const char *name)
+/* FNV-1a hash of a path name */
+static uint32_t path_name_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    for (; *name != '\0'; name++) {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Returns the slot of the path index holding the path name, or the empty slot to insert it */
+static unsigned int *path_index_find_slot(struct audio_route *ar, const char *name,
+                                          uint32_t name_hash)
 {
+    unsigned int mask = ar->path_index_size - 1;
+    unsigned int slot;
+
+    for (slot = name_hash & mask; ar->path_index[slot] != 0; slot = (slot + 1) & mask) {
+        struct mixer_path *path = &ar->mixer_path[ar->path_index[slot] - 1];
+
+        if (path->name_hash == name_hash && strcmp(path->name, name) == 0)
+            break;
+    }
+    return &ar->path_index[slot];
+}
+
+static int path_index_grow(struct audio_route *ar)
+{
+    unsigned int size = ar->path_index_size == 0 ?
+            INITIAL_PATH_INDEX_SIZE : ar->path_index_size * 2;
+    unsigned int *path_index;
     unsigned int i;
 
+    path_index = calloc(size, sizeof(unsigned int));
+    if (path_index == NULL) {
+        ALOGE("Unable to allocate the path index");
+        return -1;
+    }
+    free(ar->path_index);
+    ar->path_index = path_index;
+    ar->path_index_size = size;
+
     for (i = 0; i < ar->num_mixer_paths; i++)
-        if (strcmp(ar->mixer_path[i].name, name) == 0)
-            return &ar->mixer_path[i];
+        *path_index_find_slot(ar, ar->mixer_path[i].name, ar->mixer_path[i].name_hash) = i + 1;
 
-    return NULL;
+    return 0;
+}
+
+static struct mixer_path *path_get_by_name(struct audio_route *ar,
+                                           const char *name)
+{
+    unsigned int path_index;
+
+    if (ar->path_index_size == 0)
+        return NULL;
+
+    path_index = *path_index_find_slot(ar, name, path_name_hash(name));
+    return path_index != 0 ? &ar->mixer_path[path_index - 1] : NULL;
 }
 
 static struct mixer_path *path_create(struct audio_route *ar, const char *name)
@@ -206,6 +320,10 @@ static struct mixer_path *path_create(struct audio_route *ar, const char *name)
         return NULL;
     }
 
+    /* keep the path index at most half full */
+    if (ar->path_index_size < (ar->num_mixer_paths + 1) * 2 && path_index_grow(ar) < 0)
+        return NULL;
+
     /* check if we need to allocate more space for mixer paths */
     if (ar->mixer_path_size <= ar->num_mixer_paths) {
         if (ar->mixer_path_size == 0)
@@ -225,9 +343,12 @@ static struct mixer_path *path_create(struct audio_route *ar, const char *name)
 
     /* initialise the new mixer path */
     ar->mixer_path[ar->num_mixer_paths].name = strdup(name);
+    ar->mixer_path[ar->num_mixer_paths].name_hash = path_name_hash(name);
     ar->mixer_path[ar->num_mixer_paths].size = 0;
     ar->mixer_path[ar->num_mixer_paths].length = 0;
     ar->mixer_path[ar->num_mixer_paths].setting = NULL;
+    *path_index_find_slot(ar, name, ar->mixer_path[ar->num_mixer_paths].name_hash) =
+            ar->num_mixer_paths + 1;
 
     /* return the mixer path just added, then increment number of them */
     return &ar->mixer_path[ar->num_mixer_paths++];
@@ -399,23 +520,33 @@ static int path_add_path(struct audio_route *ar, struct mixer_path *path,
     return 0;
 }
 
+/* Adds a control to the dirty set, after a change of its new value */
+static void mixer_state_set_dirty(struct audio_route *ar, unsigned int ctl_index)
+{
+    if (ar->mixer_state[ctl_index].dirty)
+        return;
+
+    ar->mixer_state[ctl_index].dirty = true;
+    ar->dirty_ctls[ar->num_dirty_ctls++] = ctl_index;
+}
+
+/*
+ * The settings of the paths only have controls of supported types, with the
+ * values of the whole control, so they are applied by copying value_size bytes
+ * of the mixer state of their control.
+ */
 static int path_apply(struct audio_route *ar, struct mixer_path *path)
 {
     unsigned int i;
     unsigned int ctl_index;
-    struct mixer_ctl *ctl;
-    enum mixer_ctl_type type;
+    struct mixer_state *ms;
 
     ALOGD("Apply path: %s", path->name != NULL ? path->name : "none");
     for (i = 0; i < path->length; i++) {
         ctl_index = path->setting[i].ctl_index;
-        ctl = index_to_ctl(ar, ctl_index);
-        type = mixer_ctl_get_type(ctl);
-        if (!is_supported_ctl_type(type))
-            continue;
-        size_t value_sz = sizeof_ctl_type(type);
-        memcpy(ar->mixer_state[ctl_index].new_value.ptr, path->setting[i].value.ptr,
-                   path->setting[i].num_values * value_sz);
+        ms = &ar->mixer_state[ctl_index];
+        memcpy(ms->new_value.ptr, path->setting[i].value.ptr, ms->value_size);
+        mixer_state_set_dirty(ar, ctl_index);
     }
 
     return 0;
@@ -425,24 +556,479 @@ static int path_reset(struct audio_route *ar, struct mixer_path *path)
 {
     unsigned int i;
     unsigned int ctl_index;
-    struct mixer_ctl *ctl;
-    enum mixer_ctl_type type;
+    struct mixer_state *ms;
 
     ALOGV("Reset path: %s", path->name != NULL ? path->name : "none");
     for (i = 0; i < path->length; i++) {
         ctl_index = path->setting[i].ctl_index;
-        ctl = index_to_ctl(ar, ctl_index);
-        type = mixer_ctl_get_type(ctl);
-        if (!is_supported_ctl_type(type))
-            continue;
-        size_t value_sz = sizeof_ctl_type(type);
+        ms = &ar->mixer_state[ctl_index];
         /* reset the value(s) */
-        memcpy(ar->mixer_state[ctl_index].new_value.ptr,
-               ar->mixer_state[ctl_index].reset_value.ptr,
-               ar->mixer_state[ctl_index].num_values * value_sz);
+        memcpy(ms->new_value.ptr, ms->reset_value.ptr, ms->value_size);
+        mixer_state_set_dirty(ar, ctl_index);
+    }
+
+    return 0;
+}
+
+/* cache functions */
+
+/*
+ * The cache of a configuration holds its paths, with their settings resolved
+ * to the indexes of their controls and to their values, and its initial
+ * settings, so that it can be loaded without parsing the XML file. It is
+ * mapped in memory, and the names and values of the paths point into it:
+ *
+ *   |-------------------------------------------|
+ *   | struct cache_header                       |
+ *   |-------------------------------------------|
+ *   | struct cache_path[num_paths]              |
+ *   |-------------------------------------------|
+ *   | struct cache_setting[num_settings]        |  settings of the paths
+ *   |-------------------------------------------|
+ *   | struct cache_setting[num_initial_settings]|
+ *   |-------------------------------------------|
+ *   | path names                                |
+ *   |-------------------------------------------|
+ *   | values, each aligned to CACHE_ALIGNMENT   |
+ *   |-------------------------------------------|
+ *
+ * It is only valid for the XML file of the same modification time and size,
+ * and for a card with the same controls. The values are in the layout of the
+ * device, so the cache is not portable. The header holds a hash of the rest of
+ * the cache, so that a cache corrupted on the storage is not loaded.
+ */
+#define CACHE_MAGIC 0x41524346 /* "ARCF" */
+#define CACHE_VERSION 2
+#define CACHE_ALIGNMENT 8
+#define CACHE_HASH_SEED 2166136261u /* FNV-1a offset basis */
+
+#define CACHE_ALIGN(size) (((size) + CACHE_ALIGNMENT - 1) & ~(size_t)(CACHE_ALIGNMENT - 1))
+
+struct cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t long_size;
+    uint32_t size;
+    int64_t xml_mtime_sec;
+    int64_t xml_mtime_nsec;
+    int64_t xml_size;
+    uint32_t num_ctls;
+    uint32_t ctls_hash;
+    uint32_t num_paths;
+    uint32_t num_settings;
+    uint32_t num_initial_settings;
+    uint32_t names_offset;
+    uint32_t names_size;
+    uint32_t values_offset;
+    uint32_t payload_hash; /* of everything after the header */
+};
+
+struct cache_path {
+    uint32_t name_offset; /* in the names */
+    uint32_t name_hash;
+    uint32_t first_setting;
+    uint32_t num_settings;
+};
+
+/* also the initial settings recorded while parsing, with no value_offset */
+struct cache_setting {
+    uint32_t ctl_index;
+    uint32_t first_value;
+    uint32_t num_values;
+    uint32_t value_offset; /* in the values */
+};
+
+/* Continues an FNV-1a hash with bytes */
+static uint32_t cache_hash_bytes(uint32_t hash, const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    const unsigned char *end = p + size;
+
+    for (; p < end; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Continues an FNV-1a hash with a string, and its terminator to delimit it */
+static uint32_t cache_hash_string(uint32_t hash, const char *string)
+{
+    if (string == NULL)
+        string = "";
+    return cache_hash_bytes(hash, string, strlen(string) + 1);
+}
+
+/*
+ * FNV-1a hash of the card name and of the names, types and sizes of its
+ * controls, and of the strings of its enums, as their values are cached as
+ * indexes of the strings.
+ */
+static uint32_t cache_ctls_hash(struct audio_route *ar)
+{
+    uint32_t hash = cache_hash_string(CACHE_HASH_SEED, mixer_get_name(ar->mixer));
+    unsigned int i;
+    unsigned int j;
+
+    for (i = 0; i < ar->num_mixer_ctls; i++) {
+        struct mixer_state *ms = &ar->mixer_state[i];
+        uint32_t attributes[3] = { ms->type, ms->num_values, 0 };
+
+        if (ms->type == MIXER_CTL_TYPE_ENUM)
+            attributes[2] = mixer_ctl_get_num_enums(ms->ctl);
+        hash = cache_hash_string(hash, mixer_ctl_get_name(ms->ctl));
+        hash = cache_hash_bytes(hash, attributes, sizeof(attributes));
+        for (j = 0; j < attributes[2]; j++)
+            hash = cache_hash_string(hash, mixer_ctl_get_enum_string(ms->ctl, j));
+    }
+    return hash;
+}
+
+static void initial_setting_record(struct config_parse_state *state, unsigned int ctl_index,
+                                   unsigned int first_value, unsigned int num_values)
+{
+    struct cache_setting *setting;
+
+    if (state->num_initial_settings == state->initial_settings_size) {
+        unsigned int size = state->initial_settings_size == 0 ?
+                INITIAL_MIXER_PATH_SIZE : state->initial_settings_size * 2;
+
+        setting = realloc(state->initial_settings, size * sizeof(struct cache_setting));
+        if (setting == NULL) {
+            ALOGE("Unable to allocate the initial settings, not caching");
+            state->record_initial_settings = false;
+            return;
+        }
+        state->initial_settings = setting;
+        state->initial_settings_size = size;
+    }
+
+    setting = &state->initial_settings[state->num_initial_settings++];
+    setting->ctl_index = ctl_index;
+    setting->first_value = first_value;
+    setting->num_values = num_values;
+    setting->value_offset = 0;
+}
+
+/*
+ * Writes the cache of the parsed configuration, with the initial settings
+ * recorded while parsing, and their values from the mixer state. The cache is
+ * written to a temporary file synced and renamed when complete, so that it is
+ * never read partially written, even after a power loss.
+ */
+static int cache_write(struct audio_route *ar, struct config_parse_state *state,
+                       const struct stat *xml_stat, const char *cache_path)
+{
+    struct cache_header header;
+    struct cache_path *paths;
+    struct cache_setting *settings;
+    struct cache_setting *initial_settings;
+    size_t size;
+    size_t values_size = 0;
+    size_t num_settings = 0;
+    uint8_t *buf;
+    char *tmp_path;
+    unsigned int i;
+    unsigned int j;
+    int fd;
+    int ret = -1;
+
+    memset(&header, 0, sizeof(header));
+    for (i = 0; i < ar->num_mixer_paths; i++) {
+        struct mixer_path *path = &ar->mixer_path[i];
+
+        num_settings += path->length;
+        header.names_size += strlen(path->name) + 1;
+        for (j = 0; j < path->length; j++)
+            values_size += CACHE_ALIGN(ar->mixer_state[path->setting[j].ctl_index].value_size);
+    }
+    for (i = 0; i < state->num_initial_settings; i++)
+        values_size += CACHE_ALIGN(state->initial_settings[i].num_values *
+                sizeof_ctl_type(ar->mixer_state[state->initial_settings[i].ctl_index].type));
+
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.long_size = sizeof(long);
+    header.xml_mtime_sec = xml_stat->st_mtim.tv_sec;
+    header.xml_mtime_nsec = xml_stat->st_mtim.tv_nsec;
+    header.xml_size = xml_stat->st_size;
+    header.num_ctls = ar->num_mixer_ctls;
+    header.ctls_hash = cache_ctls_hash(ar);
+    header.num_paths = ar->num_mixer_paths;
+    header.num_settings = num_settings;
+    header.num_initial_settings = state->num_initial_settings;
+    header.names_offset = sizeof(header) +
+            ar->num_mixer_paths * sizeof(struct cache_path) +
+            (num_settings + state->num_initial_settings) * sizeof(struct cache_setting);
+    header.values_offset = CACHE_ALIGN(header.names_offset + header.names_size);
+    size = header.values_offset + values_size;
+    if (size > UINT32_MAX) {
+        ALOGW("The configuration is too large to be cached");
+        return -1;
     }
+    header.size = size;
 
+    buf = calloc(1, size);
+    if (buf == NULL) {
+        ALOGE("Unable to allocate the cache");
+        return -1;
+    }
+    paths = (struct cache_path *)(buf + sizeof(header));
+    settings = (struct cache_setting *)(paths + header.num_paths);
+    initial_settings = settings + header.num_settings;
+
+    size_t name_offset = 0;
+    size_t value_offset = 0;
+    num_settings = 0;
+    for (i = 0; i < ar->num_mixer_paths; i++) {
+        struct mixer_path *path = &ar->mixer_path[i];
+        size_t name_size = strlen(path->name) + 1;
+
+        paths[i].name_offset = name_offset;
+        paths[i].name_hash = path->name_hash;
+        paths[i].first_setting = num_settings;
+        paths[i].num_settings = path->length;
+        memcpy(buf + header.names_offset + name_offset, path->name, name_size);
+        name_offset += name_size;
+
+        for (j = 0; j < path->length; j++) {
+            struct mixer_setting *setting = &path->setting[j];
+            size_t value_size = ar->mixer_state[setting->ctl_index].value_size;
+
+            settings[num_settings].ctl_index = setting->ctl_index;
+            settings[num_settings].first_value = 0;
+            settings[num_settings].num_values = setting->num_values;
+            settings[num_settings].value_offset = value_offset;
+            memcpy(buf + header.values_offset + value_offset, setting->value.ptr, value_size);
+            value_offset += CACHE_ALIGN(value_size);
+            num_settings++;
+        }
+    }
+    for (i = 0; i < state->num_initial_settings; i++) {
+        struct cache_setting *setting = &initial_settings[i];
+        struct mixer_state *ms = &ar->mixer_state[state->initial_settings[i].ctl_index];
+        size_t value_sz = sizeof_ctl_type(ms->type);
+
+        *setting = state->initial_settings[i];
+        setting->value_offset = value_offset;
+        memcpy(buf + header.values_offset + value_offset,
+               (uint8_t *)ms->new_value.ptr + setting->first_value * value_sz,
+               setting->num_values * value_sz);
+        value_offset += CACHE_ALIGN(setting->num_values * value_sz);
+    }
+    header.payload_hash = cache_hash_bytes(CACHE_HASH_SEED, buf + sizeof(header),
+                                           size - sizeof(header));
+    memcpy(buf, &header, sizeof(header));
+
+    tmp_path = malloc(strlen(cache_path) + sizeof(".tmp"));
+    if (tmp_path == NULL) {
+        ALOGE("Unable to allocate the cache path");
+        free(buf);
+        return -1;
+    }
+    sprintf(tmp_path, "%s.tmp", cache_path);
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ALOGW("Failed to create %s: %s", tmp_path, strerror(errno));
+    } else {
+        ssize_t written = write(fd, buf, size);
+        /* the file must be on the storage before it replaces the cache */
+        int synced = written == (ssize_t)size ? fsync(fd) : -1;
+
+        close(fd);
+        if (written != (ssize_t)size)
+            ALOGW("Failed to write %s: %s", tmp_path, strerror(errno));
+        else if (synced < 0)
+            ALOGW("Failed to sync %s: %s", tmp_path, strerror(errno));
+        else if (rename(tmp_path, cache_path) < 0)
+            ALOGW("Failed to rename %s: %s", tmp_path, strerror(errno));
+        else
+            ret = 0;
+        if (ret < 0)
+            unlink(tmp_path);
+    }
+
+    free(tmp_path);
+    free(buf);
+    return ret;
+}
+
+/* Returns whether a setting of the cache applies to a control of the card, with its values */
+static bool cache_setting_is_valid(struct audio_route *ar, const struct cache_header *header,
+                                   const struct cache_setting *setting)
+{
+    struct mixer_state *ms;
+    size_t value_sz;
+
+    if (setting->ctl_index >= ar->num_mixer_ctls)
+        return false;
+    ms = &ar->mixer_state[setting->ctl_index];
+    if (!is_supported_ctl_type(ms->type) || setting->first_value > ms->num_values ||
+            setting->num_values > ms->num_values - setting->first_value)
+        return false;
+    value_sz = sizeof_ctl_type(ms->type);
+    return setting->value_offset % CACHE_ALIGNMENT == 0 &&
+            setting->value_offset <= header->size - header->values_offset &&
+            setting->num_values * value_sz <=
+                    header->size - header->values_offset - setting->value_offset;
+}
+
+/*
+ * Loads the paths and the initial settings from the cache, if it is valid for
+ * the XML file and the card. The settings of all the paths are allocated at
+ * once, and point to their values in the cache, which stays mapped.
+ */
+static int cache_load(struct audio_route *ar, const struct stat *xml_stat, const char *cache_path)
+{
+    const struct cache_header *header;
+    const struct cache_path *paths;
+    const struct cache_setting *settings;
+    const struct cache_setting *initial_settings;
+    struct stat cache_stat;
+    void *cache;
+    uint8_t *base;
+    unsigned int i;
+    int fd;
+
+    fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &cache_stat) < 0 || cache_stat.st_size < (off_t)sizeof(struct cache_header)) {
+        close(fd);
+        return -1;
+    }
+    cache = mmap(NULL, cache_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (cache == MAP_FAILED)
+        return -1;
+
+    base = cache;
+    header = cache;
+    if (header->magic != CACHE_MAGIC || header->version != CACHE_VERSION ||
+            header->long_size != sizeof(long) || (off_t)header->size != cache_stat.st_size) {
+        ALOGW("Invalid cache %s", cache_path);
+        goto err;
+    }
+    if (header->payload_hash != cache_hash_bytes(CACHE_HASH_SEED, base + sizeof(*header),
+                                                 header->size - sizeof(*header))) {
+        ALOGW("Corrupted cache %s", cache_path);
+        goto err;
+    }
+    if (header->xml_mtime_sec != xml_stat->st_mtim.tv_sec ||
+            header->xml_mtime_nsec != xml_stat->st_mtim.tv_nsec ||
+            header->xml_size != xml_stat->st_size) {
+        ALOGI("Cache %s out of date", cache_path);
+        goto err;
+    }
+    if (header->num_ctls != ar->num_mixer_ctls || header->ctls_hash != cache_ctls_hash(ar)) {
+        ALOGI("Cache %s for other controls", cache_path);
+        goto err;
+    }
+    if (header->num_paths > (header->size - sizeof(*header)) / sizeof(struct cache_path) ||
+            (uint64_t)header->num_settings + header->num_initial_settings >
+                    (header->size - sizeof(*header) - header->num_paths *
+                            sizeof(struct cache_path)) / sizeof(struct cache_setting) ||
+            header->names_offset != sizeof(*header) +
+                    header->num_paths * sizeof(struct cache_path) +
+                    (header->num_settings + header->num_initial_settings) *
+                            sizeof(struct cache_setting) ||
+            header->names_size > header->size - header->names_offset ||
+            header->values_offset != CACHE_ALIGN(header->names_offset + header->names_size) ||
+            header->values_offset > header->size) {
+        ALOGW("Invalid cache %s", cache_path);
+        goto err;
+    }
+
+    paths = (const struct cache_path *)(base + sizeof(*header));
+    settings = (const struct cache_setting *)(paths + header->num_paths);
+    initial_settings = settings + header->num_settings;
+
+    /* validate everything before changing the audio route */
+    for (i = 0; i < header->num_paths; i++) {
+        if (paths[i].name_offset >= header->names_size ||
+                memchr(base + header->names_offset + paths[i].name_offset, '\0',
+                       header->names_size - paths[i].name_offset) == NULL ||
+                paths[i].first_setting > header->num_settings ||
+                paths[i].num_settings > header->num_settings - paths[i].first_setting)
+            goto err_invalid;
+    }
+    for (i = 0; i < header->num_settings + header->num_initial_settings; i++) {
+        if (!cache_setting_is_valid(ar, header, &settings[i]) ||
+                (i < header->num_settings && (settings[i].first_value != 0 ||
+                        settings[i].num_values !=
+                                ar->mixer_state[settings[i].ctl_index].num_values)))
+            goto err_invalid;
+    }
+
+    ar->path_index_size = INITIAL_PATH_INDEX_SIZE;
+    while (ar->path_index_size < header->num_paths * 2)
+        ar->path_index_size *= 2;
+    ar->path_index = calloc(ar->path_index_size, sizeof(unsigned int));
+    /* one more, so that an empty configuration is not a failed allocation */
+    ar->mixer_path = calloc(header->num_paths + 1, sizeof(struct mixer_path));
+    ar->cache_settings = calloc(header->num_settings + 1, sizeof(struct mixer_setting));
+    if (ar->path_index == NULL || ar->mixer_path == NULL || ar->cache_settings == NULL) {
+        ALOGE("Unable to allocate the paths of the cache");
+        goto err_free;
+    }
+    ar->mixer_path_size = header->num_paths;
+
+    for (i = 0; i < header->num_settings; i++) {
+        struct mixer_setting *setting = &ar->cache_settings[i];
+
+        setting->ctl_index = settings[i].ctl_index;
+        setting->num_values = settings[i].num_values;
+        setting->type = ar->mixer_state[settings[i].ctl_index].type;
+        setting->value.ptr = base + header->values_offset + settings[i].value_offset;
+    }
+    for (i = 0; i < header->num_paths; i++) {
+        struct mixer_path *path = &ar->mixer_path[i];
+        unsigned int *slot;
+
+        path->name = (char *)base + header->names_offset + paths[i].name_offset;
+        path->name_hash = paths[i].name_hash;
+        path->size = paths[i].num_settings;
+        path->length = paths[i].num_settings;
+        path->setting = &ar->cache_settings[paths[i].first_setting];
+        slot = path_index_find_slot(ar, path->name, path->name_hash);
+        if (*slot != 0) {
+            ALOGW("Invalid cache %s, with path '%s' twice", cache_path, path->name);
+            goto err_free;
+        }
+        *slot = i + 1;
+    }
+    ar->num_mixer_paths = header->num_paths;
+
+    for (i = 0; i < header->num_initial_settings; i++) {
+        const struct cache_setting *setting = &initial_settings[i];
+        struct mixer_state *ms = &ar->mixer_state[setting->ctl_index];
+        size_t value_sz = sizeof_ctl_type(ms->type);
+
+        memcpy((uint8_t *)ms->new_value.ptr + setting->first_value * value_sz,
+               base + header->values_offset + setting->value_offset,
+               setting->num_values * value_sz);
+        mixer_state_set_dirty(ar, setting->ctl_index);
+    }
+
+    ar->cache = cache;
+    ar->cache_size = cache_stat.st_size;
     return 0;
+
+err_invalid:
+    ALOGW("Invalid cache %s", cache_path);
+err_free:
+    free(ar->cache_settings);
+    ar->cache_settings = NULL;
+    free(ar->mixer_path);
+    ar->mixer_path = NULL;
+    ar->mixer_path_size = 0;
+    ar->num_mixer_paths = 0;
+    free(ar->path_index);
+    ar->path_index = NULL;
+    ar->path_index_size = 0;
+err:
+    munmap(cache, cache_stat.st_size);
+    return -1;
 }
 
 /* mixer helper function */
@@ -590,9 +1176,14 @@ static void start_tag(void *data, const XML_Char *tag_name,
             type = mixer_ctl_get_type(ctl);
             if (is_supported_ctl_type(type)) {
                 /* apply the new value */
+                unsigned int first_value = 0;
+                unsigned int num_values = ar->mixer_state[ctl_index].num_values;
+
                 if (attr_id) {
                     /* set only one value */
                     id = atoi((char *)attr_id);
+                    first_value = id;
+                    num_values = id < num_values ? 1 : 0;
                     if (id < ar->mixer_state[ctl_index].num_values)
                         if (type == MIXER_CTL_TYPE_BYTE)
                             ar->mixer_state[ctl_index].new_value.bytes[id] = value_array[0];
@@ -617,6 +1208,9 @@ static void start_tag(void *data, const XML_Char *tag_name,
                         else
                             ar->mixer_state[ctl_index].new_value.integer[i] = value;
                 }
+                mixer_state_set_dirty(ar, ctl_index);
+                if (state->record_initial_settings && num_values > 0)
+                    initial_setting_record(state, ctl_index, first_value, num_values);
             }
         } else {
             /* nested ctl (within a path) */
@@ -662,6 +1256,20 @@ static int alloc_mixer_state(struct audio_route *ar)
     if (!ar->mixer_state)
         return -1;
 
+    ar->num_dirty_ctls = 0;
+    ar->dirty_ctls = calloc(ar->num_mixer_ctls, sizeof(unsigned int));
+    ar->num_transaction_ctls = 0;
+    ar->transaction_ctls = calloc(ar->num_mixer_ctls, sizeof(unsigned int));
+    if (!ar->dirty_ctls || !ar->transaction_ctls) {
+        free(ar->dirty_ctls);
+        ar->dirty_ctls = NULL;
+        free(ar->transaction_ctls);
+        ar->transaction_ctls = NULL;
+        free(ar->mixer_state);
+        ar->mixer_state = NULL;
+        return -1;
+    }
+
     for (i = 0; i < ar->num_mixer_ctls; i++) {
         ctl = mixer_get_ctl(ar->mixer, i);
         num_values = mixer_ctl_get_num_values(ctl);
@@ -672,14 +1280,17 @@ static int alloc_mixer_state(struct audio_route *ar)
 
         /* Skip unsupported types that are not supported yet in XML */
         type = mixer_ctl_get_type(ctl);
+        ar->mixer_state[i].type = type;
 
         if (!is_supported_ctl_type(type))
             continue;
 
         size_t value_sz = sizeof_ctl_type(type);
+        ar->mixer_state[i].value_size = num_values * value_sz;
         ar->mixer_state[i].old_value.ptr = calloc(num_values, value_sz);
         ar->mixer_state[i].new_value.ptr = calloc(num_values, value_sz);
         ar->mixer_state[i].reset_value.ptr = calloc(num_values, value_sz);
+        ar->mixer_state[i].committed_value.ptr = calloc(num_values, value_sz);
 
         if (type == MIXER_CTL_TYPE_ENUM)
             ar->mixer_state[i].old_value.enumerated[0] = mixer_ctl_get_value(ctl, 0);
@@ -696,76 +1307,89 @@ static int alloc_mixer_state(struct audio_route *ar)
 static void free_mixer_state(struct audio_route *ar)
 {
     unsigned int i;
-    enum mixer_ctl_type type;
 
     for (i = 0; i < ar->num_mixer_ctls; i++) {
-        type = mixer_ctl_get_type(ar->mixer_state[i].ctl);
-        if (!is_supported_ctl_type(type))
+        if (!is_supported_ctl_type(ar->mixer_state[i].type))
             continue;
 
         free(ar->mixer_state[i].old_value.ptr);
         free(ar->mixer_state[i].new_value.ptr);
         free(ar->mixer_state[i].reset_value.ptr);
+        free(ar->mixer_state[i].committed_value.ptr);
     }
 
     free(ar->mixer_state);
     ar->mixer_state = NULL;
+    free(ar->dirty_ctls);
+    ar->dirty_ctls = NULL;
+    ar->num_dirty_ctls = 0;
+    free(ar->transaction_ctls);
+    ar->transaction_ctls = NULL;
+    ar->num_transaction_ctls = 0;
+}
+
+/* Writes a value of a control to the mixer */
+static void mixer_state_write(struct mixer_state *ms, const union ctl_values *value)
+{
+    if (ms->type == MIXER_CTL_TYPE_ENUM)
+        mixer_ctl_set_value(ms->ctl, 0, value->enumerated[0]);
+    else
+        mixer_ctl_set_array(ms->ctl, value->ptr, ms->num_values);
+}
+
+/*
+ * Updates a control to its new value: writes it to the mixer, or, in a
+ * transaction, saves the value of the control in the mixer on its first update,
+ * for the commit to write it only if it changed.
+ */
+static void mixer_state_update(struct audio_route *ar, unsigned int ctl_index)
+{
+    struct mixer_state *ms = &ar->mixer_state[ctl_index];
+
+    if (!ar->in_transaction) {
+        mixer_state_write(ms, &ms->new_value);
+    } else if (!ms->in_transaction) {
+        ms->in_transaction = true;
+        memcpy(ms->committed_value.ptr, ms->old_value.ptr, ms->value_size);
+        ar->transaction_ctls[ar->num_transaction_ctls++] = ctl_index;
+    }
+
+    memcpy(ms->old_value.ptr, ms->new_value.ptr, ms->value_size);
 }
 
-/* Update the mixer with any changed values */
+static int compare_ctl_index(const void *a, const void *b)
+{
+    unsigned int ctl_index_a = *(const unsigned int *)a;
+    unsigned int ctl_index_b = *(const unsigned int *)b;
+
+    return ctl_index_a < ctl_index_b ? -1 : ctl_index_a > ctl_index_b;
+}
+
+/*
+ * Update the mixer with any changed values. Only the controls of the dirty set
+ * can have changed, and a control changed several times since the last update
+ * is written once, with its last value, or not at all if it is back to its old
+ * value. The controls are written in the order of the card, as when all of them
+ * were compared.
+ */
 int audio_route_update_mixer(struct audio_route *ar)
 {
     unsigned int i;
-    unsigned int j;
-    struct mixer_ctl *ctl;
+    struct mixer_state *ms;
 
-    for (i = 0; i < ar->num_mixer_ctls; i++) {
-        unsigned int num_values = ar->mixer_state[i].num_values;
-        enum mixer_ctl_type type;
+    /* in a transaction, the controls are written in order by the commit */
+    if (ar->num_dirty_ctls > 1 && !ar->in_transaction)
+        qsort(ar->dirty_ctls, ar->num_dirty_ctls, sizeof(unsigned int), compare_ctl_index);
 
-        ctl = ar->mixer_state[i].ctl;
-
-        /* Skip unsupported types */
-        type = mixer_ctl_get_type(ctl);
-        if (!is_supported_ctl_type(type))
-            continue;
+    for (i = 0; i < ar->num_dirty_ctls; i++) {
+        ms = &ar->mixer_state[ar->dirty_ctls[i]];
+        ms->dirty = false;
 
         /* if the value has changed, update the mixer */
-        bool changed = false;
-        if (type == MIXER_CTL_TYPE_BYTE) {
-            for (j = 0; j < num_values; j++) {
-                if (ar->mixer_state[i].old_value.bytes[j] != ar->mixer_state[i].new_value.bytes[j]) {
-                    changed = true;
-                    break;
-                }
-            }
-         } else if (type == MIXER_CTL_TYPE_ENUM) {
-             for (j = 0; j < num_values; j++) {
-                 if (ar->mixer_state[i].old_value.enumerated[j]
-                         != ar->mixer_state[i].new_value.enumerated[j]) {
-                     changed = true;
-                     break;
-                 }
-             }
-         } else {
-            for (j = 0; j < num_values; j++) {
-                if (ar->mixer_state[i].old_value.integer[j] != ar->mixer_state[i].new_value.integer[j]) {
-                    changed = true;
-                    break;
-                }
-            }
-        }
-        if (changed) {
-            if (type == MIXER_CTL_TYPE_ENUM)
-                mixer_ctl_set_value(ctl, 0, ar->mixer_state[i].new_value.enumerated[0]);
-            else
-                mixer_ctl_set_array(ctl, ar->mixer_state[i].new_value.ptr, num_values);
-
-            size_t value_sz = sizeof_ctl_type(type);
-            memcpy(ar->mixer_state[i].old_value.ptr, ar->mixer_state[i].new_value.ptr,
-                   num_values * value_sz);
-        }
+        if (memcmp(ms->old_value.ptr, ms->new_value.ptr, ms->value_size) != 0)
+            mixer_state_update(ar, ar->dirty_ctls[i]);
     }
+    ar->num_dirty_ctls = 0;
 
     return 0;
 }
@@ -774,16 +1398,13 @@ int audio_route_update_mixer(struct audio_route *ar)
 static void save_mixer_state(struct audio_route *ar)
 {
     unsigned int i;
-    enum mixer_ctl_type type;
 
     for (i = 0; i < ar->num_mixer_ctls; i++) {
-        type = mixer_ctl_get_type(ar->mixer_state[i].ctl);
-        if (!is_supported_ctl_type(type))
+        if (!is_supported_ctl_type(ar->mixer_state[i].type))
             continue;
 
-        size_t value_sz = sizeof_ctl_type(type);
         memcpy(ar->mixer_state[i].reset_value.ptr, ar->mixer_state[i].new_value.ptr,
-               ar->mixer_state[i].num_values * value_sz);
+               ar->mixer_state[i].value_size);
     }
 }
 
@@ -791,17 +1412,15 @@ static void save_mixer_state(struct audio_route *ar)
 void audio_route_reset(struct audio_route *ar)
 {
     unsigned int i;
-    enum mixer_ctl_type type;
 
     /* load all of the saved values */
     for (i = 0; i < ar->num_mixer_ctls; i++) {
-        type = mixer_ctl_get_type(ar->mixer_state[i].ctl);
-        if (!is_supported_ctl_type(type))
+        if (!is_supported_ctl_type(ar->mixer_state[i].type))
             continue;
 
-        size_t value_sz = sizeof_ctl_type(type);
         memcpy(ar->mixer_state[i].new_value.ptr, ar->mixer_state[i].reset_value.ptr,
-            ar->mixer_state[i].num_values * value_sz);
+            ar->mixer_state[i].value_size);
+        mixer_state_set_dirty(ar, i);
     }
 }
 
@@ -854,7 +1473,6 @@ int audio_route_reset_path(struct audio_route *ar, const char *name)
 static int audio_route_update_path(struct audio_route *ar, const char *name, int direction)
 {
     struct mixer_path *path;
-    unsigned int j;
     bool reverse = direction != DIRECTION_FORWARD;
     bool force_reset = direction == DIRECTION_REVERSE_RESET;
 
@@ -871,17 +1489,11 @@ static int audio_route_update_path(struct audio_route *ar, const char *name, int
 
     for (size_t i = 0; i < path->length; ++i) {
         unsigned int ctl_index;
-        enum mixer_ctl_type type;
 
         ctl_index = path->setting[reverse ? path->length - 1 - i : i].ctl_index;
 
         struct mixer_state * ms = &ar->mixer_state[ctl_index];
 
-        type = mixer_ctl_get_type(ms->ctl);
-        if (!is_supported_ctl_type(type)) {
-            continue;
-        }
-
         if (reverse && ms->active_count > 0) {
             if (force_reset)
                 ms->active_count = 0;
@@ -891,50 +1503,15 @@ static int audio_route_update_path(struct audio_route *ar, const char *name, int
             ms->active_count++;
         }
 
-       size_t value_sz = sizeof_ctl_type(type);
         /* if any value has changed, update the mixer */
-        for (j = 0; j < ms->num_values; j++) {
-            if (type == MIXER_CTL_TYPE_BYTE) {
-                if (ms->old_value.bytes[j] != ms->new_value.bytes[j]) {
-                    if (reverse && ms->active_count > 0) {
-                        ALOGD("%s: skip to reset mixer control '%s' in path '%s' "
-                            "because it is still needed by other paths", __func__,
-                            mixer_ctl_get_name(ms->ctl), name);
-                        memcpy(ms->new_value.bytes, ms->old_value.bytes,
-                            ms->num_values * value_sz);
-                        break;
-                    }
-                    mixer_ctl_set_array(ms->ctl, ms->new_value.bytes, ms->num_values);
-                    memcpy(ms->old_value.bytes, ms->new_value.bytes, ms->num_values * value_sz);
-                    break;
-                }
-            } else if (type == MIXER_CTL_TYPE_ENUM) {
-                if (ms->old_value.enumerated[j] != ms->new_value.enumerated[j]) {
-                    if (reverse && ms->active_count > 0) {
-                        ALOGD("%s: skip to reset mixer control '%s' in path '%s' "
-                            "because it is still needed by other paths", __func__,
-                            mixer_ctl_get_name(ms->ctl), name);
-                        memcpy(ms->new_value.enumerated, ms->old_value.enumerated,
-                            ms->num_values * value_sz);
-                        break;
-                    }
-                    mixer_ctl_set_value(ms->ctl, 0, ms->new_value.enumerated[0]);
-                    memcpy(ms->old_value.enumerated, ms->new_value.enumerated,
-                            ms->num_values * value_sz);
-                    break;
-                }
-            } else if (ms->old_value.integer[j] != ms->new_value.integer[j]) {
-                if (reverse && ms->active_count > 0) {
-                    ALOGD("%s: skip to reset mixer control '%s' in path '%s' "
-                        "because it is still needed by other paths", __func__,
-                        mixer_ctl_get_name(ms->ctl), name);
-                    memcpy(ms->new_value.integer, ms->old_value.integer,
-                        ms->num_values * value_sz);
-                    break;
-                }
-                mixer_ctl_set_array(ms->ctl, ms->new_value.integer, ms->num_values);
-                memcpy(ms->old_value.integer, ms->new_value.integer, ms->num_values * value_sz);
-                break;
+        if (memcmp(ms->old_value.ptr, ms->new_value.ptr, ms->value_size) != 0) {
+            if (reverse && ms->active_count > 0) {
+                ALOGD("%s: skip to reset mixer control '%s' in path '%s' "
+                    "because it is still needed by other paths", __func__,
+                    mixer_ctl_get_name(ms->ctl), name);
+                memcpy(ms->new_value.ptr, ms->old_value.ptr, ms->value_size);
+            } else {
+                mixer_state_update(ar, ctl_index);
             }
         }
     }
@@ -966,42 +1543,76 @@ int audio_route_force_reset_and_update_path(struct audio_route *ar, const char *
     return audio_route_update_path(ar, name, DIRECTION_REVERSE_RESET);
 }
 
-struct audio_route *audio_route_init(unsigned int card, const char *xml_path)
+int audio_route_begin_transaction(struct audio_route *ar)
 {
-    struct config_parse_state state;
-    XML_Parser parser;
-    FILE *file;
-    int bytes_read;
-    void *buf;
-    struct audio_route *ar;
+    if (!ar) {
+        ALOGE("invalid audio_route");
+        return -1;
+    }
 
-    ar = calloc(1, sizeof(struct audio_route));
-    if (!ar)
-        goto err_calloc;
+    if (ar->in_transaction) {
+        ALOGE("a transaction is already in progress");
+        return -1;
+    }
 
-    ar->mixer = mixer_open(card);
-    if (!ar->mixer) {
-        ALOGE("Unable to open the mixer, aborting.");
-        goto err_mixer_open;
+    ar->in_transaction = true;
+
+    return 0;
+}
+
+/*
+ * Commits the transaction: updates the mixer with the changed values, and writes
+ * the controls updated in the transaction that end with a value other than the
+ * one they had in the mixer, once, in the order of the card.
+ */
+int audio_route_commit_transaction(struct audio_route *ar)
+{
+    unsigned int i;
+    struct mixer_state *ms;
+
+    if (!ar) {
+        ALOGE("invalid audio_route");
+        return -1;
     }
 
-    ar->mixer_path = NULL;
-    ar->mixer_path_size = 0;
-    ar->num_mixer_paths = 0;
+    if (!ar->in_transaction) {
+        ALOGE("no transaction in progress");
+        return -1;
+    }
 
-    /* allocate space for and read current mixer settings */
-    if (alloc_mixer_state(ar) < 0)
-        goto err_mixer_state;
+    audio_route_update_mixer(ar);
+    ar->in_transaction = false;
 
-    /* use the default XML path if none is provided */
-    if (xml_path == NULL)
-        xml_path = MIXER_XML_PATH;
+    if (ar->num_transaction_ctls > 1)
+        qsort(ar->transaction_ctls, ar->num_transaction_ctls, sizeof(unsigned int),
+              compare_ctl_index);
+
+    for (i = 0; i < ar->num_transaction_ctls; i++) {
+        ms = &ar->mixer_state[ar->transaction_ctls[i]];
+        ms->in_transaction = false;
+
+        if (memcmp(ms->committed_value.ptr, ms->old_value.ptr, ms->value_size) != 0)
+            mixer_state_write(ms, &ms->old_value);
+    }
+    ar->num_transaction_ctls = 0;
+
+    return 0;
+}
+
+/* Parses the XML file of the configuration into the audio route of the state */
+static int config_parse(struct config_parse_state *state, const char *xml_path)
+{
+    XML_Parser parser;
+    FILE *file;
+    int bytes_read;
+    void *buf;
+    int ret = -1;
 
     file = fopen(xml_path, "r");
 
     if (!file) {
         ALOGE("Failed to open %s: %s", xml_path, strerror(errno));
-        goto err_fopen;
+        return -1;
     }
 
     parser = XML_ParserCreate(NULL);
@@ -1010,9 +1621,7 @@ struct audio_route *audio_route_init(unsigned int card, const char *xml_path)
         goto err_parser_create;
     }
 
-    memset(&state, 0, sizeof(state));
-    state.ar = ar;
-    XML_SetUserData(parser, &state);
+    XML_SetUserData(parser, state);
     XML_SetElementHandler(parser, start_tag, end_tag);
 
     for (;;) {
@@ -1033,22 +1642,72 @@ struct audio_route *audio_route_init(unsigned int card, const char *xml_path)
         if (bytes_read == 0)
             break;
     }
+    ret = 0;
+
+err_parse:
+    XML_ParserFree(parser);
+err_parser_create:
+    fclose(file);
+    return ret;
+}
+
+struct audio_route *audio_route_init_with_cache(unsigned int card, const char *xml_path,
+                                                const char *cache_path)
+{
+    struct config_parse_state state;
+    struct stat xml_stat;
+    struct audio_route *ar;
+
+    ar = calloc(1, sizeof(struct audio_route));
+    if (!ar)
+        goto err_calloc;
+
+    ar->mixer = mixer_open(card);
+    if (!ar->mixer) {
+        ALOGE("Unable to open the mixer, aborting.");
+        goto err_mixer_open;
+    }
+
+    ar->mixer_path = NULL;
+    ar->mixer_path_size = 0;
+    ar->num_mixer_paths = 0;
+
+    /* allocate space for and read current mixer settings */
+    if (alloc_mixer_state(ar) < 0)
+        goto err_mixer_state;
+
+    /* use the default XML path if none is provided */
+    if (xml_path == NULL)
+        xml_path = MIXER_XML_PATH;
+
+    /* the cache is only used if the XML file can be checked against it */
+    if (cache_path != NULL && stat(xml_path, &xml_stat) < 0) {
+        ALOGW("Failed to stat %s: %s", xml_path, strerror(errno));
+        cache_path = NULL;
+    }
+
+    if (cache_path == NULL || cache_load(ar, &xml_stat, cache_path) < 0) {
+        memset(&state, 0, sizeof(state));
+        state.ar = ar;
+        state.record_initial_settings = cache_path != NULL;
+        if (config_parse(&state, xml_path) < 0) {
+            free(state.initial_settings);
+            goto err_parse;
+        }
+        if (state.record_initial_settings)
+            cache_write(ar, &state, &xml_stat, cache_path);
+        free(state.initial_settings);
+    }
 
     /* apply the initial mixer values, and save them so we can reset the
        mixer to the original values */
     audio_route_update_mixer(ar);
     save_mixer_state(ar);
 
-    XML_ParserFree(parser);
-    fclose(file);
     return ar;
 
 err_parse:
     path_free(ar);
-    XML_ParserFree(parser);
-err_parser_create:
-    fclose(file);
-err_fopen:
     free_mixer_state(ar);
 err_mixer_state:
     mixer_close(ar->mixer);
@@ -1059,6 +1718,11 @@ err_calloc:
     return NULL;
 }
 
+struct audio_route *audio_route_init(unsigned int card, const char *xml_path)
+{
+    return audio_route_init_with_cache(card, xml_path, NULL);
+}
+
 void audio_route_free(struct audio_route *ar)
 {
     free_mixer_state(ar);
@@ -0,0 +1,306 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <audio_route/audio_route.h>
+#include <fake_mixer.h>
+
+#include <stdio.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+/*
+Device switches on a fake sound card, with a synthetic mixer_paths.xml of 4 controls per
+path: half of them stereo integer, a quarter boolean and a quarter enumerated. A path
+sets 6 controls, and every 4th path also includes the previous one. The first argument is the
+number of paths, and the second, for the device switches, is 1 if each path including
+another one is switched to from the path it includes, as for a switch from the
+headphones to the headphones and the speaker.
+
+BM_AudioRouteSwitchPath resets the path of the previous device and applies the path of
+the next one, with audio_route_reset_and_update_path() and
+audio_route_apply_and_update_path(). BM_AudioRouteUpdateMixer does the same with
+audio_route_reset_path(), audio_route_apply_path() and audio_route_update_mixer().
+
+On a single core x86_64 host, median of 7 repetitions, where the paths were looked up
+by a linear scan and the controls of each setting queried for their type:
+
+BM_AudioRouteSwitchPath/100/0         1184 ns
+BM_AudioRouteSwitchPath/1000/0        8408 ns
+BM_AudioRouteSwitchPath/4000/0       30599 ns
+BM_AudioRouteUpdateMixer/100          3098 ns
+BM_AudioRouteUpdateMixer/1000        18501 ns
+BM_AudioRouteUpdateMixer/4000       122837 ns
+
+and with the hashed path index and the sizes of the values kept in the mixer state:
+
+BM_AudioRouteSwitchPath/100/0          386 ns
+BM_AudioRouteSwitchPath/1000/0         295 ns
+BM_AudioRouteSwitchPath/4000/0         384 ns
+BM_AudioRouteUpdateMixer/100          1498 ns
+BM_AudioRouteUpdateMixer/1000        15009 ns
+BM_AudioRouteUpdateMixer/4000        68924 ns
+
+A device switch no longer depends on the number of paths. With the dirty set of the
+controls changed since the last audio_route_update_mixer(), neither does the update:
+
+BM_AudioRouteUpdateMixer/100           532 ns
+BM_AudioRouteUpdateMixer/1000          619 ns
+BM_AudioRouteUpdateMixer/4000          549 ns
+
+BM_AudioRouteSwitchPathTransaction does the device switches in a transaction, committed
+after applying the next path. The counter is the number of writes to the mixer per
+switch, each an ioctl on a device, taking from a few to tens of us:
+
+BM_AudioRouteSwitchPath/1000/0                   327 ns   writes=11.97
+BM_AudioRouteSwitchPath/1000/1                   397 ns   writes=12.97
+BM_AudioRouteSwitchPathTransaction/1000/0        686 ns   writes=11.97
+BM_AudioRouteSwitchPathTransaction/1000/1        637 ns   writes=8.97
+
+Paths sharing controls no longer write the intermediate values of the controls, for the
+cost of the bookkeeping of the transaction.
+*/
+
+static constexpr unsigned int kCtlsPerPath = 4;
+static constexpr unsigned int kSettingsPerPath = 6;
+static constexpr unsigned int kEnumCount = 4;
+static const char* const kEnumStrings[kEnumCount] = { "Off", "Low", "Mid", "High" };
+
+static std::string getCtlName(unsigned int ctl) {
+    return "Synthetic Control " + std::to_string(ctl);
+}
+
+static std::string getPathName(unsigned int path) {
+    return "synthetic-path-" + std::to_string(path);
+}
+
+static std::string getCtlValue(unsigned int ctl, unsigned int value) {
+    switch (ctl % 4) {
+    case 0:
+    case 1:
+        return std::to_string(value % 100) + " " + std::to_string((value + 1) % 100);
+    case 2:
+        return std::to_string(value % 2);
+    default:
+        return kEnumStrings[value % kEnumCount];
+    }
+}
+
+/*
+ * Adds the controls of a configuration with pathCount paths to the fake card, and writes
+ * its mixer_paths.xml to a temporary file. Returns the path of the file, or an empty
+ * string on error.
+ */
+static std::string createConfig(unsigned int pathCount) {
+    const unsigned int ctlCount = pathCount * kCtlsPerPath;
+    fake_mixer_clear();
+    for (unsigned int ctl = 0; ctl < ctlCount; ++ctl) {
+        const std::string name = getCtlName(ctl);
+        switch (ctl % 4) {
+        case 0:
+        case 1:
+            fake_mixer_add_ctl(name.c_str(), MIXER_CTL_TYPE_INT, 2, nullptr, 0);
+            break;
+        case 2:
+            fake_mixer_add_ctl(name.c_str(), MIXER_CTL_TYPE_BOOL, 1, nullptr, 0);
+            break;
+        default:
+            fake_mixer_add_ctl(name.c_str(), MIXER_CTL_TYPE_ENUM, 1, kEnumStrings, kEnumCount);
+            break;
+        }
+    }
+
+    std::string xml = "<mixer>\n";
+    for (unsigned int ctl = 0; ctl < ctlCount; ++ctl) {
+        xml += "  <ctl name=\"" + getCtlName(ctl) + "\" value=\"" + getCtlValue(ctl, 0)
+                + "\" />\n";
+    }
+    for (unsigned int path = 0; path < pathCount; ++path) {
+        xml += "  <path name=\"" + getPathName(path) + "\">\n";
+        if (path % 4 == 3) {
+            xml += "    <path name=\"" + getPathName(path - 1) + "\" />\n";
+        }
+        for (unsigned int i = 0; i < kSettingsPerPath; ++i) {
+            // spread the controls of a path over the card
+            const unsigned int ctl = (path * kCtlsPerPath + i * 7919) % ctlCount;
+            xml += "    <ctl name=\"" + getCtlName(ctl) + "\" value=\""
+                    + getCtlValue(ctl, path + i + 1) + "\" />\n";
+        }
+        xml += "  </path>\n";
+    }
+    xml += "</mixer>\n";
+
+#ifdef __ANDROID__
+    char filePath[] = "/data/local/tmp/audio_route_benchmark_XXXXXX";
+#else
+    char filePath[] = "/tmp/audio_route_benchmark_XXXXXX";
+#endif
+    const int fd = mkstemp(filePath);
+    if (fd < 0) return {};
+    const bool written = write(fd, xml.data(), xml.size()) == (ssize_t)xml.size();
+    close(fd);
+    if (!written) {
+        unlink(filePath);
+        return {};
+    }
+    return filePath;
+}
+
+/*
+ * Returns the paths of a sequence of device switches, as names. If nested, each path
+ * including another one is preceded by the path it includes, as for a switch from
+ * the headphones to the headphones and the speaker.
+ */
+static std::vector<std::string> getSwitchSequence(unsigned int pathCount, bool nested = false) {
+    std::vector<std::string> names;
+    unsigned int path = 0;
+    for (unsigned int i = 0; i < 64; ++i) {
+        path = (path * 1103515245 + 12345) % pathCount;
+        if (nested) {
+            path |= 3;
+            names.push_back(getPathName(path - 1));
+        }
+        names.push_back(getPathName(path));
+    }
+    return names;
+}
+
+static struct audio_route* initAudioRoute(benchmark::State& state, std::string* xmlPath) {
+    *xmlPath = createConfig(state.range(0));
+    if (xmlPath->empty()) {
+        state.SkipWithError("cannot write mixer_paths.xml");
+        return nullptr;
+    }
+    struct audio_route* ar = audio_route_init(0, xmlPath->c_str());
+    if (ar == nullptr) {
+        unlink(xmlPath->c_str());
+        state.SkipWithError("cannot parse mixer_paths.xml");
+    }
+    return ar;
+}
+
+static void BM_AudioRouteSwitchPath(benchmark::State& state) {
+    std::string xmlPath;
+    struct audio_route* ar = initAudioRoute(state, &xmlPath);
+    if (ar == nullptr) return;
+    const std::vector<std::string> names = getSwitchSequence(state.range(0), state.range(1));
+    size_t i = 0;
+    audio_route_apply_and_update_path(ar, names[i].c_str());
+    const unsigned int writes = fake_mixer_get_writes();
+    for (auto _ : state) {
+        audio_route_reset_and_update_path(ar, names[i].c_str());
+        i = (i + 1) % names.size();
+        audio_route_apply_and_update_path(ar, names[i].c_str());
+    }
+    state.counters["writes"] = (double)(fake_mixer_get_writes() - writes) / state.iterations();
+    audio_route_free(ar);
+    unlink(xmlPath.c_str());
+}
+
+static void BM_AudioRouteSwitchPathTransaction(benchmark::State& state) {
+    std::string xmlPath;
+    struct audio_route* ar = initAudioRoute(state, &xmlPath);
+    if (ar == nullptr) return;
+    const std::vector<std::string> names = getSwitchSequence(state.range(0), state.range(1));
+    size_t i = 0;
+    audio_route_apply_and_update_path(ar, names[i].c_str());
+    const unsigned int writes = fake_mixer_get_writes();
+    for (auto _ : state) {
+        audio_route_begin_transaction(ar);
+        audio_route_reset_and_update_path(ar, names[i].c_str());
+        i = (i + 1) % names.size();
+        audio_route_apply_and_update_path(ar, names[i].c_str());
+        audio_route_commit_transaction(ar);
+    }
+    state.counters["writes"] = (double)(fake_mixer_get_writes() - writes) / state.iterations();
+    audio_route_free(ar);
+    unlink(xmlPath.c_str());
+}
+
+static void BM_AudioRouteUpdateMixer(benchmark::State& state) {
+    std::string xmlPath;
+    struct audio_route* ar = initAudioRoute(state, &xmlPath);
+    if (ar == nullptr) return;
+    const std::vector<std::string> names = getSwitchSequence(state.range(0));
+    size_t i = 0;
+    audio_route_apply_path(ar, names[i].c_str());
+    audio_route_update_mixer(ar);
+    for (auto _ : state) {
+        audio_route_reset_path(ar, names[i].c_str());
+        i = (i + 1) % names.size();
+        audio_route_apply_path(ar, names[i].c_str());
+        audio_route_update_mixer(ar);
+    }
+    audio_route_free(ar);
+    unlink(xmlPath.c_str());
+}
+
+/*
+Time to initialize the audio routes, on a fake sound card, with the synthetic
+mixer_paths.xml. The first argument is the number of paths, and the second is 1 if the
+configuration is loaded from its cache with audio_route_init_with_cache(), instead of
+parsing the XML file with audio_route_init().
+
+On a single core x86_64 host, median of 7 repetitions:
+
+BM_AudioRouteInit/100/0            1719 us
+BM_AudioRouteInit/1000/0         113217 us
+BM_AudioRouteInit/4000/0        1828863 us
+BM_AudioRouteInit/100/1              99 us
+BM_AudioRouteInit/1000/1            958 us
+BM_AudioRouteInit/4000/1           4530 us
+
+Parsing looks up each control of the file by name among the controls of the card, as
+mixer_get_ctl_by_name() of tinyalsa does, so it grows with the square of the size of
+the configuration. The cache resolves the controls once, and is loaded in linear time.
+*/
+static void BM_AudioRouteInit(benchmark::State& state) {
+    const std::string xmlPath = createConfig(state.range(0));
+    if (xmlPath.empty()) {
+        state.SkipWithError("cannot write mixer_paths.xml");
+        return;
+    }
+    const bool cached = state.range(1) != 0;
+    const std::string cachePath = xmlPath + ".cache";
+    if (cached) {
+        // write the cache
+        struct audio_route* ar =
+                audio_route_init_with_cache(0, xmlPath.c_str(), cachePath.c_str());
+        if (ar != nullptr) audio_route_free(ar);
+    }
+    for (auto _ : state) {
+        struct audio_route* ar = cached
+                ? audio_route_init_with_cache(0, xmlPath.c_str(), cachePath.c_str())
+                : audio_route_init(0, xmlPath.c_str());
+        if (ar == nullptr) {
+            state.SkipWithError("cannot initialize the audio routes");
+            break;
+        }
+        audio_route_free(ar);
+    }
+    unlink(cachePath.c_str());
+    unlink(xmlPath.c_str());
+}
+
+BENCHMARK(BM_AudioRouteSwitchPath)->ArgsProduct({{100, 1000, 4000}, {0}})->Args({1000, 1});
+BENCHMARK(BM_AudioRouteUpdateMixer)->Arg(100)->Arg(1000)->Arg(4000);
+BENCHMARK(BM_AudioRouteSwitchPathTransaction)->ArgsProduct({{1000}, {0, 1}});
+BENCHMARK(BM_AudioRouteInit)->ArgsProduct({{100, 1000, 4000}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -25,6 +25,14 @@ extern "C" {
 struct audio_route *audio_route_init(unsigned int card, const char *xml_path);
 void audio_route_free(struct audio_route *ar);
 
+/*
+ * Initialize the audio routes with a cache of the parsed XML file in cache_path,
+ * loaded instead of parsing the file if it is valid for the file and the card, or
+ * written after parsing it otherwise
+ */
+struct audio_route *audio_route_init_with_cache(unsigned int card, const char *xml_path,
+                                                const char *cache_path);
+
 /* Apply an audio route path by name */
 int audio_route_apply_path(struct audio_route *ar, const char *name);
 
@@ -46,6 +54,19 @@ void audio_route_reset(struct audio_route *ar);
 /* Update the mixer with any changed values */
 int audio_route_update_mixer(struct audio_route *ar);
 
+/*
+ * Begin a transaction, for a device switch: until it is committed, the paths
+ * applied and reset, and updated with the functions above, are not written to
+ * the mixer
+ */
+int audio_route_begin_transaction(struct audio_route *ar);
+
+/*
+ * Commit the transaction: update the mixer with any changed values, and write
+ * once the controls whose value changed since the beginning of the transaction
+ */
+int audio_route_commit_transaction(struct audio_route *ar);
+
 #if defined(__cplusplus)
 }  /* extern "C" */
 #endif
@@ -0,0 +1,496 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <audio_route/audio_route.h>
+#include <fake_mixer.h>
+
+#include <fcntl.h>
+#include <iterator>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+enum {
+    kSpeakerSwitch,
+    kSpeakerVolume,
+    kHeadphoneSwitch,
+    kHeadphoneVolume,
+    kOutputMux,
+    kMicSwitch,
+    kUnusedVolume,
+    kEqCoefficients,
+};
+
+enum { kMuxNone, kMuxSpeaker, kMuxHeadphone };
+const char* const kMuxStrings[] = { "None", "Speaker", "Headphone" };
+
+constexpr char kMixerPaths[] = R"(<mixer>
+    <ctl name="Speaker Volume" value="10 10" />
+    <ctl name="Headphone Volume" value="20 20" />
+    <ctl name="Output Mux" value="None" />
+    <ctl name="EQ Coefficients" value="00 00 00 00" />
+    <path name="speaker">
+        <ctl name="Speaker Switch" value="1" />
+        <ctl name="Speaker Volume" value="80 80" />
+        <ctl name="Output Mux" value="Speaker" />
+    </path>
+    <path name="headphone">
+        <ctl name="Headphone Switch" value="1" />
+        <ctl name="Headphone Volume" value="60 70" />
+        <ctl name="Output Mux" value="Headphone" />
+        <ctl name="EQ Coefficients" value="01 02 0a ff" />
+    </path>
+    <path name="speaker-and-headphone">
+        <path name="speaker" />
+        <path name="headphone" />
+    </path>
+    <path name="mic">
+        <ctl name="Mic Switch" value="1" />
+    </path>
+</mixer>
+)";
+
+class AudioRouteTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_NO_FATAL_FAILURE(addControls());
+
+        char xmlPath[] = "/tmp/audio_route_tests_XXXXXX";
+        const int fd = mkstemp(xmlPath);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        mXmlPath = xmlPath;
+        ASSERT_NO_FATAL_FAILURE(writeMixerPaths(kMixerPaths));
+
+        mAudioRoute = audio_route_init(0, mXmlPath.c_str());
+        ASSERT_NE(nullptr, mAudioRoute);
+    }
+
+    void TearDown() override {
+        if (mAudioRoute != nullptr) audio_route_free(mAudioRoute);
+        if (!mXmlPath.empty()) unlink(mXmlPath.c_str());
+        if (!mCachePath.empty()) unlink(mCachePath.c_str());
+        fake_mixer_clear();
+    }
+
+    // Replaces the card with a new one, with all the values at 0.
+    void addControls(const char* const* muxStrings = kMuxStrings) {
+        fake_mixer_clear();
+        ASSERT_EQ(kSpeakerSwitch,
+                fake_mixer_add_ctl("Speaker Switch", MIXER_CTL_TYPE_BOOL, 1, nullptr, 0));
+        ASSERT_EQ(kSpeakerVolume,
+                fake_mixer_add_ctl("Speaker Volume", MIXER_CTL_TYPE_INT, 2, nullptr, 0));
+        ASSERT_EQ(kHeadphoneSwitch,
+                fake_mixer_add_ctl("Headphone Switch", MIXER_CTL_TYPE_BOOL, 1, nullptr, 0));
+        ASSERT_EQ(kHeadphoneVolume,
+                fake_mixer_add_ctl("Headphone Volume", MIXER_CTL_TYPE_INT, 2, nullptr, 0));
+        ASSERT_EQ(kOutputMux, fake_mixer_add_ctl("Output Mux", MIXER_CTL_TYPE_ENUM, 1,
+                muxStrings, std::size(kMuxStrings)));
+        ASSERT_EQ(kMicSwitch,
+                fake_mixer_add_ctl("Mic Switch", MIXER_CTL_TYPE_BOOL, 1, nullptr, 0));
+        ASSERT_EQ(kUnusedVolume,
+                fake_mixer_add_ctl("Unused Volume", MIXER_CTL_TYPE_INT, 1, nullptr, 0));
+        ASSERT_EQ(kEqCoefficients,
+                fake_mixer_add_ctl("EQ Coefficients", MIXER_CTL_TYPE_BYTE, 4, nullptr, 0));
+    }
+
+    void writeMixerPaths(const std::string& mixerPaths) {
+        const int fd = open(mXmlPath.c_str(), O_WRONLY | O_TRUNC);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ((ssize_t)mixerPaths.size(), write(fd, mixerPaths.data(), mixerPaths.size()));
+        close(fd);
+    }
+
+    // Changes the speaker volume of the speaker path, keeping the size of the XML file,
+    // and its modification time unless touched.
+    void changeSpeakerVolume(bool touched) {
+        struct stat xmlStat;
+        ASSERT_EQ(0, stat(mXmlPath.c_str(), &xmlStat));
+        std::string mixerPaths = kMixerPaths;
+        const size_t pos = mixerPaths.find("80 80");
+        ASSERT_NE(std::string::npos, pos);
+        mixerPaths.replace(pos, 5, "90 90");
+        ASSERT_NO_FATAL_FAILURE(writeMixerPaths(mixerPaths));
+        struct timespec times[2] = { xmlStat.st_atim, xmlStat.st_mtim };
+        if (touched) times[1].tv_sec += 1;
+        ASSERT_EQ(0, utimensat(AT_FDCWD, mXmlPath.c_str(), times, 0));
+    }
+
+    // Initializes the audio routes with the cache, on a new card.
+    void initWithCache() {
+        if (mAudioRoute != nullptr) audio_route_free(mAudioRoute);
+        ASSERT_NO_FATAL_FAILURE(addControls());
+        if (mCachePath.empty()) mCachePath = mXmlPath + ".cache";
+        mAudioRoute = audio_route_init_with_cache(0, mXmlPath.c_str(), mCachePath.c_str());
+        ASSERT_NE(nullptr, mAudioRoute);
+    }
+
+    long getSpeakerVolume() {
+        EXPECT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "speaker"));
+        const long volume = fake_mixer_get_ctl_value(kSpeakerVolume, 0);
+        EXPECT_EQ(0, audio_route_reset_and_update_path(mAudioRoute, "speaker"));
+        return volume;
+    }
+
+    void expectInitialValues() {
+        EXPECT_EQ(0, fake_mixer_get_ctl_value(kSpeakerSwitch, 0));
+        EXPECT_EQ(10, fake_mixer_get_ctl_value(kSpeakerVolume, 0));
+        EXPECT_EQ(10, fake_mixer_get_ctl_value(kSpeakerVolume, 1));
+        EXPECT_EQ(0, fake_mixer_get_ctl_value(kHeadphoneSwitch, 0));
+        EXPECT_EQ(20, fake_mixer_get_ctl_value(kHeadphoneVolume, 0));
+        EXPECT_EQ(20, fake_mixer_get_ctl_value(kHeadphoneVolume, 1));
+        EXPECT_EQ(kMuxNone, fake_mixer_get_ctl_value(kOutputMux, 0));
+        EXPECT_EQ(0, fake_mixer_get_ctl_value(kMicSwitch, 0));
+        for (unsigned int i = 0; i < 4; ++i) {
+            EXPECT_EQ(0, fake_mixer_get_ctl_value(kEqCoefficients, i));
+        }
+    }
+
+    std::string mXmlPath;
+    std::string mCachePath;
+    struct audio_route* mAudioRoute = nullptr;
+};
+
+TEST_F(AudioRouteTest, InitWritesChangedControls) {
+    expectInitialValues();
+    // only the volumes differ from the initial values of the card
+    EXPECT_EQ(1u, fake_mixer_get_ctl_writes(kSpeakerVolume));
+    EXPECT_EQ(1u, fake_mixer_get_ctl_writes(kHeadphoneVolume));
+    EXPECT_EQ(2u, fake_mixer_get_writes());
+
+    EXPECT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    EXPECT_EQ(2u, fake_mixer_get_writes());
+}
+
+TEST_F(AudioRouteTest, UnknownPath) {
+    EXPECT_EQ(-1, audio_route_apply_path(mAudioRoute, "earpiece"));
+    EXPECT_EQ(-1, audio_route_reset_path(mAudioRoute, "earpiece"));
+    EXPECT_EQ(-1, audio_route_apply_and_update_path(mAudioRoute, "earpiece"));
+    EXPECT_EQ(-1, audio_route_reset_and_update_path(mAudioRoute, "earpiece"));
+    EXPECT_EQ(2u, fake_mixer_get_writes());
+}
+
+TEST_F(AudioRouteTest, UpdateMixerWritesPathControls) {
+    const unsigned int writes = fake_mixer_get_writes();
+    ASSERT_EQ(0, audio_route_apply_path(mAudioRoute, "speaker"));
+    EXPECT_EQ(writes, fake_mixer_get_writes());
+
+    ASSERT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kSpeakerSwitch, 0));
+    EXPECT_EQ(80, fake_mixer_get_ctl_value(kSpeakerVolume, 0));
+    EXPECT_EQ(80, fake_mixer_get_ctl_value(kSpeakerVolume, 1));
+    EXPECT_EQ(kMuxSpeaker, fake_mixer_get_ctl_value(kOutputMux, 0));
+    EXPECT_EQ(writes + 3, fake_mixer_get_writes());
+
+    // nothing changed since the last update
+    ASSERT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    EXPECT_EQ(writes + 3, fake_mixer_get_writes());
+
+    ASSERT_EQ(0, audio_route_reset_path(mAudioRoute, "speaker"));
+    ASSERT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    expectInitialValues();
+    EXPECT_EQ(writes + 6, fake_mixer_get_writes());
+}
+
+TEST_F(AudioRouteTest, UpdateMixerCoalescesWrites) {
+    const unsigned int writes = fake_mixer_get_writes();
+    const unsigned int muxWrites = fake_mixer_get_ctl_writes(kOutputMux);
+
+    // the mux is set by both paths, and only written with its last value
+    ASSERT_EQ(0, audio_route_apply_path(mAudioRoute, "speaker"));
+    ASSERT_EQ(0, audio_route_apply_path(mAudioRoute, "headphone"));
+    ASSERT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    EXPECT_EQ(kMuxHeadphone, fake_mixer_get_ctl_value(kOutputMux, 0));
+    EXPECT_EQ(muxWrites + 1, fake_mixer_get_ctl_writes(kOutputMux));
+    EXPECT_EQ(writes + 6, fake_mixer_get_writes());
+
+    // a control changed back to its value in the mixer is not written
+    ASSERT_EQ(0, audio_route_apply_path(mAudioRoute, "mic"));
+    ASSERT_EQ(0, audio_route_reset_path(mAudioRoute, "mic"));
+    ASSERT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    EXPECT_EQ(0, fake_mixer_get_ctl_value(kMicSwitch, 0));
+    EXPECT_EQ(0u, fake_mixer_get_ctl_writes(kMicSwitch));
+    EXPECT_EQ(writes + 6, fake_mixer_get_writes());
+}
+
+TEST_F(AudioRouteTest, NestedPaths) {
+    ASSERT_EQ(0, audio_route_apply_path(mAudioRoute, "speaker-and-headphone"));
+    ASSERT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kSpeakerSwitch, 0));
+    EXPECT_EQ(80, fake_mixer_get_ctl_value(kSpeakerVolume, 1));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kHeadphoneSwitch, 0));
+    EXPECT_EQ(60, fake_mixer_get_ctl_value(kHeadphoneVolume, 0));
+    EXPECT_EQ(70, fake_mixer_get_ctl_value(kHeadphoneVolume, 1));
+    // a control of several included paths keeps the value of the first one
+    EXPECT_EQ(kMuxSpeaker, fake_mixer_get_ctl_value(kOutputMux, 0));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kEqCoefficients, 0));
+    EXPECT_EQ(2, fake_mixer_get_ctl_value(kEqCoefficients, 1));
+    EXPECT_EQ(10, fake_mixer_get_ctl_value(kEqCoefficients, 2));
+    EXPECT_EQ(255, fake_mixer_get_ctl_value(kEqCoefficients, 3));
+    EXPECT_EQ(0u, fake_mixer_get_ctl_writes(kUnusedVolume));
+
+    ASSERT_EQ(0, audio_route_reset_path(mAudioRoute, "speaker-and-headphone"));
+    ASSERT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    expectInitialValues();
+}
+
+TEST_F(AudioRouteTest, ResetRestoresInitialValues) {
+    ASSERT_EQ(0, audio_route_apply_path(mAudioRoute, "speaker-and-headphone"));
+    ASSERT_EQ(0, audio_route_apply_path(mAudioRoute, "mic"));
+    ASSERT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    const unsigned int writes = fake_mixer_get_writes();
+
+    audio_route_reset(mAudioRoute);
+    ASSERT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    expectInitialValues();
+    EXPECT_EQ(writes + 7, fake_mixer_get_writes());
+}
+
+TEST_F(AudioRouteTest, UpdatePathKeepsSharedControls) {
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "speaker"));
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "headphone"));
+    EXPECT_EQ(kMuxHeadphone, fake_mixer_get_ctl_value(kOutputMux, 0));
+    const unsigned int muxWrites = fake_mixer_get_ctl_writes(kOutputMux);
+
+    // the mux is still used by the speaker path, and keeps its value
+    ASSERT_EQ(0, audio_route_reset_and_update_path(mAudioRoute, "headphone"));
+    EXPECT_EQ(0, fake_mixer_get_ctl_value(kHeadphoneSwitch, 0));
+    EXPECT_EQ(20, fake_mixer_get_ctl_value(kHeadphoneVolume, 0));
+    EXPECT_EQ(kMuxHeadphone, fake_mixer_get_ctl_value(kOutputMux, 0));
+    EXPECT_EQ(muxWrites, fake_mixer_get_ctl_writes(kOutputMux));
+
+    // and is not written by the next update either
+    const unsigned int writes = fake_mixer_get_writes();
+    ASSERT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    EXPECT_EQ(writes, fake_mixer_get_writes());
+
+    ASSERT_EQ(0, audio_route_reset_and_update_path(mAudioRoute, "speaker"));
+    expectInitialValues();
+    EXPECT_EQ(muxWrites + 1, fake_mixer_get_ctl_writes(kOutputMux));
+}
+
+TEST_F(AudioRouteTest, ForceResetAndUpdatePath) {
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "speaker"));
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "speaker"));
+
+    // a reset releases one use of the path
+    ASSERT_EQ(0, audio_route_reset_and_update_path(mAudioRoute, "speaker"));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kSpeakerSwitch, 0));
+    EXPECT_EQ(kMuxSpeaker, fake_mixer_get_ctl_value(kOutputMux, 0));
+
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "speaker"));
+    ASSERT_EQ(0, audio_route_force_reset_and_update_path(mAudioRoute, "speaker"));
+    expectInitialValues();
+}
+
+TEST_F(AudioRouteTest, TransactionDefersWrites) {
+    const unsigned int writes = fake_mixer_get_writes();
+    ASSERT_EQ(0, audio_route_begin_transaction(mAudioRoute));
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "speaker"));
+    ASSERT_EQ(0, audio_route_apply_path(mAudioRoute, "mic"));
+    EXPECT_EQ(writes, fake_mixer_get_writes());
+
+    // the paths applied without an update are updated by the commit
+    ASSERT_EQ(0, audio_route_commit_transaction(mAudioRoute));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kSpeakerSwitch, 0));
+    EXPECT_EQ(80, fake_mixer_get_ctl_value(kSpeakerVolume, 0));
+    EXPECT_EQ(kMuxSpeaker, fake_mixer_get_ctl_value(kOutputMux, 0));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kMicSwitch, 0));
+    EXPECT_EQ(writes + 4, fake_mixer_get_writes());
+
+    // and the updates after the commit are written immediately
+    ASSERT_EQ(0, audio_route_reset_and_update_path(mAudioRoute, "mic"));
+    EXPECT_EQ(0, fake_mixer_get_ctl_value(kMicSwitch, 0));
+    EXPECT_EQ(writes + 5, fake_mixer_get_writes());
+}
+
+TEST_F(AudioRouteTest, TransactionWritesNetChanges) {
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "speaker"));
+    const unsigned int writes = fake_mixer_get_writes();
+    const unsigned int muxWrites = fake_mixer_get_ctl_writes(kOutputMux);
+
+    // the mux is reset by the speaker path before being set by the headphone path
+    ASSERT_EQ(0, audio_route_begin_transaction(mAudioRoute));
+    ASSERT_EQ(0, audio_route_reset_and_update_path(mAudioRoute, "speaker"));
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "headphone"));
+    ASSERT_EQ(0, audio_route_commit_transaction(mAudioRoute));
+    EXPECT_EQ(0, fake_mixer_get_ctl_value(kSpeakerSwitch, 0));
+    EXPECT_EQ(10, fake_mixer_get_ctl_value(kSpeakerVolume, 0));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kHeadphoneSwitch, 0));
+    EXPECT_EQ(kMuxHeadphone, fake_mixer_get_ctl_value(kOutputMux, 0));
+    EXPECT_EQ(muxWrites + 1, fake_mixer_get_ctl_writes(kOutputMux));
+    EXPECT_EQ(writes + 6, fake_mixer_get_writes());
+
+    // a path applied and reset in the same transaction is not written
+    ASSERT_EQ(0, audio_route_begin_transaction(mAudioRoute));
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "mic"));
+    ASSERT_EQ(0, audio_route_reset_and_update_path(mAudioRoute, "mic"));
+    ASSERT_EQ(0, audio_route_commit_transaction(mAudioRoute));
+    EXPECT_EQ(0u, fake_mixer_get_ctl_writes(kMicSwitch));
+    EXPECT_EQ(writes + 6, fake_mixer_get_writes());
+}
+
+TEST_F(AudioRouteTest, TransactionKeepsSharedControls) {
+    // the mux is still used by the speaker path at the commit, and keeps the value
+    // of the headphone path, as without a transaction
+    ASSERT_EQ(0, audio_route_begin_transaction(mAudioRoute));
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "speaker"));
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "headphone"));
+    ASSERT_EQ(0, audio_route_reset_and_update_path(mAudioRoute, "headphone"));
+    ASSERT_EQ(0, audio_route_commit_transaction(mAudioRoute));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kSpeakerSwitch, 0));
+    EXPECT_EQ(0, fake_mixer_get_ctl_value(kHeadphoneSwitch, 0));
+    EXPECT_EQ(kMuxHeadphone, fake_mixer_get_ctl_value(kOutputMux, 0));
+    EXPECT_EQ(1u, fake_mixer_get_ctl_writes(kOutputMux));
+    EXPECT_EQ(0u, fake_mixer_get_ctl_writes(kHeadphoneSwitch));
+
+    ASSERT_EQ(0, audio_route_begin_transaction(mAudioRoute));
+    ASSERT_EQ(0, audio_route_reset_and_update_path(mAudioRoute, "speaker"));
+    ASSERT_EQ(0, audio_route_commit_transaction(mAudioRoute));
+    expectInitialValues();
+}
+
+TEST_F(AudioRouteTest, TransactionErrors) {
+    EXPECT_EQ(-1, audio_route_commit_transaction(mAudioRoute));
+    ASSERT_EQ(0, audio_route_begin_transaction(mAudioRoute));
+    EXPECT_EQ(-1, audio_route_begin_transaction(mAudioRoute));
+    ASSERT_EQ(0, audio_route_commit_transaction(mAudioRoute));
+    EXPECT_EQ(-1, audio_route_commit_transaction(mAudioRoute));
+    EXPECT_EQ(2u, fake_mixer_get_writes());
+}
+
+TEST_F(AudioRouteTest, CacheMatchesXml) {
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+    struct stat cacheStat;
+    ASSERT_EQ(0, stat(mCachePath.c_str(), &cacheStat));
+
+    // loaded from the cache
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+    expectInitialValues();
+    EXPECT_EQ(2u, fake_mixer_get_writes());
+    EXPECT_EQ(-1, audio_route_apply_path(mAudioRoute, "earpiece"));
+
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "speaker-and-headphone"));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kSpeakerSwitch, 0));
+    EXPECT_EQ(80, fake_mixer_get_ctl_value(kSpeakerVolume, 1));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kHeadphoneSwitch, 0));
+    EXPECT_EQ(60, fake_mixer_get_ctl_value(kHeadphoneVolume, 0));
+    EXPECT_EQ(70, fake_mixer_get_ctl_value(kHeadphoneVolume, 1));
+    EXPECT_EQ(kMuxSpeaker, fake_mixer_get_ctl_value(kOutputMux, 0));
+    EXPECT_EQ(10, fake_mixer_get_ctl_value(kEqCoefficients, 2));
+    EXPECT_EQ(255, fake_mixer_get_ctl_value(kEqCoefficients, 3));
+
+    ASSERT_EQ(0, audio_route_reset_and_update_path(mAudioRoute, "speaker-and-headphone"));
+    expectInitialValues();
+    ASSERT_EQ(0, audio_route_apply_path(mAudioRoute, "mic"));
+    ASSERT_EQ(0, audio_route_update_mixer(mAudioRoute));
+    EXPECT_EQ(1, fake_mixer_get_ctl_value(kMicSwitch, 0));
+}
+
+TEST_F(AudioRouteTest, CacheInvalidatedByXml) {
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+    EXPECT_EQ(80, getSpeakerVolume());
+
+    // the cache is checked against the modification time and the size of the XML file
+    ASSERT_NO_FATAL_FAILURE(changeSpeakerVolume(false /* touched */));
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+    EXPECT_EQ(80, getSpeakerVolume());
+
+    ASSERT_NO_FATAL_FAILURE(changeSpeakerVolume(true /* touched */));
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+    EXPECT_EQ(90, getSpeakerVolume());
+
+    // and updated
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+    EXPECT_EQ(90, getSpeakerVolume());
+}
+
+TEST_F(AudioRouteTest, CacheInvalidatedByCard) {
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+    ASSERT_NO_FATAL_FAILURE(changeSpeakerVolume(false /* touched */));
+
+    audio_route_free(mAudioRoute);
+    ASSERT_NO_FATAL_FAILURE(addControls());
+    ASSERT_LE(0, fake_mixer_add_ctl("Extra Switch", MIXER_CTL_TYPE_BOOL, 1, nullptr, 0));
+    mAudioRoute = audio_route_init_with_cache(0, mXmlPath.c_str(), mCachePath.c_str());
+    ASSERT_NE(nullptr, mAudioRoute);
+    EXPECT_EQ(90, getSpeakerVolume());
+}
+
+TEST_F(AudioRouteTest, CacheCorrupted) {
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+    struct stat cacheStat;
+    ASSERT_EQ(0, stat(mCachePath.c_str(), &cacheStat));
+
+    for (const off_t size : { (off_t)0, (off_t)16, cacheStat.st_size / 2 }) {
+        ASSERT_EQ(0, truncate(mCachePath.c_str(), size));
+        ASSERT_NO_FATAL_FAILURE(initWithCache());
+        expectInitialValues();
+        EXPECT_EQ(80, getSpeakerVolume());
+    }
+
+    // the values of the paths refer to controls past the end of the card
+    std::string cache(cacheStat.st_size, '\0');
+    int fd = open(mCachePath.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(cacheStat.st_size, read(fd, cache.data(), cache.size()));
+    for (size_t i = cache.size() / 4; i < cache.size() / 2; ++i) cache[i] = (char)0xff;
+    ASSERT_EQ(cacheStat.st_size, pwrite(fd, cache.data(), cache.size(), 0));
+    close(fd);
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+    expectInitialValues();
+    EXPECT_EQ(80, getSpeakerVolume());
+}
+
+TEST_F(AudioRouteTest, CacheInvalidatedByEnumStrings) {
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+
+    // the same enum, with its strings in another order
+    audio_route_free(mAudioRoute);
+    const char* const muxStrings[] = { "None", "Headphone", "Speaker" };
+    ASSERT_NO_FATAL_FAILURE(addControls(muxStrings));
+    mAudioRoute = audio_route_init_with_cache(0, mXmlPath.c_str(), mCachePath.c_str());
+    ASSERT_NE(nullptr, mAudioRoute);
+    ASSERT_EQ(0, audio_route_apply_and_update_path(mAudioRoute, "speaker"));
+    EXPECT_EQ(2, fake_mixer_get_ctl_value(kOutputMux, 0));
+}
+
+TEST_F(AudioRouteTest, CachePayloadCorrupted) {
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+    struct stat cacheStat;
+    ASSERT_EQ(0, stat(mCachePath.c_str(), &cacheStat));
+
+    // a value of the speaker path changed on the storage, in a valid cache otherwise
+    std::string cache(cacheStat.st_size, '\0');
+    int fd = open(mCachePath.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(cacheStat.st_size, read(fd, cache.data(), cache.size()));
+    const long speakerVolume[] = { 80, 80 };
+    const size_t pos = cache.find(std::string((const char*)speakerVolume, sizeof(speakerVolume)));
+    ASSERT_NE(std::string::npos, pos);
+    cache[pos] = 81;
+    ASSERT_EQ(cacheStat.st_size, pwrite(fd, cache.data(), cache.size(), 0));
+    close(fd);
+    ASSERT_NO_FATAL_FAILURE(initWithCache());
+    EXPECT_EQ(80, getSpeakerVolume());
+}
+
+}  // namespace
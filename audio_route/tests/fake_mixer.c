@@ -0,0 +1,247 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fake_mixer.h"
+
+struct mixer_ctl {
+    char *name;
+    enum mixer_ctl_type type;
+    unsigned int num_values;
+    long *values;
+    char **enum_strings;
+    unsigned int num_enums;
+    unsigned int writes;
+};
+
+struct mixer {
+    unsigned int num_ctls;
+    unsigned int size;
+    struct mixer_ctl *ctls;
+};
+
+static struct mixer fake_mixer;
+
+void fake_mixer_clear(void)
+{
+    unsigned int i;
+    unsigned int j;
+
+    for (i = 0; i < fake_mixer.num_ctls; i++) {
+        struct mixer_ctl *ctl = &fake_mixer.ctls[i];
+
+        free(ctl->name);
+        free(ctl->values);
+        for (j = 0; j < ctl->num_enums; j++)
+            free(ctl->enum_strings[j]);
+        free(ctl->enum_strings);
+    }
+    free(fake_mixer.ctls);
+    memset(&fake_mixer, 0, sizeof(fake_mixer));
+}
+
+int fake_mixer_add_ctl(const char *name, enum mixer_ctl_type type, unsigned int num_values,
+                       const char *const *enum_strings, unsigned int num_enums)
+{
+    struct mixer_ctl *ctl;
+    unsigned int i;
+
+    if (fake_mixer.num_ctls == fake_mixer.size) {
+        unsigned int size = fake_mixer.size == 0 ? 16 : fake_mixer.size * 2;
+        struct mixer_ctl *ctls = realloc(fake_mixer.ctls, size * sizeof(struct mixer_ctl));
+
+        if (ctls == NULL)
+            return -1;
+        fake_mixer.ctls = ctls;
+        fake_mixer.size = size;
+    }
+
+    ctl = &fake_mixer.ctls[fake_mixer.num_ctls];
+    memset(ctl, 0, sizeof(struct mixer_ctl));
+    ctl->name = strdup(name);
+    ctl->type = type;
+    ctl->num_values = num_values;
+    ctl->values = calloc(num_values, sizeof(long));
+    if (num_enums != 0) {
+        ctl->enum_strings = calloc(num_enums, sizeof(char *));
+        for (i = 0; i < num_enums; i++)
+            ctl->enum_strings[i] = strdup(enum_strings[i]);
+        ctl->num_enums = num_enums;
+    }
+    return fake_mixer.num_ctls++;
+}
+
+long fake_mixer_get_ctl_value(unsigned int ctl_index, unsigned int value_index)
+{
+    return fake_mixer.ctls[ctl_index].values[value_index];
+}
+
+unsigned int fake_mixer_get_ctl_writes(unsigned int ctl_index)
+{
+    return fake_mixer.ctls[ctl_index].writes;
+}
+
+unsigned int fake_mixer_get_writes(void)
+{
+    unsigned int writes = 0;
+    unsigned int i;
+
+    for (i = 0; i < fake_mixer.num_ctls; i++)
+        writes += fake_mixer.ctls[i].writes;
+    return writes;
+}
+
+/* tinyalsa mixer functions */
+
+struct mixer *mixer_open(unsigned int card)
+{
+    (void)card;
+    return fake_mixer.num_ctls != 0 ? &fake_mixer : NULL;
+}
+
+void mixer_close(struct mixer *mixer)
+{
+    (void)mixer;
+}
+
+const char *mixer_get_name(struct mixer *mixer)
+{
+    (void)mixer;
+    return "fake";
+}
+
+unsigned int mixer_get_num_ctls(struct mixer *mixer)
+{
+    return mixer->num_ctls;
+}
+
+struct mixer_ctl *mixer_get_ctl(struct mixer *mixer, unsigned int id)
+{
+    return id < mixer->num_ctls ? &mixer->ctls[id] : NULL;
+}
+
+struct mixer_ctl *mixer_get_ctl_by_name(struct mixer *mixer, const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < mixer->num_ctls; i++)
+        if (strcmp(mixer->ctls[i].name, name) == 0)
+            return &mixer->ctls[i];
+    return NULL;
+}
+
+const char *mixer_ctl_get_name(struct mixer_ctl *ctl)
+{
+    return ctl->name;
+}
+
+enum mixer_ctl_type mixer_ctl_get_type(struct mixer_ctl *ctl)
+{
+    return ctl->type;
+}
+
+const char *mixer_ctl_get_type_string(struct mixer_ctl *ctl)
+{
+    (void)ctl;
+    return "fake";
+}
+
+unsigned int mixer_ctl_get_num_values(struct mixer_ctl *ctl)
+{
+    return ctl->num_values;
+}
+
+unsigned int mixer_ctl_get_num_enums(struct mixer_ctl *ctl)
+{
+    return ctl->num_enums;
+}
+
+const char *mixer_ctl_get_enum_string(struct mixer_ctl *ctl, unsigned int enum_id)
+{
+    return enum_id < ctl->num_enums ? ctl->enum_strings[enum_id] : NULL;
+}
+
+int mixer_ctl_get_value(struct mixer_ctl *ctl, unsigned int id)
+{
+    return id < ctl->num_values ? (int)ctl->values[id] : -1;
+}
+
+/* The values are arrays of long, int and unsigned char, as in audio_route */
+int mixer_ctl_get_array(struct mixer_ctl *ctl, void *array, size_t count)
+{
+    size_t i;
+
+    if (count > ctl->num_values)
+        return -1;
+    for (i = 0; i < count; i++) {
+        switch (ctl->type) {
+        case MIXER_CTL_TYPE_BYTE:
+            ((unsigned char *)array)[i] = ctl->values[i];
+            break;
+        case MIXER_CTL_TYPE_ENUM:
+            ((int *)array)[i] = ctl->values[i];
+            break;
+        default:
+            ((long *)array)[i] = ctl->values[i];
+            break;
+        }
+    }
+    return 0;
+}
+
+int mixer_ctl_set_value(struct mixer_ctl *ctl, unsigned int id, int value)
+{
+    if (id >= ctl->num_values)
+        return -1;
+    ctl->values[id] = value;
+    ctl->writes++;
+    return 0;
+}
+
+int mixer_ctl_set_array(struct mixer_ctl *ctl, const void *array, size_t count)
+{
+    size_t i;
+
+    if (count > ctl->num_values)
+        return -1;
+    for (i = 0; i < count; i++) {
+        switch (ctl->type) {
+        case MIXER_CTL_TYPE_BYTE:
+            ctl->values[i] = ((const unsigned char *)array)[i];
+            break;
+        case MIXER_CTL_TYPE_ENUM:
+            ctl->values[i] = ((const int *)array)[i];
+            break;
+        default:
+            ctl->values[i] = ((const long *)array)[i];
+            break;
+        }
+    }
+    ctl->writes++;
+    return 0;
+}
+
+int mixer_ctl_set_enum_by_string(struct mixer_ctl *ctl, const char *string)
+{
+    unsigned int i;
+
+    for (i = 0; i < ctl->num_enums; i++)
+        if (strcmp(ctl->enum_strings[i], string) == 0)
+            return mixer_ctl_set_value(ctl, 0, i);
+    return -1;
+}
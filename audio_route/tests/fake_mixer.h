@@ -0,0 +1,55 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUDIO_ROUTE_FAKE_MIXER_H
+#define AUDIO_ROUTE_FAKE_MIXER_H
+
+#include <tinyalsa/asoundlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * A fake sound card, which replaces the mixer functions of tinyalsa, so that
+ * audio_route can be tested and benchmarked without a sound card. Its controls
+ * keep their values when the mixer is closed, like those of a real card, and
+ * count the writes to them.
+ */
+
+/* Remove all the controls of the fake card */
+void fake_mixer_clear(void);
+
+/*
+ * Add a control to the fake card, with num_values values initialized to 0, and
+ * num_enums enum_strings for a MIXER_CTL_TYPE_ENUM control. Returns the index
+ * of the control, or -1 on error.
+ */
+int fake_mixer_add_ctl(const char *name, enum mixer_ctl_type type, unsigned int num_values,
+                       const char *const *enum_strings, unsigned int num_enums);
+
+/* Get a value of a control, as written by the last update */
+long fake_mixer_get_ctl_value(unsigned int ctl_index, unsigned int value_index);
+
+/* Get the number of writes to a control, or to all the controls */
+unsigned int fake_mixer_get_ctl_writes(unsigned int ctl_index);
+unsigned int fake_mixer_get_writes(void);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
@@ -15,6 +15,9 @@
  */
 
 #include <audio_utils/ChannelMix.h>
+#include <audio_utils/intrinsic_utils.h>
+
+#include <algorithm>
 
 namespace android::audio_utils::channels {
 
@@ -141,6 +144,9 @@ std::shared_ptr<IChannelMix> IChannelMix::create(audio_channel_mask_t outputChan
      case AUDIO_CHANNEL_OUT_7POINT1POINT4:
          return std::make_shared<ChannelMix<AUDIO_CHANNEL_OUT_7POINT1POINT4>>();
      default:
+         if (RuntimeChannelMix::isOutputChannelMaskSupported(outputChannelMask)) {
+             return std::make_shared<RuntimeChannelMix>(outputChannelMask);
+         }
          return {};
      }
 }
@@ -154,8 +160,398 @@ bool IChannelMix::isOutputChannelMaskSupported(audio_channel_mask_t outputChanne
     case AUDIO_CHANNEL_OUT_7POINT1POINT4:
         return true;
     default:
+        return RuntimeChannelMix::isOutputChannelMaskSupported(outputChannelMask);
+    }
+}
+
+namespace {
+
+// A contribution of an input channel to another channel.
+struct Fold {
+    uint32_t channel;  // a single channel bit, or 0 for unused.
+    float gain;
+};
+
+// An alternative for folding an input channel absent from the output channel mask.
+struct FoldRule {
+    Fold folds[4];
+};
+
+struct FoldRules {
+    const FoldRule *rules;
+    size_t count;
+};
+
+constexpr float MINUS_3_DB_IN_FLOAT = M_SQRT1_2; // -3dB = 0.70710678
+constexpr float MINUS_4_5_DB_IN_FLOAT = 0.5946035575f;
+constexpr float COEF_25 = 0.2508909536f;
+constexpr float COEF_61 = 0.6057043428f;
+
+template <size_t N>
+constexpr FoldRules makeRules(const FoldRule (&rules)[N]) {
+    return {rules, N};
+}
+
+/*
+ * Returns the ways an input channel may be folded into other channels, in order
+ * of preference. The first rule whose channels are all present in the output is used,
+ * otherwise the last rule is used, folding its channels again as needed.
+ */
+FoldRules getFoldRules(uint32_t channel, audio_channel_mask_t inputChannelMask) {
+    switch (channel) {
+    case AUDIO_CHANNEL_OUT_FRONT_CENTER: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, MINUS_3_DB_IN_FLOAT},
+              {AUDIO_CHANNEL_OUT_FRONT_RIGHT, MINUS_3_DB_IN_FLOAT}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_LOW_FREQUENCY: {
+        // If there is a second LFE, keep each LFE on its own side.
+        static constexpr FoldRule kRulesLeft[] = {
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, MINUS_3_DB_IN_FLOAT}}},
+        };
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, 0.5f}, {AUDIO_CHANNEL_OUT_FRONT_RIGHT, 0.5f}}},
+        };
+        return (inputChannelMask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2)
+                ? makeRules(kRulesLeft) : makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_LOW_FREQUENCY, 1.f}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_RIGHT, MINUS_3_DB_IN_FLOAT}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_BACK_LEFT: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_SIDE_LEFT, 1.f}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, MINUS_3_DB_IN_FLOAT}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_BACK_RIGHT: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_SIDE_RIGHT, 1.f}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_RIGHT, MINUS_3_DB_IN_FLOAT}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_SIDE_LEFT: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_BACK_LEFT, 1.f}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, MINUS_3_DB_IN_FLOAT}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_SIDE_RIGHT: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_BACK_RIGHT, 1.f}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_RIGHT, MINUS_3_DB_IN_FLOAT}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_BACK_CENTER: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_BACK_LEFT, MINUS_3_DB_IN_FLOAT},
+              {AUDIO_CHANNEL_OUT_BACK_RIGHT, MINUS_3_DB_IN_FLOAT}}},
+            {{{AUDIO_CHANNEL_OUT_SIDE_LEFT, MINUS_3_DB_IN_FLOAT},
+              {AUDIO_CHANNEL_OUT_SIDE_RIGHT, MINUS_3_DB_IN_FLOAT}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, 0.5f}, {AUDIO_CHANNEL_OUT_FRONT_RIGHT, 0.5f}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, MINUS_4_5_DB_IN_FLOAT},
+              {AUDIO_CHANNEL_OUT_FRONT_CENTER, MINUS_3_DB_IN_FLOAT}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, COEF_61}, {AUDIO_CHANNEL_OUT_FRONT_RIGHT, COEF_25}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_FRONT_RIGHT, MINUS_4_5_DB_IN_FLOAT},
+              {AUDIO_CHANNEL_OUT_FRONT_CENTER, MINUS_3_DB_IN_FLOAT}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, COEF_25}, {AUDIO_CHANNEL_OUT_FRONT_RIGHT, COEF_61}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_FRONT_WIDE_LEFT: { // FRONT_WIDE closer to SIDE.
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, MINUS_4_5_DB_IN_FLOAT},
+              {AUDIO_CHANNEL_OUT_SIDE_LEFT, MINUS_3_DB_IN_FLOAT}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, MINUS_3_DB_IN_FLOAT},
+              {AUDIO_CHANNEL_OUT_BACK_LEFT, MINUS_4_5_DB_IN_FLOAT}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, MINUS_3_DB_IN_FLOAT}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_FRONT_WIDE_RIGHT: { // FRONT_WIDE closer to SIDE.
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_FRONT_RIGHT, MINUS_4_5_DB_IN_FLOAT},
+              {AUDIO_CHANNEL_OUT_SIDE_RIGHT, MINUS_3_DB_IN_FLOAT}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_RIGHT, MINUS_3_DB_IN_FLOAT},
+              {AUDIO_CHANNEL_OUT_BACK_RIGHT, MINUS_4_5_DB_IN_FLOAT}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_RIGHT, MINUS_3_DB_IN_FLOAT}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT:
+    case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_LEFT: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_FRONT_LEFT, 1.f}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT:
+    case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_RIGHT: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_FRONT_RIGHT, 1.f}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_TOP_FRONT_CENTER: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT, MINUS_3_DB_IN_FLOAT},
+              {AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT, MINUS_3_DB_IN_FLOAT}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_CENTER, 1.f}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_CENTER: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_FRONT_CENTER, 1.f}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_TOP_CENTER: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT, 0.5f}, {AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT, 0.5f},
+              {AUDIO_CHANNEL_OUT_TOP_BACK_LEFT, 0.5f}, {AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT, 0.5f}}},
+            {{{AUDIO_CHANNEL_OUT_FRONT_CENTER, 0.5f}, {AUDIO_CHANNEL_OUT_BACK_LEFT, 0.5f},
+              {AUDIO_CHANNEL_OUT_BACK_RIGHT, 0.5f}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_TOP_BACK_LEFT: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_BACK_LEFT, 1.f}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_BACK_RIGHT, 1.f}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_TOP_BACK_CENTER: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_TOP_BACK_LEFT, MINUS_3_DB_IN_FLOAT},
+              {AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT, MINUS_3_DB_IN_FLOAT}}},
+            {{{AUDIO_CHANNEL_OUT_BACK_CENTER, 1.f}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_TOP_SIDE_LEFT: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_SIDE_LEFT, 1.f}}},
+        };
+        return makeRules(kRules);
+    }
+    case AUDIO_CHANNEL_OUT_TOP_SIDE_RIGHT: {
+        static constexpr FoldRule kRules[] = {
+            {{{AUDIO_CHANNEL_OUT_SIDE_RIGHT, 1.f}}},
+        };
+        return makeRules(kRules);
+    }
+    default:
+        // FRONT_LEFT and FRONT_RIGHT are always in the output, other channels are dropped.
+        return {nullptr, 0};
+    }
+}
+
+// Adds the contribution of an input channel with gain to a matrix row.
+void foldChannel(audio_channel_mask_t outputChannelMask, audio_channel_mask_t inputChannelMask,
+        uint32_t channel, float gain, float *row, int depth) {
+    if (outputChannelMask & channel) {
+        row[__builtin_popcount(outputChannelMask & (channel - 1))] += gain;
+        return;
+    }
+    // The rules always end by folding towards the front left and right,
+    // the depth limit is a safeguard.
+    if (depth == 0) return;
+    const FoldRules rules = getFoldRules(channel, inputChannelMask);
+    if (rules.count == 0) return;
+    const FoldRule *selected = &rules.rules[rules.count - 1];
+    for (size_t i = 0; i < rules.count - 1; ++i) {
+        bool present = true;
+        for (const auto& fold : rules.rules[i].folds) {
+            present = present && (fold.channel & ~outputChannelMask) == 0;
+        }
+        if (present) {
+            selected = &rules.rules[i];
+            break;
+        }
+    }
+    for (const auto& fold : selected->folds) {
+        if (fold.channel == 0) break;
+        foldChannel(outputChannelMask, inputChannelMask,
+                fold.channel, gain * fold.gain, row, depth - 1);
+    }
+}
+
+// The vector type used for mixing a frame, see intrinsic_utils.h
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+using vfloat_t = float32x4_t;
+#elif defined(__SSE2__)
+using vfloat_t = __m128;
+#else
+using vfloat_t = intrinsics::internal_array_t<float, 4>;
+#endif
+
+// Copies the first count (less than 4) floats; a variable length std::copy
+// would otherwise become a call to memmove for every frame.
+inline void copyPartialVector(const float *src, float *dst, size_t count) {
+    switch (count) {
+    case 3: dst[2] = src[2]; [[fallthrough]];
+    case 2: dst[1] = src[1]; [[fallthrough]];
+    case 1: dst[0] = src[0];
+    }
+}
+
+} // namespace
+
+bool fillRuntimeChannelMatrix(audio_channel_mask_t outputChannelMask,
+        audio_channel_mask_t inputChannelMask, float *matrix, size_t outputStride) {
+    if (!RuntimeChannelMix::isOutputChannelMaskSupported(outputChannelMask)
+            || audio_channel_mask_get_representation(inputChannelMask)
+                    != AUDIO_CHANNEL_REPRESENTATION_POSITION
+            || inputChannelMask & ~((1 << RuntimeChannelMix::MAX_INPUT_CHANNELS_SUPPORTED) - 1)
+            || outputStride < audio_channel_count_from_out_mask(outputChannelMask)) {
         return false;
     }
+    constexpr int kMaxFoldDepth = 4;
+    float *row = matrix;
+    for (uint32_t tmp = inputChannelMask; tmp != 0; row += outputStride) {
+        const uint32_t lowestBit = tmp & -tmp;
+        std::fill(row, row + outputStride, 0.f);
+        foldChannel(outputChannelMask, inputChannelMask, lowestBit, 1.f, row, kMaxFoldDepth);
+        tmp ^= lowestBit;
+    }
+    return true;
+}
+
+RuntimeChannelMix::RuntimeChannelMix(audio_channel_mask_t outputChannelMask,
+        audio_channel_mask_t inputChannelMask)
+    : mOutputChannelMask(outputChannelMask)
+    , mOutputChannelCount(audio_channel_count_from_out_mask(outputChannelMask))
+    , mOutputVectorCount((mOutputChannelCount + kVectorWidth - 1) / kVectorWidth) {
+    setInputChannelMask(inputChannelMask);
+}
+
+bool RuntimeChannelMix::setInputChannelMask(audio_channel_mask_t inputChannelMask) {
+    if (mInputChannelMask == inputChannelMask) return true;
+    float matrix[MAX_INPUT_CHANNELS_SUPPORTED][kRowStride];
+    if (!fillRuntimeChannelMatrix(mOutputChannelMask, inputChannelMask, &matrix[0][0],
+            kRowStride)) {
+        return false;
+    }
+    // Keep only the input channels which contribute to the output.
+    const size_t inputChannelCount = audio_channel_count_from_out_mask(inputChannelMask);
+    size_t rowCount = 0;
+    for (size_t i = 0; i < inputChannelCount; ++i) {
+        if (std::any_of(matrix[i], matrix[i] + mOutputChannelCount,
+                [](float f) { return f != 0.f; })) {
+            std::copy(matrix[i], matrix[i] + kRowStride, mRows[rowCount]);
+            mRowInput[rowCount++] = i;
+        }
+    }
+    mRowCount = rowCount;
+    mInputChannelMask = inputChannelMask;
+    mInputChannelCount = inputChannelCount;
+    return true;
+}
+
+bool RuntimeChannelMix::process(const float *src, float *dst, size_t frameCount,
+        bool accumulate) const {
+    if (mInputChannelMask == AUDIO_CHANNEL_NONE) return false;
+    if (accumulate) {
+        processFrames<true>(src, dst, frameCount);
+    } else {
+        processFrames<false>(src, dst, frameCount);
+    }
+    return true;
+}
+
+template <bool ACCUMULATE>
+void RuntimeChannelMix::processFrames(const float *src, float *dst, size_t frameCount) const {
+    // Dispatch on the number of output vectors so the accumulators stay in registers.
+    static_assert(kRowStride / kVectorWidth == 7);
+    switch (mOutputVectorCount) {
+    case 1: mixFrames<1, ACCUMULATE>(src, dst, frameCount); break;
+    case 2: mixFrames<2, ACCUMULATE>(src, dst, frameCount); break;
+    case 3: mixFrames<3, ACCUMULATE>(src, dst, frameCount); break;
+    case 4: mixFrames<4, ACCUMULATE>(src, dst, frameCount); break;
+    case 5: mixFrames<5, ACCUMULATE>(src, dst, frameCount); break;
+    case 6: mixFrames<6, ACCUMULATE>(src, dst, frameCount); break;
+    case 7: mixFrames<7, ACCUMULATE>(src, dst, frameCount); break;
+    }
+}
+
+template <size_t VECTORS, bool ACCUMULATE>
+void RuntimeChannelMix::mixFrames(const float *src, float *dst, size_t frameCount) const {
+    using namespace intrinsics;
+    constexpr float LIMIT_AMPLITUDE = M_SQRT2;  // see clamp()
+    const vfloat_t upper = vdupn<vfloat_t>(LIMIT_AMPLITUDE);
+    const vfloat_t lower = vdupn<vfloat_t>(-LIMIT_AMPLITUDE);
+
+    // Copy the members to locals, as stores to dst may otherwise force reloads.
+    const size_t inputChannelCount = mInputChannelCount;
+    const size_t outputChannelCount = mOutputChannelCount;
+    const size_t rowCount = mRowCount;
+    const size_t lastCount = outputChannelCount - (VECTORS - 1) * kVectorWidth;
+    const size_t fullVectors = lastCount == kVectorWidth ? VECTORS : VECTORS - 1;
+    // The last vector may extend past the frame, in which case it goes through last.
+    alignas(16) float last[kVectorWidth]{};
+
+    for (; frameCount > 0; --frameCount) {
+        // Each output vector is accumulated in a register over the nonzero rows.
+        vfloat_t acc[VECTORS];
+        for (size_t v = 0; v < VECTORS; ++v) acc[v] = vdupn<vfloat_t>(0.f);
+        for (size_t r = 0; r < rowCount; ++r) {
+            const float *row = mRows[r];
+            const float sample = src[mRowInput[r]];
+            for (size_t v = 0; v < VECTORS; ++v) {
+                acc[v] = vmla(acc[v], vld1<vfloat_t>(row + v * kVectorWidth), sample);
+            }
+        }
+
+        float *const lastDst = dst + (VECTORS - 1) * kVectorWidth;
+        if constexpr (ACCUMULATE) {
+            if (fullVectors != VECTORS) copyPartialVector(lastDst, last, lastCount);
+        }
+        for (size_t v = 0; v < VECTORS; ++v) {
+            float *const out = v < fullVectors ? dst + v * kVectorWidth : last;
+            vfloat_t value = acc[v];
+            if constexpr (ACCUMULATE) value = vadd(value, vld1<vfloat_t>(out));
+            vst1(out, vmin(vmax(value, lower), upper));
+        }
+        if (fullVectors != VECTORS) copyPartialVector(last, lastDst, lastCount);
+
+        src += inputChannelCount;
+        dst += outputChannelCount;
+    }
+}
+
+/* static */
+bool RuntimeChannelMix::isOutputChannelMaskSupported(audio_channel_mask_t outputChannelMask) {
+    return audio_channel_mask_get_representation(outputChannelMask)
+                    == AUDIO_CHANNEL_REPRESENTATION_POSITION
+            && (outputChannelMask & AUDIO_CHANNEL_OUT_STEREO) == AUDIO_CHANNEL_OUT_STEREO
+            && (outputChannelMask & ~((1 << MAX_OUTPUT_CHANNELS_SUPPORTED) - 1)) == 0;
 }
 
 } // android::audio_utils::channels
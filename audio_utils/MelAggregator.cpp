@@ -19,8 +19,14 @@
 
 #include <audio_utils/MelAggregator.h>
 #include <audio_utils/power.h>
+#include <algorithm>
 #include <cinttypes>
-#include <iterator>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <utils/Log.h>
 
 namespace android::audio_utils {
@@ -36,52 +42,64 @@ constexpr float kCsdThreshold = 5760.0f; // 1.6f(Pa^2h) * 3600.0f(s);
 constexpr float kReferenceEnergyPa = 4e-10;
 
 /**
- * Checking the intersection of the time intervals of v1 and v2. Each MelRecord v
- * spawns an interval [t1, t2) if and only if:
- *    v.timestamp == t1 && v.mels.size() == t2 - t1
- **/
-std::pair<int64_t, int64_t> intersectRegion(const MelRecord& v1, const MelRecord& v2)
-{
-    const int64_t maxStart = std::max(v1.timestamp, v2.timestamp);
-    const int64_t v1End = v1.timestamp + v1.mels.size();
-    const int64_t v2End = v2.timestamp + v2.mels.size();
-    const int64_t minEnd = std::min(v1End, v2End);
-    return {maxStart, minEnd};
-}
+ * Preallocated seconds of MEL values and runs. The values are converted to CSD after
+ * at most 1440 seconds at RS1, so larger buffers are only needed for long records.
+ */
+constexpr size_t kMelEnergiesCapacity = 4096;
+constexpr size_t kMelRunsCapacity = 64;
 
-float aggregateMels(const float mel1, const float mel2) {
-    return audio_utils_power_from_energy(powf(10.f, mel1 / 10.f) + powf(10.f, mel2 / 10.f));
-}
+/** Preallocated CSD records, must be a power of 2. */
+constexpr size_t kCsdEntriesCapacity = 1024;
+static_assert((kCsdEntriesCapacity & (kCsdEntriesCapacity - 1)) == 0);
 
-float averageMelEnergy(const float mel1,
-                       const int64_t duration1,
-                       const float mel2,
-                       const int64_t duration2) {
-    return audio_utils_power_from_energy((powf(10.f, mel1 / 10.f) * duration1
-        + powf(10.f, mel2 / 10.f) * duration2) / (duration1 + duration2));
+float melToEnergy(float mel) {
+    return powf(10.f, mel / 10.f);
 }
 
-float melToCsd(float mel) {
-    float energy = powf(10.f, mel / 10.0f);
+float energyToCsd(float energy) {
     return kReferenceEnergyPa * energy / kCsdThreshold;
 }
 
-CsdRecord createRevertedRecord(const CsdRecord& record) {
-    return {record.timestamp, record.duration, -record.value, record.averageMel};
-}
-
 }  // namespace
 
+MelAggregator::MelAggregator(int64_t csdWindowSeconds)
+    : mCsdWindowSeconds(csdWindowSeconds),
+      mCsdEntries(kCsdEntriesCapacity)
+{
+    mMelRuns.reserve(kMelRunsCapacity);
+    mMelEnergies.reserve(kMelEnergiesCapacity);
+}
+
 int64_t MelAggregator::csdTimeIntervalStored_l()
 {
-    return mCsdRecords.rbegin()->second.timestamp + mCsdRecords.rbegin()->second.duration
-        - mCsdRecords.begin()->second.timestamp;
+    const CsdEntry& newest = csdEntry_l(mCsdCount - 1);
+    return newest.timestamp + newest.duration - csdEntry_l(0).timestamp;
 }
 
-std::map<int64_t, CsdRecord>::iterator MelAggregator::addNewestCsdRecord_l(int64_t timestamp,
-                                                                           int64_t duration,
-                                                                           float csdRecord,
-                                                                           float averageMel)
+void MelAggregator::insertCsdEntry_l(const CsdEntry& entry)
+{
+    if (mCsdCount == mCsdEntries.size()) {
+        std::vector<CsdEntry> entries(mCsdEntries.size() * 2);
+        for (size_t i = 0; i < mCsdCount; ++i) {
+            entries[i] = csdEntry_l(i);
+        }
+        mCsdEntries.swap(entries);
+        mCsdFront = 0;
+    }
+
+    // the entry is usually the newest, otherwise shift the newer entries
+    size_t pos = mCsdCount;
+    for (; pos > 0 && csdEntry_l(pos - 1).timestamp > entry.timestamp; --pos) {
+        csdEntry_l(pos) = csdEntry_l(pos - 1);
+    }
+    csdEntry_l(pos) = entry;
+    ++mCsdCount;
+}
+
+CsdRecord MelAggregator::addNewestCsdRecord_l(int64_t timestamp,
+                                              int64_t duration,
+                                              float csdRecord,
+                                              float averageMel)
 {
     ALOGV("%s: add new csd[%" PRId64 ", %" PRId64 "]=%f for MEL avg %f",
                       __func__,
@@ -91,20 +109,21 @@ std::map<int64_t, CsdRecord>::iterator MelAggregator::addNewestCsdRecord_l(int64
                       averageMel);
 
     mCurrentCsd += csdRecord;
-    return mCsdRecords.emplace_hint(mCsdRecords.end(),
-                                    timestamp,
-                                    CsdRecord(timestamp,
-                                              duration,
-                                              csdRecord,
-                                              averageMel));
+    const CsdEntry entry{timestamp, static_cast<uint32_t>(duration), csdRecord, averageMel};
+    insertCsdEntry_l(entry);
+    return entry.toRecord();
 }
 
 void MelAggregator::removeOldCsdRecords_l(std::vector<CsdRecord>& removeRecords) {
     // Remove older CSD values
-    while (!mCsdRecords.empty() && csdTimeIntervalStored_l() > mCsdWindowSeconds) {
-        mCurrentCsd -= mCsdRecords.begin()->second.value;
-        removeRecords.emplace_back(createRevertedRecord(mCsdRecords.begin()->second));
-        mCsdRecords.erase(mCsdRecords.begin());
+    while (mCsdCount > 0 && csdTimeIntervalStored_l() > mCsdWindowSeconds) {
+        const CsdEntry& oldest = csdEntry_l(0);
+        mCurrentCsd -= oldest.value;
+        // reverted record
+        removeRecords.emplace_back(oldest.timestamp, oldest.duration, -oldest.value,
+                                   oldest.averageMel);
+        mCsdFront = (mCsdFront + 1) & (mCsdEntries.size() - 1);
+        --mCsdCount;
     }
 }
 
@@ -119,117 +138,161 @@ std::vector<CsdRecord> MelAggregator::updateCsdRecords_l()
     }
 
     float converted = 0.f;
-    float averageMel = 0.f;
+    float energy = 0.f;
     float csdValue = 0.f;
     int64_t duration = 0;
-    int64_t timestamp = mMelRecords.begin()->first;
-    for (const auto& storedMel: mMelRecords) {
-        int melsIdx = 0;
-        for (const auto& mel: storedMel.second.mels) {
-            averageMel = averageMelEnergy(averageMel, duration, mel, 1.f);
-            csdValue += melToCsd(mel);
+    int64_t timestamp = mMelRuns.front().timestamp;
+    for (const auto& run : mMelRuns) {
+        for (size_t melsIdx = 0; melsIdx < run.length; ++melsIdx) {
+            const float melEnergy = mMelEnergies[run.offset + melsIdx];
+            energy += melEnergy;
+            csdValue += energyToCsd(melEnergy);
             ++duration;
             if (csdValue >= kMinCsdRecordToStore
                 && mCurrentMelRecordsCsd - converted - csdValue >= kMinCsdRecordToStore) {
-                auto it = addNewestCsdRecord_l(timestamp,
-                                               duration,
-                                               csdValue,
-                                               averageMel);
-                newRecords.emplace_back(it->second);
+                newRecords.emplace_back(addNewestCsdRecord_l(timestamp,
+                        duration,
+                        csdValue,
+                        audio_utils_power_from_energy(energy / duration)));
 
                 duration = 0;
-                averageMel = 0.f;
+                energy = 0.f;
                 converted += csdValue;
                 csdValue = 0.f;
-                timestamp = storedMel.first + melsIdx;
+                timestamp = run.timestamp + melsIdx;
             }
-            ++ melsIdx;
         }
     }
 
     if(csdValue > 0) {
-        auto it = addNewestCsdRecord_l(timestamp,
-                                       duration,
-                                       csdValue,
-                                       averageMel);
-        newRecords.emplace_back(it->second);
+        newRecords.emplace_back(addNewestCsdRecord_l(timestamp,
+                duration,
+                csdValue,
+                audio_utils_power_from_energy(energy / duration)));
     }
 
     removeOldCsdRecords_l(newRecords);
 
     // reset mel values
     mCurrentMelRecordsCsd = 0.0f;
-    mMelRecords.clear();
+    clearMelRuns_l();
 
     return newRecords;
 }
 
-std::vector<CsdRecord> MelAggregator::aggregateAndAddNewMelRecord(const MelRecord& mel)
+void MelAggregator::clearMelRuns_l()
 {
-    std::lock_guard _l(mLock);
-    return aggregateAndAddNewMelRecord_l(mel);
+    mMelRuns.clear();
+    mMelEnergies.clear();
+    mMelEnergiesUsed = 0;
+    // release the memory grown for long records
+    if (mMelEnergies.capacity() > kMelEnergiesCapacity) {
+        std::vector<float>().swap(mMelEnergies);
+        mMelEnergies.reserve(kMelEnergiesCapacity);
+    }
+    if (mMelRuns.capacity() > kMelRunsCapacity) {
+        std::vector<MelRun>().swap(mMelRuns);
+        mMelRuns.reserve(kMelRunsCapacity);
+    }
 }
 
-std::vector<CsdRecord> MelAggregator::aggregateAndAddNewMelRecord_l(const MelRecord& mel)
+void MelAggregator::addMelRun_l(const MelRecord& mel)
 {
-    for (const auto& m : mel.mels) {
-        mCurrentMelRecordsCsd += melToCsd(m);
+    const int64_t start = mel.timestamp;
+    const size_t length = mel.mels.size();
+    const int64_t end = start + static_cast<int64_t>(length);
+    if (length == 0) {
+        return;
     }
-    ALOGV("%s: current mel values CSD %f", __func__, mCurrentMelRecordsCsd);
-
-    auto mergeIt = mMelRecords.lower_bound(mel.timestamp);
 
-    if (mergeIt != mMelRecords.begin()) {
-        auto prevMergeIt = std::prev(mergeIt);
-        if (prevMergeIt->second.overlapsEnd(mel)) {
-            mergeIt = prevMergeIt;
+    // Streams playing simultaneously report increasing times, so the record is
+    // usually after or overlapping the end of the newest run.
+    if (mMelRuns.empty() || mMelRuns.back().end() <= start) {
+        mMelRuns.push_back({start, length, mMelEnergies.size(), mel.portId});
+        for (float value : mel.mels) {
+            mMelEnergies.push_back(melToEnergy(value));
         }
+        mMelEnergiesUsed += length;
+        return;
     }
-
-    int64_t newTimestamp = mel.timestamp;
-    std::vector<float> newMels = mel.mels;
-    auto mergeStart = mergeIt;
-    int overlapStart = 0;
-    while(mergeIt != mMelRecords.end()) {
-        const auto& [melRecordStart, melRecord] = *mergeIt;
-        const auto [regionStart, regionEnd] = intersectRegion(melRecord, mel);
-        if (regionStart >= regionEnd) {
-            // no intersection
-            break;
+    MelRun& newest = mMelRuns.back();
+    if (newest.timestamp <= start
+            && (mMelRuns.size() == 1 || mMelRuns.rbegin()[1].end() <= start)
+            && newest.offset + newest.length == mMelEnergies.size()) {
+        // aggregate in place, and extend at the end of the energies
+        const size_t overlapStart = start - newest.timestamp;
+        const size_t overlap = std::min(length, newest.length - overlapStart);
+        for (size_t i = 0; i < overlap; ++i) {
+            mMelEnergies[newest.offset + overlapStart + i] += melToEnergy(mel.mels[i]);
         }
-
-        if (melRecordStart < regionStart) {
-            newTimestamp = melRecordStart;
-            overlapStart = regionStart - melRecordStart;
-            newMels.insert(newMels.begin(), melRecord.mels.begin(),
-                           melRecord.mels.begin() + overlapStart);
+        for (size_t i = overlap; i < length; ++i) {
+            mMelEnergies.push_back(melToEnergy(mel.mels[i]));
         }
+        newest.length += length - overlap;
+        newest.portId = mel.portId;
+        mMelEnergiesUsed += length - overlap;
+        return;
+    }
 
-        for (int64_t aggregateTime = regionStart; aggregateTime < regionEnd; ++aggregateTime) {
-            const int offsetStored = aggregateTime - melRecordStart;
-            const int offsetNew = aggregateTime - mel.timestamp;
-            newMels[overlapStart + offsetNew] =
-                aggregateMels(melRecord.mels[offsetStored], mel.mels[offsetNew]);
-        }
+    // The runs are sorted and do not overlap, so their ends are sorted as well.
+    const auto first = std::partition_point(mMelRuns.begin(), mMelRuns.end(),
+            [start](const MelRun& run) { return run.end() <= start; });
+    const auto last = std::partition_point(first, mMelRuns.end(),
+            [end](const MelRun& run) { return run.timestamp < end; });
+    const int64_t mergedStart = first != last ? std::min(start, first->timestamp) : start;
+    const int64_t mergedEnd = first != last ? std::max(end, std::prev(last)->end()) : end;
+    const size_t mergedLength = mergedEnd - mergedStart;
+
+    // The merged run is stored at the end of the energies, the merged runs become stale.
+    const size_t offset = mMelEnergies.size();
+    mMelEnergies.resize(offset + mergedLength, 0.f);
+    for (auto it = first; it != last; ++it) {
+        std::copy_n(mMelEnergies.begin() + it->offset, it->length,
+                    mMelEnergies.begin() + offset + (it->timestamp - mergedStart));
+        mMelEnergiesUsed -= it->length;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        mMelEnergies[offset + (start - mergedStart) + i] += melToEnergy(mel.mels[i]);
+    }
+    mMelEnergiesUsed += mergedLength;
+
+    const MelRun merged{mergedStart, mergedLength, offset, mel.portId};
+    if (first == last) {
+        mMelRuns.insert(first, merged);
+    } else {
+        *first = merged;
+        mMelRuns.erase(first + 1, last);
+    }
 
-        const int64_t mergeEndTime = melRecordStart + melRecord.mels.size();
-        if (mergeEndTime > regionEnd) {
-            newMels.insert(newMels.end(),
-                           melRecord.mels.end() - mergeEndTime + regionEnd,
-                           melRecord.mels.end());
+    // Compact when more than half of the energies are stale.
+    if (mMelEnergies.size() > kMelEnergiesCapacity / 2
+            && mMelEnergies.size() > 2 * mMelEnergiesUsed) {
+        std::vector<float> energies;
+        energies.reserve(std::max(kMelEnergiesCapacity, mMelEnergiesUsed));
+        for (auto& run : mMelRuns) {
+            const size_t runOffset = energies.size();
+            energies.insert(energies.end(), mMelEnergies.begin() + run.offset,
+                            mMelEnergies.begin() + run.offset + run.length);
+            run.offset = runOffset;
         }
-
-        ++mergeIt;
+        mMelEnergies.swap(energies);
     }
+}
 
-    auto hint = mergeIt;
-    if (mergeStart != mergeIt) {
-        hint = mMelRecords.erase(mergeStart, mergeIt);
+std::vector<CsdRecord> MelAggregator::aggregateAndAddNewMelRecord(const MelRecord& mel)
+{
+    std::lock_guard _l(mLock);
+    return aggregateAndAddNewMelRecord_l(mel);
+}
+
+std::vector<CsdRecord> MelAggregator::aggregateAndAddNewMelRecord_l(const MelRecord& mel)
+{
+    for (const auto& m : mel.mels) {
+        mCurrentMelRecordsCsd += energyToCsd(melToEnergy(m));
     }
+    ALOGV("%s: current mel values CSD %f", __func__, mCurrentMelRecordsCsd);
 
-    mMelRecords.emplace_hint(hint,
-                             newTimestamp,
-                             MelRecord(mel.portId, newMels, newTimestamp));
+    addMelRun_l(mel);
 
     return updateCsdRecords_l();
 }
@@ -237,26 +300,32 @@ std::vector<CsdRecord> MelAggregator::aggregateAndAddNewMelRecord_l(const MelRec
 void MelAggregator::reset(float newCsd, const std::vector<CsdRecord>& newRecords)
 {
     std::lock_guard _l(mLock);
-    mCsdRecords.clear();
-    mMelRecords.clear();
+    mCsdFront = 0;
+    mCsdCount = 0;
+    clearMelRuns_l();
 
     mCurrentCsd = newCsd;
     for (const auto& record : newRecords) {
-        mCsdRecords.emplace_hint(mCsdRecords.end(), record.timestamp, record);
+        insertCsdEntry_l({record.timestamp, static_cast<uint32_t>(record.duration),
+                          record.value, record.averageMel});
     }
 }
 
 size_t MelAggregator::getCachedMelRecordsSize() const
 {
     std::lock_guard _l(mLock);
-    return mMelRecords.size();
+    return mMelRuns.size();
 }
 
 void MelAggregator::foreachCachedMel(const std::function<void(const MelRecord&)>& f) const
 {
      std::lock_guard _l(mLock);
-     for (const auto &melRecord : mMelRecords) {
-         f(melRecord.second);
+     for (const auto& run : mMelRuns) {
+         std::vector<float> mels(run.length);
+         for (size_t i = 0; i < run.length; ++i) {
+             mels[i] = audio_utils_power_from_energy(mMelEnergies[run.offset + i]);
+         }
+         f(MelRecord(run.portId, std::move(mels), run.timestamp));
      }
 }
 
@@ -267,15 +336,216 @@ float MelAggregator::getCsd() {
 
 size_t MelAggregator::getCsdRecordsSize() const {
     std::lock_guard _l(mLock);
-    return mCsdRecords.size();
+    return mCsdCount;
 }
 
 void MelAggregator::foreachCsd(const std::function<void(const CsdRecord&)>& f) const
 {
      std::lock_guard _l(mLock);
-     for (const auto &csdRecord : mCsdRecords) {
-         f(csdRecord.second);
+     for (size_t i = 0; i < mCsdCount; ++i) {
+         f(csdEntry_l(i).toRecord());
      }
 }
 
+std::vector<uint8_t> MelAggregator::serialize() const
+{
+    using PersistedState = MelAggregator::PersistedState;
+    std::lock_guard _l(mLock);
+    const PersistedState::Header header{
+        .magic = PersistedState::kMagic,
+        .version = PersistedState::kVersion,
+        .csd = mCurrentCsd,
+        .melRecordsCsd = mCurrentMelRecordsCsd,
+        .csdRecordsSize = static_cast<uint32_t>(mCsdCount),
+        .melRecordsSize = static_cast<uint32_t>(mMelRuns.size()),
+        .melValuesSize = mMelEnergiesUsed,
+    };
+    std::vector<uint8_t> data(sizeof(header)
+            + mCsdCount * sizeof(CsdEntry)
+            + mMelRuns.size() * sizeof(PersistedState::MelRunEntry)
+            + mMelEnergiesUsed * sizeof(float));
+    uint8_t* dst = data.data();
+    const auto append = [&dst](const void* src, size_t size) {
+        memcpy(dst, src, size);
+        dst += size;
+    };
+    append(&header, sizeof(header));
+
+    // the CSD ring wraps at most once
+    const size_t firstCount = std::min(mCsdCount, mCsdEntries.size() - mCsdFront);
+    append(&mCsdEntries[mCsdFront], firstCount * sizeof(CsdEntry));
+    append(mCsdEntries.data(), (mCsdCount - firstCount) * sizeof(CsdEntry));
+
+    for (const auto& run : mMelRuns) {
+        const PersistedState::MelRunEntry entry{
+                run.timestamp, static_cast<uint32_t>(run.length), run.portId};
+        append(&entry, sizeof(entry));
+    }
+    for (const auto& run : mMelRuns) {
+        append(&mMelEnergies[run.offset], run.length * sizeof(float));
+    }
+    return data;
+}
+
+void MelAggregator::reset(const PersistedState& state)
+{
+    std::lock_guard _l(mLock);
+    clearMelRuns_l();
+    mCurrentCsd = state.mHeader.csd;
+    mCurrentMelRecordsCsd = state.mHeader.melRecordsCsd;
+
+    const size_t csdCount = state.mHeader.csdRecordsSize;
+    size_t capacity = kCsdEntriesCapacity;
+    while (capacity < csdCount) capacity *= 2;
+    if (mCsdEntries.size() < capacity) {
+        mCsdEntries.resize(capacity);
+    }
+    memcpy(mCsdEntries.data(), state.csdEntries(), csdCount * sizeof(CsdEntry));
+    mCsdFront = 0;
+    mCsdCount = csdCount;
+
+    const size_t melValues = state.mHeader.melValuesSize;
+    mMelEnergies.resize(melValues);
+    memcpy(mMelEnergies.data(), state.melValues(), melValues * sizeof(float));
+    mMelEnergiesUsed = melValues;
+    size_t offset = 0;
+    for (size_t i = 0; i < state.mHeader.melRecordsSize; ++i) {
+        PersistedState::MelRunEntry entry;
+        memcpy(&entry, state.melRunEntries() + i * sizeof(entry), sizeof(entry));
+        mMelRuns.push_back({entry.timestamp, entry.length, offset, entry.portId});
+        offset += entry.length;
+    }
+}
+
+std::unique_ptr<MelAggregator::PersistedState> MelAggregator::PersistedState::fromData(
+        const void* data, size_t size)
+{
+    return create(static_cast<const uint8_t*>(data), size, 0 /* mappedSize */);
+}
+
+std::unique_ptr<MelAggregator::PersistedState> MelAggregator::PersistedState::fromFile(
+        const char* path)
+{
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGW("%s: cannot open %s: %s", __func__, path, strerror(errno));
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ALOGW("%s: cannot stat %s or empty file", __func__, path);
+        close(fd);
+        return nullptr;
+    }
+    const size_t size = st.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        ALOGW("%s: cannot map %s: %s", __func__, path, strerror(errno));
+        return nullptr;
+    }
+    auto state = create(static_cast<const uint8_t*>(data), size, size);
+    if (state == nullptr) {
+        munmap(data, size);
+    }
+    return state;
+}
+
+std::unique_ptr<MelAggregator::PersistedState> MelAggregator::PersistedState::create(
+        const uint8_t* data, size_t size, size_t mappedSize)
+{
+    // the persisted layout must not depend on the ABI
+    static_assert(sizeof(Header) == 32);
+    static_assert(sizeof(CsdEntry) == 24);
+    static_assert(sizeof(MelRunEntry) == 16);
+
+    Header header;
+    if (size < sizeof(header)) {
+        ALOGW("%s: size %zu is too small", __func__, size);
+        return nullptr;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != kMagic || header.version != kVersion) {
+        ALOGW("%s: unsupported magic %#x version %u", __func__, header.magic, header.version);
+        return nullptr;
+    }
+    // the counts are bounded, so that the expected size cannot overflow
+    const uint64_t expectedSize = sizeof(header)
+            + uint64_t{header.csdRecordsSize} * sizeof(CsdEntry)
+            + uint64_t{header.melRecordsSize} * sizeof(MelRunEntry)
+            + std::min<uint64_t>(header.melValuesSize, size) * sizeof(float);
+    if (expectedSize != size) {
+        ALOGW("%s: size %zu does not match the %" PRIu64 " expected",
+              __func__, size, expectedSize);
+        return nullptr;
+    }
+
+    // the aggregator relies on the records being sorted
+    const uint8_t* const csdEntries = data + sizeof(header);
+    int64_t previousTimestamp = INT64_MIN;
+    for (size_t i = 0; i < header.csdRecordsSize; ++i) {
+        int64_t timestamp;
+        memcpy(&timestamp, csdEntries + i * sizeof(CsdEntry), sizeof(timestamp));
+        if (timestamp < previousTimestamp) {
+            ALOGW("%s: CSD record %zu is not sorted", __func__, i);
+            return nullptr;
+        }
+        previousTimestamp = timestamp;
+    }
+    const uint8_t* const melRunEntries = csdEntries + header.csdRecordsSize * sizeof(CsdEntry);
+    uint64_t melValues = 0;
+    int64_t previousEnd = INT64_MIN;
+    for (size_t i = 0; i < header.melRecordsSize; ++i) {
+        MelRunEntry entry;
+        memcpy(&entry, melRunEntries + i * sizeof(entry), sizeof(entry));
+        if (entry.length == 0 || entry.timestamp < previousEnd) {
+            ALOGW("%s: MEL record %zu is empty or not sorted", __func__, i);
+            return nullptr;
+        }
+        if (entry.timestamp > INT64_MAX - int64_t{entry.length}) {
+            ALOGW("%s: MEL record %zu ends past the largest timestamp", __func__, i);
+            return nullptr;
+        }
+        previousEnd = entry.timestamp + entry.length;
+        melValues += entry.length;
+    }
+    if (melValues != header.melValuesSize) {
+        ALOGW("%s: MEL records have %" PRIu64 " values instead of %" PRIu64,
+              __func__, melValues, header.melValuesSize);
+        return nullptr;
+    }
+    return std::unique_ptr<PersistedState>(new PersistedState(data, header, mappedSize));
+}
+
+MelAggregator::PersistedState::~PersistedState()
+{
+    if (mMappedSize != 0) {
+        munmap(const_cast<uint8_t*>(mData), mMappedSize);
+    }
+}
+
+CsdRecord MelAggregator::PersistedState::getCsdRecord(size_t i) const
+{
+    CsdEntry entry;
+    memcpy(&entry, csdEntries() + i * sizeof(entry), sizeof(entry));
+    return entry.toRecord();
+}
+
+void MelAggregator::PersistedState::foreachCachedMel(
+        const std::function<void(const MelRecord&)>& f) const
+{
+    const uint8_t* values = melValues();
+    for (size_t i = 0; i < mHeader.melRecordsSize; ++i) {
+        MelRunEntry entry;
+        memcpy(&entry, melRunEntries() + i * sizeof(entry), sizeof(entry));
+        std::vector<float> mels(entry.length);
+        memcpy(mels.data(), values, entry.length * sizeof(float));
+        values += entry.length * sizeof(float);
+        for (auto& mel : mels) {
+            mel = audio_utils_power_from_energy(mel);
+        }
+        f(MelRecord(entry.portId, std::move(mels), entry.timestamp));
+    }
+}
+
 }  // namespace android::audio_utils
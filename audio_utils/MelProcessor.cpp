@@ -25,8 +25,9 @@
 
 #include <audio_utils/MelProcessor.h>
 
-#include <audio_utils/format.h>
+#include <algorithm>
 #include <audio_utils/power.h>
+#include <audio_utils/primitives.h>
 #include <log/log.h>
 #include <sstream>
 #include <unordered_map>
@@ -115,15 +116,14 @@ MelProcessor::MelProcessor(uint32_t sampleRate,
         const sp<MelCallback>& callback,
         audio_port_handle_t deviceId,
         float rs2Value,
-        size_t maxMelsCallback)
+        size_t maxMelsCallback,
+        const sp<MelExecutor>& executor)
     : mCallback(callback),
-      mMelWorker("MelWorker#" + pointerString(), mCallback),
+      mMelWorker("MelWorker#" + pointerString(), mCallback, executor),
       mSampleRate(sampleRate),
       mFramesPerMelValue(sampleRate * kSecondsPerMelValue),
       mChannelCount(channelCount),
       mFormat(format),
-      mAWeightSamples(mFramesPerMelValue * mChannelCount),
-      mFloatSamples(mFramesPerMelValue * mChannelCount),
       mCurrentChannelEnergy(channelCount, 0.0f),
       mMelValues(maxMelsCallback),
       mCurrentIndex(0),
@@ -169,10 +169,11 @@ void MelProcessor::createBiquads_l() {
     }
 
     const auto& biquadCoeffs = getSampleRateBiquadCoeffs().at(mSampleRate); // checked above
-    mCascadedBiquads =
-              {std::make_unique<DefaultBiquadFilter>(mChannelCount, biquadCoeffs->at(0)),
-               std::make_unique<DefaultBiquadFilter>(mChannelCount, biquadCoeffs->at(1)),
-               std::make_unique<DefaultBiquadFilter>(mChannelCount, biquadCoeffs->at(2))};
+    static_assert(kCascadeBiquadNumber <= BiquadCascade<float>::kSectionsPerPass);
+    mAWeightCascade = std::make_unique<BiquadCascade<float>>(mChannelCount, kCascadeBiquadNumber);
+    for (size_t i = 0; i < kCascadeBiquadNumber; ++i) {
+        mAWeightCascade->setCoefficients(i, biquadCoeffs->at(i));
+    }
 }
 
 status_t MelProcessor::setOutputRs2UpperBound(float rs2Value)
@@ -219,7 +220,6 @@ void MelProcessor::updateAudioFormat(uint32_t sampleRate,
 
     std::lock_guard l(mLock);
 
-    bool differentSampleRate = (mSampleRate != sampleRate);
     bool differentChannelCount = (mChannelCount != channelCount);
 
     mSampleRate = sampleRate;
@@ -227,10 +227,6 @@ void MelProcessor::updateAudioFormat(uint32_t sampleRate,
     mChannelCount = channelCount;
     mFormat = format;
 
-    if (differentSampleRate || differentChannelCount) {
-        mAWeightSamples.resize(mFramesPerMelValue * mChannelCount);
-        mFloatSamples.resize(mFramesPerMelValue * mChannelCount);
-    }
     if (differentChannelCount) {
         mCurrentChannelEnergy.resize(channelCount);
     }
@@ -238,22 +234,39 @@ void MelProcessor::updateAudioFormat(uint32_t sampleRate,
     createBiquads_l();
 }
 
-void MelProcessor::applyAWeight_l(const void* buffer, size_t samples)
+void MelProcessor::accumulateAWeightedEnergy_l(const void* buffer, size_t frames)
 {
-    memcpy_by_audio_format(mFloatSamples.data(), AUDIO_FORMAT_PCM_FLOAT, buffer, mFormat, samples);
-
-    float* tempFloat[2] = { mFloatSamples.data(), mAWeightSamples.data() };
-    int inIdx = 1, outIdx = 0;
-    const size_t frames = samples / mChannelCount;
-    for (const auto& biquad : mCascadedBiquads) {
-        outIdx ^= 1;
-        inIdx ^= 1;
-        biquad->process(tempFloat[outIdx], tempFloat[inIdx], frames);
+    // Converts, A-weights and accumulates the energy in a single pass over the input.
+    float* const energy = mCurrentChannelEnergy.data();
+    switch (mFormat) {
+    case AUDIO_FORMAT_PCM_8_BIT:
+        mAWeightCascade->accumulateEnergy(energy, static_cast<const uint8_t*>(buffer), frames,
+                [](uint8_t sample) { return float_from_u8(sample); });
+        break;
+    case AUDIO_FORMAT_PCM_16_BIT:
+        mAWeightCascade->accumulateEnergy(energy, static_cast<const int16_t*>(buffer), frames,
+                [](int16_t sample) { return float_from_i16(sample); });
+        break;
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED: {
+        struct p24_t { uint8_t bytes[3]; };
+        static_assert(sizeof(p24_t) == 3);
+        mAWeightCascade->accumulateEnergy(energy, static_cast<const p24_t*>(buffer), frames,
+                [](const p24_t& sample) { return float_from_p24(sample.bytes); });
+        break;
     }
-
-    // should not be the case since the size is odd
-    if (!(mCascadedBiquads.size() & 1)) {
-        std::swap(mFloatSamples, mAWeightSamples);
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        mAWeightCascade->accumulateEnergy(energy, static_cast<const int32_t*>(buffer), frames,
+                [](int32_t sample) { return float_from_q8_23(sample); });
+        break;
+    case AUDIO_FORMAT_PCM_32_BIT:
+        mAWeightCascade->accumulateEnergy(energy, static_cast<const int32_t*>(buffer), frames,
+                [](int32_t sample) { return float_from_i32(sample); });
+        break;
+    case AUDIO_FORMAT_PCM_FLOAT:
+        mAWeightCascade->accumulateEnergy(energy, static_cast<const float*>(buffer), frames);
+        break;
+    default:
+        LOG_ALWAYS_FATAL("%s: invalid format: %#x", __func__, mFormat);
     }
 }
 
@@ -298,7 +311,7 @@ void MelProcessor::addMelValue_l(float mel) {
     }
 
     if (notifyWorker) {
-        mMelWorker.mCondVar.notify_one();
+        mMelWorker.notify();
     }
 }
 
@@ -322,13 +335,7 @@ int32_t MelProcessor::process(const void* buffer, size_t bytes) {
         size_t processSamples = std::min(requiredSamples, samples);
         processSamples -= processSamples % mChannelCount;
 
-        applyAWeight_l(buffer, processSamples);
-
-        audio_utils_accumulate_energy(mAWeightSamples.data(),
-                                      AUDIO_FORMAT_PCM_FLOAT,
-                                      processSamples,
-                                      mChannelCount,
-                                      mCurrentChannelEnergy.data());
+        accumulateAWeightedEnergy_l(buffer, processSamples / mChannelCount);
         mCurrentSamples += processSamples;
 
         ALOGVV(
@@ -375,6 +382,11 @@ std::string MelProcessor::pointerString() const {
 }
 
 void MelProcessor::MelWorker::run() {
+    if (mExecutor != nullptr) {
+        // callbacks are delivered by the executor threads
+        return;
+    }
+
     mThread = std::thread([&]{
         // name the thread to help identification
         androidSetThreadName(mThreadName.c_str());
@@ -387,32 +399,47 @@ void MelProcessor::MelWorker::run() {
             }
             mCondVar.wait(l, [&] { return (mRbReadPtr != mRbWritePtr) || mStopRequested; });
 
-            while (mRbReadPtr != mRbWritePtr && !mStopRequested) {
-                ALOGV("%s::run(): new callbacks, rb idx read=%zu, write=%zu",
-                      mThreadName.c_str(),
-                      mRbReadPtr.load(),
-                      mRbWritePtr.load());
-                auto callback = mCallback.promote();
-                if (callback == nullptr) {
-                    ALOGW("%s::run(): MelCallback is null, quitting MelWorker",
-                          mThreadName.c_str());
-                    return;
-                }
-
-                MelCallbackData data = mCallbackRingBuffer[mRbReadPtr];
-                if (data.mMel != 0.f) {
-                    callback->onMomentaryExposure(data.mMel, data.mPort);
-                } else if (data.mMelsSize != 0) {
-                    callback->onNewMelValues(data.mMels, 0, data.mMelsSize, data.mPort);
-                } else {
-                    ALOGE("%s::run(): Invalid MEL data. Skipping callback", mThreadName.c_str());
-                }
-                incRingBufferIndex(mRbReadPtr);
+            if (!deliverCallbacks_l()) {
+                return;
             }
         }
     });
 }
 
+bool MelProcessor::MelWorker::deliverCallbacks_l() {
+    while (mRbReadPtr != mRbWritePtr && !mStopRequested) {
+        ALOGV("%s::run(): new callbacks, rb idx read=%zu, write=%zu",
+              mThreadName.c_str(),
+              mRbReadPtr.load(),
+              mRbWritePtr.load());
+        auto callback = mCallback.promote();
+        if (callback == nullptr) {
+            ALOGW("%s::run(): MelCallback is null, quitting MelWorker",
+                  mThreadName.c_str());
+            return false;
+        }
+
+        MelCallbackData data = mCallbackRingBuffer[mRbReadPtr];
+        if (data.mMel != 0.f) {
+            callback->onMomentaryExposure(data.mMel, data.mPort);
+        } else if (data.mMelsSize != 0) {
+            callback->onNewMelValues(data.mMels, 0, data.mMelsSize, data.mPort);
+        } else {
+            ALOGE("%s::run(): Invalid MEL data. Skipping callback", mThreadName.c_str());
+        }
+        incRingBufferIndex(mRbReadPtr);
+    }
+    return true;
+}
+
+void MelProcessor::MelWorker::notify() {
+    if (mExecutor != nullptr) {
+        mExecutor->schedule(this);
+    } else {
+        mCondVar.notify_one();
+    }
+}
+
 void MelProcessor::MelWorker::stop() {
     bool oldValue;
     {
@@ -420,7 +447,12 @@ void MelProcessor::MelWorker::stop() {
         oldValue = mStopRequested;
         mStopRequested = true;
     }
-    if (!oldValue) {
+    if (oldValue) {
+        return;
+    }
+    if (mExecutor != nullptr) {
+        mExecutor->cancel(this);
+    } else {
         mCondVar.notify_one();
         mThread.join();
     }
@@ -481,4 +513,102 @@ void MelProcessor::MelWorker::incRingBufferIndex(std::atomic_size_t& idx) {
     } while (!idx.compare_exchange_strong(expected, nextIdx));
 }
 
+MelProcessor::MelExecutor::MelExecutor(size_t threadCount,
+                                       std::chrono::milliseconds batchPeriod,
+                                       std::string name)
+    : mName(std::move(name)),
+      mBatchPeriod(batchPeriod)
+{
+    threadCount = std::clamp(threadCount, size_t{1}, kMaxThreadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        mThreads.emplace_back([this, i] {
+            // name the thread to help identification
+            androidSetThreadName((mName + "#" + std::to_string(i)).c_str());
+            ALOGV("%s#%zu: Started thread", mName.c_str(), i);
+            threadLoop();
+        });
+    }
+}
+
+MelProcessor::MelExecutor::~MelExecutor() {
+    {
+        std::lock_guard l(mLock);
+        // the MelProcessors hold a reference, so all workers are cancelled at this point
+        LOG_ALWAYS_FATAL_IF(!mQueue.empty(), "%s: destroyed with queued workers", mName.c_str());
+        mStopRequested = true;
+    }
+    mCondVar.notify_all();
+    mStopCondVar.notify_all();
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void MelProcessor::MelExecutor::threadLoop() {
+    std::unique_lock l(mLock);
+    while (true) {
+        mCondVar.wait(l, [&] { return !mQueue.empty() || mStopRequested; });
+        if (mStopRequested) {
+            return;
+        }
+
+        // serve all the queued workers before waiting again
+        while (!mQueue.empty()) {
+            MelWorker* worker = mQueue.front();
+            mQueue.pop_front();
+            worker->mQueued = false;
+            worker->mDelivering = true;
+            l.unlock();
+
+            bool callbackValid;
+            {
+                std::lock_guard workerLock(worker->mCondVarMutex);
+                callbackValid = worker->deliverCallbacks_l();
+            }
+
+            l.lock();
+            worker->mDelivering = false;
+            if (!callbackValid) {
+                ALOGW("%s: MelCallback is null, no more callbacks for %s",
+                      mName.c_str(), worker->mThreadName.c_str());
+                worker->mCancelled = true;
+            } else if (!worker->mCancelled && !worker->mQueued
+                    && worker->mRbReadPtr != worker->mRbWritePtr) {
+                // callbacks posted while delivering, keep the order by queueing again
+                worker->mQueued = true;
+                mQueue.push_back(worker);
+            }
+            mDeliveredCondVar.notify_all();
+        }
+
+        if (mBatchPeriod.count() > 0) {
+            // let more callbacks queue up, new ones do not wake up this thread
+            mStopCondVar.wait_for(l, mBatchPeriod, [&] { return mStopRequested; });
+        }
+    }
+}
+
+void MelProcessor::MelExecutor::schedule(MelWorker* worker) {
+    {
+        std::lock_guard l(mLock);
+        // a worker being delivered is queued again by the executor thread if needed
+        if (worker->mQueued || worker->mDelivering || worker->mCancelled) {
+            return;
+        }
+        worker->mQueued = true;
+        mQueue.push_back(worker);
+    }
+    mCondVar.notify_one();
+}
+
+void MelProcessor::MelExecutor::cancel(MelWorker* worker) {
+    std::unique_lock l(mLock);
+    worker->mCancelled = true;
+    if (worker->mQueued) {
+        mQueue.erase(std::find(mQueue.begin(), mQueue.end(), worker));
+        worker->mQueued = false;
+    }
+    mDeliveredCondVar.wait(l, [&] { return !worker->mDelivering; });
+}
+
 }   // namespace android
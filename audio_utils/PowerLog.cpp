@@ -48,7 +48,6 @@ PowerLog::PowerLog(uint32_t sampleRate,
     : mCurrentTime(0)
     , mCurrentEnergy(0)
     , mCurrentFrames(0)
-    , mIdx(0)
     , mConsecutiveZeroes(0)
     , mSampleRate(sampleRate)
     , mChannelCount(channelCount)
@@ -63,8 +62,6 @@ PowerLog::PowerLog(uint32_t sampleRate,
 
 void PowerLog::log(const void *buffer, size_t frames, int64_t nowNs)
 {
-    std::lock_guard<std::mutex> guard(mLock);
-
     const size_t bytes_per_sample = audio_bytes_per_sample(mFormat);
     while (frames > 0) {
         // check partial computation
@@ -88,32 +85,62 @@ void PowerLog::log(const void *buffer, size_t frames, int64_t nowNs)
         // zero terminated. Consecutive zeroes are ignored.
         if (mCurrentEnergy == 0.f) {
             if (mConsecutiveZeroes++ == 0) {
-                mEntries[mIdx++] = std::make_pair(nowNs, 0.f);
+                appendEntry(nowNs, 0.f);
                 // zero terminate the signal sequence.
             }
         } else {
             mConsecutiveZeroes = 0;
-            mEntries[mIdx++] = std::make_pair(mCurrentTime, mCurrentEnergy);
+            appendEntry(mCurrentTime, mCurrentEnergy);
             ALOGV("writing %lld %f", (long long)mCurrentTime, mCurrentEnergy);
         }
-        if (mIdx >= mEntries.size()) {
-            mIdx -= mEntries.size();
-        }
         mCurrentTime = 0;
         mCurrentEnergy = 0;
         mCurrentFrames = 0;
         frames -= process;
-        buffer = (const uint8_t *)buffer + mCurrentFrames * mChannelCount * bytes_per_sample;
+        buffer = (const uint8_t *)buffer + process * mChannelCount * bytes_per_sample;
     }
 }
 
+void PowerLog::appendEntry(int64_t time, float energy)
+{
+    static_assert(std::atomic<int64_t>::is_always_lock_free);
+    static_assert(std::atomic<float>::is_always_lock_free);
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+    // Announce the write before modifying the entry, see dumpToString().
+    const uint64_t n = mWritten.load(std::memory_order_relaxed);
+    mStarted.store(n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Entry& entry = mEntries[n % mEntries.size()];
+    entry.time.store(time, std::memory_order_relaxed);
+    entry.energy.store(energy, std::memory_order_relaxed);
+    mWritten.store(n + 1, std::memory_order_release);
+}
+
 std::string PowerLog::dumpToString(
         const char *prefix, size_t lines, int64_t limitNs, bool logPlot) const
 {
-    std::lock_guard<std::mutex> guard(mLock);
+    // Copy the entries without blocking log(), which may overwrite the oldest ones
+    // during the copy. Any entry write observed by the copy has started before the
+    // acquire fence, so the entries of the writes started since mWritten are
+    // discarded, as if they were never written.
+    const size_t numberOfEntries = mEntries.size();
+    const uint64_t written = mWritten.load(std::memory_order_acquire);
+    std::vector<std::pair<int64_t /* real time ns */, float /* energy */>> entries;
+    entries.reserve(numberOfEntries);
+    for (const auto& entry : mEntries) {
+        entries.emplace_back(entry.time.load(std::memory_order_relaxed),
+                entry.energy.load(std::memory_order_relaxed));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t started = mStarted.load(std::memory_order_relaxed);
+    for (uint64_t n = written; n < started && n < written + numberOfEntries; ++n) {
+        entries[n % numberOfEntries] = std::make_pair(0, 0.f);
+    }
+    const size_t entriesIdx = written % numberOfEntries; // next usable index in entries
 
     const size_t maxColumns = 10;
-    const size_t numberOfEntries = mEntries.size();
     if (lines == 0) lines = SIZE_MAX;
 
     // compute where to start logging
@@ -126,10 +153,10 @@ std::string PowerLog::dumpToString(
     size_t nonzeros = 0;
     ssize_t offset; // TODO doesn't dump if # entries exceeds SSIZE_MAX
     for (offset = 0; offset < (ssize_t)numberOfEntries && count < lines; ++offset) {
-        const size_t idx = (mIdx + numberOfEntries - offset - 1) % numberOfEntries;
+        const size_t idx = (entriesIdx + numberOfEntries - offset - 1) % numberOfEntries;
                                                                                 // reverse direction
-        const int64_t time = mEntries[idx].first;
-        const float energy = mEntries[idx].second;
+        const int64_t time = entries[idx].first;
+        const float energy = entries[idx].second;
 
         if (state == AT_END) {
             if (energy == 0.f) {
@@ -179,9 +206,9 @@ std::string PowerLog::dumpToString(
         bool start = false;
         float cumulative = 0.f;
         for (; offset >= 0; --offset) {
-            const size_t idx = (mIdx + numberOfEntries - offset - 1) % numberOfEntries;
-            const int64_t time = mEntries[idx].first;
-            const float energy = mEntries[idx].second;
+            const size_t idx = (entriesIdx + numberOfEntries - offset - 1) % numberOfEntries;
+            const int64_t time = entries[idx].first;
+            const float energy = entries[idx].second;
 
             if (energy == 0.f) {
                 if (!first) {
@@ -25,15 +25,13 @@
 #include <audio_utils/intrinsic_utils.h>
 #include <audio_utils/format.h>
 
+template <typename vec, typename D = float>
 static void BM_Intrinsic(benchmark::State& state) {
-    using D = float;
     using namespace android::audio_utils::intrinsics;
-    constexpr size_t SIMD_LENGTH = 4;
 
     // Possible testing types:
-    using vec = android::audio_utils::intrinsics::internal_array_t<D, SIMD_LENGTH>;
-    //using vec = float32x4_t;
-    //using vec = float32x4x4_t;
+    //   internal_array_t<float, 4>, float32x4_t, float32x4x4_t (NEON),
+    //   __m128, __m256, __m512 (x86), internal_array_t<__m128, 4> (x86 composite).
 
     constexpr size_t DATA_SIZE = 1024;
     D a[DATA_SIZE];
@@ -74,6 +72,31 @@ static void BM_IntrinsicArgs(benchmark::internal::Benchmark* b) {
          b->Args({k});
 }
 
-BENCHMARK(BM_Intrinsic)->Apply(BM_IntrinsicArgs);
+using android::audio_utils::intrinsics::internal_array_t;
+
+// Scalar struct recursion, the compiler is free to auto-vectorize.
+BENCHMARK(BM_Intrinsic<internal_array_t<float, 4>>)->Apply(BM_IntrinsicArgs);
+BENCHMARK(BM_Intrinsic<internal_array_t<float, 16>>)->Apply(BM_IntrinsicArgs);
+BENCHMARK(BM_Intrinsic<internal_array_t<double, 4>, double>)->Apply(BM_IntrinsicArgs);
+
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+BENCHMARK(BM_Intrinsic<float32x4_t>)->Apply(BM_IntrinsicArgs);
+BENCHMARK(BM_Intrinsic<float32x4x4_t>)->Apply(BM_IntrinsicArgs);
+#endif
+
+#if defined(__SSE2__)
+BENCHMARK(BM_Intrinsic<__m128>)->Apply(BM_IntrinsicArgs);
+BENCHMARK(BM_Intrinsic<internal_array_t<__m128, 4>>)->Apply(BM_IntrinsicArgs);
+BENCHMARK(BM_Intrinsic<__m128d, double>)->Apply(BM_IntrinsicArgs);
+#endif
+#if defined(__AVX__)
+BENCHMARK(BM_Intrinsic<__m256>)->Apply(BM_IntrinsicArgs);
+BENCHMARK(BM_Intrinsic<internal_array_t<__m256, 2>>)->Apply(BM_IntrinsicArgs);
+BENCHMARK(BM_Intrinsic<__m256d, double>)->Apply(BM_IntrinsicArgs);
+#endif
+#if defined(__AVX512F__)
+BENCHMARK(BM_Intrinsic<__m512>)->Apply(BM_IntrinsicArgs);
+BENCHMARK(BM_Intrinsic<__m512d, double>)->Apply(BM_IntrinsicArgs);
+#endif
 
 BENCHMARK_MAIN();
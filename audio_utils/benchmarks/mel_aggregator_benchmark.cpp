@@ -0,0 +1,187 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <audio_utils/MelAggregator.h>
+
+#include <random>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+/*
+Time to aggregate a week of MEL values into the 7 day CSD window.
+
+The first argument is the number of devices. Each device plays for a few hours a day,
+at a level between RS1 and RS2, and reports MelProcessor::kMaxMelValues MELs at a time.
+The devices play simultaneously, with MEL seconds not aligned, so their records overlap.
+
+On a single core x86_64 host, median of 7 repetitions, where the MEL and CSD
+records were kept in std::map:
+
+BM_MelAggregatorWeek/1       6.24 ms   csdRecords=457
+BM_MelAggregatorWeek/2       12.7 ms   csdRecords=918
+BM_MelAggregatorWeek/4       24.9 ms   csdRecords=1.838k
+
+and with the MEL runs over a flat energy buffer and the CSD records in a ring:
+
+BM_MelAggregatorWeek/1       1.87 ms   csdRecords=457
+BM_MelAggregatorWeek/2       3.92 ms   csdRecords=918
+BM_MelAggregatorWeek/4       8.42 ms   csdRecords=1.838k
+*/
+
+using android::audio_utils::CsdRecord;
+using android::audio_utils::MelAggregator;
+using android::audio_utils::MelProcessor;
+using android::audio_utils::MelRecord;
+
+static constexpr int64_t kSecondsPerDay = 24 * 3600;
+static constexpr int64_t kCsdWindowSeconds = 7 * kSecondsPerDay;
+
+// Returns the MEL records of a week, sorted by the time they are reported.
+static std::vector<MelRecord> generateWeek(size_t deviceCount) {
+    constexpr int64_t kPlaybackStart = 8 * 3600;
+    constexpr int64_t kPlaybackSeconds = 3 * 3600;
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> level(80.f, 95.f);
+    std::uniform_int_distribution<int64_t> jitter(0, 600);
+
+    std::vector<MelRecord> records;
+    for (int64_t day = 0; day < 7; ++day) {
+        std::vector<int64_t> starts(deviceCount);
+        for (size_t device = 0; device < deviceCount; ++device) {
+            // offset by a second per device, so that the records overlap
+            starts[device] = day * kSecondsPerDay + kPlaybackStart + jitter(gen) + device;
+        }
+        for (int64_t t = 0; t < kPlaybackSeconds; t += MelProcessor::kMaxMelValues) {
+            for (size_t device = 0; device < deviceCount; ++device) {
+                std::vector<float> mels(MelProcessor::kMaxMelValues);
+                for (auto& mel : mels) mel = level(gen);
+                records.emplace_back(device, std::move(mels), starts[device] + t);
+            }
+        }
+    }
+    return records;
+}
+
+static void BM_MelAggregatorWeek(benchmark::State& state) {
+    const std::vector<MelRecord> records = generateWeek(state.range(0));
+    size_t csdRecords = 0;
+    for (auto _ : state) {
+        MelAggregator aggregator(kCsdWindowSeconds);
+        for (const auto& record : records) {
+            benchmark::DoNotOptimize(aggregator.aggregateAndAddNewMelRecord(record));
+        }
+        csdRecords = aggregator.getCsdRecordsSize();
+        benchmark::DoNotOptimize(aggregator.getCsd());
+    }
+    state.SetItemsProcessed(state.iterations() * records.size());
+    state.counters["csdRecords"] = csdRecords;
+}
+
+BENCHMARK(BM_MelAggregatorWeek)->Arg(1)->Arg(2)->Arg(4)->Unit(benchmark::kMillisecond);
+
+/*
+Time to restore the CSD records of a 7 day window, the argument is the number of records.
+
+BM_MelAggregatorRestoreRecords creates the CsdRecord's one at a time and resets the
+aggregator with them, BM_MelAggregatorRestoreSerialized resets it with the serialized
+state in memory, and BM_MelAggregatorRestoreFile maps the persisted state file first.
+
+On a single core x86_64 host, median of 7 repetitions:
+
+BM_MelAggregatorRestoreRecords/1024               22638 ns
+BM_MelAggregatorRestoreRecords/8192              181147 ns
+BM_MelAggregatorRestoreRecords/65536            1542979 ns
+BM_MelAggregatorRestoreSerialized/1024              621 ns
+BM_MelAggregatorRestoreSerialized/8192             8185 ns
+BM_MelAggregatorRestoreSerialized/65536          160765 ns
+BM_MelAggregatorRestoreFile/1024                   7998 ns
+BM_MelAggregatorRestoreFile/8192                  19482 ns
+BM_MelAggregatorRestoreFile/65536                165806 ns
+*/
+
+// Returns the serialized state of an aggregator with the given number of CSD records.
+static std::vector<uint8_t> createState(size_t csdRecords) {
+    std::vector<CsdRecord> records;
+    float csd = 0.f;
+    for (size_t i = 0; i < csdRecords; ++i) {
+        const float value = 0.01f;
+        records.emplace_back(i * kCsdWindowSeconds / csdRecords, 60, value, 90.f);
+        csd += value;
+    }
+    MelAggregator aggregator(kCsdWindowSeconds);
+    aggregator.reset(csd, records);
+    return aggregator.serialize();
+}
+
+static void BM_MelAggregatorRestoreRecords(benchmark::State& state) {
+    const std::vector<uint8_t> data = createState(state.range(0));
+    const auto persisted = MelAggregator::PersistedState::fromData(data.data(), data.size());
+    MelAggregator aggregator(kCsdWindowSeconds);
+    for (auto _ : state) {
+        std::vector<CsdRecord> records;
+        for (size_t i = 0; i < persisted->getCsdRecordsSize(); ++i) {
+            records.push_back(persisted->getCsdRecord(i));
+        }
+        aggregator.reset(persisted->getCsd(), records);
+        benchmark::DoNotOptimize(aggregator.getCsd());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_MelAggregatorRestoreSerialized(benchmark::State& state) {
+    const std::vector<uint8_t> data = createState(state.range(0));
+    MelAggregator aggregator(kCsdWindowSeconds);
+    for (auto _ : state) {
+        const auto persisted =
+                MelAggregator::PersistedState::fromData(data.data(), data.size());
+        aggregator.reset(*persisted);
+        benchmark::DoNotOptimize(aggregator.getCsd());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_MelAggregatorRestoreFile(benchmark::State& state) {
+    const std::vector<uint8_t> data = createState(state.range(0));
+#ifdef __ANDROID__
+    char filePath[] = "/data/local/tmp/mel_aggregator_benchmark_XXXXXX";
+#else
+    char filePath[] = "/tmp/mel_aggregator_benchmark_XXXXXX";
+#endif
+    const int fd = mkstemp(filePath);
+    if (fd < 0 || write(fd, data.data(), data.size()) != (ssize_t)data.size()) {
+        state.SkipWithError("cannot write the state file");
+        return;
+    }
+    close(fd);
+
+    MelAggregator aggregator(kCsdWindowSeconds);
+    for (auto _ : state) {
+        const auto persisted = MelAggregator::PersistedState::fromFile(filePath);
+        aggregator.reset(*persisted);
+        benchmark::DoNotOptimize(aggregator.getCsd());
+    }
+    unlink(filePath);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_MelAggregatorRestoreRecords)->Arg(1024)->Arg(8192)->Arg(65536);
+BENCHMARK(BM_MelAggregatorRestoreSerialized)->Arg(1024)->Arg(8192)->Arg(65536);
+BENCHMARK(BM_MelAggregatorRestoreFile)->Arg(1024)->Arg(8192)->Arg(65536);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,220 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <audio_utils/MelProcessor.h>
+#include <audio_utils/format.h>
+
+#include <atomic>
+#include <chrono>
+#include <dirent.h>
+#include <fstream>
+#include <math.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+/*
+Callback threads and their wakeups for a number of MelProcessors, each processing
+10 ms buffers with a MEL callback per second. The MEL second boundaries of the
+processors are staggered, as for streams started at different times. The buffers are
+paced 10 times faster than real time, so a second of audio lasts 100 ms.
+
+The first argument is the number of MelProcessors, the second the number of threads
+of the shared MelExecutor, where 0 means a thread per MelProcessor, and the third the
+batch period of the MelExecutor in ms, also 10 times shorter than in real time. The counters are the number of callback threads
+and their wakeups per second of audio.
+
+On a single core x86_64 host:
+
+--------------------------------------------------------------------------------------------
+Benchmark                                  Time        CPU  Iterations UserCounters...
+--------------------------------------------------------------------------------------------
+BM_MelProcessorCallbacks/1/0/0/iterations:20  100 ms  1.37 ms  20 threads=1 wakeups/s=1
+BM_MelProcessorCallbacks/4/0/0/iterations:20  100 ms  2.97 ms  20 threads=4 wakeups/s=4
+BM_MelProcessorCallbacks/16/0/0/iterations:20 100 ms  8.87 ms  20 threads=16 wakeups/s=16
+BM_MelProcessorCallbacks/64/0/0/iterations:20 100 ms  32.4 ms  20 threads=64 wakeups/s=64
+BM_MelProcessorCallbacks/1/1/0/iterations:20  100 ms  1.40 ms  20 threads=1 wakeups/s=1
+BM_MelProcessorCallbacks/4/1/0/iterations:20  100 ms  3.20 ms  20 threads=1 wakeups/s=4
+BM_MelProcessorCallbacks/16/1/0/iterations:20 100 ms  9.10 ms  20 threads=1 wakeups/s=16
+BM_MelProcessorCallbacks/64/1/0/iterations:20 100 ms  32.6 ms  20 threads=1 wakeups/s=64
+BM_MelProcessorCallbacks/1/1/10/iterations:20  100 ms  1.37 ms  20 threads=1 wakeups/s=1.95
+BM_MelProcessorCallbacks/4/1/10/iterations:20  100 ms  2.91 ms  20 threads=1 wakeups/s=7.95
+BM_MelProcessorCallbacks/16/1/10/iterations:20 100 ms  9.58 ms  20 threads=1 wakeups/s=9.95
+BM_MelProcessorCallbacks/64/1/10/iterations:20 100 ms  33.5 ms  20 threads=1 wakeups/s=9.95
+BM_MelProcessorCallbacks/64/2/10/iterations:20 100 ms  33.3 ms  20 threads=2 wakeups/s=20.15
+
+A shared executor bounds the number of threads. With a batch period, the wakeups are
+bounded by the number of periods per second instead of growing with the MelProcessors,
+while a sparse load costs an additional wakeup per delivery for the end of the period.
+*/
+
+static constexpr uint32_t kSampleRate = 48000;
+static constexpr size_t kBufferFrames = kSampleRate / 100;  // 10 ms
+static constexpr size_t kBuffersPerSecond = kSampleRate / kBufferFrames;
+static constexpr auto kBufferPeriod = std::chrono::milliseconds(1);  // 10 ms paced 10x
+
+using android::sp;
+using android::audio_utils::MelProcessor;
+
+class NullMelCallback : public MelProcessor::MelCallback {
+public:
+    void onNewMelValues(const std::vector<float>&, size_t, size_t length,
+                        audio_port_handle_t) const override {
+        mMelCount += length;
+    }
+    void onMomentaryExposure(float, audio_port_handle_t) const override {}
+
+    mutable std::atomic_size_t mMelCount = 0;
+};
+
+// Returns the thread count and the total voluntary context switches, that is the number
+// of times they blocked and were woken up, of the callback threads of this process.
+static std::pair<size_t, size_t> getCallbackThreadWakeups() {
+    size_t threads = 0;
+    size_t wakeups = 0;
+    DIR* dir = opendir("/proc/self/task");
+    if (dir == nullptr) return {};
+    while (const struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        const std::string task = std::string("/proc/self/task/") + entry->d_name;
+        std::string comm;
+        std::getline(std::ifstream(task + "/comm"), comm);
+        if (comm.rfind("MelWorker", 0) != 0 && comm.rfind("MelExecutor", 0) != 0) continue;
+        ++threads;
+        std::ifstream status(task + "/status");
+        for (std::string line; std::getline(status, line); ) {
+            size_t switches;
+            if (sscanf(line.c_str(), "voluntary_ctxt_switches: %zu", &switches) == 1) {
+                wakeups += switches;
+                break;
+            }
+        }
+    }
+    closedir(dir);
+    return {threads, wakeups};
+}
+
+static void BM_MelProcessorCallbacks(benchmark::State& state) {
+    const size_t processorCount = state.range(0);
+    const size_t executorThreads = state.range(1);
+    const std::chrono::milliseconds batchPeriod(state.range(2));
+
+    // A loud enough 1 kHz sine, so that each second has a MEL above RS1.
+    std::vector<float> buffer(kBufferFrames);
+    for (size_t i = 0; i < kBufferFrames; ++i) {
+        buffer[i] = 0.5f * sinf(2.f * M_PI * 1000.f * i / kSampleRate);
+    }
+
+    auto callback = sp<NullMelCallback>::make();
+    const sp<MelProcessor::MelExecutor> executor = executorThreads == 0
+            ? nullptr : sp<MelProcessor::MelExecutor>::make(executorThreads, batchPeriod);
+    std::vector<sp<MelProcessor>> processors;
+    for (size_t i = 0; i < processorCount; ++i) {
+        processors.push_back(sp<MelProcessor>::make(kSampleRate, 1, AUDIO_FORMAT_PCM_FLOAT,
+                callback, i, 100.f, 1 /* maxMelsCallback */, executor));
+        // stagger the second boundaries
+        for (size_t j = 0; j < i * kBuffersPerSecond / processorCount; ++j) {
+            processors[i]->process(buffer.data(), buffer.size() * sizeof(float));
+        }
+    }
+    // let the threads start and block
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const size_t melCount = callback->mMelCount;
+    const auto [threads, startWakeups] = getCallbackThreadWakeups();
+
+    // Each iteration processes a second of audio for every processor.
+    auto nextBuffer = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        for (size_t j = 0; j < kBuffersPerSecond; ++j) {
+            for (auto& processor : processors) {
+                processor->process(buffer.data(), buffer.size() * sizeof(float));
+            }
+            nextBuffer += kBufferPeriod;
+            std::this_thread::sleep_until(nextBuffer);
+        }
+    }
+
+    const size_t expectedMelCount = melCount + processorCount * state.iterations();
+    for (int i = 0; i < 100 && callback->mMelCount < expectedMelCount; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const auto [endThreads, endWakeups] = getCallbackThreadWakeups();
+    if (callback->mMelCount != expectedMelCount || endThreads != threads) {
+        state.SkipWithError("missing MEL callbacks");
+    }
+    state.counters["threads"] = threads;
+    state.counters["wakeups/s"] = (double)(endWakeups - startWakeups) / state.iterations();
+}
+
+BENCHMARK(BM_MelProcessorCallbacks)
+    ->ArgsProduct({{1, 4, 16, 64}, {0}, {0}})
+    ->ArgsProduct({{1, 4, 16, 64}, {1}, {0, 10}})
+    ->Args({64, 2, 10})
+    ->Iterations(20)
+    ->Unit(benchmark::kMillisecond);
+
+/*
+Time to process a 10 ms buffer at 48 kHz. The first argument is the audio format,
+1 for AUDIO_FORMAT_PCM_16_BIT or 5 for AUDIO_FORMAT_PCM_FLOAT, the second the channel count.
+
+On a single core x86_64 host (SSE), median of 7 repetitions, where the separate format
+conversion, A-weighting and energy passes took:
+
+BM_MelProcessorProcess/1/1       5088 ns
+BM_MelProcessorProcess/5/1       4969 ns
+BM_MelProcessorProcess/1/2       5302 ns
+BM_MelProcessorProcess/5/2       5161 ns
+BM_MelProcessorProcess/1/8       6210 ns
+BM_MelProcessorProcess/5/8       5929 ns
+
+and the fused BiquadCascade::accumulateEnergy() takes:
+
+BM_MelProcessorProcess/1/1       2862 ns
+BM_MelProcessorProcess/5/1       2739 ns
+BM_MelProcessorProcess/1/2       3797 ns
+BM_MelProcessorProcess/5/2       3365 ns
+BM_MelProcessorProcess/1/8       4853 ns
+BM_MelProcessorProcess/5/8       4390 ns
+*/
+static void BM_MelProcessorProcess(benchmark::State& state) {
+    const audio_format_t format = static_cast<audio_format_t>(state.range(0));
+    const uint32_t channelCount = state.range(1);
+    const size_t samples = kBufferFrames * channelCount;
+
+    // below RS1, so that there are no callbacks.
+    std::vector<float> floatBuffer(samples);
+    for (size_t i = 0; i < samples; ++i) {
+        floatBuffer[i] = 0.01f * sinf(2.f * M_PI * 1000.f * (i / channelCount) / kSampleRate);
+    }
+    std::vector<uint8_t> buffer(samples * audio_bytes_per_sample(format));
+    memcpy_by_audio_format(buffer.data(), format, floatBuffer.data(), AUDIO_FORMAT_PCM_FLOAT,
+            samples);
+
+    auto processor = sp<MelProcessor>::make(kSampleRate, channelCount, format,
+            sp<NullMelCallback>::make(), 0, 100.f);
+    for (auto _ : state) {
+        processor->process(buffer.data(), buffer.size());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kBufferFrames);
+}
+
+BENCHMARK(BM_MelProcessorProcess)
+    ->ArgsProduct({{AUDIO_FORMAT_PCM_16_BIT, AUDIO_FORMAT_PCM_FLOAT}, {1, 2, 8}});
+
+BENCHMARK_MAIN();
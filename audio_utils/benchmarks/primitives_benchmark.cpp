@@ -16,10 +16,12 @@
 
 #include <cstddef>
 #include <random>
+#include <type_traits>
 #include <vector>
 
 #include <benchmark/benchmark.h>
 
+#include <audio_utils/format.h>
 #include <audio_utils/primitives.h>
 
 static void BM_MemcpyToFloatFromFloatWithClamping(benchmark::State& state) {
@@ -137,4 +139,124 @@ static void BM_MemcpyToI16FromFloat(benchmark::State& state) {
 
 BENCHMARK(BM_MemcpyToI16FromFloat)->RangeMultiplier(2)->Ranges({{10, 8<<12}});
 
+// Per format throughput of the memcpy_to_*_from_* converters.
+// SRC_SIZE and DST_SIZE are the sample sizes in bytes (3 for packed 24 bit).
+template <typename D, typename S, size_t DST_SIZE, size_t SRC_SIZE,
+        void (*CONVERT)(D *, const S *, size_t)>
+static void BM_MemcpyConvert(benchmark::State& state) {
+    const size_t count = state.range(0);
+
+    std::vector<uint8_t> src(count * SRC_SIZE);
+    std::vector<uint8_t> dst(count * DST_SIZE);
+
+    // Initialize src buffer with deterministic pseudo-random values
+    std::minstd_rand gen(count);
+    if constexpr (std::is_same_v<S, float>) {
+        std::uniform_real_distribution<float> dis(-1.1f, 1.1f);
+        float *fsrc = reinterpret_cast<float *>(src.data());
+        for (size_t i = 0; i < count; i++) {
+            fsrc[i] = dis(gen);
+        }
+    } else {
+        std::uniform_int_distribution<> dis(0, UINT8_MAX);
+        for (auto &byte : src) {
+            byte = dis(gen);
+        }
+    }
+
+    // Run the test
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(src.data());
+        benchmark::DoNotOptimize(dst.data());
+        CONVERT(reinterpret_cast<D *>(dst.data()), reinterpret_cast<const S *>(src.data()),
+                count);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * count * (SRC_SIZE + DST_SIZE));
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetComplexityN(state.range(0));
+}
+
+#define MEMCPY_CONVERT_BENCHMARK(D, S, DST_SIZE, SRC_SIZE, FUNCTION) \
+    BENCHMARK(BM_MemcpyConvert<D, S, DST_SIZE, SRC_SIZE, FUNCTION>) \
+            ->Name("BM_" #FUNCTION)->RangeMultiplier(8)->Ranges({{8, 8<<12}})
+
+MEMCPY_CONVERT_BENCHMARK(int16_t, int32_t, 2, 4, memcpy_to_i16_from_q4_27);
+MEMCPY_CONVERT_BENCHMARK(int16_t, uint8_t, 2, 1, memcpy_to_i16_from_u8);
+MEMCPY_CONVERT_BENCHMARK(uint8_t, int16_t, 1, 2, memcpy_to_u8_from_i16);
+MEMCPY_CONVERT_BENCHMARK(uint8_t, uint8_t, 1, 3, memcpy_to_u8_from_p24);
+MEMCPY_CONVERT_BENCHMARK(uint8_t, int32_t, 1, 4, memcpy_to_u8_from_i32);
+MEMCPY_CONVERT_BENCHMARK(uint8_t, int32_t, 1, 4, memcpy_to_u8_from_q8_23);
+MEMCPY_CONVERT_BENCHMARK(uint8_t, float, 1, 4, memcpy_to_u8_from_float);
+MEMCPY_CONVERT_BENCHMARK(int16_t, int32_t, 2, 4, memcpy_to_i16_from_i32);
+MEMCPY_CONVERT_BENCHMARK(int16_t, float, 2, 4, memcpy_to_i16_from_float);
+MEMCPY_CONVERT_BENCHMARK(float, int32_t, 4, 4, memcpy_to_float_from_q4_27);
+MEMCPY_CONVERT_BENCHMARK(float, int16_t, 4, 2, memcpy_to_float_from_i16);
+MEMCPY_CONVERT_BENCHMARK(float, uint8_t, 4, 1, memcpy_to_float_from_u8);
+MEMCPY_CONVERT_BENCHMARK(float, uint8_t, 4, 3, memcpy_to_float_from_p24);
+MEMCPY_CONVERT_BENCHMARK(int16_t, uint8_t, 2, 3, memcpy_to_i16_from_p24);
+MEMCPY_CONVERT_BENCHMARK(int32_t, uint8_t, 4, 3, memcpy_to_i32_from_p24);
+MEMCPY_CONVERT_BENCHMARK(uint8_t, int16_t, 3, 2, memcpy_to_p24_from_i16);
+MEMCPY_CONVERT_BENCHMARK(uint8_t, float, 3, 4, memcpy_to_p24_from_float);
+MEMCPY_CONVERT_BENCHMARK(uint8_t, int32_t, 3, 4, memcpy_to_p24_from_q8_23);
+MEMCPY_CONVERT_BENCHMARK(uint8_t, int32_t, 3, 4, memcpy_to_p24_from_i32);
+MEMCPY_CONVERT_BENCHMARK(int32_t, int16_t, 4, 2, memcpy_to_q8_23_from_i16);
+MEMCPY_CONVERT_BENCHMARK(int32_t, float, 4, 4, memcpy_to_q8_23_from_float_with_clamp);
+MEMCPY_CONVERT_BENCHMARK(int32_t, uint8_t, 4, 3, memcpy_to_q8_23_from_p24);
+MEMCPY_CONVERT_BENCHMARK(int32_t, float, 4, 4, memcpy_to_q4_27_from_float);
+MEMCPY_CONVERT_BENCHMARK(int16_t, int32_t, 2, 4, memcpy_to_i16_from_q8_23);
+MEMCPY_CONVERT_BENCHMARK(float, int32_t, 4, 4, memcpy_to_float_from_q8_23);
+MEMCPY_CONVERT_BENCHMARK(int32_t, uint8_t, 4, 1, memcpy_to_i32_from_u8);
+MEMCPY_CONVERT_BENCHMARK(int32_t, int16_t, 4, 2, memcpy_to_i32_from_i16);
+MEMCPY_CONVERT_BENCHMARK(int32_t, float, 4, 4, memcpy_to_i32_from_float);
+MEMCPY_CONVERT_BENCHMARK(float, int32_t, 4, 4, memcpy_to_float_from_i32);
+
+// Format and channel conversion as a plan (fused) or as two separate passes.
+template <audio_format_t DST_FORMAT, audio_channel_mask_t DST_MASK,
+        audio_format_t SRC_FORMAT, audio_channel_mask_t SRC_MASK>
+static void BM_MemcpyByAudioFormatRemix(benchmark::State& state) {
+    const size_t frames = state.range(0);
+    const bool fused = state.range(1);
+    const size_t dstChannels = audio_channel_count_from_out_mask(DST_MASK);
+    const size_t srcChannels = audio_channel_count_from_out_mask(SRC_MASK);
+
+    std::vector<uint8_t> src(frames * srcChannels * audio_bytes_per_sample(SRC_FORMAT));
+    std::vector<uint8_t> tmp(frames * srcChannels * audio_bytes_per_sample(DST_FORMAT));
+    std::vector<uint8_t> dst(frames * dstChannels * audio_bytes_per_sample(DST_FORMAT));
+    std::minstd_rand gen(frames);
+    for (auto& b : src) b = gen();
+
+    audio_format_remix_plan_t plan;
+    if (audio_format_remix_plan_init(&plan, DST_FORMAT, DST_MASK, SRC_FORMAT, SRC_MASK) != 0) {
+        state.SkipWithError("unsupported conversion");
+        return;
+    }
+    int8_t idxary[AUDIO_FORMAT_REMIX_MAX_CHANNELS];
+    memcpy_by_index_array_initialization_from_channel_mask(
+            idxary, AUDIO_FORMAT_REMIX_MAX_CHANNELS, DST_MASK, SRC_MASK);
+
+    while (state.KeepRunning()) {
+        if (fused) {
+            memcpy_by_audio_format_remix(dst.data(), src.data(), frames, &plan);
+        } else {
+            memcpy_by_audio_format(tmp.data(), DST_FORMAT, src.data(), SRC_FORMAT,
+                    frames * srcChannels);
+            memcpy_by_index_array(dst.data(), dstChannels, tmp.data(), srcChannels,
+                    idxary, audio_bytes_per_sample(DST_FORMAT), frames);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * frames);
+}
+
+BENCHMARK_TEMPLATE(BM_MemcpyByAudioFormatRemix,
+        AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+        AUDIO_FORMAT_PCM_24_BIT_PACKED, AUDIO_CHANNEL_OUT_5POINT1)
+        ->ArgsProduct({{960, 8192}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_MemcpyByAudioFormatRemix,
+        AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_7POINT1,
+        AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO)
+        ->ArgsProduct({{960, 8192}, {0, 1}});
+
 BENCHMARK_MAIN();
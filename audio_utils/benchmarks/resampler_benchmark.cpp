@@ -0,0 +1,127 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <audio_utils/resampler.h>
+
+#include <random>
+#include <vector>
+
+#include <audio_utils/primitives.h>
+#include <benchmark/benchmark.h>
+#include <system/audio.h>
+
+/*
+Time to resample 1024 stereo frames from 44100 Hz to 48000 Hz.
+The argument is the RESAMPLER_QUALITY_* level.
+
+x86_64 host (SSE), speex is only available on Android:
+
+------------------------------------------------------------------------
+Benchmark                              Time             CPU   Iterations
+------------------------------------------------------------------------
+BM_PolyphaseResampler_Float/1      10374 ns        10341 ns        40074
+BM_PolyphaseResampler_Float/2      13914 ns        13832 ns        30526
+BM_PolyphaseResampler_Float/3      15938 ns        15793 ns        26993
+BM_PolyphaseResampler_Float/4      19201 ns        19163 ns        21462
+BM_PolyphaseResampler_Float/5      22548 ns        22269 ns        18307
+BM_PolyphaseResampler_Float/6      32180 ns        32093 ns        17119
+BM_PolyphaseResampler_Float/7      32583 ns        32294 ns        13030
+BM_PolyphaseResampler_Float/8      41730 ns        41352 ns        10498
+BM_PolyphaseResampler_Float/9      46584 ns        46156 ns         8533
+BM_PolyphaseResampler_Int16/1      10788 ns        10513 ns        41873
+BM_PolyphaseResampler_Int16/2      13846 ns        13723 ns        31232
+BM_PolyphaseResampler_Int16/3      17647 ns        17503 ns        22445
+BM_PolyphaseResampler_Int16/4      21619 ns        21499 ns        18601
+BM_PolyphaseResampler_Int16/5      24162 ns        23861 ns        17135
+BM_PolyphaseResampler_Int16/6      28752 ns        27986 ns        15164
+BM_PolyphaseResampler_Int16/7      34005 ns        33921 ns        12517
+BM_PolyphaseResampler_Int16/8      41768 ns        41424 ns        10135
+BM_PolyphaseResampler_Int16/9      49862 ns        49527 ns         8704
+*/
+
+static constexpr uint32_t kInSampleRate = 44100;
+static constexpr uint32_t kOutSampleRate = 48000;
+static constexpr uint32_t kChannelCount = 2;
+static constexpr size_t kFrameCount = 1024;
+
+template <typename T>
+static void BenchmarkResampler(benchmark::State& state, struct resampler_itfe *resampler) {
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<> dis(-1.0f, 1.0f);
+    std::vector<float> inFloat(kFrameCount * kChannelCount);
+    for (auto& f : inFloat) {
+        f = dis(gen);
+    }
+    std::vector<T> in(inFloat.size());
+    if constexpr (std::is_same_v<T, int16_t>) {
+        memcpy_to_i16_from_float(in.data(), inFloat.data(), in.size());
+    } else {
+        in = inFloat;
+    }
+    std::vector<T> out(2 * kFrameCount * kChannelCount);
+
+    // Run the test
+    for (auto _ : state) {
+        size_t framesRd = 0;
+        while (framesRd < kFrameCount) {
+            size_t inFrameCount = kFrameCount - framesRd;
+            size_t outFrameCount = out.size() / kChannelCount;
+            resampler->resample_from_input_format(resampler,
+                    &in[framesRd * kChannelCount], &inFrameCount, out.data(), &outFrameCount);
+            framesRd += inFrameCount;
+        }
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    release_resampler(resampler);
+}
+
+static void BM_PolyphaseResampler_Float(benchmark::State& state) {
+    struct resampler_itfe *resampler;
+    create_resampler_format(kInSampleRate, kOutSampleRate, kChannelCount,
+            AUDIO_FORMAT_PCM_FLOAT, state.range(0), NULL, &resampler);
+    BenchmarkResampler<float>(state, resampler);
+}
+
+static void BM_PolyphaseResampler_Int16(benchmark::State& state) {
+    struct resampler_itfe *resampler;
+    create_resampler_format(kInSampleRate, kOutSampleRate, kChannelCount,
+            AUDIO_FORMAT_PCM_16_BIT, state.range(0), NULL, &resampler);
+    BenchmarkResampler<int16_t>(state, resampler);
+}
+
+#ifdef __ANDROID__
+static void BM_SpeexResampler_Int16(benchmark::State& state) {
+    struct resampler_itfe *resampler;
+    create_resampler(kInSampleRate, kOutSampleRate, kChannelCount,
+            state.range(0), NULL, &resampler);
+    BenchmarkResampler<int16_t>(state, resampler);
+}
+#endif
+
+static void ResamplerArgs(benchmark::internal::Benchmark* b) {
+    b->DenseRange(RESAMPLER_QUALITY_MIN + 1, RESAMPLER_QUALITY_MAX - 1);
+}
+
+BENCHMARK(BM_PolyphaseResampler_Float)->Apply(ResamplerArgs);
+
+BENCHMARK(BM_PolyphaseResampler_Int16)->Apply(ResamplerArgs);
+
+#ifdef __ANDROID__
+BENCHMARK(BM_SpeexResampler_Int16)->Apply(ResamplerArgs);
+#endif
+
+BENCHMARK_MAIN();
@@ -0,0 +1,576 @@
+/*
+** Copyright 2011, The Android Open-Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "echo_reference"
+
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <inttypes.h>
+#include <linux/futex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include <log/log.h>
+#include <system/audio.h>
+#include <audio_utils/echo_reference.h>
+#include <audio_utils/fifo.h>
+#include <audio_utils/format.h>
+#include <audio_utils/resampler.h>
+#include <audio_utils/roundup.h>
+
+// The reference frames are passed from write() to read() through a single writer, single reader
+// FIFO of float samples, in the read channel count and sampling rate. write() is called by the
+// playback thread and read() by the capture thread: neither blocks the other, and all buffers
+// are allocated by create_echo_reference().
+// The state that is shared is either atomic, or published by write() with a sequence lock.
+// Otherwise the writer side state is only accessed by write() and the reader side state by read().
+
+// echo reference state: bit field indicating if read, write or both are active.
+enum state {
+    ECHOREF_IDLE = 0x00,        // idle
+    ECHOREF_READING = 0x01,     // reading is active
+    ECHOREF_WRITING = 0x02      // writing is active
+};
+
+// number of frames converted at a time by write() and read()
+#define ECHOREF_BLOCK_FRAMES 256
+// minimum duration of reference frames buffered in the FIFO
+#define ECHOREF_BUFFER_MS 500
+
+// Playback timing indicated by the last write(), used by read() to align the reference.
+struct echo_reference_timing {
+    int64_t render_time_ns;     // latest render time indicated by write(), 0 if none
+    int32_t playback_delay;     // playback buffer delay indicated by last write()
+    int32_t resampler_delay;    // delay of the frames buffered by the resampler
+    uint64_t frames_written;    // total frames written to the FIFO by last write()
+};
+
+// Derives from the interface, so that the interface pointer can be converted back by static_cast:
+// with C++ members this is not a standard-layout type, so the interface can't be a first member.
+struct echo_reference : public echo_reference_itfe {
+    echo_reference(audio_format_t rdFormat, uint32_t rdChannelCount, uint32_t rdSamplingRate,
+            audio_format_t wrFormat, uint32_t wrChannelCount, uint32_t wrSamplingRate,
+            uint32_t frameCount)
+        : rd_format(rdFormat)
+        , rd_channel_count(rdChannelCount)
+        , rd_sampling_rate(rdSamplingRate)
+        , rd_frame_size(audio_bytes_per_sample(rdFormat) * rdChannelCount)
+        , wr_format(wrFormat)
+        , wr_channel_count(wrChannelCount)
+        , wr_sampling_rate(wrSamplingRate)
+        , wr_frame_size(audio_bytes_per_sample(wrFormat) * wrChannelCount)
+        , buffer(frameCount * rdChannelCount)
+        , fifo(frameCount, rdChannelCount * sizeof(float), buffer.data(), indices,
+                true /*throttlesWriter*/, AUDIO_UTILS_FIFO_SYNC_PRIVATE)
+        , writer(fifo)
+        , reader(fifo)
+        , wr_conv_buf(ECHOREF_BLOCK_FRAMES * wrChannelCount)
+        , wr_mix_buf(ECHOREF_BLOCK_FRAMES * rdChannelCount)
+        , wr_rsmp_buf(ECHOREF_BLOCK_FRAMES * rdChannelCount)
+        , rd_conv_buf(rdFormat == AUDIO_FORMAT_PCM_FLOAT ? 0 : ECHOREF_BLOCK_FRAMES * rdChannelCount)
+    {
+        // The writer never blocks, so there is no need to wake it up.
+        reader.setHysteresis(frameCount, 0);
+    }
+
+    const audio_format_t rd_format;     // read sample format
+    const uint32_t rd_channel_count;    // read number of channels
+    const uint32_t rd_sampling_rate;    // read sampling rate in Hz
+    const size_t rd_frame_size;         // read frame size (bytes per sample)
+    const audio_format_t wr_format;     // write sample format
+    const uint32_t wr_channel_count;    // write number of channels
+    const uint32_t wr_sampling_rate;    // write sampling rate in Hz
+    const size_t wr_frame_size;         // write frame size (bytes per sample)
+    std::atomic<uint32_t> state{ECHOREF_IDLE};  // active state: reading, writing or both
+
+    // reference FIFO
+    std::vector<float> buffer;          // FIFO buffer, in read channel count and sampling rate
+    audio_utils_fifo_indices indices;   // FIFO indices, read() waits on indices.mRear
+    audio_utils_fifo fifo;
+    audio_utils_fifo_writer writer;
+    audio_utils_fifo_reader reader;
+
+    // published by write() for read(), see echo_reference_publish_timing()
+    std::atomic<uint32_t> timing_seq{0};            // odd while write() is updating the timing
+    std::atomic<int64_t> timing_render_time_ns{0};
+    std::atomic<int32_t> timing_playback_delay{0};
+    std::atomic<int32_t> timing_resampler_delay{0};
+    std::atomic<uint64_t> timing_frames_written{0};
+
+    // writer side
+    int64_t wr_render_time_ns = 0;      // latest render time indicated by write(), 0 if none
+    struct resampler_itfe *resampler = NULL;    // input resampler
+    std::vector<float> wr_conv_buf;     // write frames converted to float
+    std::vector<float> wr_mix_buf;      // write frames converted to the read channel count
+    std::vector<float> wr_rsmp_buf;     // write frames resampled to the read sampling rate
+
+    // reader side
+    size_t rd_pad_frames = 0;           // frames of silence to return before the FIFO frames
+    int16_t prev_delta_sign = 0;        // sign of previous delay difference:
+                                        //  1: positive, -1: negative, 0: unknown
+    uint16_t delta_count = 0;           // number of consecutive delay differences with same sign
+    std::vector<float> rd_conv_buf;     // FIFO frames to convert to the read format
+};
+
+static void echo_reference_publish_timing(struct echo_reference *er,
+                                          const struct echo_reference_timing *timing)
+{
+    const uint32_t seq = er->timing_seq.load(std::memory_order_relaxed) + 1;
+    er->timing_seq.store(seq, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    er->timing_render_time_ns.store(timing->render_time_ns, std::memory_order_relaxed);
+    er->timing_playback_delay.store(timing->playback_delay, std::memory_order_relaxed);
+    er->timing_resampler_delay.store(timing->resampler_delay, std::memory_order_relaxed);
+    er->timing_frames_written.store(timing->frames_written, std::memory_order_relaxed);
+    er->timing_seq.store(seq + 1, std::memory_order_release);
+}
+
+static void echo_reference_load_timing(struct echo_reference *er,
+                                       struct echo_reference_timing *timing)
+{
+    for (;;) {
+        const uint32_t seq = er->timing_seq.load(std::memory_order_acquire);
+        timing->render_time_ns = er->timing_render_time_ns.load(std::memory_order_relaxed);
+        timing->playback_delay = er->timing_playback_delay.load(std::memory_order_relaxed);
+        timing->resampler_delay = er->timing_resampler_delay.load(std::memory_order_relaxed);
+        timing->frames_written = er->timing_frames_written.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((seq & 1) == 0 && er->timing_seq.load(std::memory_order_relaxed) == seq) {
+            return;
+        }
+    }
+}
+
+static int64_t echo_reference_ns(const struct timespec *ts)
+{
+    return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+// Converts frames of the write buffer to float in the read channel count.
+// Returns the converted frames, which may be the write buffer itself.
+static const float *echo_reference_downmix(struct echo_reference *er, const void *src,
+                                           size_t frames)
+{
+    const float *conv = (const float *)src;
+    if (er->wr_format != AUDIO_FORMAT_PCM_FLOAT) {
+        memcpy_by_audio_format(er->wr_conv_buf.data(), AUDIO_FORMAT_PCM_FLOAT,
+                               src, er->wr_format, frames * er->wr_channel_count);
+        conv = er->wr_conv_buf.data();
+    }
+    if (er->rd_channel_count == er->wr_channel_count) {
+        return conv;
+    }
+    float *mix = er->wr_mix_buf.data();
+    if (er->rd_channel_count == 1) {
+        // average all write channels
+        const float scale = 1.f / er->wr_channel_count;
+        for (size_t i = 0; i < frames; i++) {
+            float sum = 0.f;
+            for (uint32_t ch = 0; ch < er->wr_channel_count; ch++) {
+                sum += *conv++;
+            }
+            mix[i] = sum * scale;
+        }
+    } else {
+        // keep the first read channels, e.g. front left and right
+        for (size_t i = 0; i < frames; i++) {
+            memcpy(mix + i * er->rd_channel_count, conv + i * er->wr_channel_count,
+                   er->rd_channel_count * sizeof(float));
+        }
+    }
+    return mix;
+}
+
+static void echo_reference_write_fifo(struct echo_reference *er, const float *src, size_t frames)
+{
+    ssize_t written = er->writer.write(src, frames);
+    ALOGV_IF(written != (ssize_t)frames,
+             "echo_reference_write() reference buffer full, dropped %zd frames",
+             written >= 0 ? (ssize_t)frames - written : (ssize_t)frames);
+    (void)written;
+}
+
+static int echo_reference_write(struct echo_reference_itfe *echo_reference,
+                         struct echo_reference_buffer *buffer)
+{
+    struct echo_reference *er = static_cast<struct echo_reference *>(echo_reference);
+
+    if (er == NULL) {
+        return -EINVAL;
+    }
+
+    if (buffer == NULL) {
+        ALOGV("echo_reference_write() stop write");
+        er->state.fetch_and(~ECHOREF_WRITING);
+        er->wr_render_time_ns = 0;
+        struct echo_reference_timing timing = {};
+        timing.frames_written = er->writer.totalReleased();
+        echo_reference_publish_timing(er, &timing);
+        return 0;
+    }
+
+    ALOGV("echo_reference_write() START trying to write %zu frames", buffer->frame_count);
+    ALOGV("echo_reference_write() playbackTimestamp:[%d].[%d], delay_ns:[%d]",
+            (int)buffer->time_stamp.tv_sec,
+            (int)buffer->time_stamp.tv_nsec, buffer->delay_ns);
+
+    // discard writes until a valid time stamp is provided.
+    const int64_t renderTimeNs = echo_reference_ns(&buffer->time_stamp);
+    if (renderTimeNs == 0 && er->wr_render_time_ns == 0) {
+        return 0;
+    }
+
+    if ((er->state.load() & ECHOREF_WRITING) == 0) {
+        ALOGV("echo_reference_write() start write");
+        if (er->resampler != NULL) {
+            er->resampler->reset(er->resampler);
+        }
+        er->state.fetch_or(ECHOREF_WRITING);
+    }
+
+    if ((er->state.load() & ECHOREF_READING) == 0) {
+        return 0;
+    }
+
+    er->wr_render_time_ns = renderTimeNs;
+
+    // publish all the blocks at once
+    er->writer.beginBatch();
+    for (size_t done = 0; done < buffer->frame_count; ) {
+        size_t frames = std::min(buffer->frame_count - done, (size_t)ECHOREF_BLOCK_FRAMES);
+        const float *src = echo_reference_downmix(er,
+                (const char *)buffer->raw + done * er->wr_frame_size, frames);
+        done += frames;
+        if (er->resampler == NULL) {
+            echo_reference_write_fifo(er, src, frames);
+            continue;
+        }
+        while (frames > 0) {
+            size_t inFrames = frames;
+            size_t outFrames = ECHOREF_BLOCK_FRAMES;
+            er->resampler->resample_from_input_format(er->resampler, src, &inFrames,
+                                                      er->wr_rsmp_buf.data(), &outFrames);
+            echo_reference_write_fifo(er, er->wr_rsmp_buf.data(), outFrames);
+            src += inFrames * er->rd_channel_count;
+            frames -= inFrames;
+        }
+    }
+    er->writer.endBatch();
+
+    struct echo_reference_timing timing;
+    timing.render_time_ns = renderTimeNs;
+    timing.playback_delay = buffer->delay_ns;
+    timing.resampler_delay = er->resampler != NULL ? er->resampler->delay_ns(er->resampler) : 0;
+    timing.frames_written = er->writer.totalReleased();
+    echo_reference_publish_timing(er, &timing);
+
+    ALOGV("echo_reference_write() END frames total:[%" PRIu64 "] render_time_ns:[%" PRId64
+          "], playback_delay:[%d]",
+          timing.frames_written, timing.render_time_ns, timing.playback_delay);
+    return 0;
+}
+
+// delay jump threshold to update ref buffer: 6 samples at 8kHz in nsecs
+#define MIN_DELAY_DELTA_NS (375000*2)
+// number of consecutive delta with same sign between expected and actual delay before adjusting
+// the buffer
+#define MIN_DELTA_NUM 4
+
+// Discards the oldest frames from the reference, first the silence then the FIFO frames.
+static void echo_reference_skip(struct echo_reference *er, size_t frames)
+{
+    const size_t pad = std::min(frames, er->rd_pad_frames);
+    er->rd_pad_frames -= pad;
+    frames -= pad;
+    while (frames > 0) {
+        audio_utils_iovec iovec[2];
+        ssize_t obtained = er->reader.obtain(iovec, frames);
+        if (obtained <= 0) {
+            break;
+        }
+        er->reader.release(obtained);
+        frames -= obtained;
+    }
+}
+
+// Waits at most for half the duration of frames, until frames are available to read.
+static void echo_reference_wait(struct echo_reference *er, size_t frames)
+{
+    const uint32_t timeoutMs = (uint32_t)((1000 * frames) / er->rd_sampling_rate / 2);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    const int64_t deadlineNs = echo_reference_ns(&ts) + (int64_t)timeoutMs * 1000000;
+    for (;;) {
+        // load the rear index before checking the fill level, so no write() can be missed
+        const uint32_t rear = er->indices.mRear.loadAcquire();
+        const ssize_t available = er->reader.available();
+        if (available < 0 || (size_t)available + er->rd_pad_frames >= frames) {
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        const int64_t remainingNs = deadlineNs - echo_reference_ns(&ts);
+        if (remainingNs <= 0) {
+            ALOGV("echo_reference_read() waited %d ms but still not enough frames"
+                  " available: %zd, frame_count = %zu", timeoutMs, available, frames);
+            break;
+        }
+        ts.tv_sec = remainingNs / 1000000000;
+        ts.tv_nsec = remainingNs % 1000000000;
+        er->indices.mRear.wait(FUTEX_WAIT, rear, &ts);
+    }
+}
+
+// Returns frames of the reference in the read format, silence if there are not enough frames.
+static void echo_reference_read_frames(struct echo_reference *er, void *dst, size_t frames)
+{
+    const size_t pad = std::min(frames, er->rd_pad_frames);
+    memset(dst, 0, pad * er->rd_frame_size);
+    er->rd_pad_frames -= pad;
+    size_t done = pad;
+    er->reader.beginBatch();
+    while (done < frames) {
+        void *out = (char *)dst + done * er->rd_frame_size;
+        ssize_t read;
+        if (er->rd_format == AUDIO_FORMAT_PCM_FLOAT) {
+            read = er->reader.read(out, frames - done);
+        } else {
+            read = er->reader.read(er->rd_conv_buf.data(),
+                                   std::min(frames - done, (size_t)ECHOREF_BLOCK_FRAMES));
+            if (read > 0) {
+                memcpy_by_audio_format(out, er->rd_format,
+                        er->rd_conv_buf.data(), AUDIO_FORMAT_PCM_FLOAT,
+                        read * er->rd_channel_count);
+            }
+        }
+        if (read <= 0) {
+            // filling up the reference buffer with 0s to match the expected delay.
+            memset(out, 0, (frames - done) * er->rd_frame_size);
+            break;
+        }
+        done += read;
+    }
+    er->reader.endBatch();
+}
+
+static int echo_reference_read(struct echo_reference_itfe *echo_reference,
+                         struct echo_reference_buffer *buffer)
+{
+    struct echo_reference *er = static_cast<struct echo_reference *>(echo_reference);
+
+    if (er == NULL) {
+        return -EINVAL;
+    }
+
+    if (buffer == NULL) {
+        ALOGV("echo_reference_read() stop read");
+        er->state.fetch_and(~ECHOREF_READING);
+        return 0;
+    }
+
+    ALOGV("echo_reference_read() START, delayCapture:[%d], buffer->frame_count:[%zu]",
+          buffer->delay_ns, buffer->frame_count);
+
+    if ((er->state.load() & ECHOREF_READING) == 0) {
+        ALOGV("echo_reference_read() start read");
+        er->reader.flush();
+        er->rd_pad_frames = 0;
+        er->delta_count = 0;
+        er->prev_delta_sign = 0;
+        er->state.fetch_or(ECHOREF_READING);
+    }
+
+    if ((er->state.load() & ECHOREF_WRITING) == 0) {
+        memset(buffer->raw, 0, er->rd_frame_size * buffer->frame_count);
+        buffer->delay_ns = 0;
+        // discard the frames of a previous playback
+        er->reader.flush();
+        er->rd_pad_frames = 0;
+        return 0;
+    }
+
+    // allow some time for new frames to arrive if not enough frames are ready for read
+    echo_reference_wait(er, buffer->frame_count);
+
+    struct echo_reference_timing timing;
+    echo_reference_load_timing(er, &timing);
+    // frames in the reference that were written by the write() of the timing
+    const int64_t framesIn = std::max((int64_t)0,
+            (int64_t)(timing.frames_written - er->reader.totalReleased())) + er->rd_pad_frames;
+    const int64_t captureTimeNs = echo_reference_ns(&buffer->time_stamp);
+
+    if (timing.render_time_ns == 0 || captureTimeNs == 0) {
+        ALOGV("echo_reference_read(): NEW:timestamp is zero---------setting timeDiff = 0, "
+             "not updating delay this time");
+    } else {
+        const int64_t timeDiff = captureTimeNs - timing.render_time_ns;
+        // Resampler already compensates part of the delay
+        const int64_t expectedDelayNs = (int64_t)timing.playback_delay + buffer->delay_ns
+                - timeDiff - timing.resampler_delay;
+
+        ALOGV("echo_reference_read(): expectedDelayNs[%" PRId64 "] = "
+                "playback_delay[%d] + delayCapture[%d"
+                "] - timeDiff[%" PRId64 "] - resampler_delay[%d]",
+                expectedDelayNs, timing.playback_delay, buffer->delay_ns, timeDiff,
+                timing.resampler_delay);
+
+        if (expectedDelayNs > 0) {
+            int64_t delayNs = (framesIn * 1000000000) / er->rd_sampling_rate;
+
+            int64_t deltaNs = delayNs - expectedDelayNs;
+
+            ALOGV("echo_reference_read(): EchoPathDelayDeviation between reference and DMA [%"
+                    PRId64 "]", deltaNs);
+            if (llabs(deltaNs) >= MIN_DELAY_DELTA_NS) {
+                // smooth the variation and update the reference buffer only
+                // if a deviation in the same direction is observed for more than MIN_DELTA_NUM
+                // consecutive reads.
+                int16_t delay_sign = (deltaNs >= 0) ? 1 : -1;
+                if (delay_sign == er->prev_delta_sign) {
+                    er->delta_count++;
+                } else {
+                    er->delta_count = 1;
+                }
+                er->prev_delta_sign = delay_sign;
+
+                if (er->delta_count > MIN_DELTA_NUM) {
+                    const int64_t expectedFramesIn =
+                            (expectedDelayNs * er->rd_sampling_rate) / 1000000000;
+
+                    ALOGV("echo_reference_read(): deltaNs ENOUGH and %s: "
+                            "framesIn: %" PRId64 ", expected = %" PRId64,
+                         deltaNs < 0 ? "negative" : "positive", framesIn, expectedFramesIn);
+
+                    if (expectedFramesIn > framesIn) {
+                        // Less data available in the reference buffer than expected
+                        er->rd_pad_frames += expectedFramesIn - framesIn;
+                        ALOGV("echo_reference_read(): pushing ref buffer by [%" PRId64 "]",
+                              expectedFramesIn - framesIn);
+                    } else {
+                        // More data available in the reference buffer than expected
+                        echo_reference_skip(er, framesIn - expectedFramesIn);
+                        ALOGV("echo_reference_read(): shifting ref buffer by [%" PRId64 "]",
+                              framesIn - expectedFramesIn);
+                    }
+                }
+            } else {
+                er->delta_count = 0;
+                er->prev_delta_sign = 0;
+                ALOGV("echo_reference_read(): Constant EchoPathDelay - difference "
+                        "between reference and DMA %" PRId64, deltaNs);
+            }
+        } else {
+            ALOGV("echo_reference_read(): NEGATIVE expectedDelayNs[%" PRId64
+                 "] = playback_delay[%d] + delayCapture[%d"
+                 "] - timeDiff[%" PRId64 "]",
+                 expectedDelayNs, timing.playback_delay, buffer->delay_ns, timeDiff);
+        }
+    }
+
+    echo_reference_read_frames(er, buffer->raw, buffer->frame_count);
+
+    // As the reference buffer is now time aligned to the microphone signal there is a zero delay
+    buffer->delay_ns = 0;
+
+    ALOGV("echo_reference_read() END %zu frames", buffer->frame_count);
+    return 0;
+}
+
+static bool echo_reference_format_supported(audio_format_t format)
+{
+    return format == AUDIO_FORMAT_PCM_16_BIT
+            || format == AUDIO_FORMAT_PCM_32_BIT
+            || format == AUDIO_FORMAT_PCM_FLOAT;
+}
+
+int create_echo_reference(audio_format_t rdFormat,
+                            uint32_t rdChannelCount,
+                            uint32_t rdSamplingRate,
+                            audio_format_t wrFormat,
+                            uint32_t wrChannelCount,
+                            uint32_t wrSamplingRate,
+                            struct echo_reference_itfe **echo_reference)
+{
+    struct echo_reference *er;
+
+    ALOGV("create_echo_reference()");
+
+    if (echo_reference == NULL) {
+        return -EINVAL;
+    }
+
+    *echo_reference = NULL;
+
+    if (!echo_reference_format_supported(rdFormat) ||
+            !echo_reference_format_supported(wrFormat)) {
+        ALOGW("create_echo_reference bad format rd %d, wr %d", rdFormat, wrFormat);
+        return -EINVAL;
+    }
+    if (rdChannelCount == 0 || wrChannelCount > FCC_LIMIT ||
+            rdChannelCount > wrChannelCount) {
+        ALOGW("create_echo_reference bad channel count rd %d, wr %d", rdChannelCount,
+                wrChannelCount);
+        return -EINVAL;
+    }
+    if (rdSamplingRate == 0 || wrSamplingRate == 0) {
+        ALOGW("create_echo_reference bad sampling rate rd %d, wr %d", rdSamplingRate,
+                wrSamplingRate);
+        return -EINVAL;
+    }
+
+    struct resampler_itfe *resampler = NULL;
+    if (rdSamplingRate != wrSamplingRate) {
+        ALOGV("create_echo_reference() new ReSampler(%d, %d)", wrSamplingRate, rdSamplingRate);
+        int rc = create_resampler_format(wrSamplingRate,
+                                         rdSamplingRate,
+                                         rdChannelCount,
+                                         AUDIO_FORMAT_PCM_FLOAT,
+                                         RESAMPLER_QUALITY_DEFAULT,
+                                         NULL,
+                                         &resampler);
+        if (rc != 0) {
+            ALOGW("create_echo_reference failure to create resampler %d", rc);
+            return -ENODEV;
+        }
+    }
+
+    const uint32_t frameCount = roundup(rdSamplingRate * ECHOREF_BUFFER_MS / 1000);
+    er = new struct echo_reference(rdFormat, rdChannelCount, rdSamplingRate,
+                            wrFormat, wrChannelCount, wrSamplingRate, frameCount);
+    er->read = echo_reference_read;
+    er->write = echo_reference_write;
+    er->resampler = resampler;
+
+    *echo_reference = er;
+    return 0;
+}
+
+void release_echo_reference(struct echo_reference_itfe *echo_reference) {
+    struct echo_reference *er = static_cast<struct echo_reference *>(echo_reference);
+
+    if (er == NULL) {
+        return;
+    }
+
+    ALOGV("EchoReference dstor");
+    if (er->resampler != NULL) {
+        release_resampler(er->resampler);
+    }
+    delete er;
+}
@@ -17,6 +17,7 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "audio_utils_fifo"
 
+#include <atomic>
 #include <errno.h>
 #include <limits.h>
 #include <stdlib.h>
@@ -148,6 +149,18 @@ audio_utils_fifo::audio_utils_fifo(uint32_t frameCount, uint32_t frameSize, void
     LOG_ALWAYS_FATAL_IF(sync == AUDIO_UTILS_FIFO_SYNC_SHARED);
 }
 
+audio_utils_fifo::audio_utils_fifo(uint32_t frameCount, uint32_t frameSize, void *buffer,
+        audio_utils_fifo_indices& indices, bool throttlesWriter, audio_utils_fifo_sync sync)
+        __attribute__((no_sanitize("integer"))) :
+    audio_utils_fifo_base(frameCount, indices.mRear, throttlesWriter ? &indices.mFront : NULL,
+        sync),
+    mFrameSize(frameSize), mBuffer(buffer)
+{
+    // same as above
+    LOG_ALWAYS_FATAL_IF(frameCount == 0 || frameSize == 0 || buffer == NULL ||
+            frameCount > ((uint32_t) INT32_MAX) / frameSize);
+}
+
 audio_utils_fifo::~audio_utils_fifo()
 {
 }
@@ -166,7 +179,8 @@ audio_utils_fifo_provider::~audio_utils_fifo_provider()
 ////////////////////////////////////////////////////////////////////////////////
 
 audio_utils_fifo_writer::audio_utils_fifo_writer(audio_utils_fifo& fifo) :
-    audio_utils_fifo_provider(fifo), mLocalRear(0),
+    audio_utils_fifo_provider(fifo), mLocalRear(0), mPublishedRear(0), mCachedFront(0),
+    mBatch(false),
     mArmLevel(fifo.mFrameCount), mTriggerLevel(0),
     mIsArmed(true), // because initial fill level of zero is < mArmLevel
     mEffectiveFrames(fifo.mFrameCount)
@@ -175,6 +189,7 @@ audio_utils_fifo_writer::audio_utils_fifo_writer(audio_utils_fifo& fifo) :
 
 audio_utils_fifo_writer::~audio_utils_fifo_writer()
 {
+    endBatch();
 }
 
 ssize_t audio_utils_fifo_writer::write(const void *buffer, size_t count,
@@ -205,10 +220,16 @@ ssize_t audio_utils_fifo_writer::obtain(audio_utils_iovec iovec[2], size_t count
     size_t availToWrite;
     if (mFifo.mThrottleFront != NULL) {
         int retries = kRetries;
+        // In a batch, first try the front index as most recently loaded.
+        bool useCachedFront = mBatch;
         for (;;) {
-            uint32_t front = mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
-                    mFifo.mThrottleFront->loadSingleThreaded() :
-                    mFifo.mThrottleFront->loadAcquire();
+            uint32_t front = mCachedFront;
+            if (!useCachedFront) {
+                front = mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
+                        mFifo.mThrottleFront->loadSingleThreaded() :
+                        mFifo.mThrottleFront->loadAcquire();
+                mCachedFront = front;
+            }
             // returns -EIO if mIsShutdown
             int32_t filled = mFifo.diff(mLocalRear, front);
             if (filled < 0) {
@@ -219,11 +240,23 @@ ssize_t audio_utils_fifo_writer::obtain(audio_utils_iovec iovec[2], size_t count
             }
             availToWrite = mEffectiveFrames > (uint32_t) filled ?
                     mEffectiveFrames - (uint32_t) filled : 0;
+            if (useCachedFront) {
+                // The cached front index is stale, so it can only underestimate availToWrite.
+                useCachedFront = false;
+                if (availToWrite < count && availToWrite < mEffectiveFrames) {
+                    continue;
+                }
+                break;
+            }
             // TODO pull out "count == 0"
             if (count == 0 || availToWrite > 0 || timeout == NULL ||
                     (timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
                 break;
             }
+            // The reader may be waiting for the frames released so far in a batch.
+            if (mPublishedRear != mLocalRear) {
+                publish();
+            }
             // TODO add comments
             // TODO abstract out switch and replace by general sync object
             //      the high level code (synchronization, sleep, futex, iovec) should be completely
@@ -316,57 +349,82 @@ void audio_utils_fifo_writer::release(size_t count)
             mFifo.shutdown();
             return;
         }
-        if (mFifo.mThrottleFront != NULL) {
-            uint32_t front = mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
-                    mFifo.mThrottleFront->loadSingleThreaded() :
-                    mFifo.mThrottleFront->loadAcquire();
-            // returns -EIO if mIsShutdown
-            int32_t filled = mFifo.diff(mLocalRear, front);
-            mLocalRear = mFifo.sum(mLocalRear, count);
-            if (mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
-                mFifo.mWriterRear.storeSingleThreaded(mLocalRear);
-            } else {
-                mFifo.mWriterRear.storeRelease(mLocalRear);
-            }
-            // TODO add comments
-            int op = FUTEX_WAKE;
-            switch (mFifo.mWriterRearSync) {
-            case AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED:
-            case AUDIO_UTILS_FIFO_SYNC_SLEEP:
-                break;
-            case AUDIO_UTILS_FIFO_SYNC_PRIVATE:
-                op = FUTEX_WAKE_PRIVATE;
-                FALLTHROUGH_INTENDED;
-            case AUDIO_UTILS_FIFO_SYNC_SHARED:
-                if (filled >= 0) {
-                    if ((uint32_t) filled < mArmLevel) {
-                        mIsArmed = true;
-                    }
-                    if (mIsArmed && filled + count > mTriggerLevel) {
-                        int err = mFifo.mWriterRear.wake(op, INT32_MAX /*waiters*/);
-                        // err is number of processes woken up
-                        if (err < 0) {
-                            LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d",
-                                    __func__, err, errno);
-                        }
-                        mIsArmed = false;
+        mLocalRear = mFifo.sum(mLocalRear, count);
+        if (!mBatch) {
+            publish();
+        }
+        mObtained -= count;
+        mTotalReleased += count;
+    }
+}
+
+void audio_utils_fifo_writer::publish()
+        __attribute__((no_sanitize("integer")))
+{
+    if (mFifo.mThrottleFront != NULL) {
+        uint32_t front = mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
+                mFifo.mThrottleFront->loadSingleThreaded() :
+                mFifo.mThrottleFront->loadAcquire();
+        mCachedFront = front;
+        // returns -EIO if mIsShutdown
+        int32_t filled = mFifo.diff(mPublishedRear, front);
+        // number of frames released since the previous publish()
+        size_t count = mLocalRear == mPublishedRear ? 0 :
+                (size_t) mFifo.diff(mLocalRear, mPublishedRear);
+        if (mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
+            mFifo.mWriterRear.storeSingleThreaded(mLocalRear);
+        } else {
+            mFifo.mWriterRear.storeRelease(mLocalRear);
+        }
+        // TODO add comments
+        int op = FUTEX_WAKE;
+        switch (mFifo.mWriterRearSync) {
+        case AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED:
+        case AUDIO_UTILS_FIFO_SYNC_SLEEP:
+            break;
+        case AUDIO_UTILS_FIFO_SYNC_PRIVATE:
+            op = FUTEX_WAKE_PRIVATE;
+            FALLTHROUGH_INTENDED;
+        case AUDIO_UTILS_FIFO_SYNC_SHARED:
+            if (filled >= 0) {
+                if ((uint32_t) filled < mArmLevel) {
+                    mIsArmed = true;
+                }
+                if (mIsArmed && filled + count > mTriggerLevel) {
+                    int err = mFifo.mWriterRear.wake(op, INT32_MAX /*waiters*/);
+                    // err is number of processes woken up
+                    if (err < 0) {
+                        LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d",
+                                __func__, err, errno);
                     }
+                    mIsArmed = false;
                 }
-                break;
-            default:
-                LOG_ALWAYS_FATAL("mFifo.mWriterRearSync=%d", mFifo.mWriterRearSync);
-                break;
             }
+            break;
+        default:
+            LOG_ALWAYS_FATAL("mFifo.mWriterRearSync=%d", mFifo.mWriterRearSync);
+            break;
+        }
+    } else {
+        if (mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
+            mFifo.mWriterRear.storeSingleThreaded(mLocalRear);
         } else {
-            mLocalRear = mFifo.sum(mLocalRear, count);
-            if (mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
-                mFifo.mWriterRear.storeSingleThreaded(mLocalRear);
-            } else {
-                mFifo.mWriterRear.storeRelease(mLocalRear);
-            }
+            mFifo.mWriterRear.storeRelease(mLocalRear);
         }
-        mObtained -= count;
-        mTotalReleased += count;
+    }
+    mPublishedRear = mLocalRear;
+}
+
+void audio_utils_fifo_writer::beginBatch()
+{
+    mBatch = true;
+}
+
+void audio_utils_fifo_writer::endBatch()
+{
+    mBatch = false;
+    if (mPublishedRear != mLocalRear) {
+        publish();
     }
 }
 
@@ -435,6 +493,7 @@ audio_utils_fifo_reader::audio_utils_fifo_reader(audio_utils_fifo& fifo, bool th
     // where reader starts out more than one buffer behind writer.  The initial catch-up does not
     // contribute towards the totalLost, totalFlushed, or totalReleased counters.
     mLocalFront(throttlesWriter ? 0 : mFifo.mWriterRear.loadAcquire()),
+    mPublishedFront(mLocalFront), mCachedRear(mLocalFront), mBatch(false),
 
     mThrottleFront(throttlesWriter ? mFifo.mThrottleFront : NULL),
     mFlush(flush),
@@ -446,6 +505,7 @@ audio_utils_fifo_reader::audio_utils_fifo_reader(audio_utils_fifo& fifo, bool th
 
 audio_utils_fifo_reader::~audio_utils_fifo_reader()
 {
+    endBatch();
     // TODO Need a way to pass throttle capability to the another reader, should one reader exit.
 }
 
@@ -485,51 +545,76 @@ void audio_utils_fifo_reader::release(size_t count)
             mFifo.shutdown();
             return;
         }
-        if (mThrottleFront != NULL) {
-            uint32_t rear = mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
-                    mFifo.mWriterRear.loadSingleThreaded() : mFifo.mWriterRear.loadAcquire();
-            // returns -EIO if mIsShutdown
-            int32_t filled = mFifo.diff(rear, mLocalFront);
-            mLocalFront = mFifo.sum(mLocalFront, count);
-            if (mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
-                mThrottleFront->storeSingleThreaded(mLocalFront);
-            } else {
-                mThrottleFront->storeRelease(mLocalFront);
-            }
-            // TODO add comments
-            int op = FUTEX_WAKE;
-            switch (mFifo.mThrottleFrontSync) {
-            case AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED:
-            case AUDIO_UTILS_FIFO_SYNC_SLEEP:
-                break;
-            case AUDIO_UTILS_FIFO_SYNC_PRIVATE:
-                op = FUTEX_WAKE_PRIVATE;
-                FALLTHROUGH_INTENDED;
-            case AUDIO_UTILS_FIFO_SYNC_SHARED:
-                if (filled >= 0) {
-                    if (filled > mArmLevel) {
-                        mIsArmed = true;
-                    }
-                    if (mIsArmed && filled - count < mTriggerLevel) {
-                        int err = mThrottleFront->wake(op, 1 /*waiters*/);
-                        // err is number of processes woken up
-                        if (err < 0 || err > 1) {
-                            LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d",
-                                    __func__, err, errno);
-                        }
-                        mIsArmed = false;
+        mLocalFront = mFifo.sum(mLocalFront, count);
+        if (!mBatch) {
+            publish();
+        }
+        mObtained -= count;
+        mTotalReleased += count;
+    }
+}
+
+void audio_utils_fifo_reader::publish()
+        __attribute__((no_sanitize("integer")))
+{
+    if (mThrottleFront != NULL) {
+        uint32_t rear = mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
+                mFifo.mWriterRear.loadSingleThreaded() : mFifo.mWriterRear.loadAcquire();
+        mCachedRear = rear;
+        // returns -EIO if mIsShutdown
+        int32_t filled = mFifo.diff(rear, mPublishedFront);
+        // number of frames released since the previous publish()
+        size_t count = mLocalFront == mPublishedFront ? 0 :
+                (size_t) mFifo.diff(mLocalFront, mPublishedFront);
+        if (mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
+            mThrottleFront->storeSingleThreaded(mLocalFront);
+        } else {
+            mThrottleFront->storeRelease(mLocalFront);
+        }
+        // TODO add comments
+        int op = FUTEX_WAKE;
+        switch (mFifo.mThrottleFrontSync) {
+        case AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED:
+        case AUDIO_UTILS_FIFO_SYNC_SLEEP:
+            break;
+        case AUDIO_UTILS_FIFO_SYNC_PRIVATE:
+            op = FUTEX_WAKE_PRIVATE;
+            FALLTHROUGH_INTENDED;
+        case AUDIO_UTILS_FIFO_SYNC_SHARED:
+            if (filled >= 0) {
+                if (filled > mArmLevel) {
+                    mIsArmed = true;
+                }
+                if (mIsArmed && filled - count < mTriggerLevel) {
+                    // There can be more than one waiting audio_utils_fifo_multi_writer.
+                    int err = mThrottleFront->wake(op, INT32_MAX /*waiters*/);
+                    // err is number of processes woken up
+                    if (err < 0) {
+                        LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d",
+                                __func__, err, errno);
                     }
+                    mIsArmed = false;
                 }
-                break;
-            default:
-                LOG_ALWAYS_FATAL("mFifo.mThrottleFrontSync=%d", mFifo.mThrottleFrontSync);
-                break;
             }
-        } else {
-            mLocalFront = mFifo.sum(mLocalFront, count);
+            break;
+        default:
+            LOG_ALWAYS_FATAL("mFifo.mThrottleFrontSync=%d", mFifo.mThrottleFrontSync);
+            break;
         }
-        mObtained -= count;
-        mTotalReleased += count;
+    }
+    mPublishedFront = mLocalFront;
+}
+
+void audio_utils_fifo_reader::beginBatch()
+{
+    mBatch = true;
+}
+
+void audio_utils_fifo_reader::endBatch()
+{
+    mBatch = false;
+    if (mPublishedFront != mLocalFront) {
+        publish();
     }
 }
 
@@ -540,15 +625,27 @@ ssize_t audio_utils_fifo_reader::obtain(audio_utils_iovec iovec[2], size_t count
 {
     int err = 0;
     int retries = kRetries;
-    uint32_t rear;
-    for (;;) {
+    uint32_t rear = mCachedRear;
+    // In a batch, a reader that throttles the writer first tries the rear index as most recently
+    // loaded. It can only underestimate the frames available, and there can be no overrun.
+    bool useCachedRear = false;
+    if (mBatch && mThrottleFront != NULL) {
+        int32_t filled = mFifo.diff(rear, mLocalFront);
+        useCachedRear = filled >= 0 && (size_t) filled >= count;
+    }
+    while (!useCachedRear) {
         rear = mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
                 mFifo.mWriterRear.loadSingleThreaded() : mFifo.mWriterRear.loadAcquire();
+        mCachedRear = rear;
         // TODO pull out "count == 0"
         if (count == 0 || rear != mLocalFront || timeout == NULL ||
                 (timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
             break;
         }
+        // The writer may be waiting for the frames released so far in a batch.
+        if (mPublishedFront != mLocalFront) {
+            publish();
+        }
         // TODO add comments
         int op = FUTEX_WAIT;
         switch (mFifo.mWriterRearSync) {
@@ -686,3 +783,452 @@ void audio_utils_fifo_reader::getHysteresis(int32_t *armLevel, uint32_t *trigger
     *armLevel = mArmLevel;
     *triggerLevel = mTriggerLevel;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Helpers for the multi-producer and multi-consumer providers.
+
+// Number of times to retry a reservation that loses the race to another provider.
+static const int kReserveRetries = 16;
+
+// Wait for the value of index to change from expected, as in the obtain() loops above.
+// On return *timeout is NULL, unless the wait should be retried after a benign race.
+// Returns zero or a negative error code as for obtain().
+static int fifo_wait(audio_utils_fifo_index& index, audio_utils_fifo_sync sync, uint32_t expected,
+        const struct timespec **timeout, int *retries)
+{
+    int err = 0;
+    int op = FUTEX_WAIT;
+    switch (sync) {
+    case AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED:
+        err = -ENOTSUP;
+        break;
+    case AUDIO_UTILS_FIFO_SYNC_SLEEP:
+        err = audio_utils_clock_nanosleep(CLOCK_MONOTONIC, 0 /*flags*/, *timeout, NULL /*remain*/);
+        if (err < 0) {
+            LOG_ALWAYS_FATAL_IF(errno != EINTR, "unexpected err=%d errno=%d", err, errno);
+            err = -errno;
+        } else {
+            err = -ETIMEDOUT;
+        }
+        break;
+    case AUDIO_UTILS_FIFO_SYNC_PRIVATE:
+        op = FUTEX_WAIT_PRIVATE;
+        FALLTHROUGH_INTENDED;
+    case AUDIO_UTILS_FIFO_SYNC_SHARED:
+        err = index.wait(op, expected, (*timeout)->tv_sec == LONG_MAX ? NULL : *timeout);
+        if (err < 0) {
+            switch (errno) {
+            case EWOULDBLOCK:
+                // Benign race condition with partner: index changed value between the earlier
+                // load and sys_futex().  Try to load index again, but give up if we are unable
+                // to converge.
+                if ((*retries)-- > 0) {
+                    return 0;
+                }
+                FALLTHROUGH_INTENDED;
+            case EINTR:
+            case ETIMEDOUT:
+                err = -errno;
+                break;
+            default:
+                LOG_ALWAYS_FATAL("unexpected err=%d errno=%d", err, errno);
+                break;
+            }
+        }
+        break;
+    default:
+        LOG_ALWAYS_FATAL("sync=%d", sync);
+        break;
+    }
+    *timeout = NULL;
+    return err;
+}
+
+// Wake all providers waiting for the value of index to change.
+static void fifo_wake(audio_utils_fifo_index& index, audio_utils_fifo_sync sync)
+{
+    int op = FUTEX_WAKE;
+    switch (sync) {
+    case AUDIO_UTILS_FIFO_SYNC_SLEEP:
+        break;
+    case AUDIO_UTILS_FIFO_SYNC_PRIVATE:
+        op = FUTEX_WAKE_PRIVATE;
+        FALLTHROUGH_INTENDED;
+    case AUDIO_UTILS_FIFO_SYNC_SHARED:
+        // the return value is the number of processes woken up
+        if (index.wake(op, INT32_MAX /*waiters*/) < 0) {
+            LOG_ALWAYS_FATAL("%s: unexpected errno=%d", __func__, errno);
+        }
+        break;
+    default:
+        LOG_ALWAYS_FATAL("sync=%d", sync);
+        break;
+    }
+}
+
+// Record the release of the slice [start, end), then advance index over the contiguous run of
+// committed slices which starts at it, and wake the providers waiting for it to change.
+// Never waits for the providers which reserved the preceding slices: whichever provider commits
+// the slice at index advances it, and each step is a single compare-and-exchange.
+// The commits are indexed by frame index modulo frameCountP2, as the buffer.
+static void fifo_commit(audio_utils_fifo_index& index, audio_utils_fifo_sync sync,
+        audio_utils_fifo_commit *commits, uint32_t frameCountP2, uint32_t start, uint32_t end)
+{
+    audio_utils_fifo_commit& commit = commits[start & (frameCountP2 - 1)];
+    commit.mEnd.storeRelease(end);
+    commit.mStart.storeRelease(start);
+    bool advanced = false;
+    // Either we see the index stored by the provider which advances it to our slice,
+    // or that provider sees our commit.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t value = index.loadAcquire();
+    for (;;) {
+        // A slot which was not yet committed in this lap has the commit of an earlier lap,
+        // or the initial commit with no frames.
+        audio_utils_fifo_commit& next = commits[value & (frameCountP2 - 1)];
+        if (next.mStart.loadAcquire() != value) {
+            break;
+        }
+        const uint32_t nextEnd = next.mEnd.loadAcquire();
+        if (nextEnd == value) {
+            break;
+        }
+        // The slot is committed again in a later lap only after index has advanced past value,
+        // in which case the compare-and-exchange fails and updates value to the current index.
+        if (index.compareExchange(value, nextEnd)) {
+            value = nextEnd;
+            advanced = true;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    if (advanced) {
+        fifo_wake(index, sync);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+audio_utils_fifo_multi_writer::audio_utils_fifo_multi_writer(audio_utils_fifo& fifo,
+        audio_utils_fifo_index& reservedRear, audio_utils_fifo_commit *commits) :
+    audio_utils_fifo_provider(fifo), mReservedRear(reservedRear), mCommits(commits),
+    mLocalRear(0), mReservedEnd(0)
+{
+    LOG_ALWAYS_FATAL_IF(commits == NULL ||
+            fifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED);
+}
+
+audio_utils_fifo_multi_writer::~audio_utils_fifo_multi_writer()
+{
+    // The readers can't see the frames reserved after ours until ours are released.
+    if (mObtained > 0 && !cancel()) {
+        ALOGW("%s releasing %u unreleased frames", __func__, mObtained);
+        release(mObtained);
+    }
+}
+
+ssize_t audio_utils_fifo_multi_writer::write(const void *buffer, size_t count,
+        const struct timespec *timeout)
+        __attribute__((no_sanitize("integer")))
+{
+    audio_utils_iovec iovec[2];
+    ssize_t availToWrite = obtain(iovec, count, timeout);
+    if (availToWrite > 0) {
+        memcpy((char *) mFifo.mBuffer + iovec[0].mOffset * mFifo.mFrameSize, buffer,
+                iovec[0].mLength * mFifo.mFrameSize);
+        if (iovec[1].mLength > 0) {
+            memcpy((char *) mFifo.mBuffer + iovec[1].mOffset * mFifo.mFrameSize,
+                    (char *) buffer + (iovec[0].mLength * mFifo.mFrameSize),
+                    iovec[1].mLength * mFifo.mFrameSize);
+        }
+        release(availToWrite);
+    }
+    return availToWrite;
+}
+
+bool audio_utils_fifo_multi_writer::cancel()
+{
+    // Only possible if no other writer has reserved the frames following ours.
+    uint32_t expected = mReservedEnd;
+    if (!mReservedRear.compareExchange(expected, mLocalRear)) {
+        return false;
+    }
+    mReservedEnd = mLocalRear;
+    mObtained = 0;
+    return true;
+}
+
+// iovec == NULL is not part of the public API, but internally it means don't reserve
+ssize_t audio_utils_fifo_multi_writer::obtain(audio_utils_iovec iovec[2], size_t count,
+        const struct timespec *timeout)
+        __attribute__((no_sanitize("integer")))
+{
+    if (iovec != NULL && mObtained > 0 && !cancel()) {
+        iovec[0].mLength = 0;
+        iovec[1].mLength = 0;
+        return -EBUSY;
+    }
+    int err = 0;
+    int retries = kRetries;
+    int reserveRetries = kReserveRetries;
+    uint32_t rear;
+    size_t availToWrite;
+    for (;;) {
+        // Load the front before the reserved rear, so that front <= rear: the reader can't go
+        // past the writer's rear, which is at most the reserved rear.
+        uint32_t front = 0;
+        if (mFifo.mThrottleFront != NULL) {
+            front = mFifo.mThrottleFront->loadAcquire();
+        }
+        rear = mReservedRear.loadAcquire();
+        if (mFifo.mThrottleFront != NULL) {
+            // returns -EIO if mIsShutdown
+            int32_t filled = mFifo.diff(rear, front);
+            // The other writers can have reserved more than mFrameCount frames past our front,
+            // if the reader has consumed frames since we loaded it.
+            if (filled == -EOVERFLOW && mFifo.mThrottleFront->loadAcquire() != front) {
+                if (reserveRetries-- > 0) {
+                    continue;
+                }
+                filled = -EWOULDBLOCK;
+            }
+            if (filled < 0) {
+                // on error, return an empty slice
+                err = filled;
+                availToWrite = 0;
+                break;
+            }
+            availToWrite = mFifo.mFrameCount - (uint32_t) filled;
+        } else if (mFifo.mIsShutdown) {
+            err = -EIO;
+            availToWrite = 0;
+            break;
+        } else {
+            availToWrite = mFifo.mFrameCount;
+        }
+        if (availToWrite > count) {
+            availToWrite = count;
+        }
+        if (availToWrite > 0) {
+            if (iovec == NULL) {
+                break;
+            }
+            // Reserve the slice, unless another writer has reserved frames since we loaded rear.
+            uint32_t expected = rear;
+            if (mReservedRear.compareExchange(expected, mFifo.sum(rear, availToWrite))) {
+                break;
+            }
+            if (reserveRetries-- > 0) {
+                continue;
+            }
+            err = -EWOULDBLOCK;
+            availToWrite = 0;
+            break;
+        }
+        if (count == 0 || timeout == NULL || mFifo.mThrottleFront == NULL ||
+                (timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
+            break;
+        }
+        err = fifo_wait(*mFifo.mThrottleFront, mFifo.mThrottleFrontSync, front, &timeout,
+                &retries);
+    }
+    uint32_t rearOffset = rear & (mFifo.mFrameCountP2 - 1);
+    size_t part1 = mFifo.mFrameCount - rearOffset;
+    if (part1 > availToWrite) {
+        part1 = availToWrite;
+    }
+    size_t part2 = part1 > 0 ? availToWrite - part1 : 0;
+    // return slice
+    if (iovec != NULL) {
+        iovec[0].mOffset = rearOffset;
+        iovec[0].mLength = part1;
+        iovec[1].mOffset = 0;
+        iovec[1].mLength = part2;
+        if (availToWrite > 0) {
+            mLocalRear = rear;
+            mReservedEnd = mFifo.sum(rear, availToWrite);
+        }
+        mObtained = availToWrite;
+    }
+    return availToWrite > 0 ? availToWrite : err;
+}
+
+void audio_utils_fifo_multi_writer::release(size_t count)
+        __attribute__((no_sanitize("integer")))
+{
+    if (count > 0) {
+        if (count > mObtained) {
+            ALOGE("%s(count=%zu) > mObtained=%u", __func__, count, mObtained);
+            mFifo.shutdown();
+            return;
+        }
+        const uint32_t end = mFifo.sum(mLocalRear, count);
+        fifo_commit(mFifo.mWriterRear, mFifo.mWriterRearSync, mCommits, mFifo.mFrameCountP2,
+                mLocalRear, end);
+        mLocalRear = end;
+        mObtained -= count;
+        mTotalReleased += count;
+    }
+}
+
+ssize_t audio_utils_fifo_multi_writer::available()
+{
+    // iovec == NULL is not part of the public API, but internally it means don't reserve
+    return obtain(NULL /*iovec*/, SIZE_MAX /*count*/, NULL /*timeout*/);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+audio_utils_fifo_multi_reader::audio_utils_fifo_multi_reader(audio_utils_fifo& fifo,
+        audio_utils_fifo_index& reservedFront, audio_utils_fifo_commit *commits) :
+    audio_utils_fifo_provider(fifo), mReservedFront(reservedFront), mCommits(commits),
+    mLocalFront(0), mReservedEnd(0)
+{
+    LOG_ALWAYS_FATAL_IF(commits == NULL || fifo.mThrottleFront == NULL ||
+            fifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED);
+}
+
+audio_utils_fifo_multi_reader::~audio_utils_fifo_multi_reader()
+{
+    // The writers can't reuse the slots reserved after ours until ours are released.
+    if (mObtained > 0 && !cancel()) {
+        ALOGW("%s releasing %u unreleased frames", __func__, mObtained);
+        release(mObtained);
+    }
+}
+
+ssize_t audio_utils_fifo_multi_reader::read(void *buffer, size_t count,
+        const struct timespec *timeout)
+        __attribute__((no_sanitize("integer")))
+{
+    audio_utils_iovec iovec[2];
+    ssize_t availToRead = obtain(iovec, count, timeout);
+    if (availToRead > 0) {
+        memcpy(buffer, (char *) mFifo.mBuffer + iovec[0].mOffset * mFifo.mFrameSize,
+                iovec[0].mLength * mFifo.mFrameSize);
+        if (iovec[1].mLength > 0) {
+            memcpy((char *) buffer + (iovec[0].mLength * mFifo.mFrameSize),
+                    (char *) mFifo.mBuffer + iovec[1].mOffset * mFifo.mFrameSize,
+                    iovec[1].mLength * mFifo.mFrameSize);
+        }
+        release(availToRead);
+    }
+    return availToRead;
+}
+
+bool audio_utils_fifo_multi_reader::cancel()
+{
+    // Only possible if no other reader has reserved the frames following ours.
+    uint32_t expected = mReservedEnd;
+    if (!mReservedFront.compareExchange(expected, mLocalFront)) {
+        return false;
+    }
+    mReservedEnd = mLocalFront;
+    mObtained = 0;
+    return true;
+}
+
+// iovec == NULL is not part of the public API, but internally it means don't reserve
+ssize_t audio_utils_fifo_multi_reader::obtain(audio_utils_iovec iovec[2], size_t count,
+        const struct timespec *timeout)
+        __attribute__((no_sanitize("integer")))
+{
+    if (iovec != NULL && mObtained > 0 && !cancel()) {
+        iovec[0].mLength = 0;
+        iovec[1].mLength = 0;
+        return -EBUSY;
+    }
+    int err = 0;
+    int retries = kRetries;
+    int reserveRetries = kReserveRetries;
+    uint32_t front;
+    size_t availToRead;
+    for (;;) {
+        front = mReservedFront.loadAcquire();
+        const uint32_t rear = mFifo.mWriterRear.loadAcquire();
+        // returns -EIO if mIsShutdown
+        int32_t filled = mFifo.diff(rear, front);
+        // The writers can have written more than mFrameCount frames past our front,
+        // if the other readers have reserved and released frames since we loaded it.
+        if (filled == -EOVERFLOW && mReservedFront.loadAcquire() != front) {
+            if (reserveRetries-- > 0) {
+                continue;
+            }
+            filled = -EWOULDBLOCK;
+        }
+        if (filled < 0) {
+            // on error, return an empty slice
+            err = filled;
+            availToRead = 0;
+            break;
+        }
+        availToRead = (size_t) filled;
+        if (availToRead > count) {
+            availToRead = count;
+        }
+        if (availToRead > 0) {
+            if (iovec == NULL) {
+                break;
+            }
+            // Reserve the slice, unless another reader has reserved frames since we loaded front.
+            uint32_t expected = front;
+            if (mReservedFront.compareExchange(expected, mFifo.sum(front, availToRead))) {
+                break;
+            }
+            if (reserveRetries-- > 0) {
+                continue;
+            }
+            err = -EWOULDBLOCK;
+            availToRead = 0;
+            break;
+        }
+        if (count == 0 || timeout == NULL ||
+                (timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
+            break;
+        }
+        err = fifo_wait(mFifo.mWriterRear, mFifo.mWriterRearSync, rear, &timeout, &retries);
+    }
+    uint32_t frontOffset = front & (mFifo.mFrameCountP2 - 1);
+    size_t part1 = mFifo.mFrameCount - frontOffset;
+    if (part1 > availToRead) {
+        part1 = availToRead;
+    }
+    size_t part2 = part1 > 0 ? availToRead - part1 : 0;
+    // return slice
+    if (iovec != NULL) {
+        iovec[0].mOffset = frontOffset;
+        iovec[0].mLength = part1;
+        iovec[1].mOffset = 0;
+        iovec[1].mLength = part2;
+        if (availToRead > 0) {
+            mLocalFront = front;
+            mReservedEnd = mFifo.sum(front, availToRead);
+        }
+        mObtained = availToRead;
+    }
+    return availToRead > 0 ? availToRead : err;
+}
+
+void audio_utils_fifo_multi_reader::release(size_t count)
+        __attribute__((no_sanitize("integer")))
+{
+    if (count > 0) {
+        if (count > mObtained) {
+            ALOGE("%s(count=%zu) > mObtained=%u", __func__, count, mObtained);
+            mFifo.shutdown();
+            return;
+        }
+        const uint32_t end = mFifo.sum(mLocalFront, count);
+        fifo_commit(*mFifo.mThrottleFront, mFifo.mThrottleFrontSync, mCommits,
+                mFifo.mFrameCountP2, mLocalFront, end);
+        mLocalFront = end;
+        mObtained -= count;
+        mTotalReleased += count;
+    }
+}
+
+ssize_t audio_utils_fifo_multi_reader::available()
+{
+    // iovec == NULL is not part of the public API, but internally it means don't reserve
+    return obtain(NULL /*iovec*/, SIZE_MAX /*count*/, NULL /*timeout*/);
+}
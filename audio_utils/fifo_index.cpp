@@ -46,6 +46,15 @@ void audio_utils_fifo_index::storeRelease(uint32_t value)
     atomic_store_explicit(&mIndex, value, std::memory_order_release);
 }
 
+bool audio_utils_fifo_index::compareExchange(uint32_t& expected, uint32_t value)
+{
+    uint_least32_t actual = expected;
+    const bool exchanged = atomic_compare_exchange_strong_explicit(&mIndex, &actual, value,
+            std::memory_order_acq_rel, std::memory_order_acquire);
+    expected = actual;
+    return exchanged;
+}
+
 int audio_utils_fifo_index::wait(int op, uint32_t expected, const struct timespec *timeout)
 {
     return sys_futex(&mIndex, op, expected, timeout, NULL, 0);
@@ -15,6 +15,9 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <string.h>
+
 #include <audio_utils/format.h>
 #include <audio_utils/primitives.h>
 
@@ -227,3 +230,251 @@ void accumulate_by_audio_format(void *dst, const void *src,
     // invalid format
     assert(false);
 }
+
+/* Adapts the typed memcpy_to_*_from_* converters to audio_format_convert_t. */
+#define DEFINE_CONVERT(dst_name, dst_type, src_name, src_type, function) \
+    static void convert_##dst_name##_from_##src_name(void *dst, const void *src, size_t count) \
+    { \
+        function((dst_type *)dst, (const src_type *)src, count); \
+    }
+
+DEFINE_CONVERT(i16, int16_t, float, float, memcpy_to_i16_from_float)
+DEFINE_CONVERT(i16, int16_t, u8, uint8_t, memcpy_to_i16_from_u8)
+DEFINE_CONVERT(i16, int16_t, p24, uint8_t, memcpy_to_i16_from_p24)
+DEFINE_CONVERT(i16, int16_t, i32, int32_t, memcpy_to_i16_from_i32)
+DEFINE_CONVERT(i16, int16_t, q8_23, int32_t, memcpy_to_i16_from_q8_23)
+DEFINE_CONVERT(float, float, i16, int16_t, memcpy_to_float_from_i16)
+DEFINE_CONVERT(float, float, u8, uint8_t, memcpy_to_float_from_u8)
+DEFINE_CONVERT(float, float, p24, uint8_t, memcpy_to_float_from_p24)
+DEFINE_CONVERT(float, float, i32, int32_t, memcpy_to_float_from_i32)
+DEFINE_CONVERT(float, float, q8_23, int32_t, memcpy_to_float_from_q8_23)
+DEFINE_CONVERT(u8, uint8_t, i16, int16_t, memcpy_to_u8_from_i16)
+DEFINE_CONVERT(u8, uint8_t, float, float, memcpy_to_u8_from_float)
+DEFINE_CONVERT(u8, uint8_t, p24, uint8_t, memcpy_to_u8_from_p24)
+DEFINE_CONVERT(u8, uint8_t, i32, int32_t, memcpy_to_u8_from_i32)
+DEFINE_CONVERT(u8, uint8_t, q8_23, int32_t, memcpy_to_u8_from_q8_23)
+DEFINE_CONVERT(p24, uint8_t, i16, int16_t, memcpy_to_p24_from_i16)
+DEFINE_CONVERT(p24, uint8_t, float, float, memcpy_to_p24_from_float)
+DEFINE_CONVERT(p24, uint8_t, i32, int32_t, memcpy_to_p24_from_i32)
+DEFINE_CONVERT(p24, uint8_t, q8_23, int32_t, memcpy_to_p24_from_q8_23)
+DEFINE_CONVERT(i32, int32_t, i16, int16_t, memcpy_to_i32_from_i16)
+DEFINE_CONVERT(i32, int32_t, float, float, memcpy_to_i32_from_float)
+DEFINE_CONVERT(i32, int32_t, p24, uint8_t, memcpy_to_i32_from_p24)
+DEFINE_CONVERT(q8_23, int32_t, i16, int16_t, memcpy_to_q8_23_from_i16)
+DEFINE_CONVERT(q8_23, int32_t, float, float, memcpy_to_q8_23_from_float_with_clamp)
+DEFINE_CONVERT(q8_23, int32_t, p24, uint8_t, memcpy_to_q8_23_from_p24)
+
+#undef DEFINE_CONVERT
+
+/* Returns the converter used by memcpy_by_audio_format() for different formats, or NULL. */
+static audio_format_convert_t get_convert(audio_format_t dst_format, audio_format_t src_format)
+{
+    switch (dst_format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+        switch (src_format) {
+        case AUDIO_FORMAT_PCM_FLOAT: return convert_i16_from_float;
+        case AUDIO_FORMAT_PCM_8_BIT: return convert_i16_from_u8;
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED: return convert_i16_from_p24;
+        case AUDIO_FORMAT_PCM_32_BIT: return convert_i16_from_i32;
+        case AUDIO_FORMAT_PCM_8_24_BIT: return convert_i16_from_q8_23;
+        default: return NULL;
+        }
+    case AUDIO_FORMAT_PCM_FLOAT:
+        switch (src_format) {
+        case AUDIO_FORMAT_PCM_16_BIT: return convert_float_from_i16;
+        case AUDIO_FORMAT_PCM_8_BIT: return convert_float_from_u8;
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED: return convert_float_from_p24;
+        case AUDIO_FORMAT_PCM_32_BIT: return convert_float_from_i32;
+        case AUDIO_FORMAT_PCM_8_24_BIT: return convert_float_from_q8_23;
+        default: return NULL;
+        }
+    case AUDIO_FORMAT_PCM_8_BIT:
+        switch (src_format) {
+        case AUDIO_FORMAT_PCM_16_BIT: return convert_u8_from_i16;
+        case AUDIO_FORMAT_PCM_FLOAT: return convert_u8_from_float;
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED: return convert_u8_from_p24;
+        case AUDIO_FORMAT_PCM_32_BIT: return convert_u8_from_i32;
+        case AUDIO_FORMAT_PCM_8_24_BIT: return convert_u8_from_q8_23;
+        default: return NULL;
+        }
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        switch (src_format) {
+        case AUDIO_FORMAT_PCM_16_BIT: return convert_p24_from_i16;
+        case AUDIO_FORMAT_PCM_FLOAT: return convert_p24_from_float;
+        case AUDIO_FORMAT_PCM_32_BIT: return convert_p24_from_i32;
+        case AUDIO_FORMAT_PCM_8_24_BIT: return convert_p24_from_q8_23;
+        default: return NULL;
+        }
+    case AUDIO_FORMAT_PCM_32_BIT:
+        switch (src_format) {
+        case AUDIO_FORMAT_PCM_16_BIT: return convert_i32_from_i16;
+        case AUDIO_FORMAT_PCM_FLOAT: return convert_i32_from_float;
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED: return convert_i32_from_p24;
+        default: return NULL;
+        }
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        switch (src_format) {
+        case AUDIO_FORMAT_PCM_16_BIT: return convert_q8_23_from_i16;
+        case AUDIO_FORMAT_PCM_FLOAT: return convert_q8_23_from_float;
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED: return convert_q8_23_from_p24;
+        default: return NULL;
+        }
+    default:
+        return NULL;
+    }
+}
+
+/*
+ * Copies frames selecting source channels by index array, like memcpy_by_index_array().
+ * Destination channels are filled one at a time, so the inner loops have constant
+ * strides and no branches. A negative index fills the channel with silence.
+ */
+#define DEFINE_REMIX_BY_INDEX(name, type, silence) \
+    static void name(type *dst, uint32_t dst_channels, const type *src, uint32_t src_channels, \
+            const int8_t *idxary, size_t count) \
+    { \
+        for (uint32_t i = 0; i < dst_channels; ++i) { \
+            type *d = dst + i; \
+            const int index = idxary[i]; \
+            if (index < 0) { \
+                for (size_t j = 0; j < count; ++j, d += dst_channels) { \
+                    *d = (silence); \
+                } \
+            } else { \
+                const type *s = src + index; \
+                for (size_t j = 0; j < count; ++j, d += dst_channels, s += src_channels) { \
+                    *d = *s; \
+                } \
+            } \
+        } \
+    }
+
+DEFINE_REMIX_BY_INDEX(remix_by_index_array_u8, uint8_t, 0x80)  // PCM 8 bit is unsigned.
+DEFINE_REMIX_BY_INDEX(remix_by_index_array_16, uint16_t, 0)
+DEFINE_REMIX_BY_INDEX(remix_by_index_array_32, uint32_t, 0)
+
+#undef DEFINE_REMIX_BY_INDEX
+
+static void remix_by_index_array(void *dst, uint32_t dst_channels,
+        const void *src, uint32_t src_channels,
+        const int8_t *idxary, size_t sample_size, size_t count)
+{
+    switch (sample_size) {
+    case 1:
+        remix_by_index_array_u8((uint8_t *)dst, dst_channels,
+                (const uint8_t *)src, src_channels, idxary, count);
+        break;
+    case 2:
+        remix_by_index_array_16((uint16_t *)dst, dst_channels,
+                (const uint16_t *)src, src_channels, idxary, count);
+        break;
+    case 4:
+        remix_by_index_array_32((uint32_t *)dst, dst_channels,
+                (const uint32_t *)src, src_channels, idxary, count);
+        break;
+    default:
+        memcpy_by_index_array(dst, dst_channels, src, src_channels, idxary, sample_size, count);
+        break;
+    }
+}
+
+/* Size in bytes of the intermediate buffer used by memcpy_by_audio_format_remix(). */
+#define REMIX_BLOCK_BYTES 2048
+
+int audio_format_remix_plan_init(audio_format_remix_plan_t *plan,
+        audio_format_t dst_format, audio_channel_mask_t dst_channel_mask,
+        audio_format_t src_format, audio_channel_mask_t src_channel_mask)
+{
+    const size_t dst_sample_size = audio_bytes_per_sample(dst_format);
+    const size_t src_sample_size = audio_bytes_per_sample(src_format);
+    if (!audio_is_linear_pcm(dst_format) || !audio_is_linear_pcm(src_format)
+            || dst_sample_size == 0 || src_sample_size == 0) {
+        return -EINVAL;
+    }
+    audio_format_convert_t convert = NULL;
+    if (dst_format != src_format) {
+        convert = get_convert(dst_format, src_format);
+        if (convert == NULL) {
+            return -EINVAL;
+        }
+    }
+
+    int8_t idxary[AUDIO_FORMAT_REMIX_MAX_CHANNELS];
+    const size_t dst_channels = memcpy_by_index_array_initialization_from_channel_mask(
+            idxary, AUDIO_FORMAT_REMIX_MAX_CHANNELS, dst_channel_mask, src_channel_mask);
+    const size_t src_channels = __builtin_popcount(audio_channel_mask_get_bits(src_channel_mask));
+    if (dst_channels == 0 || dst_channels > AUDIO_FORMAT_REMIX_MAX_CHANNELS
+            || src_channels == 0) {
+        return -EINVAL;
+    }
+
+    bool remix = dst_channels != src_channels;
+    for (size_t i = 0; i < dst_channels; ++i) {
+        remix = remix || idxary[i] != (int8_t)i;
+    }
+
+    // Remix where there are fewer samples to move: drop channels before converting, and
+    // add channels after converting. Copying packed 24 bit samples by index is slow,
+    // so avoid remixing in that format.
+    bool remix_first = dst_channels <= src_channels;
+    if (src_sample_size == 3 && dst_sample_size != 3) {
+        remix_first = false;
+    } else if (dst_sample_size == 3 && src_sample_size != 3) {
+        remix_first = true;
+    }
+    const size_t remix_sample_size = remix_first ? src_sample_size : dst_sample_size;
+    const size_t block_frame_size = remix_first
+            ? dst_channels * src_sample_size : src_channels * dst_sample_size;
+
+    memset(plan, 0, sizeof(*plan));
+    plan->convert = convert;
+    plan->dst_channels = dst_channels;
+    plan->src_channels = src_channels;
+    plan->dst_frame_size = dst_channels * dst_sample_size;
+    plan->src_frame_size = src_channels * src_sample_size;
+    plan->remix_sample_size = remix_sample_size;
+    plan->block_frames = REMIX_BLOCK_BYTES / block_frame_size;
+    plan->remix = remix;
+    plan->remix_first = remix_first;
+    memcpy(plan->idxary, idxary, dst_channels * sizeof(idxary[0]));
+    return 0;
+}
+
+void memcpy_by_audio_format_remix(void *dst, const void *src, size_t frames,
+        const audio_format_remix_plan_t *plan)
+{
+    if (!plan->remix) {
+        if (plan->convert != NULL) {
+            plan->convert(dst, src, frames * plan->src_channels);
+        } else if (dst != src) {
+            memcpy(dst, src, frames * plan->src_frame_size);
+        }
+        return;
+    }
+    if (plan->convert == NULL) {
+        remix_by_index_array(dst, plan->dst_channels, src, plan->src_channels,
+                plan->idxary, plan->remix_sample_size, frames);
+        return;
+    }
+
+    // Each block is remixed and converted through the intermediate buffer while it is
+    // still in cache, so the source and destination buffers are only traversed once.
+    uint32_t block[REMIX_BLOCK_BYTES / sizeof(uint32_t)];
+    uint8_t *dst8 = (uint8_t *)dst;
+    const uint8_t *src8 = (const uint8_t *)src;
+    while (frames > 0) {
+        const size_t block_frames = frames < plan->block_frames ? frames : plan->block_frames;
+        if (plan->remix_first) {
+            remix_by_index_array(block, plan->dst_channels, src8, plan->src_channels,
+                    plan->idxary, plan->remix_sample_size, block_frames);
+            plan->convert(dst8, block, block_frames * plan->dst_channels);
+        } else {
+            plan->convert(block, src8, block_frames * plan->src_channels);
+            remix_by_index_array(dst8, plan->dst_channels, block, plan->src_channels,
+                    plan->idxary, plan->remix_sample_size, block_frames);
+        }
+        dst8 += block_frames * plan->dst_frame_size;
+        src8 += block_frames * plan->src_frame_size;
+        frames -= block_frames;
+    }
+}
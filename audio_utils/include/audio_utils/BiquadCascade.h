@@ -0,0 +1,537 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "BiquadFilter.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include <assert.h>
+
+// We conditionally include neon optimizations for ARM devices
+#pragma push_macro("USE_NEON")
+#undef USE_NEON
+
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define USE_NEON
+#endif
+
+// We conditionally include SSE optimizations for x86 devices
+#pragma push_macro("USE_SSE")
+#undef USE_SSE
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define USE_SSE
+#endif
+
+namespace android::audio_utils {
+
+/**
+ * Parametric Biquad filter types, see designBiquad().
+ */
+enum class BiquadType {
+    LOW_PASS,
+    HIGH_PASS,
+    PEAKING,
+    LOW_SHELF,
+    HIGH_SHELF,
+};
+
+/**
+ * Returns the normalized Biquad coefficients b0, b1, b2, a1, a2 of a parametric filter,
+ * from the Audio EQ Cookbook by Robert Bristow-Johnson.
+ *
+ * \param type       the filter type.
+ * \param frequency  the cutoff, center or shelf midpoint frequency in Hz,
+ *                   less than half the sample rate.
+ * \param sampleRate the sample rate in Hz.
+ * \param q          the quality factor, for example M_SQRT1_2 for a Butterworth
+ *                   low or high pass, or a shelf slope of 1.
+ * \param gainDb     the gain in dB at the center frequency for PEAKING,
+ *                   or of the shelf for LOW_SHELF and HIGH_SHELF, otherwise ignored.
+ */
+template <typename D = float>
+std::array<D, kBiquadNumCoefs> designBiquad(BiquadType type, double frequency,
+        double sampleRate, double q, double gainDb = 0.) {
+    const double w0 = 2. * M_PI * frequency / sampleRate;
+    const double cosW0 = cos(w0);
+    const double alpha = sin(w0) / (2. * q);
+    const double A = pow(10., gainDb / 40.);
+    const double sqrtAAlpha2 = 2. * sqrt(A) * alpha;
+    double b0, b1, b2, a0, a1, a2;
+    switch (type) {
+    case BiquadType::LOW_PASS:
+        b0 = b2 = (1. - cosW0) / 2.;
+        b1 = 1. - cosW0;
+        a0 = 1. + alpha;
+        a1 = -2. * cosW0;
+        a2 = 1. - alpha;
+        break;
+    case BiquadType::HIGH_PASS:
+        b0 = b2 = (1. + cosW0) / 2.;
+        b1 = -(1. + cosW0);
+        a0 = 1. + alpha;
+        a1 = -2. * cosW0;
+        a2 = 1. - alpha;
+        break;
+    case BiquadType::PEAKING:
+        b0 = 1. + alpha * A;
+        b1 = -2. * cosW0;
+        b2 = 1. - alpha * A;
+        a0 = 1. + alpha / A;
+        a1 = -2. * cosW0;
+        a2 = 1. - alpha / A;
+        break;
+    case BiquadType::LOW_SHELF:
+        b0 = A * ((A + 1.) - (A - 1.) * cosW0 + sqrtAAlpha2);
+        b1 = 2. * A * ((A - 1.) - (A + 1.) * cosW0);
+        b2 = A * ((A + 1.) - (A - 1.) * cosW0 - sqrtAAlpha2);
+        a0 = (A + 1.) + (A - 1.) * cosW0 + sqrtAAlpha2;
+        a1 = -2. * ((A - 1.) + (A + 1.) * cosW0);
+        a2 = (A + 1.) + (A - 1.) * cosW0 - sqrtAAlpha2;
+        break;
+    case BiquadType::HIGH_SHELF:
+    default:
+        b0 = A * ((A + 1.) + (A - 1.) * cosW0 + sqrtAAlpha2);
+        b1 = -2. * A * ((A - 1.) + (A + 1.) * cosW0);
+        b2 = A * ((A + 1.) + (A - 1.) * cosW0 - sqrtAAlpha2);
+        a0 = (A + 1.) - (A - 1.) * cosW0 + sqrtAAlpha2;
+        a1 = 2. * ((A - 1.) - (A + 1.) * cosW0);
+        a2 = (A + 1.) - (A - 1.) * cosW0 - sqrtAAlpha2;
+        break;
+    }
+    return {D(b0 / a0), D(b1 / a0), D(b2 / a0), D(a1 / a0), D(a2 / a0)};
+}
+
+/**
+ * BiquadCascade
+ *
+ * A multichannel cascade of Biquad second order sections, for example a parametric
+ * equalizer, with the same sections applied to every channel.
+ *
+ * Chaining BiquadFilters reads and writes the whole buffer once per section.
+ * Instead, the cascade loads each frame once, and applies up to kSectionsPerPass
+ * sections with the frame kept in registers, using the step() method of the filter kernel
+ * selected by ConstOptions (BiquadStateSpace by default, or BiquadDirect2Transpose).
+ * Channels are processed 4 at a time with SIMD, and the remaining channels together.
+ *
+ * The coefficients of a section may be changed smoothly by interpolating them over
+ * a number of frames, updated every kRampStepFrames. The stable region of (a1, a2) is
+ * a triangle, which is convex, so linear interpolation between stable sections
+ * is stable at every step.
+ *
+ * \param D type variable representing the data type, one of float or double.
+ *         The default is float.
+ */
+template <typename D = float,
+        typename ConstOptions = details::DefaultBiquadConstOptions>
+class BiquadCascade {
+public:
+    // Maximum sections applied per pass over the data.
+    static constexpr size_t kSectionsPerPass = 4;
+    // Frames between coefficient updates while interpolating.
+    static constexpr size_t kRampStepFrames = 16;
+
+    /**
+     * \param channelCount the number of interleaved channels.
+     * \param sectionCount the number of sections, initially pass through.
+     */
+    BiquadCascade(size_t channelCount, size_t sectionCount)
+            : mChannelCount(channelCount)
+            , mSectionCount(sectionCount)
+            , mCoefs(sectionCount * kBiquadNumCoefs)
+            , mTargetCoefs(sectionCount * kBiquadNumCoefs)
+            , mCoefIncrements(sectionCount * kBiquadNumCoefs)
+            , mRampSteps(sectionCount)
+            , mDelays(sectionCount * kBiquadNumDelays * channelCount) {
+        for (size_t i = 0; i < sectionCount; ++i) {
+            mCoefs[i * kBiquadNumCoefs] = mTargetCoefs[i * kBiquadNumCoefs] = 1;
+        }
+    }
+
+    size_t getChannelCount() const { return mChannelCount; }
+    size_t getSectionCount() const { return mSectionCount; }
+
+    /**
+     * \brief Sets the coefficients of one section
+     *
+     * \param section    the section index.
+     * \param coefs      the coefficients, as for BiquadFilter::setCoefficients().
+     * \return true if the section is stable, otherwise, return false.
+     */
+    template <typename T = std::array<D, kBiquadNumCoefs>>
+    bool setCoefficients(size_t section, const T& coefs) {
+        return setCoefficientsRamped(section, coefs, 0 /* rampFrames */);
+    }
+
+    /**
+     * \brief Sets the coefficients of one section, interpolated from the current ones
+     *
+     * \param section    the section index.
+     * \param coefs      the coefficients, as for BiquadFilter::setCoefficients().
+     * \param rampFrames the number of frames to interpolate from the current coefficients,
+     *                   rounded up to a multiple of kRampStepFrames, or 0 to change immediately.
+     * \return true if the section is stable, otherwise, return false.
+     */
+    template <typename T = std::array<D, kBiquadNumCoefs>>
+    bool setCoefficientsRamped(size_t section, const T& coefs, size_t rampFrames) {
+        assert(section < mSectionCount);
+        const auto lcoef = details::reduceCoefficients<D, T>(coefs);
+        D* const current = &mCoefs[section * kBiquadNumCoefs];
+        D* const target = &mTargetCoefs[section * kBiquadNumCoefs];
+        D* const increment = &mCoefIncrements[section * kBiquadNumCoefs];
+        const size_t steps = (rampFrames + kRampStepFrames - 1) / kRampStepFrames;
+        std::copy(lcoef.begin(), lcoef.end(), target);
+        if (steps <= 1) {
+            std::copy(lcoef.begin(), lcoef.end(), current);
+            mRampSteps[section] = 0;
+        } else {
+            for (size_t i = 0; i < kBiquadNumCoefs; ++i) {
+                increment[i] = (target[i] - current[i]) / steps;
+            }
+            mRampSteps[section] = steps;
+        }
+        return details::isStable(target[3], target[4]);
+    }
+
+    /**
+     * Returns the current, possibly interpolated, coefficients of a section.
+     */
+    std::array<D, kBiquadNumCoefs> getCoefficients(size_t section) const {
+        assert(section < mSectionCount);
+        std::array<D, kBiquadNumCoefs> coefs;
+        std::copy_n(&mCoefs[section * kBiquadNumCoefs], kBiquadNumCoefs, coefs.begin());
+        return coefs;
+    }
+
+    /** Returns true if all the sections are stable. */
+    bool isStable() const {
+        for (size_t i = 0; i < mSectionCount; ++i) {
+            if (!details::isStable(mTargetCoefs[i * kBiquadNumCoefs + 3],
+                    mTargetCoefs[i * kBiquadNumCoefs + 4])) return false;
+        }
+        return true;
+    }
+
+    /** Returns true if the coefficients of any section are being interpolated. */
+    bool isRamping() const {
+        return std::any_of(mRampSteps.begin(), mRampSteps.end(),
+                [](size_t steps) { return steps > 0; });
+    }
+
+    /**
+     * \brief Filters the input data through all the sections
+     *
+     * \param out     pointer to the output data, which may be the same as the input.
+     * \param in      pointer to the input data
+     * \param frames  number of audio frames to be processed
+     */
+    void process(D* out, const D* in, size_t frames) {
+        while (frames > 0) {
+            size_t chunk = frames;
+            const bool ramping = isRamping();
+            if (ramping) {
+                chunk = std::min(frames, kRampStepFrames - mRampPhase);
+            }
+            processSections(out, in, chunk);
+            out += chunk * mChannelCount;
+            in += chunk * mChannelCount;
+            frames -= chunk;
+            if (ramping && (mRampPhase += chunk) == kRampStepFrames) {
+                mRampPhase = 0;
+                stepRamp();
+            }
+        }
+    }
+
+    /**
+     * \brief Filters the input data through all the sections, and accumulates the
+     * energy of the filtered data of each channel, without storing it
+     *
+     * Each frame is loaded and converted once, filtered and squared in registers.
+     * The sections are applied in a single pass, so the cascade must have at most
+     * kSectionsPerPass sections, and must not be interpolating coefficients.
+     *
+     * \param energy  the sum of the squared filtered samples of each channel is added
+     *                to energy[channel].
+     * \param in      pointer to the input data.
+     * \param frames  number of audio frames to be processed.
+     * \param convert converts an input sample of type S to D, for example
+     *                float_from_i16() for int16_t input.
+     */
+    template <typename S, typename Convert>
+    void accumulateEnergy(D* energy, const S* in, size_t frames, Convert convert) {
+        accumulateSections<S, Convert, true /* CONVERT */>(energy, in, frames, convert);
+    }
+
+    void accumulateEnergy(D* energy, const D* in, size_t frames) {
+        accumulateSections<D, std::nullptr_t, false /* CONVERT */>(energy, in, frames, nullptr);
+    }
+
+    /** Clears the delay elements of all the sections. */
+    void clear() {
+        std::fill(mDelays.begin(), mDelays.end(), 0.f);
+    }
+
+private:
+    void processSections(D* out, const D* in, size_t frames) {
+        if (mSectionCount == 0) {
+            if (out != in) std::copy_n(in, frames * mChannelCount, out);
+            return;
+        }
+        for (size_t section = 0; section < mSectionCount; section += kSectionsPerPass) {
+            switch (std::min(kSectionsPerPass, mSectionCount - section)) {
+            case 1: processPass<1>(out, in, frames, section); break;
+            case 2: processPass<2>(out, in, frames, section); break;
+            case 3: processPass<3>(out, in, frames, section); break;
+            default: processPass<4>(out, in, frames, section); break;
+            }
+            in = out;
+        }
+    }
+
+    template <size_t SECTIONS>
+    void processPass(D* out, const D* in, size_t frames, size_t section) {
+        static_assert(SECTIONS <= kSectionsPerPass);
+        size_t channel = 0;
+        if constexpr (std::is_same_v<D, float>) {
+#if defined(USE_NEON)
+            using alt_4_t = float32x4_t;
+#elif defined(USE_SSE)
+            using alt_4_t = __m128;
+#else
+            using alt_4_t = intrinsics::internal_array_t<float, 4>;
+#endif
+            for (; channel + 4 <= mChannelCount; channel += 4) {
+                processChannels<alt_4_t, SECTIONS>(out, in, frames, section, channel);
+            }
+            // Interleave the independent channels of the remainder, rather than
+            // filter them one after the other.
+            switch (mChannelCount - channel) {
+            case 3:
+                processChannels<intrinsics::internal_array_t<float, 3>, SECTIONS>(
+                        out, in, frames, section, channel);
+                return;
+            case 2:
+                processChannels<intrinsics::internal_array_t<float, 2>, SECTIONS>(
+                        out, in, frames, section, channel);
+                return;
+            }
+        }
+        for (; channel < mChannelCount; ++channel) {
+            processChannels<D, SECTIONS>(out, in, frames, section, channel);
+        }
+    }
+
+    template <typename Kernel, typename T, size_t... Is>
+    std::array<Kernel, sizeof...(Is)> makeKernels(
+            size_t section, size_t channel, std::index_sequence<Is...>) const {
+        using namespace intrinsics;
+        [[maybe_unused]] const D* coefs = &mCoefs[section * kBiquadNumCoefs];
+        [[maybe_unused]] const D* delays =
+                &mDelays[section * kBiquadNumDelays * mChannelCount + channel];
+        return {{ Kernel(
+                vdupn<T>(coefs[Is * kBiquadNumCoefs + 0]),
+                vdupn<T>(coefs[Is * kBiquadNumCoefs + 1]),
+                vdupn<T>(coefs[Is * kBiquadNumCoefs + 2]),
+                vdupn<T>(coefs[Is * kBiquadNumCoefs + 3]),
+                vdupn<T>(coefs[Is * kBiquadNumCoefs + 4]),
+                vld1<T>(delays + Is * kBiquadNumDelays * mChannelCount),
+                vld1<T>(delays + (Is * kBiquadNumDelays + 1) * mChannelCount))... }};
+    }
+
+    // Applies SECTIONS sections, starting at section, to the channels of type T
+    // starting at channel.
+    template <typename T, size_t SECTIONS>
+    void processChannels(D* out, const D* in, size_t frames, size_t section, size_t channel) {
+        using namespace intrinsics;
+        using Kernel = typename ConstOptions::template FilterType<T, T>;
+        auto kernels = makeKernels<Kernel, T>(
+                section, channel, std::make_index_sequence<SECTIONS>());
+        in += channel;
+        out += channel;
+        for (size_t i = 0; i < frames; ++i) {
+            T x = vld1<T>(in);
+            #pragma unroll
+            for (auto& kernel : kernels) {
+                x = kernel.step(x);
+            }
+            vst1(out, x);
+            in += mChannelCount;
+            out += mChannelCount;
+        }
+        D* delays = &mDelays[section * kBiquadNumDelays * mChannelCount + channel];
+        for (const auto& kernel : kernels) {
+            vst1(delays, kernel.s_[0]);
+            vst1(delays + mChannelCount, kernel.s_[1]);
+            delays += kBiquadNumDelays * mChannelCount;
+        }
+    }
+
+    template <typename S, typename Convert, bool CONVERT>
+    void accumulateSections(D* energy, const S* in, size_t frames, Convert convert) {
+        assert(mSectionCount <= kSectionsPerPass && !isRamping());
+        switch (mSectionCount) {
+        case 0: accumulatePass<0, S, Convert, CONVERT>(energy, in, frames, convert); break;
+        case 1: accumulatePass<1, S, Convert, CONVERT>(energy, in, frames, convert); break;
+        case 2: accumulatePass<2, S, Convert, CONVERT>(energy, in, frames, convert); break;
+        case 3: accumulatePass<3, S, Convert, CONVERT>(energy, in, frames, convert); break;
+        default: accumulatePass<4, S, Convert, CONVERT>(energy, in, frames, convert); break;
+        }
+    }
+
+    template <size_t SECTIONS, typename S, typename Convert, bool CONVERT>
+    void accumulatePass(D* energy, const S* in, size_t frames, Convert convert) {
+        size_t channel = 0;
+        if constexpr (std::is_same_v<D, float>) {
+#if defined(USE_NEON)
+            using alt_8_t = float32x4x2_t;
+            using alt_4_t = float32x4_t;
+#elif defined(USE_SSE)
+            using alt_8_t = intrinsics::internal_array_t<__m128, 2>;
+            using alt_4_t = __m128;
+#else
+            using alt_8_t = intrinsics::internal_array_t<float, 8>;
+            using alt_4_t = intrinsics::internal_array_t<float, 4>;
+#endif
+            // The filtered data is not stored, so 8 channels fit in the registers.
+            for (; channel + 8 <= mChannelCount; channel += 8) {
+                accumulateChannels<alt_8_t, SECTIONS, S, Convert, CONVERT>(
+                        energy, in, frames, channel, convert);
+            }
+            for (; channel + 4 <= mChannelCount; channel += 4) {
+                accumulateChannels<alt_4_t, SECTIONS, S, Convert, CONVERT>(
+                        energy, in, frames, channel, convert);
+            }
+            switch (mChannelCount - channel) {
+            case 3:
+                accumulateChannels<intrinsics::internal_array_t<float, 3>, SECTIONS,
+                        S, Convert, CONVERT>(energy, in, frames, channel, convert);
+                return;
+            case 2:
+                accumulateChannels<intrinsics::internal_array_t<float, 2>, SECTIONS,
+                        S, Convert, CONVERT>(energy, in, frames, channel, convert);
+                return;
+            }
+        }
+        for (; channel < mChannelCount; ++channel) {
+            accumulateChannels<D, SECTIONS, S, Convert, CONVERT>(
+                    energy, in, frames, channel, convert);
+        }
+    }
+
+    // Applies SECTIONS sections to the channels of type T starting at channel,
+    // and adds the energy of the filtered channels to energy.
+    template <typename T, size_t SECTIONS, typename S, typename Convert, bool CONVERT>
+    void accumulateChannels(D* energy, const S* in, size_t frames, size_t channel,
+            Convert convert) {
+        using namespace intrinsics;
+        using Kernel = typename ConstOptions::template FilterType<T, T>;
+        constexpr size_t kLanes = sizeof(T) / sizeof(D);
+        auto kernels = makeKernels<Kernel, T>(
+                0 /* section */, channel, std::make_index_sequence<SECTIONS>());
+        T sum = vdupn<T>(D(0));
+        in += channel;
+        if constexpr (CONVERT) {
+            // Convert a block of frames ahead of filtering, as a vector load of
+            // values just stored individually would stall on store forwarding.
+            constexpr size_t kConvertFrames = 16;
+            D converted[kConvertFrames * kLanes];
+            while (frames > 0) {
+                const size_t block = std::min(frames, kConvertFrames);
+                for (size_t i = 0; i < block; ++i) {
+                    #pragma unroll
+                    for (size_t j = 0; j < kLanes; ++j) {
+                        converted[i * kLanes + j] = convert(in[j]);
+                    }
+                    in += mChannelCount;
+                }
+                for (size_t i = 0; i < block; ++i) {
+                    T x = vld1<T>(&converted[i * kLanes]);
+                    #pragma unroll
+                    for (auto& kernel : kernels) {
+                        x = kernel.step(x);
+                    }
+                    sum = vmla(sum, x, x);
+                }
+                frames -= block;
+            }
+        } else {
+            (void)convert;
+            for (size_t i = 0; i < frames; ++i) {
+                T x = vld1<T>(in);
+                #pragma unroll
+                for (auto& kernel : kernels) {
+                    x = kernel.step(x);
+                }
+                sum = vmla(sum, x, x);
+                in += mChannelCount;
+            }
+        }
+        D* delays = &mDelays[channel];
+        for (const auto& kernel : kernels) {
+            vst1(delays, kernel.s_[0]);
+            vst1(delays + mChannelCount, kernel.s_[1]);
+            delays += kBiquadNumDelays * mChannelCount;
+        }
+        D sums[kLanes];
+        vst1(sums, sum);
+        for (size_t j = 0; j < kLanes; ++j) {
+            energy[channel + j] += sums[j];
+        }
+    }
+
+    void stepRamp() {
+        for (size_t i = 0; i < mSectionCount; ++i) {
+            if (mRampSteps[i] == 0) continue;
+            const size_t offset = i * kBiquadNumCoefs;
+            if (--mRampSteps[i] == 0) {
+                // avoid accumulated rounding error.
+                std::copy_n(&mTargetCoefs[offset], kBiquadNumCoefs, &mCoefs[offset]);
+            } else {
+                for (size_t j = offset; j < offset + kBiquadNumCoefs; ++j) {
+                    mCoefs[j] += mCoefIncrements[j];
+                }
+            }
+        }
+    }
+
+    const size_t mChannelCount;
+    const size_t mSectionCount;
+
+    // Normalized coefficients b0, b1, b2, a1, a2 of each section, as for BiquadFilter.
+    std::vector<D> mCoefs;              // current coefficients
+    std::vector<D> mTargetCoefs;        // coefficients at the end of interpolation
+    std::vector<D> mCoefIncrements;     // increment per kRampStepFrames while interpolating
+    std::vector<size_t> mRampSteps;     // remaining interpolation steps of each section
+    size_t mRampPhase = 0;              // frames since the last interpolation step
+
+    // The delays of each section, mDelays[(section * 2 + i) * mChannelCount + channel]
+    // is the i-th delay of the channel in the section.
+    std::vector<D> mDelays;
+};
+
+} // namespace android::audio_utils
+
+#pragma pop_macro("USE_SSE")
+#pragma pop_macro("USE_NEON")
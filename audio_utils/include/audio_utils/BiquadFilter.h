@@ -18,6 +18,7 @@
 
 #include "intrinsic_utils.h"
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <functional>
@@ -35,6 +36,20 @@
 #define USE_NEON
 #endif
 
+// We conditionally include SSE/AVX optimizations for x86 devices
+#pragma push_macro("USE_SSE")
+#pragma push_macro("USE_AVX")
+#undef USE_SSE
+#undef USE_AVX
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define USE_SSE
+#if defined(__AVX__)
+#define USE_AVX
+#endif
+#endif
+
 // Use dither to prevent subnormals for CPUs that raise an exception.
 #pragma push_macro("USE_DITHER")
 #undef USE_DITHER
@@ -168,6 +183,17 @@ struct BiquadDirect2Transpose {
         s_[0] = s[0];
         s_[1] = s[1];
     }
+
+    // Filters a single frame x in place of process(), for a cascade of filters
+    // where the frame stays in registers between filters.
+    __attribute__((always_inline))
+    T step(const T& x) {
+        using namespace intrinsics;
+        const T y = vmla(s_[0], coef_[0], x);
+        s_[0] = vmla(vmla(s_[1], coef_[3], y), coef_[1], x);
+        s_[1] = vmla(vmul(coef_[2], x), coef_[4], y);
+        return y;
+    }
 };
 
 /**
@@ -396,6 +422,18 @@ struct BiquadStateSpace {
         s_[0] = s[0];
         s_[1] = s[1];
     }
+
+    // Filters a single frame x in place of process(), for a cascade of filters
+    // where the frame stays in registers between filters.
+    __attribute__((always_inline))
+    T step(const T& x) {
+        using namespace intrinsics;
+        const T y = vmla(s_[0], coef_[0], x);
+        const T s0 = vmla(vmla(s_[1], coef_[1], x), coef_[3], s_[0]);
+        s_[1] = vmla(vmul(coef_[2], x), coef_[4], s_[0]);
+        s_[0] = s0;
+        return y;
+    }
 };
 
 namespace details {
@@ -569,6 +607,16 @@ void biquad_filter_func(D *out, const D *in, size_t frames, size_t stride,
     using alt_16_t = float32x4x4_t;
     using alt_8_t = float32x4x2_t;
     using alt_4_t = float32x4_t;
+#elif defined(USE_AVX)
+    // use AVX types, the 4 channel case stays on SSE.
+    using alt_16_t = intrinsics::internal_array_t<__m256, 2>;
+    using alt_8_t = __m256;
+    using alt_4_t = __m128;
+#elif defined(USE_SSE)
+    // use SSE types to ensure we have the proper intrinsic acceleration.
+    using alt_16_t = intrinsics::internal_array_t<__m128, 4>;
+    using alt_8_t = intrinsics::internal_array_t<__m128, 2>;
+    using alt_4_t = __m128;
 #else
     // Use C++ types, no NEON needed.
     using alt_16_t = intrinsics::internal_array_t<float, 16>;
@@ -1106,7 +1154,241 @@ private:
     std::decay_t<decltype(mFilterFuncs[0])> mFunc;
 };
 
+/**
+ * BiquadFilterBank
+ *
+ * A bank of Biquad filters for many independent streams, each with its own
+ * channel count, coefficients and delay state.
+ *
+ * Filtering many short mono or stereo streams with one BiquadFilter per stream
+ * uses at most a couple of SIMD lanes per call. Instead, the filter bank assigns one
+ * lane to each channel of each stream, and filters all the streams at once with a single
+ * BiquadFilter<D, false> (not SAME_COEF_PER_CHANNEL) style call, vectorized across the lanes.
+ * The streams are gathered into a lane interleaved work buffer, in blocks of frames
+ * small enough for the work buffer to stay in cache, and the results are scattered back
+ * to the streams.
+ *
+ * Lanes are assigned in stream order, so stream i occupies the lanes
+ * [getLaneOffset(i), getLaneOffset(i) + getChannelCount(i)).
+ *
+ * \param D type variable representing the data type, one of float or double.
+ *         The default is float.
+ */
+template <typename D = float,
+        typename ConstOptions = details::DefaultBiquadConstOptions>
+class BiquadFilterBank {
+public:
+    // Maximum frames processed per gather/filter/scatter block.
+    static constexpr size_t kMaxBlockFrames = 32;
+    // Maximum samples of the work buffer, so it stays in a 32 KB L1 cache for float.
+    static constexpr size_t kMaxWorkSamples = 8192;
+    // Lanes filtered per call, so that the delays and coefficients stay in registers
+    // (16 lanes would spill on both NEON and SSE).
+    static constexpr size_t kLanesPerCall = 8;
+
+    /**
+     * \param channelCounts the channel count of each stream.
+     * \param coefs the initial filter coefficients of all the streams, see
+     *        BiquadFilter::setCoefficients().
+     * \param optimized whether to use processor optimized function (optional, defaults true).
+     */
+    template <typename T = std::array<D, kBiquadNumCoefs>>
+    explicit BiquadFilterBank(const std::vector<size_t>& channelCounts,
+            const T& coefs = {}, bool optimized = true)
+            : mChannelCounts(channelCounts)
+            , mLaneOffsets(channelCounts.size()) {
+        for (size_t i = 0; i < mChannelCounts.size(); ++i) {
+            mLaneOffsets[i] = mLaneCount;
+            mLaneCount += mChannelCounts[i];
+        }
+        mCoefs.resize(kBiquadNumCoefs * mLaneCount);
+        mDelays.resize(kBiquadNumDelays * mLaneCount);
+        mBlockFrames = std::clamp(kMaxWorkSamples / std::max(mLaneCount, size_t(1)),
+                size_t(1), kMaxBlockFrames);
+        mWork.resize(mBlockFrames * mLaneCount);
+        setCoefficients(coefs, optimized);
+    }
+
+    size_t getStreamCount() const { return mChannelCounts.size(); }
+    size_t getChannelCount(size_t stream) const { return mChannelCounts[stream]; }
+    size_t getLaneOffset(size_t stream) const { return mLaneOffsets[stream]; }
+
+    /** Returns the total number of channels of all the streams. */
+    size_t getLaneCount() const { return mLaneCount; }
+
+    /**
+     * Sets the filter coefficients of all the streams.
+     *
+     * \return true if the filters are stable, otherwise, return false.
+     */
+    template <typename T = std::array<D, kBiquadNumCoefs>>
+    bool setCoefficients(const T& coefs, bool optimized = true) {
+        details::setCoefficients<D, T>(
+                mCoefs, 0 /* offset */, mLaneCount, mLaneCount, coefs);
+        setOptimization(optimized);
+        return mLaneCount == 0 || isStable(0);
+    }
+
+    /**
+     * Sets the filter coefficients of one stream, specified by stream index.
+     *
+     * The coefficients are interpreted as in BiquadFilter::setCoefficients(),
+     * and are used for all the channels of the stream.
+     *
+     * \return true if the filter is stable, otherwise, return false.
+     */
+    template <typename T = std::array<D, kBiquadNumCoefs>>
+    bool setCoefficients(const T& coefs, size_t stream, bool optimized = true) {
+        assert(stream < mChannelCounts.size());
+        details::setCoefficients<D, T>(
+                mCoefs, mLaneOffsets[stream], mLaneCount, mChannelCounts[stream], coefs);
+        setOptimization(optimized);
+        return isStable(stream);
+    }
+
+    /**
+     * Returns the coefficients as a const vector reference,
+     * interleaved by lane in the same manner as BiquadFilter<D, false>.
+     */
+    const std::vector<D>& getCoefficients() const {
+        return mCoefs;
+    }
+
+    /** Returns true if the filter of the stream is stable. */
+    bool isStable(size_t stream) const {
+        assert(stream < mChannelCounts.size());
+        const size_t lane = mLaneOffsets[stream];
+        return details::isStable(mCoefs[3 * mLaneCount + lane], mCoefs[4 * mLaneCount + lane]);
+    }
+
+    /**
+     * Updates the filter function based on the coefficients of all the streams
+     * and processor optimization.
+     */
+    void setOptimization(bool optimized) {
+        size_t category = 0;
+        for (size_t i = 0; i < kBiquadNumCoefs; ++i) {
+            for (size_t j = 0; j < mLaneCount; ++j) {
+                if (mCoefs[i * mLaneCount + j] != 0) {
+                    category |= 1 << i;
+                    break;
+                }
+            }
+        }
+        if (optimized) {
+            mFilterOptions = (details::FILTER_OPTION)
+                    (mFilterOptions & ~details::FILTER_OPTION_SCALAR_ONLY);
+        } else {
+            mFilterOptions = (details::FILTER_OPTION)
+                    (mFilterOptions | details::FILTER_OPTION_SCALAR_ONLY);
+        }
+        mFunc = mFilterFuncs[category];
+    }
+
+    /**
+     * \brief Filters the input data of all the streams
+     *
+     * \param out     array of getStreamCount() pointers to the interleaved output of each stream.
+     * \param in      array of getStreamCount() pointers to the interleaved input of each stream.
+     *                The output may be the same as the input for in-place processing.
+     * \param frames  number of audio frames to be processed for every stream.
+     */
+    void process(D* const* out, const D* const* in, size_t frames) {
+        const size_t streamCount = mChannelCounts.size();
+        for (size_t frame = 0; frame < frames; frame += mBlockFrames) {
+            const size_t blockFrames = std::min(mBlockFrames, frames - frame);
+            for (size_t i = 0; i < streamCount; ++i) {
+                const size_t channelCount = mChannelCounts[i];
+                copyFrames(mWork.data() + mLaneOffsets[i], mLaneCount,
+                        in[i] + frame * channelCount, channelCount, blockFrames, channelCount);
+            }
+            for (size_t lane = 0; lane < mLaneCount; lane += kLanesPerCall) {
+                mFunc(mWork.data() + lane, mWork.data() + lane, blockFrames, mLaneCount,
+                        std::min(kLanesPerCall, mLaneCount - lane), mDelays.data() + lane,
+                        mCoefs.data() + lane, mLaneCount, mFilterOptions);
+            }
+            for (size_t i = 0; i < streamCount; ++i) {
+                const size_t channelCount = mChannelCounts[i];
+                copyFrames(out[i] + frame * channelCount, channelCount,
+                        mWork.data() + mLaneOffsets[i], mLaneCount, blockFrames, channelCount);
+            }
+        }
+    }
+
+    /** Clears the delay elements of all the streams. */
+    void clear() {
+        std::fill(mDelays.begin(), mDelays.end(), 0.f);
+    }
+
+    /** Clears the delay elements of one stream, for example when the stream restarts. */
+    void clear(size_t stream) {
+        assert(stream < mChannelCounts.size());
+        for (size_t i = 0; i < kBiquadNumDelays; ++i) {
+            std::fill_n(mDelays.begin() + i * mLaneCount + mLaneOffsets[stream],
+                    mChannelCounts[stream], 0.f);
+        }
+    }
+
+private:
+    // Copies frames of channelCount samples between buffers with different strides.
+    template <size_t CHANNELS = 0>
+    static void copyFrames(D* dst, size_t dstStride, const D* src, size_t srcStride,
+            size_t frames, size_t channelCount) {
+        if constexpr (CHANNELS == 0) {
+            // mono and stereo are the common cases.
+            switch (channelCount) {
+            case 1:
+                return copyFrames<1>(dst, dstStride, src, srcStride, frames, channelCount);
+            case 2:
+                return copyFrames<2>(dst, dstStride, src, srcStride, frames, channelCount);
+            }
+        }
+        for (size_t i = 0; i < frames; ++i) {
+            std::copy_n(src, CHANNELS == 0 ? channelCount : CHANNELS, dst);
+            src += srcStride;
+            dst += dstStride;
+        }
+    }
+
+    const std::vector<size_t> mChannelCounts;
+    std::vector<size_t> mLaneOffsets;   // first lane of each stream
+    size_t mLaneCount = 0;
+
+    // Stored as BiquadFilter<D, false>, with each lane as a channel:
+    // mCoefs[i * mLaneCount + j] is the i-th coefficient of lane j,
+    // mDelays[i * mLaneCount + j] is the i-th delay of lane j.
+    std::vector<D> mCoefs;
+    std::vector<D> mDelays;
+    size_t mBlockFrames;                // frames per block
+    std::vector<D> mWork;               // mBlockFrames of all the lanes, interleaved by lane
+
+    details::FILTER_OPTION mFilterOptions{};
+
+    template <size_t OCCUPANCY, bool SC>
+    struct FuncWrap {
+        static void func(D* out, const D *in, size_t frames, size_t stride,
+                size_t channelCount, D *delays, const D *coef, size_t localStride,
+                details::FILTER_OPTION filterOptions) {
+            constexpr size_t NEAREST_OCCUPANCY =
+                details::nearestOccupancy(
+                        OCCUPANCY, ConstOptions::template FilterType<D, D>
+                                               ::required_occupancies_);
+            details::biquad_filter_func<ConstOptions, NEAREST_OCCUPANCY, SC>(
+                    out, in, frames, stride, channelCount, delays, coef, localStride,
+                    filterOptions);
+        }
+    };
+
+    static inline constexpr auto mFilterFuncs =
+            details::make_functional_array<
+                    FuncWrap, 1 << kBiquadNumCoefs, false /* SAME_COEF_PER_CHANNEL */>();
+
+    std::decay_t<decltype(mFilterFuncs[0])> mFunc;
+};
+
 } // namespace android::audio_utils
 
 #pragma pop_macro("USE_DITHER")
+#pragma pop_macro("USE_AVX")
+#pragma pop_macro("USE_SSE")
 #pragma pop_macro("USE_NEON")
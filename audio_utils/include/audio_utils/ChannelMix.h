@@ -254,6 +254,7 @@ constexpr bool fillChannelMatrix(audio_channel_mask_t INPUT_CHANNEL_MASK,
             const unsigned lowestBit = tmp & -(signed)tmp;
             matrix[index][FL] = matrix[index][FR] = matrix[index][FC] = 0.f;
             matrix[index][LFE] = matrix[index][BL] = matrix[index][BR] = 0.f;
+            matrix[index][SL] = matrix[index][SR] = 0.f;
             switch (lowestBit) {
                 case AUDIO_CHANNEL_OUT_FRONT_LEFT:
                 case AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT:
@@ -348,6 +349,8 @@ constexpr bool fillChannelMatrix(audio_channel_mask_t INPUT_CHANNEL_MASK,
             const unsigned lowestBit = tmp & -(signed)tmp;
             matrix[index][FL] = matrix[index][FR] = matrix[index][FC] = 0.f;
             matrix[index][LFE] = matrix[index][BL] = matrix[index][BR] = 0.f;
+            matrix[index][SL] = matrix[index][SR] = 0.f;
+            matrix[index][TFL] = matrix[index][TFR] = matrix[index][TBL] = matrix[index][TBR] = 0.f;
             switch (lowestBit) {
                 case AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT:
                     matrix[index][TFL] = 1.f;
@@ -485,7 +488,12 @@ public:
     virtual bool process(const float *src, float *dst, size_t frameCount, bool accumulate,
             audio_channel_mask_t inputChannelMask) = 0;
 
-    /** Built in ChannelMix factory. */
+    /**
+     * Built in ChannelMix factory.
+     *
+     * Output channel masks without a ChannelMix specialization are handled
+     * by RuntimeChannelMix.
+     */
     static std::shared_ptr<IChannelMix> create(audio_channel_mask_t outputChannelMask);
 
     /** Returns true if the Built-in factory supports the outputChannelMask */
@@ -693,4 +701,102 @@ private:
     }
 };
 
+/**
+ * Fills the channel mix matrix for an output channel mask chosen at runtime.
+ *
+ * Input channels present in the output are copied with unity gain.
+ * Other input channels are folded into the nearest output channels, e.g.
+ * side to back (or back to side) on the same side, then to the front;
+ * top channels to their bottom counterparts; centers to the left and right pair.
+ * The gains follow the ChannelMix specializations above where they are equivalent.
+ *
+ * \param outputChannelMask channel position mask for output data,
+ *                          must contain AUDIO_CHANNEL_OUT_STEREO.
+ * \param inputChannelMask  channel position mask for input data.
+ * \param matrix            the row major matrix [inputChannelCount][outputStride],
+ *                          where rows are the input channels and columns the output channels.
+ * \param outputStride      the row stride of the matrix in floats,
+ *                          at least the output channel count.
+ *
+ * \return false if a channel mask is not supported.
+ */
+bool fillRuntimeChannelMatrix(audio_channel_mask_t outputChannelMask,
+        audio_channel_mask_t inputChannelMask, float *matrix, size_t outputStride);
+
+/**
+ * RuntimeChannelMix
+ *
+ * Converts audio streams with different positional channel configurations,
+ * where the output channel mask is chosen at runtime, e.g. AUDIO_CHANNEL_OUT_QUAD,
+ * AUDIO_CHANNEL_OUT_5POINT1POINT2 or AUDIO_CHANNEL_OUT_9POINT1POINT6.
+ *
+ * The matrix is computed by fillRuntimeChannelMatrix() when the input channel mask changes.
+ * Processing skips input channels which do not contribute to the output,
+ * and mixes each frame with SIMD vectors spanning the output channels.
+ */
+class RuntimeChannelMix : public IChannelMix {
+public:
+    /**
+     * Creates a RuntimeChannelMix object
+     *
+     * Note: If the input channel mask is not supported then getInputChannelMask will return
+     * AUDIO_CHANNEL_NONE.
+     *
+     * \param outputChannelMask  channel position mask for output audio data, which
+     *                           must be supported by isOutputChannelMaskSupported().
+     * \param inputChannelMask   channel position mask for input audio data.
+     */
+    explicit RuntimeChannelMix(audio_channel_mask_t outputChannelMask,
+            audio_channel_mask_t inputChannelMask = AUDIO_CHANNEL_NONE);
+
+    bool setInputChannelMask(audio_channel_mask_t inputChannelMask) override;
+
+    audio_channel_mask_t getInputChannelMask() const override {
+        return mInputChannelMask;
+    }
+
+    audio_channel_mask_t getOutputChannelMask() const {
+        return mOutputChannelMask;
+    }
+
+    bool process(const float *src, float *dst, size_t frameCount,
+            bool accumulate) const override;
+
+    bool process(const float *src, float *dst, size_t frameCount,
+            bool accumulate, audio_channel_mask_t inputChannelMask) override {
+        return setInputChannelMask(inputChannelMask) && process(src, dst, frameCount, accumulate);
+    }
+
+    /** Returns true if the outputChannelMask is supported by RuntimeChannelMix. */
+    static bool isOutputChannelMaskSupported(audio_channel_mask_t outputChannelMask);
+
+    // The maximum channels supported (bits in the channel mask).
+    static constexpr size_t MAX_INPUT_CHANNELS_SUPPORTED = FCC_26;
+    static constexpr size_t MAX_OUTPUT_CHANNELS_SUPPORTED = FCC_26;
+
+private:
+    // Floats per SIMD vector; each matrix row is padded to a multiple of this.
+    static constexpr size_t kVectorWidth = 4;
+    static constexpr size_t kRowStride =
+            (MAX_OUTPUT_CHANNELS_SUPPORTED + kVectorWidth - 1) / kVectorWidth * kVectorWidth;
+
+    // Dispatches to mixFrames() for the number of output vectors.
+    template <bool ACCUMULATE>
+    void processFrames(const float *src, float *dst, size_t frameCount) const;
+    template <size_t VECTORS, bool ACCUMULATE>
+    void mixFrames(const float *src, float *dst, size_t frameCount) const;
+
+    const audio_channel_mask_t mOutputChannelMask;
+    const size_t mOutputChannelCount;
+    const size_t mOutputVectorCount;
+
+    // These values are modified only when the input channel mask changes.
+    // mRows holds the nonzero rows of the matrix, mRowInput the input channel of each row.
+    alignas(16) float mRows[MAX_INPUT_CHANNELS_SUPPORTED][kRowStride]{};
+    uint8_t mRowInput[MAX_INPUT_CHANNELS_SUPPORTED]{};
+    size_t mRowCount = 0;
+    audio_channel_mask_t mInputChannelMask = AUDIO_CHANNEL_NONE;
+    size_t mInputChannelCount = 0;
+};
+
 } // android::audio_utils::channels
@@ -18,8 +18,10 @@
 
 #include <android-base/thread_annotations.h>
 #include <audio_utils/MelProcessor.h>
-#include <map>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 namespace android::audio_utils {
 
@@ -68,13 +70,20 @@ struct CsdRecord {
  * Class used to aggregate MEL values from different streams that play sounds
  * simultaneously.
  *
+ * The MEL values which did not contribute to the CSD yet are stored as runs of
+ * continuous seconds, sorted by time, with the linear energy of each second stored
+ * contiguously in a flat buffer. Records overlapping the end of the newest run, which
+ * is the common case for simultaneous streams, are aggregated in place. The CSD
+ * records are stored in a flat ring buffer sorted by time, so the newest is added
+ * and the oldest expired in constant time. The buffers are preallocated, and do not
+ * allocate in the steady state.
+ *
  * The public methods are internally protected by a mutex to be thread-safe.
  */
 class MelAggregator : public RefBase {
 public:
 
-    explicit MelAggregator(int64_t csdWindowSeconds)
-        : mCsdWindowSeconds(csdWindowSeconds) {}
+    explicit MelAggregator(int64_t csdWindowSeconds);
 
     /**
      * \returns the size of the stored CSD values.
@@ -118,33 +127,193 @@ public:
      * uses the passed records for the new callbacks.
      **/
     void reset(float newCsd, const std::vector<CsdRecord>& newRecords);
+
+    class PersistedState;
+
+    /**
+     * \returns the CSD records and the cached MEL values in the compact binary
+     *   format described in PersistedState, to be persisted and later restored
+     *   with reset(const PersistedState&).
+     */
+    std::vector<uint8_t> serialize() const;
+
+    /**
+     * Reset the aggregator values to a serialized state. Discards all the previous
+     * cached values. The records are copied in bulk, without being hydrated.
+     */
+    void reset(const PersistedState& state);
 private:
+    /** Continuous seconds of MEL values, the energies are stored in mMelEnergies. */
+    struct MelRun {
+        int64_t timestamp;
+        size_t length;
+        size_t offset;
+        audio_port_handle_t portId;
+
+        int64_t end() const { return timestamp + static_cast<int64_t>(length); }
+    };
+
+    /**
+     * Same as CsdRecord, but assignable to be stored in a ring buffer. The layout is
+     * the one persisted by serialize().
+     */
+    struct CsdEntry {
+        int64_t timestamp;
+        uint32_t duration;
+        float value;
+        float averageMel;
+        uint32_t reserved = 0;
+
+        CsdRecord toRecord() const { return {timestamp, duration, value, averageMel}; }
+    };
+
     /** Locked aggregateAndAddNewMelRecord method. */
     std::vector<CsdRecord> aggregateAndAddNewMelRecord_l(const MelRecord& record) REQUIRES(mLock);
 
+    /** Merges the record with the stored runs it overlaps, if any. */
+    void addMelRun_l(const MelRecord& record) REQUIRES(mLock);
+
+    /** Discards the MEL runs, keeping the preallocated buffers. */
+    void clearMelRuns_l() REQUIRES(mLock);
+
     void removeOldCsdRecords_l(std::vector<CsdRecord>& removeRecords) REQUIRES(mLock);
 
     std::vector<CsdRecord> updateCsdRecords_l() REQUIRES(mLock);
 
     int64_t csdTimeIntervalStored_l() REQUIRES(mLock);
 
-    std::map<int64_t, CsdRecord>::iterator addNewestCsdRecord_l(int64_t timestamp,
-                                                                int64_t duration,
-                                                                 float csdRecord,
-                                                                 float averageMel) REQUIRES(mLock);
+    CsdRecord addNewestCsdRecord_l(int64_t timestamp,
+                                   int64_t duration,
+                                   float csdRecord,
+                                   float averageMel) REQUIRES(mLock);
+
+    /** Inserts the entry into the CSD ring buffer, after the entries with the same time. */
+    void insertCsdEntry_l(const CsdEntry& entry) REQUIRES(mLock);
+
+    /** Returns the i-th oldest CSD entry. */
+    CsdEntry& csdEntry_l(size_t i) REQUIRES(mLock) {
+        return mCsdEntries[(mCsdFront + i) & (mCsdEntries.size() - 1)];
+    }
+    const CsdEntry& csdEntry_l(size_t i) const REQUIRES(mLock) {
+        return mCsdEntries[(mCsdFront + i) & (mCsdEntries.size() - 1)];
+    }
 
     const int64_t mCsdWindowSeconds;
 
     mutable std::mutex mLock;
 
-    std::map<int64_t, MelRecord> mMelRecords GUARDED_BY(mLock);
-    std::map<int64_t, CsdRecord> mCsdRecords GUARDED_BY(mLock);
+    /** MEL runs sorted by time, not overlapping. */
+    std::vector<MelRun> mMelRuns GUARDED_BY(mLock);
+    /** Linear energy of each second of the MEL runs, 10^(MEL/10). */
+    std::vector<float> mMelEnergies GUARDED_BY(mLock);
+    /** Number of values in mMelEnergies used by mMelRuns, the rest is stale after merges. */
+    size_t mMelEnergiesUsed GUARDED_BY(mLock) = 0;
+
+    /** Ring buffer of the CSD entries sorted by time, the size is a power of 2. */
+    std::vector<CsdEntry> mCsdEntries GUARDED_BY(mLock);
+    size_t mCsdFront GUARDED_BY(mLock) = 0;
+    size_t mCsdCount GUARDED_BY(mLock) = 0;
 
-    /** Current CSD value in mMelRecords. */
+    /** Current CSD value in mMelRuns. */
     float mCurrentMelRecordsCsd GUARDED_BY(mLock) = 0.f;
 
     /** CSD value containing sum of all CSD values stored. */
     float mCurrentCsd GUARDED_BY(mLock) = 0.f;
 };
 
+/**
+ * Read-only view of a MelAggregator state returned by MelAggregator::serialize(),
+ * usually a persisted file mapped in memory. The data is validated when the view is
+ * created, but the records are only hydrated when accessed, and
+ * MelAggregator::reset(const PersistedState&) copies them in bulk.
+ *
+ * The format is in native byte order, which is little endian on all Android devices,
+ * and contains in order:
+ *   Header                        magic, version, CSD and number of records
+ *   CsdEntry[csdRecordsSize]      CSD records sorted by timestamp
+ *   MelRunEntry[melRecordsSize]   cached MEL records sorted by timestamp, not overlapping
+ *   float[melValuesSize]          linear energy of each second of the cached MEL records
+ */
+class MelAggregator::PersistedState {
+public:
+    /** "MELA" in little endian, also rejects data in another byte order. */
+    static constexpr uint32_t kMagic = 0x414c454d;
+    /** Incremented for incompatible changes of the format. */
+    static constexpr uint32_t kVersion = 1;
+
+    /**
+     * \returns a view of the data, which must outlive the view, or nullptr if the
+     *   data is not a valid serialized state.
+     */
+    static std::unique_ptr<PersistedState> fromData(const void* data, size_t size);
+
+    /**
+     * \returns a view of the file mapped read-only in memory, or nullptr if the
+     *   file cannot be mapped or is not a valid serialized state.
+     */
+    static std::unique_ptr<PersistedState> fromFile(const char* path);
+
+    ~PersistedState();
+
+    PersistedState(const PersistedState&) = delete;
+    PersistedState& operator=(const PersistedState&) = delete;
+
+    /** Returns the serialized CSD value. */
+    float getCsd() const { return mHeader.csd; }
+
+    /** \returns the number of serialized CSD records. */
+    size_t getCsdRecordsSize() const { return mHeader.csdRecordsSize; }
+
+    /** \returns the i-th CSD record sorted by timestamp, i < getCsdRecordsSize(). */
+    CsdRecord getCsdRecord(size_t i) const;
+
+    /** \returns the number of serialized MEL records. */
+    size_t getCachedMelRecordsSize() const { return mHeader.melRecordsSize; }
+
+    /**
+     * \brief Iterate over the serialized MelRecords and applies function f.
+     *
+     * \param f      function to apply on the iterated MelRecord's sorted by timestamp
+     */
+    void foreachCachedMel(const std::function<void(const MelRecord&)>& f) const;
+
+private:
+    friend class MelAggregator;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        float csd;
+        float melRecordsCsd;
+        uint32_t csdRecordsSize;
+        uint32_t melRecordsSize;
+        uint64_t melValuesSize;
+    };
+
+    struct MelRunEntry {
+        int64_t timestamp;
+        uint32_t length;
+        audio_port_handle_t portId;
+    };
+
+    static std::unique_ptr<PersistedState> create(const uint8_t* data, size_t size,
+                                                  size_t mappedSize);
+
+    PersistedState(const uint8_t* data, const Header& header, size_t mappedSize)
+        : mData(data), mHeader(header), mMappedSize(mappedSize) {}
+
+    const uint8_t* csdEntries() const { return mData + sizeof(Header); }
+    const uint8_t* melRunEntries() const {
+        return csdEntries() + mHeader.csdRecordsSize * sizeof(CsdEntry);
+    }
+    const uint8_t* melValues() const {
+        return melRunEntries() + mHeader.melRecordsSize * sizeof(MelRunEntry);
+    }
+
+    const uint8_t* const mData;
+    const Header mHeader;
+    /** Size of the mapping of mData to unmap, or 0 if not mapped by fromFile(). */
+    const size_t mMappedSize;
+};
+
 }  // naemspace android::audio_utils
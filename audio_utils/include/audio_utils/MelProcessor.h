@@ -17,12 +17,15 @@
 #pragma once
 
 #include <array>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include <android-base/thread_annotations.h>
-#include <audio_utils/BiquadFilter.h>
+#include <audio_utils/BiquadCascade.h>
 #include <system/audio.h>
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
@@ -70,6 +73,9 @@ public:
         virtual void onMomentaryExposure(float currentMel, audio_port_handle_t deviceId) const = 0;
     };
 
+    /** Shared executor for the callbacks of many MelProcessors, see below. */
+    class MelExecutor;
+
     /**
      * \brief Creates a MelProcessor object.
      *
@@ -82,6 +88,8 @@ public:
      * \param deviceId          the device ID for the MEL callbacks
      * \param rs2Value          initial RS2 upper bound to use
      * \param maxMelsCallback   the number of max elements a callback can have.
+     * \param executor          shared executor delivering the callbacks. If nullptr,
+     *                          the MelProcessor starts its own callback thread.
      */
     MelProcessor(uint32_t sampleRate,
                  uint32_t channelCount,
@@ -89,7 +97,8 @@ public:
                  const sp<MelCallback>& callback,
                  audio_port_handle_t deviceId,
                  float rs2Value,
-                 size_t maxMelsCallback = kMaxMelValues);
+                 size_t maxMelsCallback = kMaxMelValues,
+                 const sp<MelExecutor>& executor = nullptr);
 
     /**
      * Sets the output RS2 upper bound for momentary exposure warnings. Default value
@@ -159,21 +168,31 @@ private:
         audio_port_handle_t mPort = AUDIO_PORT_HANDLE_NONE;
     };
 
-    // class used to asynchronously execute all MelProcessor callbacks
+    // class used to asynchronously execute all MelProcessor callbacks, either on its
+    // own thread or on a shared MelExecutor
     class MelWorker {
     public:
         static constexpr int kRingBufferSize = 32;
 
-        MelWorker(std::string threadName, const wp<MelCallback>& callback)
+        MelWorker(std::string threadName, const wp<MelCallback>& callback,
+                  const sp<MelExecutor>& executor)
             : mCallback(callback),
               mThreadName(std::move(threadName)),
+              mExecutor(executor),
               mCallbackRingBuffer(kRingBufferSize) {};
 
         void run();
 
-        // blocks until the MelWorker thread is stopped
+        // blocks until the MelWorker thread is stopped, or until the executor
+        // no longer delivers callbacks for this worker
         void stop();
 
+        // wakes up the thread delivering the callbacks after new data was added
+        void notify();
+
+        // delivers the pending callbacks, returns false if the MelCallback is gone
+        bool deliverCallbacks_l() REQUIRES(mCondVarMutex);
+
         // callback methods for new MEL values
         void momentaryExposure(float mel, audio_port_handle_t port);
         void newMelValues(const std::vector<float>& mels,
@@ -185,6 +204,7 @@ private:
 
         const wp<MelCallback> mCallback;
         const std::string mThreadName;
+        const sp<MelExecutor> mExecutor;
         std::vector<MelCallbackData> mCallbackRingBuffer GUARDED_BY(mCondVarMutex);
 
         std::atomic_size_t mRbReadPtr = 0;
@@ -194,12 +214,17 @@ private:
         std::condition_variable mCondVar;
         std::mutex mCondVarMutex;
         bool mStopRequested GUARDED_BY(mCondVarMutex) = false;
+
+        // state of the worker in mExecutor, guarded by mExecutor->mLock
+        bool mQueued = false;      // is in the queue of the executor
+        bool mDelivering = false;  // an executor thread is delivering the callbacks
+        bool mCancelled = false;   // must not be queued anymore
     };
 
     std::string pointerString() const;
     void createBiquads_l() REQUIRES(mLock);
     bool isSampleRateSupported_l() const REQUIRES(mLock);
-    void applyAWeight_l(const void* buffer, size_t frames) REQUIRES(mLock);
+    void accumulateAWeightedEnergy_l(const void* buffer, size_t frames) REQUIRES(mLock);
     float getCombinedChannelEnergy_l() REQUIRES(mLock);
     void addMelValue_l(float mel) REQUIRES(mLock);
 
@@ -207,8 +232,8 @@ private:
                                                // and momentary exposure warning
                                                // does not own the callback, must outlive
 
-    MelWorker mMelWorker;                      // spawns thread for asynchronous callbacks,
-                                               // worker is thread-safe
+    MelWorker mMelWorker;                      // spawns thread or posts to the executor for
+                                               // asynchronous callbacks, worker is thread-safe
 
     mutable std::mutex mLock;                  // monitor mutex
     // audio data sample rate
@@ -219,20 +244,14 @@ private:
     uint32_t mChannelCount GUARDED_BY(mLock);
     // audio data format
     audio_format_t mFormat GUARDED_BY(mLock);
-    // contains the A-weighted input samples to be processed
-    std::vector<float> mAWeightSamples GUARDED_BY(mLock);
-    // contains the input samples converted to float
-    std::vector<float> mFloatSamples GUARDED_BY(mLock);
     // local energy accumulation
     std::vector<float> mCurrentChannelEnergy GUARDED_BY(mLock);
     // accumulated MEL values
     std::vector<float> mMelValues GUARDED_BY(mLock);
     // current index to store the MEL values
     uint32_t mCurrentIndex GUARDED_BY(mLock);
-    using DefaultBiquadFilter = BiquadFilter<float, true, details::DefaultBiquadConstOptions>;
-    // Biquads used for the A-weighting
-    std::array<std::unique_ptr<DefaultBiquadFilter>, kCascadeBiquadNumber>
-        mCascadedBiquads GUARDED_BY(mLock);
+    // Biquads used for the A-weighting, fused with the energy accumulation
+    std::unique_ptr<BiquadCascade<float>> mAWeightCascade GUARDED_BY(mLock);
 
     std::atomic<float> mAttenuationDB = 0.f;
     // device id used for the callbacks
@@ -241,7 +260,67 @@ private:
     std::atomic<float> mRs2UpperBound;
     // number of samples in the energy
     std::atomic_size_t mCurrentSamples;
-    std::atomic_bool mPaused;
+    std::atomic_bool mPaused = false;
+};
+
+/**
+ * A bounded pool of threads which delivers the callbacks of many MelProcessors.
+ *
+ * By default each MelProcessor starts its own callback thread, which is idle
+ * most of the time. MelProcessors created with a shared MelExecutor post their
+ * callbacks to the executor instead, so the number of threads does not grow with
+ * the number of devices and streams.
+ *
+ * The callbacks of one MelProcessor are delivered in order, by one executor thread
+ * at a time. A thread which wakes up delivers all the callbacks pending for a
+ * MelProcessor, and serves all the MelProcessors queued before it waits again.
+ * With a batch period, a thread serves the queue at most once per period, so that
+ * the MEL values of streams with unaligned MEL seconds are delivered in batches
+ * with fewer wakeups, at the cost of up to a batch period of callback latency.
+ */
+class MelProcessor::MelExecutor : public RefBase {
+public:
+    static constexpr size_t kDefaultThreadCount = 1;
+    static constexpr size_t kMaxThreadCount = 8;
+
+    /**
+     * \brief Creates a MelExecutor and starts its threads.
+     *
+     * \param threadCount  number of threads, between 1 and kMaxThreadCount.
+     * \param batchPeriod  minimum time between two deliveries of a thread, 0 to
+     *                     deliver the callbacks as soon as they are posted.
+     * \param name         used as prefix for the thread names.
+     */
+    explicit MelExecutor(size_t threadCount = kDefaultThreadCount,
+                         std::chrono::milliseconds batchPeriod = {},
+                         std::string name = "MelExecutor");
+
+    /** Blocks until the threads are stopped. */
+    ~MelExecutor() override;
+
+    /** Returns the number of threads of the executor. */
+    size_t getThreadCount() const { return mThreads.size(); }
+
+private:
+    friend class MelProcessor::MelWorker;
+
+    void threadLoop();
+
+    // queues the worker for delivery if it is not already queued
+    void schedule(MelProcessor::MelWorker* worker);
+
+    // blocks until the worker is neither queued nor delivered by the executor
+    void cancel(MelProcessor::MelWorker* worker);
+
+    const std::string mName;
+    const std::chrono::milliseconds mBatchPeriod;
+    std::mutex mLock;
+    std::condition_variable mCondVar;           // signals queued workers to the threads
+    std::condition_variable mDeliveredCondVar;  // signals the end of a delivery
+    std::condition_variable mStopCondVar;       // signals the stop during a batch period
+    std::deque<MelProcessor::MelWorker*> mQueue GUARDED_BY(mLock);
+    bool mStopRequested GUARDED_BY(mLock) = false;
+    std::vector<std::thread> mThreads;
 };
 
 }  // namespace android::audio_utils
@@ -19,7 +19,8 @@
 
 #ifdef __cplusplus
 
-#include <mutex>
+#include <atomic>
+#include <string>
 #include <vector>
 #include <system/audio.h>
 #include <utils/Errors.h>
@@ -36,7 +37,10 @@ namespace android {
  * No distinction is made between channels in an audio frame; they are all
  * summed together for energy purposes.
  *
- * The public methods are internally protected by a mutex to be thread-safe.
+ * log() is wait-free, so that it can be called from a real-time audio thread,
+ * but it must not be called concurrently from different threads. The dump methods
+ * may be called concurrently with log() and with each other from any thread,
+ * they copy a consistent snapshot of the entries without blocking log().
  */
 class PowerLog {
 public:
@@ -93,17 +97,31 @@ public:
             bool logPlot = true) const;
 
 private:
-    mutable std::mutex mLock;     // monitor mutex
+    // An energy entry, written by log() while it may be read by dumpToString().
+    struct Entry {
+        std::atomic<int64_t> time{0}; // real time ns
+        std::atomic<float> energy{0.f};
+    };
+
+    // Appends an entry, called by log() only.
+    void appendEntry(int64_t time, float energy);
+
+    // Only accessed by log().
     int64_t mCurrentTime;         // time of first frame in buffer
     float mCurrentEnergy;         // local energy accumulation
     size_t mCurrentFrames;        // number of frames in the energy
-    size_t mIdx;                  // next usable index in mEntries
     size_t mConsecutiveZeroes;    // current run of consecutive zero entries
+
     const uint32_t mSampleRate;   // audio data sample rate
     const uint32_t mChannelCount; // audio data channel count
     const audio_format_t mFormat; // audio data format
     const size_t mFramesPerEntry; // number of audio frames per entry
-    std::vector<std::pair<int64_t /* real time ns */, float /* energy */>> mEntries;
+
+    // Entry n is stored at mEntries[n % mEntries.size()]. mWritten is the number of
+    // entries written, mStarted the number of entries whose write has started.
+    std::atomic<uint64_t> mWritten{0};
+    std::atomic<uint64_t> mStarted{0};
+    std::vector<Entry> mEntries;
 };
 
 } // namespace android
@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <sys/time.h>
+#include <system/audio.h>
 
 __BEGIN_DECLS
 
@@ -143,6 +143,8 @@ protected:
  */
 class audio_utils_fifo : public audio_utils_fifo_base {
 
+    friend class audio_utils_fifo_multi_reader;
+    friend class audio_utils_fifo_multi_writer;
     friend class audio_utils_fifo_reader;
     friend class audio_utils_fifo_writer;
     template <typename T> friend class audio_utils_fifo_writer_T;
@@ -167,6 +169,27 @@ public:
     audio_utils_fifo(uint32_t frameCount, uint32_t frameSize, void *buffer,
             audio_utils_fifo_index& writerRear, audio_utils_fifo_index *throttleFront = NULL);
 
+    /**
+     * Construct a FIFO object: multi-process or single-process, with the indices in separate
+     * cache lines.
+     *
+     *  \param frameCount  Maximum usable frames to be stored in the FIFO > 0 && <= INT32_MAX,
+     *                     aka "capacity".
+     *  \param frameSize   Size of each frame in bytes > 0,
+     *                     \p frameSize * \p frameCount <= INT32_MAX.
+     *  \param buffer      Pointer to a non-NULL caller-allocated buffer of \p frameCount frames.
+     *  \param indices     Indices, typically in shared memory.  The writer's rear index is
+     *                     \p indices.mRear.  Passed by reference because it must be non-NULL.
+     *  \param throttlesWriter Whether there is one reader that throttles the writer,
+     *                         with front index \p indices.mFront.
+     *  \param sync        Index synchronization, defaults to AUDIO_UTILS_FIFO_SYNC_SHARED.
+     *                     Should be AUDIO_UTILS_FIFO_SYNC_PRIVATE if the indices are not in memory
+     *                     shared with another process.
+     */
+    audio_utils_fifo(uint32_t frameCount, uint32_t frameSize, void *buffer,
+            audio_utils_fifo_indices& indices, bool throttlesWriter = true,
+            audio_utils_fifo_sync sync = AUDIO_UTILS_FIFO_SYNC_SHARED);
+
     /**
      * Construct a FIFO object: single-process.
      *  \param frameCount  Maximum usable frames to be stored in the FIFO > 0 && <= INT32_MAX,
@@ -210,9 +233,12 @@ private:
                                 // of size mFrameCount frames
 
     // only used for single-process constructor
+    // The indices are in separate cache lines from each other and from the const fields above.
+    alignas(audio_utils_fifo_indices::kCacheLineSize)
     audio_utils_fifo_index      mSingleProcessSharedRear;
 
     // only used for single-process constructor when throttlesWriter == true
+    alignas(audio_utils_fifo_indices::kCacheLineSize)
     audio_utils_fifo_index      mSingleProcessSharedFront;
 };
 
@@ -309,6 +335,29 @@ public:
      */
     virtual ssize_t available() = 0;
 
+    /**
+     * Begin a batch of obtain() and release() rounds, or of reads or writes.
+     * Until endBatch(), release() updates only the local index of this provider:
+     * the shared index is stored, and the partner woken subject to hysteresis,
+     * once at endBatch() for all of the frames released during the batch.
+     * Also, obtain() reuses the most recently loaded partner index, if that is enough to
+     * obtain \p count frames.
+     * This amortizes the cost of the atomic operations and wake checks over the batch,
+     * at the expense of latency: the partner sees the released frames only at endBatch(),
+     * or when obtain() has to block.
+     * Batches do not nest: beginBatch() in a batch has no effect, and the next endBatch()
+     * ends the batch.
+     * The default implementation does nothing, and release() takes effect immediately.
+     */
+    virtual void beginBatch() { }
+
+    /**
+     * End a batch started by beginBatch(), and make the frames released during the batch
+     * visible to the partner. Has no effect outside of a batch.
+     * The destructor of the provider ends its batch, if any.
+     */
+    virtual void endBatch() { }
+
     /**
      * Return the capacity, or statically configured maximum frame count.
      *
@@ -351,6 +400,7 @@ protected:
  * Used to write to a FIFO.  There should be exactly one writer per FIFO.
  * The writer is multi-thread safe with respect to reader(s),
  * but not with respect to multiple threads calling the writer API.
+ * For more than one writer, see audio_utils_fifo_multi_writer.
  */
 class audio_utils_fifo_writer : public audio_utils_fifo_provider {
 
@@ -399,6 +449,8 @@ public:
             const struct timespec *timeout = NULL);
     virtual void release(size_t count);
     virtual ssize_t available();
+    virtual void beginBatch();
+    virtual void endBatch();
 
     /**
      * Set the current effective buffer size.
@@ -448,8 +500,14 @@ public:
     void getHysteresis(uint32_t *armLevel, uint32_t *triggerLevel) const;
 
 private:
+    // Store mLocalRear into the shared rear index, and wake readers subject to hysteresis.
+    void publish();
+
     // Accessed by writer only using ordinary operations
     uint32_t    mLocalRear; // frame index of next frame slot available to write, or write index
+    uint32_t    mPublishedRear;     // value of mLocalRear most recently stored in shared index
+    uint32_t    mCachedFront;       // throttling front index as most recently loaded
+    bool        mBatch;             // whether between beginBatch() and endBatch()
 
     // TODO make a separate class and associate with the synchronization object
     uint32_t    mArmLevel;          // arm if filled < arm level before release()
@@ -467,6 +525,7 @@ private:
  * All other readers must keep up with the writer or they will lose frames.
  * Each reader is multi-thread safe with respect to the writer and any other readers,
  * but not with respect to multiple threads calling the reader API.
+ * For more than one reader sharing the throttling front index, see audio_utils_fifo_multi_reader.
  */
 class audio_utils_fifo_reader : public audio_utils_fifo_provider {
 
@@ -527,6 +586,8 @@ public:
             const struct timespec *timeout = NULL);
     virtual void release(size_t count);
     virtual ssize_t available();
+    virtual void beginBatch();
+    virtual void endBatch();
 
     /**
      * Same as audio_utils_fifo_provider::obtain, except has an additional parameter \p lost.
@@ -624,8 +685,15 @@ public:
             { return mTotalFlushed; }
 
 private:
+    // Store mLocalFront into the shared front index if this reader throttles the writer,
+    // and wake the writer subject to hysteresis.
+    void publish();
+
     // Accessed by reader only using ordinary operations
     uint32_t     mLocalFront;   // frame index of first frame slot available to read, or read index
+    uint32_t     mPublishedFront;   // value of mLocalFront most recently stored in shared index
+    uint32_t     mCachedRear;       // writer's rear index as most recently loaded
+    bool         mBatch;            // whether between beginBatch() and endBatch()
 
     // Points to shared front index if this reader throttles writer, or NULL if we don't throttle
     // FIXME consider making it a boolean
@@ -641,4 +709,182 @@ private:
     uint64_t    mTotalFlushed;      // total flushed frames, does not include lost frames
 };
 
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Used to write to a FIFO from more than one thread or process ("multi-producer").
+ * Each producer has its own writer, and all of the writers of a FIFO share a "reserved rear" index
+ * in addition to the writer's rear index of the FIFO.  The reserved rear index is the frame index
+ * of the next frame slot available to be obtained by any writer, and must have the same initial
+ * value as the writer's rear index.
+ *
+ * The writers also share an array of audio_utils_fifo_commit, one per frame slot of the FIFO.
+ *
+ * Unlike audio_utils_fifo_writer, obtain() reserves the returned slice for this writer,
+ * so that other writers obtain the slots which follow it.  The reservation is lock-free
+ * (a compare-and-exchange on the reserved rear index), and gives up with -EWOULDBLOCK after
+ * a bounded number of attempts lost to other writers.
+ * The obtained frames become visible to the reader(s) in the order they were reserved.
+ * release() never waits for the writers which reserved earlier frames: it records the commit
+ * of its frames in the slot of the first one, and then advances the writer's rear index over
+ * the contiguous run of committed slices which starts at it, if any.  So a writer which is
+ * preempted between obtain() and release() delays the visibility of the frames reserved after
+ * its own, but does not block the other writers, which can keep writing until the FIFO is full.
+ * Whichever writer commits the slice at the writer's rear index publishes it, along with any
+ * following slices committed meanwhile.
+ *
+ * Each writer is multi-thread safe with respect to the reader(s) and the other writers,
+ * but not with respect to multiple threads calling the API of the same writer.
+ * It must not be mixed with audio_utils_fifo_writer on the same FIFO, and the FIFO index
+ * synchronization must not be AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED.
+ * There is no support for resize(), hysteresis or batching:
+ * each non-empty release() wakes the readers.
+ */
+class audio_utils_fifo_multi_writer : public audio_utils_fifo_provider {
+
+public:
+    /**
+     * Single-process and multi-process use same constructor here,
+     * but different FIFO constructors.
+     *
+     * \param fifo         Associated FIFO.  Passed by reference because it must be non-NULL.
+     * \param reservedRear Reserved rear index shared by all writers of the FIFO.
+     *                     Passed by reference because it must be non-NULL.
+     * \param commits      Array of frameCount commits shared by all writers of the FIFO.
+     */
+    audio_utils_fifo_multi_writer(audio_utils_fifo& fifo, audio_utils_fifo_index& reservedRear,
+            audio_utils_fifo_commit *commits);
+
+    /**
+     * Any frames obtained but not released are returned to the FIFO if possible,
+     * or else are released with their current content.
+     */
+    virtual ~audio_utils_fifo_multi_writer();
+
+    /**
+     * Write to FIFO.  Same as audio_utils_fifo_writer::write(),
+     * except it may also return -EWOULDBLOCK or -EBUSY as for obtain().
+     */
+    ssize_t write(const void *buffer, size_t count, const struct timespec *timeout = NULL);
+
+    /**
+     * Same as audio_utils_fifo_provider::obtain(), but also reserves the returned slice for this
+     * writer.  Any frames of the most recently obtained slice which are not yet released are
+     * first returned to the FIFO, which is possible only if no other writer has since obtained
+     * the following frames.
+     *
+     * \return See audio_utils_fifo_provider::obtain, and in addition:
+     *  \retval -EWOULDBLOCK the reservation lost the race to other writers, or to the reader(s),
+     *                       too many times.
+     *                       Should usually handle like -EINTR.
+     *  \retval -EBUSY       frames from the most recently obtained slice are not yet released
+     *                       and could not be returned, so they must be released first.
+     */
+    virtual ssize_t obtain(audio_utils_iovec iovec[2], size_t count = SIZE_MAX,
+            const struct timespec *timeout = NULL);
+
+    /**
+     * Same as audio_utils_fifo_provider::release().  Releases the first \p count of the frames
+     * obtained and not yet released.  Does not wait for other writers: the frames become visible
+     * to the reader(s) once any earlier frames reserved by other writers are also released.
+     */
+    virtual void release(size_t count);
+
+    /**
+     * Determine the number of frames that could be obtained or written without blocking,
+     * by this or by any other writer.
+     */
+    virtual ssize_t available();
+
+private:
+    /** Return the unreleased frames to the FIFO if possible. */
+    bool cancel();
+
+    // Shared by all writers; frame index of next frame slot available to obtain by any writer
+    audio_utils_fifo_index&     mReservedRear;
+    // Shared by all writers; commit of the released slice starting at each frame slot
+    audio_utils_fifo_commit*    mCommits;
+
+    // Accessed by writer only using ordinary operations
+    uint32_t    mLocalRear;         // frame index of first obtained frame not yet released
+    uint32_t    mReservedEnd;       // frame index following the most recently obtained frame
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Used to read from a FIFO by more than one thread or process ("multi-consumer"),
+ * such that each frame is read by exactly one of the readers.
+ * The readers together throttle the writer(s) through the FIFO throttling front index,
+ * and they share a "reserved front" index in addition, which is the frame index of the next frame
+ * available to be obtained by any reader and must have the same initial value as the throttling
+ * front index, and an array of audio_utils_fifo_commit, one per frame slot of the FIFO.
+ *
+ * Reservation and release are the mirror image of audio_utils_fifo_multi_writer:
+ * obtain() reserves the returned slice for this reader, and release() frees the slots for the
+ * writer(s) in the order they were reserved, without waiting for the other readers.
+ * This reader must not be mixed with a throttling audio_utils_fifo_reader on the same FIFO,
+ * but any number of non-throttling audio_utils_fifo_reader can observe the same FIFO.
+ * The FIFO must have a throttling front index, and the index synchronization must not be
+ * AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED.
+ * There is no support for hysteresis or batching: each non-empty release() wakes the writer(s).
+ */
+class audio_utils_fifo_multi_reader : public audio_utils_fifo_provider {
+
+public:
+    /**
+     * Single-process and multi-process use same constructor here,
+     * but different FIFO constructors.
+     *
+     * \param fifo          Associated FIFO.  Passed by reference because it must be non-NULL.
+     * \param reservedFront Reserved front index shared by all readers of the FIFO.
+     *                      Passed by reference because it must be non-NULL.
+     * \param commits       Array of frameCount commits shared by all readers of the FIFO.
+     */
+    audio_utils_fifo_multi_reader(audio_utils_fifo& fifo, audio_utils_fifo_index& reservedFront,
+            audio_utils_fifo_commit *commits);
+
+    /**
+     * Any frames obtained but not released are returned to the FIFO if possible,
+     * or else are released.
+     */
+    virtual ~audio_utils_fifo_multi_reader();
+
+    /**
+     * Read from FIFO.  Same as audio_utils_fifo_reader::read(), without lost frames,
+     * except it may also return -EWOULDBLOCK or -EBUSY as for obtain().
+     */
+    ssize_t read(void *buffer, size_t count, const struct timespec *timeout = NULL);
+
+    /**
+     * Same as audio_utils_fifo_multi_writer::obtain(), but for reading.
+     */
+    virtual ssize_t obtain(audio_utils_iovec iovec[2], size_t count = SIZE_MAX,
+            const struct timespec *timeout = NULL);
+
+    /**
+     * Same as audio_utils_fifo_multi_writer::release(), but for reading.
+     */
+    virtual void release(size_t count);
+
+    /**
+     * Determine the number of frames that could be obtained or read without blocking,
+     * by this or by any other reader.
+     */
+    virtual ssize_t available();
+
+private:
+    /** Return the unreleased frames to the FIFO if possible. */
+    bool cancel();
+
+    // Shared by all readers; frame index of next frame available to obtain by any reader
+    audio_utils_fifo_index&     mReservedFront;
+    // Shared by all readers; commit of the released slice starting at each frame slot
+    audio_utils_fifo_commit*    mCommits;
+
+    // Accessed by reader only using ordinary operations
+    uint32_t    mLocalFront;        // frame index of first obtained frame not yet released
+    uint32_t    mReservedEnd;       // frame index following the most recently obtained frame
+};
+
 #endif  // !ANDROID_AUDIO_FIFO_H
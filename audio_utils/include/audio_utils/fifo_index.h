@@ -18,6 +18,7 @@
 #define ANDROID_AUDIO_FIFO_INDEX_H
 
 #include <atomic>
+#include <stddef.h>
 #include <stdint.h>
 #include <time.h>
 
@@ -61,6 +62,17 @@ public:
      */
     void storeRelease(uint32_t value);
 
+    /**
+     * Store new value into index if the current value is equal to the expected value,
+     * with memory order 'acquire' and 'release' on success, or 'acquire' on failure.
+     *
+     * \param expected Current/expected value of index, updated to the current value on failure.
+     * \param value    New value to store into index
+     *
+     * \return true if the new value was stored, or false if the current value was not expected.
+     */
+    bool compareExchange(uint32_t& expected, uint32_t value);
+
     // TODO op should be set in the constructor.
     /**
      * Wait for value of index to change from the specified expected value.
@@ -102,6 +114,47 @@ private:
 static_assert(sizeof(audio_utils_fifo_index) == sizeof(uint32_t),
         "audio_utils_fifo_index must be 32 bits");
 
+/**
+ * The indices of a FIFO, each in its own cache line.
+ * The writer(s) and reader(s) usually run on different cores, so an index on the same cache line
+ * as another index, or as data which is read but not written, is subject to false sharing:
+ * every store to the index invalidates the line in the cache of the other cores.
+ * May be placed in shared memory, in which case exactly one process must explicitly call the
+ * constructor via placement new, and the memory must be aligned to kCacheLineSize,
+ * as for example the memory returned by mmap().
+ */
+struct audio_utils_fifo_indices {
+    /** An upper bound of the cache line size of the supported architectures. */
+    static constexpr size_t kCacheLineSize = 64;
+
+    /** Writer's rear index. */
+    alignas(kCacheLineSize) audio_utils_fifo_index mRear;
+    /** Front index of the reader(s) that throttle the writer(s). */
+    alignas(kCacheLineSize) audio_utils_fifo_index mFront;
+    /** Reserved rear index for audio_utils_fifo_multi_writer. */
+    alignas(kCacheLineSize) audio_utils_fifo_index mReservedRear;
+    /** Reserved front index for audio_utils_fifo_multi_reader. */
+    alignas(kCacheLineSize) audio_utils_fifo_index mReservedFront;
+};
+
+static_assert(sizeof(audio_utils_fifo_indices) == 4 * audio_utils_fifo_indices::kCacheLineSize,
+        "audio_utils_fifo_indices must be one cache line per index");
+
+/**
+ * The commit of a slice released by audio_utils_fifo_multi_writer or audio_utils_fifo_multi_reader,
+ * recorded in the slot of the first frame of the slice.  The multi-producers of a FIFO share an
+ * array of one commit per frame slot, and so do the multi-consumers, so that a provider can
+ * release its slice without waiting for the providers which reserved the preceding slices.
+ * May be placed in shared memory, in which case exactly one process must explicitly call the
+ * constructor of each element via placement new.
+ */
+struct audio_utils_fifo_commit {
+    /** Frame index of the first frame of the committed slice. */
+    audio_utils_fifo_index mStart;
+    /** Frame index following the last frame of the committed slice, or mStart if none. */
+    audio_utils_fifo_index mEnd;
+};
+
 // ----------------------------------------------------------------------------
 
 #if 0   // TODO not currently used, review this code later: bug 150627616
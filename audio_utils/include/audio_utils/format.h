@@ -17,6 +17,7 @@
 #ifndef ANDROID_AUDIO_FORMAT_H
 #define ANDROID_AUDIO_FORMAT_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <sys/cdefs.h>
 #include <system/audio.h>
@@ -112,6 +113,75 @@ size_t memcpy_by_index_array_initialization_from_channel_mask(int8_t *idxary, si
 void accumulate_by_audio_format(void *dst, const void *src,
         audio_format_t format, size_t count);
 
+/** Maximum number of channels in a frame handled by an audio_format_remix_plan_t. */
+#define AUDIO_FORMAT_REMIX_MAX_CHANNELS 32
+
+/**
+ * Converts count samples from src to dst, see audio_format_remix_plan_t.
+ */
+typedef void (*audio_format_convert_t)(void *dst, const void *src, size_t count);
+
+/**
+ * A precomputed plan for converting frames between sample formats and channel masks
+ * in a single pass, see memcpy_by_audio_format_remix().
+ *
+ * The fields are private and set by audio_format_remix_plan_init(); the plan is
+ * typically initialized once per stream configuration and then used for every buffer.
+ */
+typedef struct audio_format_remix_plan {
+    audio_format_convert_t convert;  // NULL if the sample formats are the same.
+    uint32_t dst_channels;
+    uint32_t src_channels;
+    uint32_t dst_frame_size;
+    uint32_t src_frame_size;
+    uint32_t remix_sample_size;      // Sample size of the buffer the channels are remixed in.
+    uint32_t block_frames;           // Frames per block for the intermediate buffer.
+    bool remix;                      // false if channels are copied as is.
+    bool remix_first;                // true to remix in the source format before conversion.
+    int8_t idxary[AUDIO_FORMAT_REMIX_MAX_CHANNELS];
+} audio_format_remix_plan_t;
+
+/**
+ * Initializes a plan for memcpy_by_audio_format_remix().
+ *
+ *  \param plan             The plan to initialize.
+ *  \param dst_format       Destination buffer format
+ *  \param dst_channel_mask Destination channel mask
+ *  \param src_format       Source buffer format
+ *  \param src_channel_mask Source channel mask
+ *
+ * The format conversion must be allowed by memcpy_by_audio_format().
+ * The channels are matched as in memcpy_by_index_array_initialization_from_channel_mask():
+ * unmatched destination channels are filled with silence, and unmatched source channels
+ * are dropped.
+ *
+ * \return 0 on success, or -EINVAL if the formats cannot be converted, or if a channel
+ * mask is not recognized or has more than AUDIO_FORMAT_REMIX_MAX_CHANNELS channels.
+ */
+int audio_format_remix_plan_init(audio_format_remix_plan_t *plan,
+        audio_format_t dst_format, audio_channel_mask_t dst_channel_mask,
+        audio_format_t src_format, audio_channel_mask_t src_channel_mask);
+
+/**
+ * Copies frames with conversion of both the sample format and the channel mask
+ * according to a plan.
+ *
+ * This is equivalent to memcpy_by_audio_format() followed by memcpy_by_index_array()
+ * (or the reverse), but is done in a single pass over the source and destination buffers
+ * using a small intermediate buffer that stays in cache.
+ *
+ *  \param dst    Destination buffer
+ *  \param src    Source buffer
+ *  \param frames Number of frames to copy
+ *  \param plan   Plan initialized by audio_format_remix_plan_init()
+ *
+ * The destination and source buffers must be completely separate (non-overlapping),
+ * unless the plan does not remix the channels, in which case the same rules as
+ * memcpy_by_audio_format() apply.
+ */
+void memcpy_by_audio_format_remix(void *dst, const void *src, size_t frames,
+        const audio_format_remix_plan_t *plan);
+
 /** \cond */
 __END_DECLS
 /** \endcond */
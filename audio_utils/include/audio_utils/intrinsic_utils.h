@@ -18,6 +18,7 @@
 #define ANDROID_AUDIO_UTILS_INTRINSIC_UTILS_H
 
 #include <array>  // std::size
+#include <cstdint>  // INT32_MIN, INT64_MIN
 #include <type_traits>
 
 /*
@@ -37,6 +38,27 @@
 #define USE_NEON
 #endif
 
+// We conditionally include SSE/AVX optimizations for x86 devices.
+// SSE2 is part of the x86_64 baseline; AVX and AVX-512 depend on the target flags
+// (e.g. -mavx2 or -march=x86-64-v3) used for compilation.
+#pragma push_macro("USE_SSE")
+#pragma push_macro("USE_AVX")
+#pragma push_macro("USE_AVX512")
+#undef USE_SSE
+#undef USE_AVX
+#undef USE_AVX512
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define USE_SSE
+#if defined(__AVX__)
+#define USE_AVX
+#endif
+#if defined(__AVX512F__)
+#define USE_AVX512
+#endif
+#endif
+
 namespace android::audio_utils::intrinsics {
 
 // For static assert(false) we need a template version to avoid early failure.
@@ -62,12 +84,16 @@ struct internal_array_t {
   2) We use recursive calls to decompose array types, e.g. float32x4x4_t -> float32x4_t
   3) NEON double SIMD acceleration is only available on 64 bit architectures.
      On Pixel 3XL, NEON double x 2 SIMD is actually slightly slower than the FP unit.
+  4) On x86, the SSE types __m128 and __m128d, the AVX types __m256 and __m256d,
+     and the AVX-512 types __m512 and __m512d are accepted as SIMD data types
+     wherever the corresponding instruction set is enabled at compile time.
+     Loads and stores are unaligned, matching the NEON vld1/vst1 semantics.
 
   We create a generic Neon acceleration to be applied to a composite type.
 
   The type follows the following compositional rules for simplicity:
       1) must be a primitive floating point type.
-      2) must be a NEON data type.
+      2) must be a NEON or x86 SIMD data type.
       3) must be a struct with one member, either
            a) an array of types 1-3.
            b) a cons-pair struct of 2 possibly different members of types 1-3.
@@ -76,6 +102,7 @@ struct internal_array_t {
   using alternative_2_t = struct { struct { float a; float b; } s; };
   using alternative_9_t = struct { struct { float32x4x2_t a; float b; } s; };
   using alternative_15_t = struct { struct { float32x4x2_t a; struct { float v[7]; } b; } s; };
+  using alternative_x86_8_t = internal_array_t<__m128, 2>;
 */
 
 // add a + b
@@ -95,6 +122,25 @@ static inline T vadd(T a, T b) {
 #endif
 #endif // USE_NEON
 
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_add_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_add_pd(a, b);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_add_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_add_pd(a, b);
+#endif
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_add_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_add_pd(a, b);
+#endif
+#endif // USE_SSE
+
     } else /* constexpr */ {
         T ret;
         auto &[retval] = ret;  // single-member struct
@@ -134,6 +180,25 @@ static inline T vdupn(F f) {
 #endif
 #endif // USE_NEON
 
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_set1_ps(f);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_set1_pd(f);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_set1_ps(f);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_set1_pd(f);
+#endif
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_set1_ps(f);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_set1_pd(f);
+#endif
+#endif // USE_SSE
+
     } else /* constexpr */ {
         T ret;
         auto &[retval] = ret;  // single-member struct
@@ -154,6 +219,122 @@ static inline T vdupn(F f) {
     }
 }
 
+// maximum of a and b (if either is NaN, the result is unspecified)
+template<typename T>
+static inline T vmax(T a, T b) {
+    if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+        return a > b ? a : b;
+
+#ifdef USE_NEON
+    } else if constexpr (std::is_same_v<T, float32x2_t>) {
+        return vmax_f32(a, b);
+    } else if constexpr (std::is_same_v<T, float32x4_t>) {
+        return vmaxq_f32(a, b);
+#if defined(__aarch64__)
+    } else if constexpr (std::is_same_v<T, float64x2_t>) {
+        return vmaxq_f64(a, b);
+#endif
+#endif // USE_NEON
+
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_max_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_max_pd(a, b);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_max_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_max_pd(a, b);
+#endif
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_max_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_max_pd(a, b);
+#endif
+#endif // USE_SSE
+
+    } else /* constexpr */ {
+        T ret;
+        auto &[retval] = ret;  // single-member struct
+        const auto &[aval] = a;
+        const auto &[bval] = b;
+        if constexpr (std::is_array_v<decltype(retval)>) {
+#pragma unroll
+            for (size_t i = 0; i < std::size(aval); ++i) {
+                retval[i] = vmax(aval[i], bval[i]);
+            }
+            return ret;
+        } else /* constexpr */ {
+             auto &[r1, r2] = retval;
+             const auto &[a1, a2] = aval;
+             const auto &[b1, b2] = bval;
+             r1 = vmax(a1, b1);
+             r2 = vmax(a2, b2);
+             return ret;
+        }
+    }
+}
+
+// minimum of a and b (if either is NaN, the result is unspecified)
+template<typename T>
+static inline T vmin(T a, T b) {
+    if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+        return a < b ? a : b;
+
+#ifdef USE_NEON
+    } else if constexpr (std::is_same_v<T, float32x2_t>) {
+        return vmin_f32(a, b);
+    } else if constexpr (std::is_same_v<T, float32x4_t>) {
+        return vminq_f32(a, b);
+#if defined(__aarch64__)
+    } else if constexpr (std::is_same_v<T, float64x2_t>) {
+        return vminq_f64(a, b);
+#endif
+#endif // USE_NEON
+
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_min_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_min_pd(a, b);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_min_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_min_pd(a, b);
+#endif
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_min_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_min_pd(a, b);
+#endif
+#endif // USE_SSE
+
+    } else /* constexpr */ {
+        T ret;
+        auto &[retval] = ret;  // single-member struct
+        const auto &[aval] = a;
+        const auto &[bval] = b;
+        if constexpr (std::is_array_v<decltype(retval)>) {
+#pragma unroll
+            for (size_t i = 0; i < std::size(aval); ++i) {
+                retval[i] = vmin(aval[i], bval[i]);
+            }
+            return ret;
+        } else /* constexpr */ {
+             auto &[r1, r2] = retval;
+             const auto &[a1, a2] = aval;
+             const auto &[b1, b2] = bval;
+             r1 = vmin(a1, b1);
+             r2 = vmin(a2, b2);
+             return ret;
+        }
+    }
+}
+
 // load from float pointer.
 template<typename T, typename F>
 static inline T vld1(const F *f) {
@@ -171,6 +352,25 @@ static inline T vld1(const F *f) {
 #endif
 #endif // USE_NEON
 
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_loadu_ps(f);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_loadu_pd(f);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_loadu_ps(f);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_loadu_pd(f);
+#endif
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_loadu_ps(f);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_loadu_pd(f);
+#endif
+#endif // USE_SSE
+
     } else /* constexpr */ {
         T ret;
         auto &[retval] = ret;  // single-member struct
@@ -231,6 +431,26 @@ static inline T vmla(T a, T b, F c) {
 #endif
         } else
 #endif // USE_NEON
+#ifdef USE_SSE
+        // x86 has no vector by scalar multiply, broadcast the scalar.
+        if constexpr (std::is_same_v<T, __m128>) {
+            return _mm_add_ps(a, _mm_mul_ps(b, _mm_set1_ps(c)));
+        } else if constexpr (std::is_same_v<T, __m128d>) {
+            return _mm_add_pd(a, _mm_mul_pd(b, _mm_set1_pd(c)));
+#ifdef USE_AVX
+        } else if constexpr (std::is_same_v<T, __m256>) {
+            return _mm256_add_ps(a, _mm256_mul_ps(b, _mm256_set1_ps(c)));
+        } else if constexpr (std::is_same_v<T, __m256d>) {
+            return _mm256_add_pd(a, _mm256_mul_pd(b, _mm256_set1_pd(c)));
+#endif
+#ifdef USE_AVX512
+        } else if constexpr (std::is_same_v<T, __m512>) {
+            return _mm512_add_ps(a, _mm512_mul_ps(b, _mm512_set1_ps(c)));
+        } else if constexpr (std::is_same_v<T, __m512d>) {
+            return _mm512_add_pd(a, _mm512_mul_pd(b, _mm512_set1_pd(c)));
+#endif
+        } else
+#endif // USE_SSE
         {
         T ret;
         auto &[retval] = ret;  // single-member struct
@@ -279,6 +499,25 @@ static inline T vmla(T a, T b, T c) {
 #endif
 #endif // USE_NEON
 
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_add_ps(a, _mm_mul_ps(b, c));
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_add_pd(a, _mm_mul_pd(b, c));
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_add_ps(a, _mm256_mul_ps(b, c));
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_add_pd(a, _mm256_mul_pd(b, c));
+#endif
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_add_ps(a, _mm512_mul_ps(b, c));
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_add_pd(a, _mm512_mul_pd(b, c));
+#endif
+#endif // USE_SSE
+
     } else /* constexpr */ {
         T ret;
         auto &[retval] = ret;  // single-member struct
@@ -330,6 +569,26 @@ static inline auto vmul(T a, F b) {
 #endif
         } else
 #endif // USE_NEON
+#ifdef USE_SSE
+        // x86 has no vector by scalar multiply, broadcast the scalar.
+        if constexpr (std::is_same_v<T, __m128>) {
+            return _mm_mul_ps(a, _mm_set1_ps(b));
+        } else if constexpr (std::is_same_v<T, __m128d>) {
+            return _mm_mul_pd(a, _mm_set1_pd(b));
+#ifdef USE_AVX
+        } else if constexpr (std::is_same_v<T, __m256>) {
+            return _mm256_mul_ps(a, _mm256_set1_ps(b));
+        } else if constexpr (std::is_same_v<T, __m256d>) {
+            return _mm256_mul_pd(a, _mm256_set1_pd(b));
+#endif
+#ifdef USE_AVX512
+        } else if constexpr (std::is_same_v<T, __m512>) {
+            return _mm512_mul_ps(a, _mm512_set1_ps(b));
+        } else if constexpr (std::is_same_v<T, __m512d>) {
+            return _mm512_mul_pd(a, _mm512_set1_pd(b));
+#endif
+        } else
+#endif // USE_SSE
         {
         T ret;
         auto &[retval] = ret;  // single-member struct
@@ -370,6 +629,25 @@ static inline T vmul(T a, T b) {
 #endif
 #endif // USE_NEON
 
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_mul_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_mul_pd(a, b);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_mul_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_mul_pd(a, b);
+#endif
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_mul_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_mul_pd(a, b);
+#endif
+#endif // USE_SSE
+
     } else /* constexpr */ {
         T ret;
         auto &[retval] = ret;  // single-member struct
@@ -409,6 +687,27 @@ static inline T vneg(T f) {
 #endif
 #endif // USE_NEON
 
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_xor_ps(f, _mm_set1_ps(-0.f));
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_xor_pd(f, _mm_set1_pd(-0.));
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_xor_ps(f, _mm256_set1_ps(-0.f));
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_xor_pd(f, _mm256_set1_pd(-0.));
+#endif
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_castsi512_ps(_mm512_xor_si512(
+                _mm512_castps_si512(f), _mm512_set1_epi32(INT32_MIN)));
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_castsi512_pd(_mm512_xor_si512(
+                _mm512_castpd_si512(f), _mm512_set1_epi64(INT64_MIN)));
+#endif
+#endif // USE_SSE
+
     } else /* constexpr */ {
         T ret;
         auto &[retval] = ret;  // single-member struct
@@ -446,6 +745,25 @@ static inline void vst1(F *f, T a) {
 #endif
 #endif // USE_NEON
 
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_storeu_ps(f, a);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_storeu_pd(f, a);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_storeu_ps(f, a);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_storeu_pd(f, a);
+#endif
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_storeu_ps(f, a);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_storeu_pd(f, a);
+#endif
+#endif // USE_SSE
+
     } else /* constexpr */ {
         const auto &[aval] = a;
         if constexpr (std::is_array_v<decltype(aval)>) {
@@ -481,6 +799,25 @@ static inline T vsub(T a, T b) {
 #endif
 #endif // USE_NEON
 
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_sub_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_sub_pd(a, b);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_sub_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_sub_pd(a, b);
+#endif
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_sub_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_sub_pd(a, b);
+#endif
+#endif // USE_SSE
+
     } else /* constexpr */ {
         T ret;
         auto &[retval] = ret;  // single-member struct
@@ -505,6 +842,9 @@ static inline T vsub(T a, T b) {
 
 } // namespace android::audio_utils::intrinsics
 
+#pragma pop_macro("USE_AVX512")
+#pragma pop_macro("USE_AVX")
+#pragma pop_macro("USE_SSE")
 #pragma pop_macro("USE_NEON")
 
 #endif // !ANDROID_AUDIO_UTILS_INTRINSIC_UTILS_H
@@ -17,6 +17,7 @@
 #ifndef ANDROID_RESAMPLER_H
 #define ANDROID_RESAMPLER_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/time.h>
 
@@ -34,6 +35,8 @@ struct resampler_buffer {
         void*       raw;
         short*      i16;
         int8_t*     i8;
+        int32_t*    i32;
+        float*      f32;
     };
     size_t frame_count;
 };
@@ -85,6 +88,26 @@ struct resampler_itfe {
      * \return the latency introduced by the resampler in ns.
      */
     int32_t (*delay_ns)(struct resampler_itfe *resampler);
+    /**
+     * same as resample_from_provider(), with out in the sample format of the resampler,
+     * see create_resampler_format().
+     */
+    int (*resample_from_provider_format)(struct resampler_itfe *resampler,
+                    void *out,
+                    size_t *outFrameCount);
+    /**
+     * same as resample_from_input(), with in and out in the sample format of the resampler,
+     * see create_resampler_format().
+     */
+    int (*resample_from_input_format)(struct resampler_itfe *resampler,
+                    const void *in,
+                    size_t *inFrameCount,
+                    void *out,
+                    size_t *outFrameCount);
+    /**
+     * release resampler resources, called by release_resampler().
+     */
+    void (*release)(struct resampler_itfe *resampler);
 };
 
 /**
@@ -99,6 +122,36 @@ int create_resampler(uint32_t inSampleRate,
           struct resampler_buffer_provider *provider,
           struct resampler_itfe **);
 
+/**
+ * create a polyphase resampler for the given sample format, according to input parameters
+ * passed as for create_resampler().
+ *
+ * The filter bank is a Kaiser windowed sinc, precomputed for the rate pair and quality,
+ * and shared by all resamplers with the same parameters. Samples are filtered in float,
+ * so there is no intermediate conversion to 16 bits.
+ *
+ * format is an audio_format_t, one of AUDIO_FORMAT_PCM_16_BIT, AUDIO_FORMAT_PCM_32_BIT or
+ * AUDIO_FORMAT_PCM_FLOAT.
+ * This is the format of the buffers passed to resample_from_provider_format() and
+ * resample_from_input_format(), and returned by the buffer provider.
+ * resample_from_provider() and resample_from_input() are only allowed for
+ * AUDIO_FORMAT_PCM_16_BIT.
+ *
+ * delay_ns() is exact: it is the time from the next output frame to the end of the input
+ * frames consumed so far.
+ *
+ * \return 0 on success, or -EINVAL if a parameter is invalid, or if the sample rates
+ * do not have a common divisor large enough to keep the filter bank size reasonable
+ * (e.g. 11025 Hz to 192000 Hz).
+ */
+int create_resampler_format(uint32_t inSampleRate,
+          uint32_t outSampleRate,
+          uint32_t channelCount,
+          uint32_t format,
+          uint32_t quality,
+          struct resampler_buffer_provider *provider,
+          struct resampler_itfe **);
+
 /**
  * release resampler resources.
  */
@@ -20,7 +20,9 @@
 
 #include <algorithm>
 #include <math.h>
+#include <string.h>
 
+#include <audio_utils/intrinsic_utils.h>
 #include <audio_utils/power.h>
 #include <audio_utils/primitives.h>
 
@@ -29,6 +31,11 @@
 #define USE_NEON
 #endif
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define USE_SSE
+#endif
+
 namespace {
 
 constexpr inline bool isFormatSupported(audio_format_t format) {
@@ -45,6 +52,24 @@ constexpr inline bool isFormatSupported(audio_format_t format) {
     }
 }
 
+constexpr inline size_t bytesPerSample(audio_format_t format) {
+    switch (format) {
+    case AUDIO_FORMAT_PCM_8_BIT:
+        return sizeof(uint8_t);
+    case AUDIO_FORMAT_PCM_16_BIT:
+        return sizeof(int16_t);
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        return sizeof(uint8_t) * 3;
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+    case AUDIO_FORMAT_PCM_32_BIT:
+        return sizeof(int32_t);
+    case AUDIO_FORMAT_PCM_FLOAT:
+        return sizeof(float);
+    default:
+        return 0;
+    }
+}
+
 template <typename T>
 inline T getPtrPtrValueAndIncrement(const void **data)
 {
@@ -141,17 +166,174 @@ inline void energyRef(const void *amplitudes, size_t size, size_t numChannels, f
     }
 }
 
+// Returns the sample i of the buffer in float, scaled by 1 / normalizeAmplitude<FORMAT>(),
+// which is exact for all the integer formats except PCM_32_BIT.
+template <audio_format_t FORMAT>
+inline float unnormalizedAmplitude(const void *amplitudes, size_t i)
+{
+    switch (FORMAT) {
+    case AUDIO_FORMAT_PCM_8_BIT:
+        return static_cast<const uint8_t *>(amplitudes)[i] - 0x80;
+
+    case AUDIO_FORMAT_PCM_16_BIT:
+        return static_cast<const int16_t *>(amplitudes)[i];
+
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        return i32_from_p24(static_cast<const uint8_t *>(amplitudes) + 3 * i) >> 8;
+
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+    case AUDIO_FORMAT_PCM_32_BIT:
+        return static_cast<const int32_t *>(amplitudes)[i];
+
+    case AUDIO_FORMAT_PCM_FLOAT:
+        return static_cast<const float *>(amplitudes)[i];
+
+    default:
+        static_assert(isFormatSupported(FORMAT), "unsupported format");
+    }
+}
+
+// Converts count samples, a multiple of 4, with unnormalizedAmplitude().
+template <audio_format_t FORMAT>
+inline void convertUnnormalized(float *dst, const void *amplitudes, size_t count)
+{
+    if constexpr (FORMAT == AUDIO_FORMAT_PCM_24_BIT_PACKED) {
+        // Extract 4 samples from 3 little endian words, rather than byte by byte.
+        const uint8_t *bamplitudes = static_cast<const uint8_t *>(amplitudes);
+        for (size_t i = 0; i < count; i += 4) {
+            uint32_t w[3];
+            memcpy(w, bamplitudes + 3 * i, sizeof(w));
+            dst[i] = static_cast<int32_t>(w[0] << 8) >> 8;
+            dst[i + 1] = static_cast<int32_t>(w[0] >> 16 | w[1] << 16) >> 8;
+            dst[i + 2] = static_cast<int32_t>(w[1] >> 8 | w[2] << 24) >> 8;
+            dst[i + 3] = static_cast<int32_t>(w[2]) >> 8;
+        }
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            dst[i] = unnormalizedAmplitude<FORMAT>(amplitudes, i);
+        }
+    }
+}
+
+/*
+ * Accumulates the energy of interleaved channels with VECTORS float vectors of 4 lanes.
+ *
+ * The samples are consumed in blocks of VECTORS * 4 samples, which must be a multiple
+ * of numChannels, so that each lane of the accumulators always gets the same channel.
+ * The lanes are only reduced to the channels at the end, and the remaining frames,
+ * fewer than a block, are accumulated with energyRef().
+ *
+ * The integer formats are first converted in chunks to a float buffer, rather than
+ * vector by vector, so that the vector loads do not wait on the scalar stores of
+ * formats like PCM_24_BIT_PACKED which are not converted with vectors.
+ */
+template <audio_format_t FORMAT, size_t VECTORS>
+void energyInterleaved(const void *amplitudes, size_t size, size_t numChannels, float* out)
+{
+#if defined(USE_NEON)
+    using vector_t = float32x4_t;
+#elif defined(USE_SSE)
+    using vector_t = __m128;
+#else
+    using vector_t = android::audio_utils::intrinsics::internal_array_t<float, 4>;
+#endif
+    using namespace android::audio_utils::intrinsics;
+    constexpr size_t kLanes = 4;
+    constexpr size_t kBlockSize = VECTORS * kLanes;
+    constexpr size_t kChunkBlocks = std::max(size_t{1}, 256 / kBlockSize);
+    constexpr size_t kSampleSize = bytesPerSample(FORMAT);
+    LOG_ALWAYS_FATAL_IF(kBlockSize % numChannels != 0,
+            "%zu channels do not fit a block of %zu samples", numChannels, kBlockSize);
+
+    vector_t accum[VECTORS];
+    for (auto& a : accum) a = vdupn<vector_t>(0.f);
+
+    const size_t blocks = size / kBlockSize;
+    const uint8_t *bamplitudes = static_cast<const uint8_t *>(amplitudes);
+    alignas(16) float converted[kChunkBlocks * kBlockSize];
+    for (size_t block = 0; block < blocks; ) {
+        const size_t chunkBlocks = std::min(kChunkBlocks, blocks - block);
+        const float *famplitudes;
+        if constexpr (FORMAT == AUDIO_FORMAT_PCM_FLOAT) {
+            famplitudes = reinterpret_cast<const float *>(bamplitudes);
+        } else {
+            convertUnnormalized<FORMAT>(converted, bamplitudes, chunkBlocks * kBlockSize);
+            famplitudes = converted;
+        }
+        for (size_t i = 0; i < chunkBlocks; ++i) {
+            for (size_t v = 0; v < VECTORS; ++v) {
+                const vector_t amplitude = vld1<vector_t>(famplitudes);
+                accum[v] = vmla(accum[v], amplitude, amplitude);
+                famplitudes += kLanes;
+            }
+        }
+        bamplitudes += chunkBlocks * kBlockSize * kSampleSize;
+        block += chunkBlocks;
+    }
+
+    float lanes[kBlockSize];
+    for (size_t v = 0; v < VECTORS; ++v) {
+        vst1(lanes + v * kLanes, accum[v]);
+    }
+    for (size_t i = 0; i < kBlockSize; ++i) {
+        out[i % numChannels] += lanes[i] * normalizeEnergy<FORMAT>();
+    }
+
+    energyRef<FORMAT>(bamplitudes, size - blocks * kBlockSize, numChannels, out);
+}
+
 template <audio_format_t FORMAT>
 inline float energyMono(const void *amplitudes, size_t size)
 {
-    return energyMonoRef<FORMAT>(amplitudes, size);
+    float energy = 0.f;
+    energyInterleaved<FORMAT, 4 /* VECTORS */>(amplitudes, size, 1 /* numChannels */, &energy);
+    return energy;
 }
 
-// TODO: optimize with NEON
 template <audio_format_t FORMAT>
 inline void energy(const void *amplitudes, size_t size, size_t numChannels, float* out)
 {
-    energyRef<FORMAT>(amplitudes, size, numChannels, out);
+    // The vector count is the smallest multiple of lcm(numChannels, 4) / 4 which
+    // is at least 4, to hide the latency of the vector multiply-accumulate.
+    switch (numChannels) {
+    case 1:
+        out[0] += energyMono<FORMAT>(amplitudes, size);
+        break;
+    case 2:
+    case 4:
+    case 8:
+    case 16:
+        energyInterleaved<FORMAT, 4>(amplitudes, size, numChannels, out);
+        break;
+    case 3:
+    case 6:
+    case 12:
+        energyInterleaved<FORMAT, 6>(amplitudes, size, numChannels, out);
+        break;
+    case 5:
+    case 10:
+        energyInterleaved<FORMAT, 5>(amplitudes, size, numChannels, out);
+        break;
+    case 7:
+    case 14:
+        energyInterleaved<FORMAT, 7>(amplitudes, size, numChannels, out);
+        break;
+    case 9:
+        energyInterleaved<FORMAT, 9>(amplitudes, size, numChannels, out);
+        break;
+    case 11:
+        energyInterleaved<FORMAT, 11>(amplitudes, size, numChannels, out);
+        break;
+    case 13:
+        energyInterleaved<FORMAT, 13>(amplitudes, size, numChannels, out);
+        break;
+    case 15:
+        energyInterleaved<FORMAT, 15>(amplitudes, size, numChannels, out);
+        break;
+    default:
+        energyRef<FORMAT>(amplitudes, size, numChannels, out);
+        break;
+    }
 }
 
 // fast float power computation for ARM processors that support NEON.
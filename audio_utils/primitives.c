@@ -18,6 +18,264 @@
 #include <string.h>
 #include "private/private.h"
 
+/*
+ * SIMD kernels for the format converters below.
+ *
+ * Each converter is written once against a small 4 lane int32/float vector layer,
+ * implemented here for NEON (aarch64) and SSE2 (x86, with SSSE3 and SSE4.1 used if enabled).
+ * The converters process blocks of PRIMITIVES_SIMD_BLOCK samples with the vector layer
+ * and finish with the original scalar loop, so results are bit-exact with the scalar path,
+ * including rounding (ties away from zero, as roundf) and clamping.
+ *
+ * Converters which expand the sample size (e.g. i16 to float) permit in-place operation
+ * by running backwards.  Each vector block is completely loaded before it is stored,
+ * so this property is preserved with the blocks also taken from the end of the buffer.
+ *
+ * Only little endian layouts are accelerated.
+ */
+#if !HAVE_BIG_ENDIAN && (defined(__aarch64__) || defined(__SSE2__))
+#define USE_PRIMITIVES_SIMD
+#define PRIMITIVES_SIMD_BLOCK 8 /* samples per block, two vectors */
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+
+typedef float32x4_t vfloat_t;
+typedef int32x4_t vint32_t;
+
+static inline vfloat_t vfloat_load(const float *src) { return vld1q_f32(src); }
+static inline void vfloat_store(float *dst, vfloat_t v) { vst1q_f32(dst, v); }
+static inline vint32_t vint32_load(const int32_t *src) { return vld1q_s32(src); }
+static inline void vint32_store(int32_t *dst, vint32_t v) { vst1q_s32(dst, v); }
+static inline vfloat_t vfloat_dup(float f) { return vdupq_n_f32(f); }
+static inline vint32_t vint32_dup(int32_t i) { return vdupq_n_s32(i); }
+static inline vfloat_t vfloat_mul(vfloat_t a, vfloat_t b) { return vmulq_f32(a, b); }
+static inline vfloat_t vfloat_add(vfloat_t a, vfloat_t b) { return vaddq_f32(a, b); }
+/* minNum/maxNum semantics as fminf/fmaxf: a NaN argument returns the other argument. */
+static inline vfloat_t vfloat_min(vfloat_t a, vfloat_t b) { return vminnmq_f32(a, b); }
+static inline vfloat_t vfloat_max(vfloat_t a, vfloat_t b) { return vmaxnmq_f32(a, b); }
+static inline vfloat_t vfloat_from_vint32(vint32_t v) { return vcvtq_f32_s32(v); }
+static inline vint32_t vint32_add(vint32_t a, vint32_t b) { return vaddq_s32(a, b); }
+static inline vint32_t vint32_min(vint32_t a, vint32_t b) { return vminq_s32(a, b); }
+static inline vint32_t vint32_max(vint32_t a, vint32_t b) { return vmaxq_s32(a, b); }
+static inline vint32_t vint32_shl(vint32_t v, int n) { return vshlq_s32(v, vdupq_n_s32(n)); }
+static inline vint32_t vint32_sra(vint32_t v, int n) { return vshlq_s32(v, vdupq_n_s32(-n)); }
+
+/* Round to nearest, ties away from zero (as roundf), saturating to the int32 range. */
+static inline vint32_t vint32_round_from_vfloat(vfloat_t v) { return vcvtaq_s32_f32(v); }
+
+/* As vint32_round_from_vfloat(v * scale), saturating for |v| >= limit. limit * scale = 2^31 */
+static inline vint32_t vint32_round_saturate_from_vfloat(vfloat_t v, float scale, float limit) {
+    (void)limit; // the NEON conversion saturates at exactly the same point.
+    return vcvtaq_s32_f32(vmulq_f32(v, vdupq_n_f32(scale)));
+}
+
+/* Sign extends 8 int16 samples into two vectors. */
+static inline void vint32x2_load_i16(const int16_t *src, vint32_t *lo, vint32_t *hi) {
+    const int16x8_t v = vld1q_s16(src);
+    *lo = vmovl_s16(vget_low_s16(v));
+    *hi = vmovl_high_s16(v);
+}
+
+/* Stores 8 samples as int16 with saturation. */
+static inline void vint32x2_store_i16(int16_t *dst, vint32_t lo, vint32_t hi) {
+    vst1q_s16(dst, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+}
+
+/* Zero extends 8 uint8 samples into two vectors. */
+static inline void vint32x2_load_u8(const uint8_t *src, vint32_t *lo, vint32_t *hi) {
+    const uint16x8_t v = vmovl_u8(vld1_u8(src));
+    *lo = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v)));
+    *hi = vreinterpretq_s32_u32(vmovl_high_u16(v));
+}
+
+/* Stores 8 samples as uint8 with saturation. */
+static inline void vint32x2_store_u8(uint8_t *dst, vint32_t lo, vint32_t hi) {
+    vst1_u8(dst, vqmovun_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi))));
+}
+
+/* Loads 4 packed 24 bit samples, returned in the upper 24 bits (as i32_from_p24). */
+static inline vint32_t vint32_load_p24(const uint8_t *src) {
+    static const uint8_t kIdx[16] = {
+            0xff, 0, 1, 2, 0xff, 3, 4, 5, 0xff, 6, 7, 8, 0xff, 9, 10, 11 };
+    uint32_t tail;
+    memcpy(&tail, src + 8, sizeof(tail)); /* 12 bytes total, avoid reading past the end */
+    const uint8x16_t v = vcombine_u8(vld1_u8(src), vreinterpret_u8_u32(vdup_n_u32(tail)));
+    return vreinterpretq_s32_u8(vqtbl1q_u8(v, vld1q_u8(kIdx)));
+}
+
+/* Stores the lower 24 bits of 4 samples as packed 24 bit. */
+static inline void vint32_store_p24(uint8_t *dst, vint32_t v) {
+    static const uint8_t kIdx[16] = {
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 0xff, 0xff, 0xff, 0xff };
+    const uint8x16_t packed = vqtbl1q_u8(vreinterpretq_u8_s32(v), vld1q_u8(kIdx));
+    vst1_u8(dst, vget_low_u8(packed));
+    const uint32_t tail = vgetq_lane_u32(vreinterpretq_u32_u8(packed), 2);
+    memcpy(dst + 8, &tail, sizeof(tail)); /* 12 bytes total, avoid writing past the end */
+}
+
+#else /* __SSE2__ */
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+typedef __m128 vfloat_t;
+typedef __m128i vint32_t;
+
+static inline vfloat_t vfloat_load(const float *src) { return _mm_loadu_ps(src); }
+static inline void vfloat_store(float *dst, vfloat_t v) { _mm_storeu_ps(dst, v); }
+static inline vint32_t vint32_load(const int32_t *src) {
+    return _mm_loadu_si128((const __m128i *)src);
+}
+static inline void vint32_store(int32_t *dst, vint32_t v) { _mm_storeu_si128((__m128i *)dst, v); }
+static inline vfloat_t vfloat_dup(float f) { return _mm_set1_ps(f); }
+static inline vint32_t vint32_dup(int32_t i) { return _mm_set1_epi32(i); }
+static inline vfloat_t vfloat_mul(vfloat_t a, vfloat_t b) { return _mm_mul_ps(a, b); }
+static inline vfloat_t vfloat_add(vfloat_t a, vfloat_t b) { return _mm_add_ps(a, b); }
+/* minps/maxps return the second operand if either is NaN; a NaN in a returns b as fminf/fmaxf.
+ * The callers only pass NaN in a. */
+static inline vfloat_t vfloat_min(vfloat_t a, vfloat_t b) { return _mm_min_ps(a, b); }
+static inline vfloat_t vfloat_max(vfloat_t a, vfloat_t b) { return _mm_max_ps(a, b); }
+static inline vfloat_t vfloat_from_vint32(vint32_t v) { return _mm_cvtepi32_ps(v); }
+static inline vint32_t vint32_add(vint32_t a, vint32_t b) { return _mm_add_epi32(a, b); }
+static inline vint32_t vint32_min(vint32_t a, vint32_t b) {
+#if defined(__SSE4_1__)
+    return _mm_min_epi32(a, b);
+#else
+    const __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+#endif
+}
+static inline vint32_t vint32_max(vint32_t a, vint32_t b) {
+#if defined(__SSE4_1__)
+    return _mm_max_epi32(a, b);
+#else
+    const __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+#endif
+}
+static inline vint32_t vint32_shl(vint32_t v, int n) {
+    return _mm_sll_epi32(v, _mm_cvtsi32_si128(n));
+}
+static inline vint32_t vint32_sra(vint32_t v, int n) {
+    return _mm_sra_epi32(v, _mm_cvtsi32_si128(n));
+}
+
+/* Round to nearest, ties away from zero (as roundf), valid for |v| < 2^31.
+ * The conversion truncates, and the fraction (computed exactly) determines the adjustment. */
+static inline vint32_t vint32_round_from_vfloat(vfloat_t v) {
+    const __m128i truncated = _mm_cvttps_epi32(v);
+    const __m128 fraction = _mm_sub_ps(v, _mm_cvtepi32_ps(truncated));
+    const __m128 absFraction = _mm_and_ps(fraction, _mm_castsi128_ps(_mm_set1_epi32(INT32_MAX)));
+    const __m128i roundAway = _mm_castps_si128(_mm_cmpge_ps(absFraction, _mm_set1_ps(0.5f)));
+    const __m128i sign = _mm_or_si128( /* -1 or 1 */
+            _mm_srai_epi32(_mm_castps_si128(v), 31), _mm_set1_epi32(1));
+    return _mm_add_epi32(truncated, _mm_and_si128(roundAway, sign));
+}
+
+/* As vint32_round_from_vfloat(v * scale), saturating for |v| >= limit. limit * scale = 2^31 */
+static inline vint32_t vint32_round_saturate_from_vfloat(vfloat_t v, float scale, float limit) {
+    const __m128i rounded = vint32_round_from_vfloat(_mm_mul_ps(v, _mm_set1_ps(scale)));
+    const __m128i high = _mm_castps_si128(_mm_cmpge_ps(v, _mm_set1_ps(limit)));
+    const __m128i low = _mm_castps_si128(_mm_cmple_ps(v, _mm_set1_ps(-limit)));
+    const __m128i clamped = _mm_or_si128(_mm_andnot_si128(_mm_or_si128(high, low), rounded),
+            _mm_and_si128(high, _mm_set1_epi32(INT32_MAX)));
+    return _mm_or_si128(clamped, _mm_and_si128(low, _mm_set1_epi32(INT32_MIN)));
+}
+
+/* Sign extends 8 int16 samples into two vectors. */
+static inline void vint32x2_load_i16(const int16_t *src, vint32_t *lo, vint32_t *hi) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)src);
+    *lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    *hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+}
+
+/* Stores 8 samples as int16 with saturation. */
+static inline void vint32x2_store_i16(int16_t *dst, vint32_t lo, vint32_t hi) {
+    _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(lo, hi));
+}
+
+/* Zero extends 8 uint8 samples into two vectors. */
+static inline void vint32x2_load_u8(const uint8_t *src, vint32_t *lo, vint32_t *hi) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src), zero);
+    *lo = _mm_unpacklo_epi16(v, zero);
+    *hi = _mm_unpackhi_epi16(v, zero);
+}
+
+/* Stores 8 samples as uint8 with saturation. */
+static inline void vint32x2_store_u8(uint8_t *dst, vint32_t lo, vint32_t hi) {
+    const __m128i v = _mm_packs_epi32(lo, hi);
+    _mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(v, v));
+}
+
+/* Loads 4 packed 24 bit samples, returned in the upper 24 bits (as i32_from_p24). */
+static inline vint32_t vint32_load_p24(const uint8_t *src) {
+    int32_t tail;
+    memcpy(&tail, src + 8, sizeof(tail)); /* 12 bytes total, avoid reading past the end */
+    const __m128i v = _mm_unpacklo_epi64(
+            _mm_loadl_epi64((const __m128i *)src), _mm_cvtsi32_si128(tail));
+#if defined(__SSSE3__)
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11));
+#else
+    const __m128i s01 = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+    const __m128i s23 = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+    return _mm_slli_epi32(_mm_unpacklo_epi64(s01, s23), 8);
+#endif
+}
+
+/* Stores the lower 24 bits of 4 samples as packed 24 bit. */
+static inline void vint32_store_p24(uint8_t *dst, vint32_t v) {
+#if defined(__SSSE3__)
+    const __m128i packed = _mm_shuffle_epi8(v, _mm_setr_epi8(
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+#else
+    const __m128i s0 = _mm_and_si128(v, _mm_setr_epi32(0xffffff, 0, 0, 0));
+    const __m128i s1 = _mm_and_si128(v, _mm_setr_epi32(0, 0xffffff, 0, 0));
+    const __m128i s2 = _mm_and_si128(v, _mm_setr_epi32(0, 0, 0xffffff, 0));
+    const __m128i s3 = _mm_and_si128(v, _mm_setr_epi32(0, 0, 0, 0xffffff));
+    const __m128i packed = _mm_or_si128(_mm_or_si128(s0, _mm_srli_si128(s1, 1)),
+            _mm_or_si128(_mm_srli_si128(s2, 2), _mm_srli_si128(s3, 3)));
+#endif
+    _mm_storel_epi64((__m128i *)dst, packed);
+    const int32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+    memcpy(dst + 8, &tail, sizeof(tail)); /* 12 bytes total, avoid writing past the end */
+}
+
+#endif /* __SSE2__ */
+
+/* Common vector kernels matching the scalar inline functions in primitives.h. */
+
+/* clamp16_from_float, clamp24_from_float (scale is 2^15 or 2^23). */
+static inline vint32_t vint32_clamp_from_vfloat(vfloat_t v, float scale) {
+    const vfloat_t scaled = vfloat_min(vfloat_mul(v, vfloat_dup(scale)), vfloat_dup(scale - 1.f));
+    return vint32_round_from_vfloat(vfloat_max(scaled, vfloat_dup(-scale)));
+}
+
+/* clamp8_from_float */
+static inline vint32_t vint32_clamp8_from_vfloat(vfloat_t v) {
+    const vfloat_t scaled = vfloat_add(vfloat_mul(v, vfloat_dup(128.f)), vfloat_dup(128.f));
+    return vint32_round_from_vfloat(
+            vfloat_max(vfloat_min(scaled, vfloat_dup(255.f)), vfloat_dup(0.f)));
+}
+
+/* clamp24_from_q8_23 */
+static inline vint32_t vint32_clamp24_from_q8_23(vint32_t v) {
+    return vint32_max(vint32_min(v, vint32_dup(0x7fffff)), vint32_dup(-0x800000));
+}
+
+/* float_from_i32, float_from_q4_27, float_from_q8_23 etc. (scale is a power of 2). */
+static inline vfloat_t vfloat_from_vint32_scaled(vint32_t v, float scale) {
+    return vfloat_mul(vfloat_from_vint32(v), vfloat_dup(scale));
+}
+
+#endif /* USE_PRIMITIVES_SIMD */
+
 void ditherAndClamp(int32_t *out, const int32_t *sums, size_t pairs)
 {
     for (; pairs > 0; --pairs) {
@@ -29,6 +287,14 @@ void ditherAndClamp(int32_t *out, const int32_t *sums, size_t pairs)
 
 void memcpy_to_i16_from_q4_27(int16_t *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32x2_store_i16(dst, vint32_sra(vint32_load(src), 12),
+                vint32_sra(vint32_load(src + 4), 12));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = clamp16(*src++ >> 12);
     }
@@ -38,6 +304,16 @@ void memcpy_to_i16_from_u8(int16_t *dst, const uint8_t *src, size_t count)
 {
     dst += count;
     src += count;
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        dst -= PRIMITIVES_SIMD_BLOCK;
+        src -= PRIMITIVES_SIMD_BLOCK;
+        vint32_t lo, hi;
+        vint32x2_load_u8(src, &lo, &hi);
+        vint32x2_store_i16(dst, vint32_shl(vint32_add(lo, vint32_dup(-0x80)), 8),
+                vint32_shl(vint32_add(hi, vint32_dup(-0x80)), 8));
+    }
+#endif
     for (; count > 0; --count) {
         *--dst = (int16_t)(*--src - 0x80) << 8;
     }
@@ -45,6 +321,16 @@ void memcpy_to_i16_from_u8(int16_t *dst, const uint8_t *src, size_t count)
 
 void memcpy_to_u8_from_i16(uint8_t *dst, const int16_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32_t lo, hi;
+        vint32x2_load_i16(src, &lo, &hi);
+        vint32x2_store_u8(dst, vint32_add(vint32_sra(lo, 8), vint32_dup(0x80)),
+                vint32_add(vint32_sra(hi, 8), vint32_dup(0x80)));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = (*src++ >> 8) + 0x80;
     }
@@ -52,6 +338,15 @@ void memcpy_to_u8_from_i16(uint8_t *dst, const int16_t *src, size_t count)
 
 void memcpy_to_u8_from_p24(uint8_t *dst, const uint8_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        const vint32_t lo = vint32_sra(vint32_load_p24(src), 24);
+        const vint32_t hi = vint32_sra(vint32_load_p24(src + 12), 24);
+        vint32x2_store_u8(dst, vint32_add(lo, vint32_dup(0x80)), vint32_add(hi, vint32_dup(0x80)));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK * 3;
+    }
+#endif
     for (; count > 0; --count) {
 #if HAVE_BIG_ENDIAN
         *dst++ = src[0] + 0x80;
@@ -64,6 +359,14 @@ void memcpy_to_u8_from_p24(uint8_t *dst, const uint8_t *src, size_t count)
 
 void memcpy_to_u8_from_i32(uint8_t *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32x2_store_u8(dst, vint32_add(vint32_sra(vint32_load(src), 24), vint32_dup(0x80)),
+                vint32_add(vint32_sra(vint32_load(src + 4), 24), vint32_dup(0x80)));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = (*src++ >> 24) + 0x80;
     }
@@ -71,6 +374,16 @@ void memcpy_to_u8_from_i32(uint8_t *dst, const int32_t *src, size_t count)
 
 void memcpy_to_u8_from_q8_23(uint8_t *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        const vint32_t lo = vint32_clamp24_from_q8_23(vint32_load(src));
+        const vint32_t hi = vint32_clamp24_from_q8_23(vint32_load(src + 4));
+        vint32x2_store_u8(dst, vint32_add(vint32_sra(lo, 16), vint32_dup(0x80)),
+                vint32_add(vint32_sra(hi, 16), vint32_dup(0x80)));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = clamp8_from_q8_23(*src++);
     }
@@ -78,6 +391,14 @@ void memcpy_to_u8_from_q8_23(uint8_t *dst, const int32_t *src, size_t count)
 
 void memcpy_to_u8_from_float(uint8_t *dst, const float *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32x2_store_u8(dst, vint32_clamp8_from_vfloat(vfloat_load(src)),
+                vint32_clamp8_from_vfloat(vfloat_load(src + 4)));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = clamp8_from_float(*src++);
     }
@@ -85,6 +406,14 @@ void memcpy_to_u8_from_float(uint8_t *dst, const float *src, size_t count)
 
 void memcpy_to_i16_from_i32(int16_t *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32x2_store_i16(dst, vint32_sra(vint32_load(src), 16),
+                vint32_sra(vint32_load(src + 4), 16));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = *src++ >> 16;
     }
@@ -92,6 +421,14 @@ void memcpy_to_i16_from_i32(int16_t *dst, const int32_t *src, size_t count)
 
 void memcpy_to_i16_from_float(int16_t *dst, const float *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32x2_store_i16(dst, vint32_clamp_from_vfloat(vfloat_load(src), 1 << 15),
+                vint32_clamp_from_vfloat(vfloat_load(src + 4), 1 << 15));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = clamp16_from_float(*src++);
     }
@@ -99,6 +436,14 @@ void memcpy_to_i16_from_float(int16_t *dst, const float *src, size_t count)
 
 void memcpy_to_float_from_q4_27(float *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vfloat_store(dst, vfloat_from_vint32_scaled(vint32_load(src), 1. / (1 << 27)));
+        vfloat_store(dst + 4, vfloat_from_vint32_scaled(vint32_load(src + 4), 1. / (1 << 27)));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = float_from_q4_27(*src++);
     }
@@ -108,6 +453,16 @@ void memcpy_to_float_from_i16(float *dst, const int16_t *src, size_t count)
 {
     dst += count;
     src += count;
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        dst -= PRIMITIVES_SIMD_BLOCK;
+        src -= PRIMITIVES_SIMD_BLOCK;
+        vint32_t lo, hi;
+        vint32x2_load_i16(src, &lo, &hi);
+        vfloat_store(dst, vfloat_from_vint32_scaled(lo, 1. / (1 << 15)));
+        vfloat_store(dst + 4, vfloat_from_vint32_scaled(hi, 1. / (1 << 15)));
+    }
+#endif
     for (; count > 0; --count) {
         *--dst = float_from_i16(*--src);
     }
@@ -117,6 +472,18 @@ void memcpy_to_float_from_u8(float *dst, const uint8_t *src, size_t count)
 {
     dst += count;
     src += count;
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        dst -= PRIMITIVES_SIMD_BLOCK;
+        src -= PRIMITIVES_SIMD_BLOCK;
+        vint32_t lo, hi;
+        vint32x2_load_u8(src, &lo, &hi);
+        lo = vint32_add(lo, vint32_dup(-128));
+        hi = vint32_add(hi, vint32_dup(-128));
+        vfloat_store(dst, vfloat_from_vint32_scaled(lo, 1. / (1 << 7)));
+        vfloat_store(dst + 4, vfloat_from_vint32_scaled(hi, 1. / (1 << 7)));
+    }
+#endif
     for (; count > 0; --count) {
         *--dst = float_from_u8(*--src);
     }
@@ -126,6 +493,16 @@ void memcpy_to_float_from_p24(float *dst, const uint8_t *src, size_t count)
 {
     dst += count;
     src += count * 3;
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        dst -= PRIMITIVES_SIMD_BLOCK;
+        src -= PRIMITIVES_SIMD_BLOCK * 3;
+        const vint32_t lo = vint32_load_p24(src);
+        const vint32_t hi = vint32_load_p24(src + 12);
+        vfloat_store(dst, vfloat_from_vint32_scaled(lo, 1. / (1UL << 31)));
+        vfloat_store(dst + 4, vfloat_from_vint32_scaled(hi, 1. / (1UL << 31)));
+    }
+#endif
     for (; count > 0; --count) {
         src -= 3;
         *--dst = float_from_p24(src);
@@ -134,6 +511,14 @@ void memcpy_to_float_from_p24(float *dst, const uint8_t *src, size_t count)
 
 void memcpy_to_i16_from_p24(int16_t *dst, const uint8_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32x2_store_i16(dst, vint32_sra(vint32_load_p24(src), 16),
+                vint32_sra(vint32_load_p24(src + 12), 16));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK * 3;
+    }
+#endif
     for (; count > 0; --count) {
 #if HAVE_BIG_ENDIAN
         *dst++ = src[1] | (src[0] << 8);
@@ -148,6 +533,16 @@ void memcpy_to_i32_from_p24(int32_t *dst, const uint8_t *src, size_t count)
 {
     dst += count;
     src += count * 3;
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        dst -= PRIMITIVES_SIMD_BLOCK;
+        src -= PRIMITIVES_SIMD_BLOCK * 3;
+        const vint32_t lo = vint32_load_p24(src);
+        const vint32_t hi = vint32_load_p24(src + 12);
+        vint32_store(dst, lo);
+        vint32_store(dst + 4, hi);
+    }
+#endif
     for (; count > 0; --count) {
         src -= 3;
 #if HAVE_BIG_ENDIAN
@@ -162,6 +557,16 @@ void memcpy_to_p24_from_i16(uint8_t *dst, const int16_t *src, size_t count)
 {
     dst += count * 3;
     src += count;
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        dst -= PRIMITIVES_SIMD_BLOCK * 3;
+        src -= PRIMITIVES_SIMD_BLOCK;
+        vint32_t lo, hi;
+        vint32x2_load_i16(src, &lo, &hi);
+        vint32_store_p24(dst, vint32_shl(lo, 8));
+        vint32_store_p24(dst + 12, vint32_shl(hi, 8));
+    }
+#endif
     for (; count > 0; --count) {
         dst -= 3;
         const int16_t sample = *--src;
@@ -179,6 +584,14 @@ void memcpy_to_p24_from_i16(uint8_t *dst, const int16_t *src, size_t count)
 
 void memcpy_to_p24_from_float(uint8_t *dst, const float *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32_store_p24(dst, vint32_clamp_from_vfloat(vfloat_load(src), 1 << 23));
+        vint32_store_p24(dst + 12, vint32_clamp_from_vfloat(vfloat_load(src + 4), 1 << 23));
+        dst += PRIMITIVES_SIMD_BLOCK * 3;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         int32_t ival = clamp24_from_float(*src++);
 
@@ -196,6 +609,14 @@ void memcpy_to_p24_from_float(uint8_t *dst, const float *src, size_t count)
 
 void memcpy_to_p24_from_q8_23(uint8_t *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32_store_p24(dst, vint32_clamp24_from_q8_23(vint32_load(src)));
+        vint32_store_p24(dst + 12, vint32_clamp24_from_q8_23(vint32_load(src + 4)));
+        dst += PRIMITIVES_SIMD_BLOCK * 3;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         int32_t ival = clamp24_from_q8_23(*src++);
 
@@ -213,6 +634,14 @@ void memcpy_to_p24_from_q8_23(uint8_t *dst, const int32_t *src, size_t count)
 
 void memcpy_to_p24_from_i32(uint8_t *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32_store_p24(dst, vint32_sra(vint32_load(src), 8));
+        vint32_store_p24(dst + 12, vint32_sra(vint32_load(src + 4), 8));
+        dst += PRIMITIVES_SIMD_BLOCK * 3;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         int32_t ival = *src++ >> 8;
 
@@ -232,6 +661,16 @@ void memcpy_to_q8_23_from_i16(int32_t *dst, const int16_t *src, size_t count)
 {
     dst += count;
     src += count;
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        dst -= PRIMITIVES_SIMD_BLOCK;
+        src -= PRIMITIVES_SIMD_BLOCK;
+        vint32_t lo, hi;
+        vint32x2_load_i16(src, &lo, &hi);
+        vint32_store(dst, vint32_shl(lo, 8));
+        vint32_store(dst + 4, vint32_shl(hi, 8));
+    }
+#endif
     for (; count > 0; --count) {
         *--dst = (int32_t)*--src << 8;
     }
@@ -239,6 +678,14 @@ void memcpy_to_q8_23_from_i16(int32_t *dst, const int16_t *src, size_t count)
 
 void memcpy_to_q8_23_from_float_with_clamp(int32_t *dst, const float *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32_store(dst, vint32_clamp_from_vfloat(vfloat_load(src), 1 << 23));
+        vint32_store(dst + 4, vint32_clamp_from_vfloat(vfloat_load(src + 4), 1 << 23));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = clamp24_from_float(*src++);
     }
@@ -248,6 +695,16 @@ void memcpy_to_q8_23_from_p24(int32_t *dst, const uint8_t *src, size_t count)
 {
     dst += count;
     src += count * 3;
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        dst -= PRIMITIVES_SIMD_BLOCK;
+        src -= PRIMITIVES_SIMD_BLOCK * 3;
+        const vint32_t lo = vint32_load_p24(src);
+        const vint32_t hi = vint32_load_p24(src + 12);
+        vint32_store(dst, vint32_sra(lo, 8));
+        vint32_store(dst + 4, vint32_sra(hi, 8));
+    }
+#endif
     for (; count > 0; --count) {
         src -= 3;
 #if HAVE_BIG_ENDIAN
@@ -260,6 +717,15 @@ void memcpy_to_q8_23_from_p24(int32_t *dst, const uint8_t *src, size_t count)
 
 void memcpy_to_q4_27_from_float(int32_t *dst, const float *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32_store(dst, vint32_round_saturate_from_vfloat(vfloat_load(src), 1UL << 27, 16.f));
+        vint32_store(dst + 4,
+                vint32_round_saturate_from_vfloat(vfloat_load(src + 4), 1UL << 27, 16.f));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = clampq4_27_from_float(*src++);
     }
@@ -267,6 +733,14 @@ void memcpy_to_q4_27_from_float(int32_t *dst, const float *src, size_t count)
 
 void memcpy_to_i16_from_q8_23(int16_t *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32x2_store_i16(dst, vint32_sra(vint32_load(src), 8),
+                vint32_sra(vint32_load(src + 4), 8));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = clamp16(*src++ >> 8);
     }
@@ -274,6 +748,14 @@ void memcpy_to_i16_from_q8_23(int16_t *dst, const int32_t *src, size_t count)
 
 void memcpy_to_float_from_q8_23(float *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vfloat_store(dst, vfloat_from_vint32_scaled(vint32_load(src), 1. / (1 << 23)));
+        vfloat_store(dst + 4, vfloat_from_vint32_scaled(vint32_load(src + 4), 1. / (1 << 23)));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = float_from_q8_23(*src++);
     }
@@ -283,6 +765,16 @@ void memcpy_to_i32_from_u8(int32_t *dst, const uint8_t *src, size_t count)
 {
     dst += count;
     src += count;
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        dst -= PRIMITIVES_SIMD_BLOCK;
+        src -= PRIMITIVES_SIMD_BLOCK;
+        vint32_t lo, hi;
+        vint32x2_load_u8(src, &lo, &hi);
+        vint32_store(dst, vint32_shl(vint32_add(lo, vint32_dup(-0x80)), 24));
+        vint32_store(dst + 4, vint32_shl(vint32_add(hi, vint32_dup(-0x80)), 24));
+    }
+#endif
     for (; count > 0; --count) {
         *--dst = ((int32_t)(*--src) - 0x80) << 24;
     }
@@ -292,6 +784,16 @@ void memcpy_to_i32_from_i16(int32_t *dst, const int16_t *src, size_t count)
 {
     dst += count;
     src += count;
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        dst -= PRIMITIVES_SIMD_BLOCK;
+        src -= PRIMITIVES_SIMD_BLOCK;
+        vint32_t lo, hi;
+        vint32x2_load_i16(src, &lo, &hi);
+        vint32_store(dst, vint32_shl(lo, 16));
+        vint32_store(dst + 4, vint32_shl(hi, 16));
+    }
+#endif
     for (; count > 0; --count) {
         *--dst = (int32_t)*--src << 16;
     }
@@ -299,6 +801,15 @@ void memcpy_to_i32_from_i16(int32_t *dst, const int16_t *src, size_t count)
 
 void memcpy_to_i32_from_float(int32_t *dst, const float *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vint32_store(dst, vint32_round_saturate_from_vfloat(vfloat_load(src), 1UL << 31, 1.f));
+        vint32_store(dst + 4,
+                vint32_round_saturate_from_vfloat(vfloat_load(src + 4), 1UL << 31, 1.f));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = clamp32_from_float(*src++);
     }
@@ -306,6 +817,14 @@ void memcpy_to_i32_from_float(int32_t *dst, const float *src, size_t count)
 
 void memcpy_to_float_from_i32(float *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_PRIMITIVES_SIMD
+    for (; count >= PRIMITIVES_SIMD_BLOCK; count -= PRIMITIVES_SIMD_BLOCK) {
+        vfloat_store(dst, vfloat_from_vint32_scaled(vint32_load(src), 1. / (1UL << 31)));
+        vfloat_store(dst + 4, vfloat_from_vint32_scaled(vint32_load(src + 4), 1. / (1UL << 31)));
+        dst += PRIMITIVES_SIMD_BLOCK;
+        src += PRIMITIVES_SIMD_BLOCK;
+    }
+#endif
     for (; count > 0; --count) {
         *dst++ = float_from_i32(*src++);
     }
@@ -187,6 +187,35 @@ int resampler_resample_from_input(struct resampler_itfe *resampler,
     return 0;
 }
 
+static int resampler_resample_from_provider_format(struct resampler_itfe *resampler,
+                                                   void *out,
+                                                   size_t *outFrameCount)
+{
+    return resampler_resample_from_provider(resampler, (int16_t *)out, outFrameCount);
+}
+
+static int resampler_resample_from_input_format(struct resampler_itfe *resampler,
+                                                const void *in,
+                                                size_t *inFrameCount,
+                                                void *out,
+                                                size_t *outFrameCount)
+{
+    return resampler_resample_from_input(resampler, (int16_t *)in, inFrameCount,
+                                         (int16_t *)out, outFrameCount);
+}
+
+static void resampler_release(struct resampler_itfe *resampler)
+{
+    struct resampler *rsmp = (struct resampler *)resampler;
+
+    free(rsmp->in_buf);
+
+    if (rsmp->speex_resampler != NULL) {
+        speex_resampler_destroy(rsmp->speex_resampler);
+    }
+    free(rsmp);
+}
+
 int create_resampler(uint32_t inSampleRate,
                     uint32_t outSampleRate,
                     uint32_t channelCount,
@@ -227,6 +256,9 @@ int create_resampler(uint32_t inSampleRate,
     rsmp->itfe.resample_from_provider = resampler_resample_from_provider;
     rsmp->itfe.resample_from_input = resampler_resample_from_input;
     rsmp->itfe.delay_ns = resampler_delay_ns;
+    rsmp->itfe.resample_from_provider_format = resampler_resample_from_provider_format;
+    rsmp->itfe.resample_from_input_format = resampler_resample_from_input_format;
+    rsmp->itfe.release = resampler_release;
 
     rsmp->provider = provider;
     rsmp->in_sample_rate = inSampleRate;
@@ -247,19 +279,3 @@ int create_resampler(uint32_t inSampleRate,
          rsmp, &rsmp->itfe, rsmp->speex_resampler);
     return 0;
 }
-
-void release_resampler(struct resampler_itfe *resampler)
-{
-    struct resampler *rsmp = (struct resampler *)resampler;
-
-    if (rsmp == NULL) {
-        return;
-    }
-
-    free(rsmp->in_buf);
-
-    if (rsmp->speex_resampler != NULL) {
-        speex_resampler_destroy(rsmp->speex_resampler);
-    }
-    free(rsmp);
-}
@@ -0,0 +1,479 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "resampler_polyphase"
+
+#include <audio_utils/resampler.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <map>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string.h>
+#include <tuple>
+#include <vector>
+
+#include <audio_utils/intrinsic_utils.h>
+#include <audio_utils/primitives.h>
+#include <log/log.h>
+#include <system/audio.h>
+
+namespace {
+
+using namespace android::audio_utils::intrinsics;
+
+// The vector type used for the inner products, see intrinsic_utils.h
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+using vfloat_t = float32x4_t;
+#elif defined(__SSE2__)
+using vfloat_t = __m128;
+#else
+using vfloat_t = internal_array_t<float, 4>;
+#endif
+constexpr size_t kVectorWidth = 4;
+
+// Maximum number of phases of a filter bank, which is the output rate divided by the
+// greatest common divisor of the input and output rates.
+constexpr uint32_t kMaxPhases = 1024;
+
+// Number of frames converted at a time, and input frames buffered beyond the filter length.
+constexpr size_t kBlockFrames = 256;
+
+// Filter parameters for each RESAMPLER_QUALITY_* level, comparable to those of the
+// speex resampler so that the costs can be compared.
+struct QualityParams {
+    uint32_t taps;      // filter length in input frames when upsampling, a multiple of 8
+    float bandwidth;    // cutoff frequency relative to the Nyquist frequency of the lower rate
+    double beta;        // Kaiser window parameter
+};
+
+constexpr QualityParams kQualityParams[RESAMPLER_QUALITY_MAX + 1] = {
+    {  8, 0.830f,  5.0 },
+    { 16, 0.850f,  6.0 },
+    { 32, 0.882f,  6.0 },
+    { 48, 0.895f,  8.0 },
+    { 64, 0.921f,  8.0 },
+    { 80, 0.922f, 10.0 },
+    { 96, 0.940f, 10.0 },
+    { 128, 0.950f, 10.0 },
+    { 160, 0.960f, 10.0 },
+    { 192, 0.968f, 12.0 },
+    { 256, 0.975f, 12.0 },
+};
+
+// A polyphase filter bank for resampling by the rational ratio phases / step.
+struct FilterBank {
+    uint32_t phases;            // output rate / gcd
+    uint32_t step;              // input rate / gcd
+    uint32_t taps;              // coefficients per phase, a multiple of kVectorWidth
+    std::vector<float> coefs;   // phases * taps, phase major
+};
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+double bessel_i0(double x)
+{
+    double sum = 1.;
+    double term = 1.;
+    const double y = x * x / 4.;
+    for (int k = 1; term > sum * 1e-12; ++k) {
+        term *= y / ((double) k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+std::unique_ptr<FilterBank> createFilterBank(uint32_t phases, uint32_t step, uint32_t quality)
+{
+    const QualityParams& params = kQualityParams[quality];
+    auto bank = std::make_unique<FilterBank>();
+    bank->phases = phases;
+    bank->step = step;
+    // When downsampling, the cutoff is lowered to the output Nyquist frequency,
+    // so the filter is made longer by the same ratio to keep the transition band.
+    const double ratio = std::min(1., (double) phases / step);
+    bank->taps = (uint32_t) ceil(params.taps / ratio / kVectorWidth) * kVectorWidth;
+    bank->coefs.resize((size_t) phases * bank->taps);
+
+    // The output frame at input time t = i + p / phases is the inner product of
+    // phase p with the input frames i - taps / 2 + 1 ... i + taps / 2.
+    const double cutoff = params.bandwidth * ratio;  // relative to the input Nyquist frequency
+    const double halfLength = bank->taps / 2;
+    const double i0beta = bessel_i0(params.beta);
+    for (uint32_t p = 0; p < phases; ++p) {
+        float *coefs = &bank->coefs[(size_t) p * bank->taps];
+        double sum = 0.;
+        for (uint32_t k = 0; k < bank->taps; ++k) {
+            const double t = halfLength - 1 - k + (double) p / phases;
+            const double x = t / halfLength;
+            double value = 0.;
+            if (x > -1. && x < 1.) {
+                const double window = bessel_i0(params.beta * sqrt(1. - x * x)) / i0beta;
+                const double arg = M_PI * cutoff * t;
+                value = (arg == 0. ? 1. : sin(arg) / arg) * window;
+            }
+            coefs[k] = (float) value;
+            sum += value;
+        }
+        // unity gain at DC for every phase
+        for (uint32_t k = 0; k < bank->taps; ++k) {
+            coefs[k] = (float) (coefs[k] / sum);
+        }
+    }
+    return bank;
+}
+
+// Filter banks are shared by all resamplers with the same rate pair and quality.
+std::shared_ptr<const FilterBank> getFilterBank(uint32_t phases, uint32_t step, uint32_t quality)
+{
+    using Key = std::tuple<uint32_t, uint32_t, uint32_t>;
+    static std::mutex lock;
+    static std::map<Key, std::weak_ptr<const FilterBank>> banks;
+
+    const Key key{phases, step, quality};
+    std::lock_guard<std::mutex> guard(lock);
+    std::shared_ptr<const FilterBank> bank = banks[key].lock();
+    if (bank == nullptr) {
+        bank = createFilterBank(phases, step, quality);
+        banks[key] = bank;
+    }
+    return bank;
+}
+
+inline float dot(const float *a, const float *b, size_t count)
+{
+    vfloat_t acc0 = vdupn<vfloat_t>(0.f);
+    vfloat_t acc1 = acc0;
+    size_t i = 0;
+    for (; i + 2 * kVectorWidth <= count; i += 2 * kVectorWidth) {
+        acc0 = vmla(acc0, vld1<vfloat_t>(a + i), vld1<vfloat_t>(b + i));
+        acc1 = vmla(acc1, vld1<vfloat_t>(a + i + kVectorWidth),
+                vld1<vfloat_t>(b + i + kVectorWidth));
+    }
+    if (i < count) {  // count is a multiple of kVectorWidth
+        acc0 = vmla(acc0, vld1<vfloat_t>(a + i), vld1<vfloat_t>(b + i));
+    }
+    float sum[kVectorWidth];
+    vst1(sum, vadd(acc0, acc1));
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+struct PolyphaseResampler : public resampler_itfe {
+    PolyphaseResampler(std::shared_ptr<const FilterBank> bank, audio_format_t format,
+            uint32_t inSampleRate, uint32_t channelCount,
+            struct resampler_buffer_provider *provider)
+        : mBank(std::move(bank))
+        , mProvider(provider)
+        , mFormat(format)
+        , mInSampleRate(inSampleRate)
+        , mChannelCount(channelCount)
+        , mFrameSize(channelCount * audio_bytes_per_sample(format))
+        , mCapacity(mBank->taps + mBank->step / mBank->phases + kBlockFrames)
+        , mHistory(mCapacity * channelCount)
+        , mOutBuffer(format == AUDIO_FORMAT_PCM_FLOAT ? 0 : kBlockFrames * channelCount) {
+        clear();
+    }
+
+    void clear() {
+        // The input is preceded by silence, so the first output frame is at input time 0.
+        std::fill(mHistory.begin(), mHistory.end(), 0.f);
+        mFramesIn = mBank->taps / 2 - 1;
+        mInPos = 0;
+        mPhase = 0;
+    }
+
+    int32_t delayNs() const {
+        // time from the next output frame to the end of the input, in units of 1 / phases frames
+        const int64_t delay = ((int64_t) mFramesIn - (mBank->taps / 2 - 1) - (int64_t) mInPos)
+                * mBank->phases - mPhase;
+        return delay <= 0 ? 0 : (int32_t) (delay * 1000000000 / ((int64_t) mBank->phases
+                * mInSampleRate));
+    }
+
+    // Filters at most frameCount frames from the history, and returns the number of frames.
+    size_t filter(float *out, size_t frameCount) {
+        const FilterBank& bank = *mBank;
+        const uint32_t stepInt = bank.step / bank.phases;
+        const uint32_t stepFrac = bank.step % bank.phases;
+        size_t frames = 0;
+        for (; frames < frameCount && mInPos + bank.taps <= mFramesIn; ++frames) {
+            const float *coefs = &bank.coefs[(size_t) mPhase * bank.taps];
+            const float *in = &mHistory[mInPos];
+            for (uint32_t channel = 0; channel < mChannelCount; ++channel) {
+                *out++ = dot(coefs, in, bank.taps);
+                in += mCapacity;
+            }
+            mInPos += stepInt;
+            mPhase += stepFrac;
+            if (mPhase >= bank.phases) {
+                mPhase -= bank.phases;
+                ++mInPos;
+            }
+        }
+        return frames;
+    }
+
+    // Filters at most frameCount frames in the resampler format, and returns the number of frames.
+    size_t produce(void *out, size_t frameCount) {
+        if (mFormat == AUDIO_FORMAT_PCM_FLOAT) {
+            return filter((float *) out, frameCount);
+        }
+        size_t frames = 0;
+        while (frames < frameCount) {
+            const size_t filtered = filter(mOutBuffer.data(),
+                    std::min(frameCount - frames, kBlockFrames));
+            if (filtered == 0) {
+                break;
+            }
+            void *dst = (char *) out + frames * mFrameSize;
+            if (mFormat == AUDIO_FORMAT_PCM_16_BIT) {
+                memcpy_to_i16_from_float((int16_t *) dst, mOutBuffer.data(),
+                        filtered * mChannelCount);
+            } else {
+                memcpy_to_i32_from_float((int32_t *) dst, mOutBuffer.data(),
+                        filtered * mChannelCount);
+            }
+            frames += filtered;
+        }
+        return frames;
+    }
+
+    // Discards the history before the next output frame.
+    void compact() {
+        const size_t discard = std::min(mInPos, mFramesIn);
+        if (discard == 0) {
+            return;
+        }
+        for (uint32_t channel = 0; channel < mChannelCount; ++channel) {
+            float *history = &mHistory[channel * mCapacity];
+            memmove(history, history + discard, (mFramesIn - discard) * sizeof(float));
+        }
+        mFramesIn -= discard;
+        mInPos -= discard;
+    }
+
+    // Appends at most frameCount frames to the history, and returns the number of frames.
+    size_t append(const void *in, size_t frameCount) {
+        const size_t frames = std::min(frameCount, mCapacity - mFramesIn);
+        for (uint32_t channel = 0; channel < mChannelCount; ++channel) {
+            float *history = &mHistory[channel * mCapacity + mFramesIn];
+            switch (mFormat) {
+            case AUDIO_FORMAT_PCM_16_BIT: {
+                const int16_t *src = (const int16_t *) in + channel;
+                for (size_t i = 0; i < frames; ++i) {
+                    history[i] = float_from_i16(src[i * mChannelCount]);
+                }
+            } break;
+            case AUDIO_FORMAT_PCM_32_BIT: {
+                const int32_t *src = (const int32_t *) in + channel;
+                for (size_t i = 0; i < frames; ++i) {
+                    history[i] = float_from_i32(src[i * mChannelCount]);
+                }
+            } break;
+            default: {
+                const float *src = (const float *) in + channel;
+                for (size_t i = 0; i < frames; ++i) {
+                    history[i] = src[i * mChannelCount];
+                }
+            } break;
+            }
+        }
+        mFramesIn += frames;
+        return frames;
+    }
+
+    int resampleFromProvider(void *out, size_t *outFrameCount) {
+        if (mProvider == NULL) {
+            *outFrameCount = 0;
+            return -ENOSYS;
+        }
+        size_t framesWr = 0;
+        for (;;) {
+            framesWr += produce((char *) out + framesWr * mFrameSize, *outFrameCount - framesWr);
+            if (framesWr == *outFrameCount) {
+                break;
+            }
+            compact();
+            struct resampler_buffer buf;
+            buf.frame_count = mCapacity - mFramesIn;
+            mProvider->get_next_buffer(mProvider, &buf);
+            if (buf.raw == NULL || buf.frame_count == 0) {
+                break;
+            }
+            append(buf.raw, buf.frame_count);
+            mProvider->release_buffer(mProvider, &buf);
+        }
+        *outFrameCount = framesWr;
+        return 0;
+    }
+
+    int resampleFromInput(const void *in, size_t *inFrameCount,
+            void *out, size_t *outFrameCount) {
+        if (mProvider != NULL) {
+            *outFrameCount = 0;
+            return -ENOSYS;
+        }
+        size_t framesRd = 0;
+        size_t framesWr = 0;
+        for (;;) {
+            framesWr += produce((char *) out + framesWr * mFrameSize, *outFrameCount - framesWr);
+            if (framesWr == *outFrameCount || framesRd == *inFrameCount) {
+                break;
+            }
+            compact();
+            framesRd += append((const char *) in + framesRd * mFrameSize,
+                    *inFrameCount - framesRd);
+        }
+        *inFrameCount = framesRd;
+        *outFrameCount = framesWr;
+        return 0;
+    }
+
+    const std::shared_ptr<const FilterBank> mBank;
+    struct resampler_buffer_provider * const mProvider;
+    const audio_format_t mFormat;
+    const uint32_t mInSampleRate;
+    const uint32_t mChannelCount;
+    const size_t mFrameSize;
+    const size_t mCapacity;         // frames of history per channel
+    std::vector<float> mHistory;    // mChannelCount planes of mCapacity input frames
+    std::vector<float> mOutBuffer;  // output frames to convert for integer formats
+    size_t mFramesIn;               // frames in the history
+    size_t mInPos;                  // first history frame of the next output frame
+    uint32_t mPhase;                // filter phase of the next output frame
+};
+
+PolyphaseResampler *toPolyphase(struct resampler_itfe *resampler)
+{
+    return static_cast<PolyphaseResampler *>(resampler);
+}
+
+void resampler_reset(struct resampler_itfe *resampler)
+{
+    if (resampler != NULL) {
+        toPolyphase(resampler)->clear();
+    }
+}
+
+int32_t resampler_delay_ns(struct resampler_itfe *resampler)
+{
+    return toPolyphase(resampler)->delayNs();
+}
+
+int resampler_resample_from_provider_format(struct resampler_itfe *resampler,
+        void *out, size_t *outFrameCount)
+{
+    if (resampler == NULL || out == NULL || outFrameCount == NULL) {
+        return -EINVAL;
+    }
+    return toPolyphase(resampler)->resampleFromProvider(out, outFrameCount);
+}
+
+int resampler_resample_from_input_format(struct resampler_itfe *resampler,
+        const void *in, size_t *inFrameCount, void *out, size_t *outFrameCount)
+{
+    if (resampler == NULL || in == NULL || inFrameCount == NULL ||
+            out == NULL || outFrameCount == NULL) {
+        return -EINVAL;
+    }
+    return toPolyphase(resampler)->resampleFromInput(in, inFrameCount, out, outFrameCount);
+}
+
+int resampler_resample_from_provider(struct resampler_itfe *resampler,
+        int16_t *out, size_t *outFrameCount)
+{
+    if (resampler != NULL && toPolyphase(resampler)->mFormat != AUDIO_FORMAT_PCM_16_BIT) {
+        return -EINVAL;
+    }
+    return resampler_resample_from_provider_format(resampler, out, outFrameCount);
+}
+
+int resampler_resample_from_input(struct resampler_itfe *resampler,
+        int16_t *in, size_t *inFrameCount, int16_t *out, size_t *outFrameCount)
+{
+    if (resampler != NULL && toPolyphase(resampler)->mFormat != AUDIO_FORMAT_PCM_16_BIT) {
+        return -EINVAL;
+    }
+    return resampler_resample_from_input_format(resampler, in, inFrameCount, out, outFrameCount);
+}
+
+void resampler_release(struct resampler_itfe *resampler)
+{
+    delete toPolyphase(resampler);
+}
+
+} // namespace
+
+int create_resampler_format(uint32_t inSampleRate,
+                            uint32_t outSampleRate,
+                            uint32_t channelCount,
+                            uint32_t format,
+                            uint32_t quality,
+                            struct resampler_buffer_provider *provider,
+                            struct resampler_itfe **resampler)
+{
+    ALOGV("%s() In SR %u Out SR %u channels %u format %#x quality %u", __func__,
+            inSampleRate, outSampleRate, channelCount, format, quality);
+
+    if (resampler == NULL) {
+        return -EINVAL;
+    }
+    *resampler = NULL;
+
+    if (quality <= RESAMPLER_QUALITY_MIN || quality >= RESAMPLER_QUALITY_MAX
+            || inSampleRate == 0 || outSampleRate == 0
+            || channelCount == 0 || channelCount > FCC_LIMIT) {
+        return -EINVAL;
+    }
+    switch (format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+    case AUDIO_FORMAT_PCM_32_BIT:
+    case AUDIO_FORMAT_PCM_FLOAT:
+        break;
+    default:
+        return -EINVAL;
+    }
+    const uint32_t gcd = std::gcd(inSampleRate, outSampleRate);
+    const uint32_t phases = outSampleRate / gcd;
+    if (phases > kMaxPhases) {
+        ALOGW("%s: Cannot resample %u Hz to %u Hz with at most %u phases", __func__,
+                inSampleRate, outSampleRate, kMaxPhases);
+        return -EINVAL;
+    }
+
+    auto rsmp = new PolyphaseResampler(getFilterBank(phases, inSampleRate / gcd, quality),
+            (audio_format_t) format, inSampleRate, channelCount, provider);
+    rsmp->reset = resampler_reset;
+    rsmp->resample_from_provider = resampler_resample_from_provider;
+    rsmp->resample_from_input = resampler_resample_from_input;
+    rsmp->delay_ns = resampler_delay_ns;
+    rsmp->resample_from_provider_format = resampler_resample_from_provider_format;
+    rsmp->resample_from_input_format = resampler_resample_from_input_format;
+    rsmp->release = resampler_release;
+
+    *resampler = rsmp;
+    return 0;
+}
+
+void release_resampler(struct resampler_itfe *resampler)
+{
+    if (resampler != NULL) {
+        resampler->release(resampler);
+    }
+}
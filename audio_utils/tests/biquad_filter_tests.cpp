@@ -14,13 +14,16 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <array>
+#include <complex>
 #include <random>
 #include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <audio_utils/BiquadCascade.h>
 #include <audio_utils/BiquadFilter.h>
 
 using ::testing::Pointwise;
@@ -351,3 +354,250 @@ TYPED_TEST(BiquadBasicTest, Equivalence) {
 TYPED_TEST(BiquadBasicTest, CoefReductionEquivalence) {
     this->testCoefReductionEquivalence();
 }
+
+// A filter bank of streams with different channel counts and filters must be equivalent
+// to a separate BiquadFilter per stream.
+TEST(BiquadFilterBankTest, EquivalentToFilterPerStream) {
+    using D = float;
+    constexpr size_t TEST_LENGTH = 1000;  // not a multiple of the block size
+    const std::vector<size_t> channelCounts = {1, 2, 1, 1, 3, 2, 1, 2, 8, 1, 1, 2, 1, 17, 2, 1};
+
+    BiquadFilterBank<D> bank(channelCounts);
+    ASSERT_EQ(channelCounts.size(), bank.getStreamCount());
+    std::vector<std::unique_ptr<BiquadFilter<D>>> biquads;
+    std::vector<std::vector<D>> inputs, test1, test2;
+    for (size_t i = 0; i < channelCounts.size(); ++i) {
+        const auto coefs = randomFilter<D>();
+        ASSERT_TRUE(bank.setCoefficients(coefs, i));
+        biquads.emplace_back(new BiquadFilter<D>(channelCounts[i], coefs));
+        inputs.emplace_back(TEST_LENGTH * channelCounts[i]);
+        randomBuffer(inputs.back().data(), TEST_LENGTH, channelCounts[i]);
+    }
+    test1 = inputs;
+    test2 = inputs;
+    std::vector<D*> out;
+    std::vector<const D*> in;
+    for (auto& buffer : test1) {
+        out.push_back(buffer.data());
+        in.push_back(buffer.data());
+    }
+
+    // In-place filter bank, processed in two calls to check the delay state.
+    constexpr size_t SPLIT = 123;
+    bank.process(out.data(), in.data(), SPLIT);
+    for (size_t i = 0; i < out.size(); ++i) {
+        out[i] += SPLIT * channelCounts[i];
+        in[i] += SPLIT * channelCounts[i];
+    }
+    bank.process(out.data(), in.data(), TEST_LENGTH - SPLIT);
+
+    for (size_t i = 0; i < biquads.size(); ++i) {
+        biquads[i]->process(test2[i].data(), test2[i].data(), TEST_LENGTH);
+        EXPECT_THAT(test1[i], Pointwise(FloatNear(EPS), test2[i])) << "stream " << i;
+    }
+
+    // After clearing one stream, only that stream restarts.
+    constexpr size_t CLEARED = 4;
+    bank.clear(CLEARED);
+    biquads[CLEARED]->clear();
+    for (size_t i = 0; i < test1.size(); ++i) {
+        test1[i] = inputs[i];
+        test2[i] = inputs[i];
+        out[i] = test1[i].data();
+        in[i] = inputs[i].data();
+    }
+    bank.process(out.data(), in.data(), TEST_LENGTH);
+    for (size_t i = 0; i < biquads.size(); ++i) {
+        biquads[i]->process(test2[i].data(), test2[i].data(), TEST_LENGTH);
+        EXPECT_THAT(test1[i], Pointwise(FloatNear(EPS), test2[i])) << "stream " << i;
+    }
+}
+
+TEST(BiquadFilterBankTest, Stability) {
+    BiquadFilterBank<double> bank({1, 2});
+    EXPECT_TRUE(bank.setCoefficients(randomFilter<double>()));
+    EXPECT_FALSE(bank.setCoefficients(randomUnstableFilter<double>(), size_t(1)));
+    EXPECT_TRUE(bank.isStable(0));
+    EXPECT_FALSE(bank.isStable(1));
+    EXPECT_EQ(3u, bank.getLaneCount());
+    EXPECT_EQ(1u, bank.getLaneOffset(1));
+}
+
+// Returns the magnitude response of a Biquad at the normalized frequency w.
+template <typename D>
+static double magnitude(const std::array<D, kBiquadNumCoefs>& coefs, double w) {
+    const std::complex<double> z1 = std::polar(1., -w);
+    const std::complex<double> z2 = z1 * z1;
+    return std::abs((coefs[0] + coefs[1] * z1 + coefs[2] * z2)
+            / (1. + coefs[3] * z1 + coefs[4] * z2));
+}
+
+// The BiquadCascadeTest is parameterized on channel count.
+class BiquadCascadeTest : public ::testing::TestWithParam<size_t> {
+protected:
+    // A cascade must be equivalent to a chain of BiquadFilters.
+    template <typename ConstOptions>
+    static void testEquivalentToChain() {
+        using D = float;
+        const size_t channelCount = GetParam();
+        constexpr size_t SECTIONS = 6;  // more than a pass
+        constexpr size_t TEST_LENGTH = 1024;
+
+        BiquadCascade<D, ConstOptions> cascade(channelCount, SECTIONS);
+        std::vector<std::unique_ptr<BiquadFilter<D, true, ConstOptions>>> biquads;
+        for (size_t i = 0; i < SECTIONS; ++i) {
+            const auto coefs = randomFilter<D>();
+            ASSERT_TRUE(cascade.setCoefficients(i, coefs));
+            biquads.emplace_back(new BiquadFilter<D, true, ConstOptions>(channelCount, coefs));
+        }
+        ASSERT_TRUE(cascade.isStable());
+
+        std::vector<D> reference(TEST_LENGTH * channelCount);
+        randomBuffer(reference.data(), TEST_LENGTH, channelCount);
+        std::vector<D> test1(reference.size());
+        constexpr size_t SPLIT = 100;
+        cascade.process(test1.data(), reference.data(), SPLIT);
+        cascade.process(test1.data() + SPLIT * channelCount,
+                reference.data() + SPLIT * channelCount, TEST_LENGTH - SPLIT);
+
+        auto test2 = reference;
+        for (auto& biquad : biquads) {
+            biquad->process(test2.data(), test2.data(), TEST_LENGTH);
+        }
+        // The random sections may have a large gain, so the error is relative.
+        D scale = 1;
+        for (D value : test2) scale = std::max(scale, std::abs(value));
+        EXPECT_THAT(test1, Pointwise(FloatNear(EPS * scale), test2));
+    }
+};
+
+// The fused energy accumulation must be equivalent to the energy of the processed data.
+TEST_P(BiquadCascadeTest, AccumulateEnergy) {
+    using D = float;
+    const size_t channelCount = GetParam();
+    constexpr size_t SECTIONS = BiquadCascade<D>::kSectionsPerPass - 1;
+    constexpr size_t TEST_LENGTH = 1024;
+    constexpr size_t SPLIT = 100;
+
+    BiquadCascade<D> cascade(channelCount, SECTIONS);
+    BiquadCascade<D> fused(channelCount, SECTIONS);
+    for (size_t i = 0; i < SECTIONS; ++i) {
+        const auto coefs = randomFilter<D>();
+        ASSERT_TRUE(cascade.setCoefficients(i, coefs));
+        ASSERT_TRUE(fused.setCoefficients(i, coefs));
+    }
+
+    // Test float input, then int16_t input continuing with the same filter state.
+    std::vector<int16_t> input16(TEST_LENGTH * channelCount);
+    std::minstd_rand gen(channelCount);
+    std::uniform_int_distribution<int16_t> dis(INT16_MIN, INT16_MAX);
+    for (auto& sample : input16) sample = dis(gen);
+    const auto convert = [](int16_t sample) { return sample * (1.f / (1 << 15)); };
+
+    std::vector<D> input(TEST_LENGTH * channelCount);
+    randomBuffer(input.data(), TEST_LENGTH, channelCount);
+    std::vector<D> converted(input16.size());
+    std::transform(input16.begin(), input16.end(), converted.begin(), convert);
+    std::vector<D> output(2 * input.size());
+    cascade.process(output.data(), input.data(), TEST_LENGTH);
+    cascade.process(output.data() + input.size(), converted.data(), TEST_LENGTH);
+
+    std::vector<D> energy(channelCount);
+    fused.accumulateEnergy(energy.data(), input.data(), SPLIT);
+    fused.accumulateEnergy(energy.data(), input.data() + SPLIT * channelCount,
+            TEST_LENGTH - SPLIT);
+    fused.accumulateEnergy(energy.data(), input16.data(), TEST_LENGTH, convert);
+
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+        double expected = 0;
+        for (size_t i = channel; i < output.size(); i += channelCount) {
+            expected += output[i] * output[i];
+        }
+        EXPECT_NEAR(expected, energy[channel], expected * 1e-4) << "channel " << channel;
+    }
+}
+
+TEST_P(BiquadCascadeTest, EquivalentToChainSS) {
+    testEquivalentToChain<StateSpaceOptions>();
+}
+
+TEST_P(BiquadCascadeTest, EquivalentToChainDT2) {
+    testEquivalentToChain<Direct2TransposeOptions>();
+}
+
+INSTANTIATE_TEST_CASE_P(
+        CstrAndRunBiquadCascade,
+        BiquadCascadeTest,
+        ::testing::Values(1, 2, 3, 4, 5, 8, 13));
+
+TEST(BiquadCascadeBasicTest, Design) {
+    constexpr double SAMPLE_RATE = 48000.;
+    constexpr double FREQUENCY = 1000.;
+    constexpr double GAIN_DB = 6.;
+    const double w = 2. * M_PI * FREQUENCY / SAMPLE_RATE;
+    const double gain = pow(10., GAIN_DB / 20.);
+
+    const auto lowPass = designBiquad<double>(
+            BiquadType::LOW_PASS, FREQUENCY, SAMPLE_RATE, M_SQRT1_2);
+    EXPECT_NEAR(1., magnitude(lowPass, 0.), 1e-9);
+    EXPECT_NEAR(M_SQRT1_2, magnitude(lowPass, w), 1e-9);
+    EXPECT_NEAR(0., magnitude(lowPass, M_PI), 1e-9);
+
+    const auto highPass = designBiquad<double>(
+            BiquadType::HIGH_PASS, FREQUENCY, SAMPLE_RATE, M_SQRT1_2);
+    EXPECT_NEAR(0., magnitude(highPass, 0.), 1e-9);
+    EXPECT_NEAR(M_SQRT1_2, magnitude(highPass, w), 1e-9);
+    EXPECT_NEAR(1., magnitude(highPass, M_PI), 1e-9);
+
+    const auto peaking = designBiquad<double>(
+            BiquadType::PEAKING, FREQUENCY, SAMPLE_RATE, 2., GAIN_DB);
+    EXPECT_NEAR(1., magnitude(peaking, 0.), 1e-9);
+    EXPECT_NEAR(gain, magnitude(peaking, w), 1e-9);
+
+    const auto lowShelf = designBiquad<double>(
+            BiquadType::LOW_SHELF, FREQUENCY, SAMPLE_RATE, 1., GAIN_DB);
+    EXPECT_NEAR(gain, magnitude(lowShelf, 0.), 1e-9);
+    EXPECT_NEAR(sqrt(gain), magnitude(lowShelf, w), 1e-9);
+    EXPECT_NEAR(1., magnitude(lowShelf, M_PI), 1e-3);
+
+    const auto highShelf = designBiquad<double>(
+            BiquadType::HIGH_SHELF, FREQUENCY, SAMPLE_RATE, 1., GAIN_DB);
+    EXPECT_NEAR(1., magnitude(highShelf, 0.), 1e-9);
+    EXPECT_NEAR(sqrt(gain), magnitude(highShelf, w), 1e-9);
+    EXPECT_NEAR(gain, magnitude(highShelf, M_PI), 1e-9);
+
+    for (const auto& coefs : {lowPass, highPass, peaking, lowShelf, highShelf}) {
+        EXPECT_TRUE(BiquadFilter<double>(1, coefs).isStable());
+    }
+}
+
+// Interpolated coefficients must reach the target, and remain stable in between.
+TEST(BiquadCascadeBasicTest, Ramp) {
+    using D = float;
+    constexpr double SAMPLE_RATE = 48000.;
+    constexpr size_t RAMP_FRAMES = 1000;
+    BiquadCascade<D> cascade(1 /* channelCount */, 2 /* sectionCount */);
+    cascade.setCoefficients(0, designBiquad(BiquadType::LOW_PASS, 200., SAMPLE_RATE, 0.5));
+    cascade.setCoefficients(1, designBiquad(BiquadType::PEAKING, 5000., SAMPLE_RATE, 1., -12.));
+    EXPECT_FALSE(cascade.isRamping());
+
+    const auto target0 = designBiquad(BiquadType::HIGH_PASS, 10000., SAMPLE_RATE, 4.);
+    const auto target1 = designBiquad(BiquadType::PEAKING, 100., SAMPLE_RATE, 1., 12.);
+    ASSERT_TRUE(cascade.setCoefficientsRamped(0, target0, RAMP_FRAMES));
+    ASSERT_TRUE(cascade.setCoefficientsRamped(1, target1, RAMP_FRAMES / 2));
+    EXPECT_TRUE(cascade.isRamping());
+
+    std::vector<D> data(1);
+    size_t frames = 0;
+    for (; cascade.isRamping(); ++frames) {
+        for (size_t i = 0; i < 2; ++i) {
+            const auto coefs = cascade.getCoefficients(i);
+            ASSERT_TRUE(details::isStable(coefs[3], coefs[4])) << "frame " << frames;
+        }
+        cascade.process(data.data(), data.data(), 1);
+        ASSERT_LE(frames, RAMP_FRAMES + BiquadCascade<D>::kRampStepFrames);
+    }
+    EXPECT_GE(frames, RAMP_FRAMES);
+    EXPECT_EQ(target0, cascade.getCoefficients(0));
+    EXPECT_EQ(target1, cascade.getCoefficients(1));
+}
@@ -24,6 +24,10 @@ static constexpr audio_channel_mask_t kOutputChannelMasks[] = {
     AUDIO_CHANNEL_OUT_5POINT1, // AUDIO_CHANNEL_OUT_5POINT1_BACK
     AUDIO_CHANNEL_OUT_7POINT1,
     AUDIO_CHANNEL_OUT_7POINT1POINT4,
+    // The following are handled by RuntimeChannelMix.
+    AUDIO_CHANNEL_OUT_QUAD,
+    AUDIO_CHANNEL_OUT_5POINT1POINT2,
+    AUDIO_CHANNEL_OUT_9POINT1POINT6,
 };
 
 static constexpr audio_channel_mask_t kInputChannelMasks[] = {
@@ -359,3 +363,85 @@ TEST(channelmix, input_channel_mask) {
     ASSERT_TRUE(channelMix.setInputChannelMask(AUDIO_CHANNEL_OUT_STEREO));
     ASSERT_EQ(AUDIO_CHANNEL_OUT_STEREO, channelMix.getInputChannelMask());
 }
+
+// RuntimeChannelMix folds channels the same way as the ChannelMix specializations
+// for these inputs, so the output must match.
+template <audio_channel_mask_t OUTPUT_CHANNEL_MASK>
+static void testRuntimeMatchesSpecialization(audio_channel_mask_t inputChannelMask) {
+    using namespace ::android::audio_utils::channels;
+    constexpr size_t frames = 37;
+    const size_t inChannels = audio_channel_count_from_out_mask(inputChannelMask);
+    const size_t outChannels = audio_channel_count_from_out_mask(OUTPUT_CHANNEL_MASK);
+    std::vector<float> input(frames * inChannels);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = (float)((i * 7) % 23) / 23.f - 0.5f;
+    }
+
+    ChannelMix<OUTPUT_CHANNEL_MASK> channelMix(inputChannelMask);
+    RuntimeChannelMix runtimeChannelMix(OUTPUT_CHANNEL_MASK, inputChannelMask);
+    ASSERT_EQ(inputChannelMask, runtimeChannelMix.getInputChannelMask());
+
+    for (bool accumulate : {false, true}) {
+        std::vector<float> expected(frames * outChannels, 0.25f);
+        std::vector<float> output(frames * outChannels, 0.25f);
+        ASSERT_TRUE(channelMix.process(input.data(), expected.data(), frames, accumulate));
+        ASSERT_TRUE(runtimeChannelMix.process(input.data(), output.data(), frames, accumulate));
+        for (size_t i = 0; i < output.size(); ++i) {
+            EXPECT_NEAR(expected[i], output[i], 1e-6f)
+                    << audio_channel_out_mask_to_string(OUTPUT_CHANNEL_MASK) << " from "
+                    << audio_channel_out_mask_to_string(inputChannelMask)
+                    << " sample " << i << " accumulate " << accumulate;
+        }
+    }
+}
+
+TEST(channelmix, runtime_matches_specialization) {
+    for (const audio_channel_mask_t inputChannelMask : {
+            AUDIO_CHANNEL_OUT_STEREO,
+            AUDIO_CHANNEL_OUT_2POINT1,
+            AUDIO_CHANNEL_OUT_QUAD,
+            AUDIO_CHANNEL_OUT_QUAD_SIDE,
+            AUDIO_CHANNEL_OUT_SURROUND,
+            AUDIO_CHANNEL_OUT_PENTA,
+            AUDIO_CHANNEL_OUT_5POINT1,
+            AUDIO_CHANNEL_OUT_5POINT1_SIDE,
+            AUDIO_CHANNEL_OUT_6POINT1,
+            AUDIO_CHANNEL_OUT_7POINT1,
+            }) {
+        testRuntimeMatchesSpecialization<AUDIO_CHANNEL_OUT_STEREO>(inputChannelMask);
+        testRuntimeMatchesSpecialization<AUDIO_CHANNEL_OUT_5POINT1>(inputChannelMask);
+        testRuntimeMatchesSpecialization<AUDIO_CHANNEL_OUT_7POINT1>(inputChannelMask);
+        testRuntimeMatchesSpecialization<AUDIO_CHANNEL_OUT_7POINT1POINT4>(inputChannelMask);
+    }
+}
+
+TEST(channelmix, runtime_matrix) {
+    using namespace ::android::audio_utils::channels;
+    // 5.1 to quad: the center is split to the front, the LFE to the front at half amplitude.
+    constexpr size_t kOutChannels = 4;
+    float matrix[6][kOutChannels];
+    ASSERT_TRUE(fillRuntimeChannelMatrix(AUDIO_CHANNEL_OUT_QUAD, AUDIO_CHANNEL_OUT_5POINT1,
+            &matrix[0][0], kOutChannels));
+    constexpr float kExpected[6][kOutChannels] = {
+        // FL      FR         BL   BR
+        {1.f,       0.f,       0.f, 0.f},  // FL
+        {0.f,       1.f,       0.f, 0.f},  // FR
+        {M_SQRT1_2, M_SQRT1_2, 0.f, 0.f},  // FC
+        {0.5f,      0.5f,      0.f, 0.f},  // LFE
+        {0.f,       0.f,       1.f, 0.f},  // BL
+        {0.f,       0.f,       0.f, 1.f},  // BR
+    };
+    for (size_t i = 0; i < 6; ++i) {
+        for (size_t j = 0; j < kOutChannels; ++j) {
+            EXPECT_FLOAT_EQ(kExpected[i][j], matrix[i][j]) << "row " << i << " column " << j;
+        }
+    }
+
+    // Outputs must contain the front left and right.
+    EXPECT_FALSE(RuntimeChannelMix::isOutputChannelMaskSupported(AUDIO_CHANNEL_OUT_MONO));
+    EXPECT_FALSE(RuntimeChannelMix::isOutputChannelMaskSupported(
+            audio_channel_mask_for_index_assignment_from_count(2)));
+    EXPECT_TRUE(RuntimeChannelMix::isOutputChannelMaskSupported(AUDIO_CHANNEL_OUT_9POINT1POINT6));
+    EXPECT_FALSE(fillRuntimeChannelMatrix(AUDIO_CHANNEL_OUT_MONO, AUDIO_CHANNEL_OUT_5POINT1,
+            &matrix[0][0], kOutChannels));
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_echo_reference_tests"
+#include <log/log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <math.h>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <audio_utils/echo_reference.h>
+#include <gtest/gtest.h>
+
+static constexpr uint32_t kSampleRate = 48000;
+static constexpr size_t kPeriodFrames = 480;  // 10 ms
+static constexpr int64_t kPeriodNs = 10000000;
+
+static struct timespec toTimespec(int64_t ns) {
+    return {(time_t)(ns / 1000000000), (long)(ns % 1000000000)};
+}
+
+// Returns a stereo ramp, where frame n has value n + 1 on both channels, so that a mono
+// reference of frame n has the value n + 1, and silence has the value 0.
+static std::vector<float> generateRamp(size_t first, size_t frames) {
+    std::vector<float> ramp(frames * 2);
+    for (size_t i = 0; i < frames; ++i) {
+        ramp[i * 2] = ramp[i * 2 + 1] = first + i + 1;
+    }
+    return ramp;
+}
+
+TEST(echo_reference, invalid_arguments) {
+    struct echo_reference_itfe *er;
+    EXPECT_EQ(-EINVAL, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 1, kSampleRate,
+            AUDIO_FORMAT_PCM_16_BIT, 2, kSampleRate, NULL));
+    EXPECT_EQ(-EINVAL, create_echo_reference(AUDIO_FORMAT_PCM_8_BIT, 1, kSampleRate,
+            AUDIO_FORMAT_PCM_16_BIT, 2, kSampleRate, &er));
+    EXPECT_EQ(-EINVAL, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 1, kSampleRate,
+            AUDIO_FORMAT_MP3, 2, kSampleRate, &er));
+    EXPECT_EQ(-EINVAL, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 0, kSampleRate,
+            AUDIO_FORMAT_PCM_16_BIT, 2, kSampleRate, &er));
+    EXPECT_EQ(-EINVAL, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 4, kSampleRate,
+            AUDIO_FORMAT_PCM_16_BIT, 2, kSampleRate, &er));
+    EXPECT_EQ(-EINVAL, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 1, 0,
+            AUDIO_FORMAT_PCM_16_BIT, 2, kSampleRate, &er));
+    EXPECT_EQ(nullptr, er);
+    release_echo_reference(nullptr);
+}
+
+class EchoReferenceJitterTest : public ::testing::TestWithParam<int64_t> {};
+
+// Simulates a playback and a capture stream with periodic, jittered, time stamps,
+// and verifies that the reference is aligned with the capture.
+TEST_P(EchoReferenceJitterTest, alignment) {
+    const int64_t jitterNs = GetParam();
+    constexpr int32_t kPlaybackDelayNs = 30000000;
+    constexpr int32_t kCaptureDelayNs = 5000000;
+    constexpr int64_t kCaptureOffsetNs = 3000000;  // capture time after playback time
+    constexpr size_t kPeriods = 100;
+    constexpr size_t kWarmupPeriods = 20;
+    // The reference is only realigned on deviations above 750 us, plus the jitter.
+    const int64_t toleranceFrames = (750000 + jitterNs) * kSampleRate / 1000000000 + 1;
+
+    struct echo_reference_itfe *er;
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_FLOAT, 1, kSampleRate,
+            AUDIO_FORMAT_PCM_FLOAT, 2, kSampleRate, &er));
+
+    std::minstd_rand gen(42);
+    std::uniform_int_distribution<int64_t> jitter(-jitterNs, jitterNs);
+    std::vector<float> out(kPeriodFrames);
+    for (size_t period = 0; period < kPeriods; ++period) {
+        // Frame n of the playback is played at n / rate + kPlaybackDelayNs.
+        std::vector<float> ramp = generateRamp(period * kPeriodFrames, kPeriodFrames);
+        struct echo_reference_buffer wr = {ramp.data(), kPeriodFrames, kPlaybackDelayNs,
+                toTimespec(period * kPeriodNs + kPeriodNs + jitter(gen))};
+        ASSERT_EQ(0, er->write(er, &wr));
+
+        const int64_t captureNs = period * kPeriodNs + kPeriodNs + kCaptureOffsetNs;
+        struct echo_reference_buffer rd = {out.data(), kPeriodFrames, kCaptureDelayNs,
+                toTimespec(captureNs + jitter(gen))};
+        ASSERT_EQ(0, er->read(er, &rd));
+        EXPECT_EQ(0, rd.delay_ns);
+        if (period < kWarmupPeriods) continue;
+
+        // The first frame read was captured at captureNs - kCaptureDelayNs.
+        const int64_t expectedFrame =
+                (captureNs - kCaptureDelayNs - kPlaybackDelayNs) * kSampleRate / 1000000000;
+        const int64_t actualFrame = (int64_t)out[0] - 1;
+        EXPECT_NEAR(expectedFrame, actualFrame, toleranceFrames) << "period " << period;
+        for (size_t i = 1; i < kPeriodFrames; ++i) {
+            ASSERT_EQ(out[i - 1] + 1, out[i]) << "period " << period << " frame " << i;
+        }
+    }
+    release_echo_reference(er);
+}
+
+INSTANTIATE_TEST_SUITE_P(EchoReferenceTestAll, EchoReferenceJitterTest,
+        ::testing::Values(0, 250000 /* ns */));
+
+// Verifies conversion of the format, channel count and sample rate.
+TEST(echo_reference, conversion) {
+    constexpr uint32_t kWrSampleRate = 44100;
+    constexpr uint32_t kRdSampleRate = 16000;
+    constexpr size_t kWrFrames = 441;
+    constexpr size_t kRdFrames = 160;
+    constexpr float kValue = 0.25f;
+    struct echo_reference_itfe *er;
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 1, kRdSampleRate,
+            AUDIO_FORMAT_PCM_32_BIT, 4, kWrSampleRate, &er));
+
+    std::vector<int32_t> in(kWrFrames * 4, kValue * (1LL << 31));
+    std::vector<int16_t> out(kRdFrames);
+    for (size_t period = 0; period < 50; ++period) {
+        struct echo_reference_buffer wr = {in.data(), kWrFrames, 0,
+                toTimespec(period * kPeriodNs + kPeriodNs)};
+        ASSERT_EQ(0, er->write(er, &wr));
+        // no capture time stamp, so the reference is not realigned.
+        struct echo_reference_buffer rd = {out.data(), kRdFrames, 0, {}};
+        ASSERT_EQ(0, er->read(er, &rd));
+    }
+    for (int16_t sample : out) {
+        EXPECT_NEAR(kValue * (1 << 15), sample, 8);
+    }
+    release_echo_reference(er);
+}
+
+// Runs write() and read() on separate threads, and reports the time spent in write(),
+// which must not wait for read().
+TEST(echo_reference, latency) {
+    constexpr size_t kPeriods = 500;
+    struct echo_reference_itfe *er;
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_FLOAT, 1, kSampleRate,
+            AUDIO_FORMAT_PCM_FLOAT, 2, kSampleRate, &er));
+
+    // Start reading first, as writes are discarded until then.
+    std::vector<float> out(kPeriodFrames);
+    struct echo_reference_buffer rd = {out.data(), kPeriodFrames, 0, {}};
+    ASSERT_EQ(0, er->read(er, &rd));
+
+    std::atomic_bool writerDone{};
+    std::vector<int64_t> writeNs(kPeriods);
+    std::thread writer([&] {
+        for (size_t period = 0; period < kPeriods; ++period) {
+            std::vector<float> ramp = generateRamp(period * kPeriodFrames, kPeriodFrames);
+            struct echo_reference_buffer wr = {ramp.data(), kPeriodFrames, 0,
+                    toTimespec(period * kPeriodNs + kPeriodNs)};
+            const auto start = std::chrono::steady_clock::now();
+            er->write(er, &wr);
+            writeNs[period] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        writerDone = true;
+    });
+
+    // The reference must be the continuous ramp, with silence when read() is early.
+    float last = 0;
+    size_t framesRead = 0;
+    while (!writerDone || framesRead < kPeriods * kPeriodFrames) {
+        ASSERT_EQ(0, er->read(er, &rd));
+        for (float sample : out) {
+            if (sample == 0) continue;
+            ASSERT_EQ(last + 1, sample);
+            last = sample;
+            ++framesRead;
+        }
+        if (writerDone && std::all_of(out.begin(), out.end(), [](float f) { return f == 0; })) {
+            break;
+        }
+    }
+    writer.join();
+    EXPECT_EQ(kPeriods * kPeriodFrames, framesRead);
+
+    int64_t maxNs = 0;
+    int64_t sumNs = 0;
+    for (int64_t ns : writeNs) {
+        maxNs = std::max(maxNs, ns);
+        sumNs += ns;
+    }
+    printf("write() of %zu frames: mean %lld ns, max %lld ns\n",
+            kPeriodFrames, (long long)(sumNs / kPeriods), (long long)maxNs);
+    release_echo_reference(er);
+}
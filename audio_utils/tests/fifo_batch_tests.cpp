@@ -0,0 +1,145 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests of the batches of audio_utils_fifo_writer and audio_utils_fifo_reader.
+
+#include <chrono>
+#include <limits.h>
+#include <thread>
+#include <vector>
+
+#include <audio_utils/fifo.h>
+#include <gtest/gtest.h>
+
+static constexpr uint32_t kFrameCount = 16;
+
+class FifoBatchTest : public ::testing::Test {
+protected:
+    void writeFrames(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(1, mWriter.write(&mNextFrame, 1));
+            ++mNextFrame;
+        }
+    }
+
+    void readFrames(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t frame;
+            ASSERT_EQ(1, mReader.read(&frame, 1));
+        }
+    }
+
+    uint32_t mBuffer[kFrameCount];
+    audio_utils_fifo_index mRear;
+    audio_utils_fifo_index mFront;
+    audio_utils_fifo mFifo{kFrameCount, sizeof(mBuffer[0]), mBuffer, mRear, &mFront};
+    audio_utils_fifo_writer mWriter{mFifo};
+    audio_utils_fifo_reader mReader{mFifo, true /*throttlesWriter*/};
+    uint32_t mNextFrame = 0;
+};
+
+TEST_F(FifoBatchTest, WriterBatchVisibleAtEnd) {
+    mWriter.beginBatch();
+    ASSERT_NO_FATAL_FAILURE(writeFrames(3));
+    EXPECT_EQ(0, mReader.available());
+    mWriter.endBatch();
+    EXPECT_EQ(3, mReader.available());
+}
+
+TEST_F(FifoBatchTest, ReaderBatchVisibleAtEnd) {
+    ASSERT_NO_FATAL_FAILURE(writeFrames(4));
+    mReader.beginBatch();
+    ASSERT_NO_FATAL_FAILURE(readFrames(4));
+    EXPECT_EQ((ssize_t) kFrameCount - 4, mWriter.available());
+    mReader.endBatch();
+    EXPECT_EQ((ssize_t) kFrameCount, mWriter.available());
+}
+
+// The reader blocked on an empty FIFO is woken once by each batch, with all of its frames.
+TEST_F(FifoBatchTest, WakeOncePerBatch) {
+    constexpr size_t kBatches = 3;
+    constexpr size_t kBatchFrames = 4;
+    std::vector<ssize_t> reads;
+    std::thread reader([&] {
+        const struct timespec forever = {LONG_MAX, 0};
+        uint32_t frames[kFrameCount];
+        for (size_t total = 0; total < kBatches * kBatchFrames; ) {
+            const ssize_t read = mReader.read(frames, kFrameCount, &forever);
+            ASSERT_GT(read, 0);
+            reads.push_back(read);
+            total += read;
+        }
+    });
+
+    for (size_t i = 0; i < kBatches; ++i) {
+        // give the reader time to block
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        mWriter.beginBatch();
+        for (size_t j = 0; j < kBatchFrames; ++j) {
+            // time for the reader to wake, had a frame been published
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            ASSERT_NO_FATAL_FAILURE(writeFrames(1));
+        }
+        mWriter.endBatch();
+        // the next batch must not be published before the reader is done with this one
+        while (mWriter.available() < (ssize_t) kFrameCount) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    reader.join();
+    EXPECT_EQ(std::vector<ssize_t>(kBatches, kBatchFrames), reads);
+}
+
+TEST_F(FifoBatchTest, NestedAndUnbalancedBatches) {
+    // outside of a batch, endBatch() has no effect
+    mWriter.endBatch();
+    ASSERT_NO_FATAL_FAILURE(writeFrames(1));
+    EXPECT_EQ(1, mReader.available());
+    mWriter.endBatch();
+    EXPECT_EQ(1, mReader.available());
+
+    // batches do not nest: the first endBatch() ends the batch
+    mWriter.beginBatch();
+    mWriter.beginBatch();
+    ASSERT_NO_FATAL_FAILURE(writeFrames(2));
+    EXPECT_EQ(1, mReader.available());
+    mWriter.endBatch();
+    EXPECT_EQ(3, mReader.available());
+    ASSERT_NO_FATAL_FAILURE(writeFrames(1));
+    EXPECT_EQ(4, mReader.available());
+    mWriter.endBatch();
+    EXPECT_EQ(4, mReader.available());
+
+    mReader.beginBatch();
+    mReader.beginBatch();
+    ASSERT_NO_FATAL_FAILURE(readFrames(2));
+    EXPECT_EQ((ssize_t) kFrameCount - 4, mWriter.available());
+    mReader.endBatch();
+    EXPECT_EQ((ssize_t) kFrameCount - 2, mWriter.available());
+    mReader.endBatch();
+    EXPECT_EQ((ssize_t) kFrameCount - 2, mWriter.available());
+}
+
+TEST_F(FifoBatchTest, DestructorEndsBatch) {
+    {
+        audio_utils_fifo_writer writer(mFifo);
+        writer.beginBatch();
+        uint32_t frame = 0;
+        ASSERT_EQ(1, writer.write(&frame, 1));
+        EXPECT_EQ(0, mReader.available());
+    }
+    EXPECT_EQ(1, mReader.available());
+}
@@ -30,6 +30,12 @@
 #define FRAME_COUNT 2048
 #define FRAME_SIZE sizeof(int16_t)
 #define BUFFER_SIZE (FRAME_COUNT * FRAME_SIZE)
+#define COMMITS_SIZE (FRAME_COUNT * sizeof(audio_utils_fifo_commit))
+
+// Each writer process is an audio_utils_fifo_multi_writer, and writes the values
+// (writer * WRITER_VALUES + 1) to (writer + 1) * WRITER_VALUES.
+#define WRITERS 2
+#define WRITER_VALUES 20
 
 int main(int argc __attribute__((unused)), char **argv __attribute__((unused)))
 {
@@ -41,10 +47,16 @@ int main(int argc __attribute__((unused)), char **argv __attribute__((unused)))
     const int rearFd = ashmem_create_region("rear", sizeof(audio_utils_fifo_index));
     printf("rearFd=%d\n", rearFd);
 
+    const int reservedRearFd = ashmem_create_region("reservedRear", sizeof(audio_utils_fifo_index));
+    printf("reservedRearFd=%d\n", reservedRearFd);
+
+    const int commitsFd = ashmem_create_region("commits", COMMITS_SIZE);
+    printf("commitsFd=%d\n", commitsFd);
+
     const int dataFd = ashmem_create_region("buffer", BUFFER_SIZE);
     printf("dataFd=%d\n", dataFd);
 
-    // next two index constructors must execute exactly once, so we do it in the parent
+    // next index and commit constructors must execute exactly once, so we do it in the parent
 
     audio_utils_fifo_index *frontIndex = (audio_utils_fifo_index *) mmap(NULL,
             sizeof(audio_utils_fifo_index), PROT_READ | PROT_WRITE, MAP_SHARED, frontFd, (off_t) 0);
@@ -56,6 +68,17 @@ int main(int argc __attribute__((unused)), char **argv __attribute__((unused)))
     printf("parent rearIndex=%p\n", rearIndex);
     (void) new(rearIndex) audio_utils_fifo_index();
 
+    audio_utils_fifo_index *reservedRearIndex = (audio_utils_fifo_index *) mmap(NULL,
+            sizeof(audio_utils_fifo_index), PROT_READ | PROT_WRITE, MAP_SHARED, reservedRearFd,
+            (off_t) 0);
+    printf("parent reservedRearIndex=%p\n", reservedRearIndex);
+    (void) new(reservedRearIndex) audio_utils_fifo_index();
+
+    audio_utils_fifo_commit *commits = (audio_utils_fifo_commit *) mmap(NULL, COMMITS_SIZE,
+            PROT_READ | PROT_WRITE, MAP_SHARED, commitsFd, (off_t) 0);
+    printf("parent commits=%p\n", commits);
+    (void) new(commits) audio_utils_fifo_commit[FRAME_COUNT];
+
     int16_t *data = (int16_t *) mmap(NULL, sizeof(audio_utils_fifo_index), PROT_READ | PROT_WRITE,
             MAP_SHARED, dataFd, (off_t) 0);
     printf("parent data=%p\n", data);
@@ -64,58 +87,67 @@ int main(int argc __attribute__((unused)), char **argv __attribute__((unused)))
     const int pageSize = getpagesize();
     printf("page size=%d\n", pageSize);
 
-    // create writer
-
-    printf("fork writer:\n");
-    const pid_t pidWriter = fork();
-    // TODO check if pidWriter < 0
-    if (!pidWriter) {
-
-        // Child inherits the parent's read/write mapping of front index.
-        // To confirm that there are no attempts to write to the front index,
-        // unmap it and then re-map it as read-only.
-        int ok = munmap(frontIndex, sizeof(audio_utils_fifo_index));
-        printf("writer unmap front ok=%d\n", ok);
-        ok = ashmem_set_prot_region(frontFd, PROT_READ);
-        printf("writer prot read front ok=%d\n", ok);
-        // The pagesize * 4 offset confirms that we don't assume identical mapping in both processes
-        frontIndex = (audio_utils_fifo_index *) mmap((char *) frontIndex + pageSize * 4,
-                sizeof(audio_utils_fifo_index), PROT_READ, MAP_SHARED | MAP_FIXED, frontFd,
-                (off_t) 0);
-        printf("writer frontIndex=%p\n", frontIndex);
-
-        // Retain our read/write mapping of rear index and data
-        audio_utils_fifo fifo(FRAME_COUNT, FRAME_SIZE, data, *rearIndex, frontIndex);
-        audio_utils_fifo_writer writer(fifo);
-
-        sleep(2);
-
-        for (int16_t value = 1; value <= 20; value++) {
-            printf("writing %d\n", value);
-            const ssize_t actual = writer.write(&value, 1);
-            if (actual != 1) {
-                printf("wrote unexpected actual = %zd\n", actual);
-                break;
-            }
-            // TODO needs a lot of work
-            switch (value) {
-            case 10:
-                sleep(2);
-                break;
-            case 14:
-                sleep(4);
-                break;
-            default:
-                usleep(500000);
-                break;
+    // create writers
+
+    pid_t pidWriters[WRITERS];
+    for (int writerIndex = 0; writerIndex < WRITERS; writerIndex++) {
+        printf("fork writer %d:\n", writerIndex);
+        const pid_t pidWriter = fork();
+        pidWriters[writerIndex] = pidWriter;
+        // TODO check if pidWriter < 0
+        if (!pidWriter) {
+
+            // Child inherits the parent's read/write mapping of front index.
+            // To confirm that there are no attempts to write to the front index,
+            // unmap it and then re-map it as read-only.
+            int ok = munmap(frontIndex, sizeof(audio_utils_fifo_index));
+            printf("writer unmap front ok=%d\n", ok);
+            ok = ashmem_set_prot_region(frontFd, PROT_READ);
+            printf("writer prot read front ok=%d\n", ok);
+            // The pagesize * 4 offset confirms that we don't assume identical mapping in both
+            // processes
+            frontIndex = (audio_utils_fifo_index *) mmap((char *) frontIndex + pageSize * 4,
+                    sizeof(audio_utils_fifo_index), PROT_READ, MAP_SHARED | MAP_FIXED, frontFd,
+                    (off_t) 0);
+            printf("writer frontIndex=%p\n", frontIndex);
+
+            // Retain our read/write mapping of rear index, reserved rear index and data
+            audio_utils_fifo fifo(FRAME_COUNT, FRAME_SIZE, data, *rearIndex, frontIndex);
+            audio_utils_fifo_multi_writer writer(fifo, *reservedRearIndex, commits);
+
+            sleep(2);
+
+            // The writers interleave their values, with different delays
+            for (int16_t value = 1; value <= WRITER_VALUES; value++) {
+                const int16_t tagged = writerIndex * WRITER_VALUES + value;
+                printf("writer %d writing %d\n", writerIndex, tagged);
+                const ssize_t actual = writer.write(&tagged, 1);
+                if (actual != 1) {
+                    printf("wrote unexpected actual = %zd\n", actual);
+                    break;
+                }
+                // TODO needs a lot of work
+                switch (value) {
+                case 10:
+                    sleep(2);
+                    break;
+                case 14:
+                    sleep(4);
+                    break;
+                default:
+                    usleep(500000 + writerIndex * 100000);
+                    break;
+                }
             }
-        }
 
-        (void) close(frontFd);
-        (void) close(rearFd);
-        (void) close(dataFd);
+            (void) close(frontFd);
+            (void) close(rearFd);
+            (void) close(reservedRearFd);
+            (void) close(commitsFd);
+            (void) close(dataFd);
 
-        return EXIT_SUCCESS;
+            return EXIT_SUCCESS;
+        }
     }
 
     // The sleep(2) above and sleep(1) here ensure that the order is:
@@ -157,10 +189,20 @@ int main(int argc __attribute__((unused)), char **argv __attribute__((unused)))
                 MAP_SHARED | MAP_FIXED, dataFd, (off_t) 0);
         printf("reader data=%p\n", data);
 
+        // The reserved rear index and the commits are used only by the writers
+        ok = munmap(reservedRearIndex, sizeof(audio_utils_fifo_index));
+        printf("reader unmap reserved rear ok=%d\n", ok);
+        ok = munmap(commits, COMMITS_SIZE);
+        printf("reader unmap commits ok=%d\n", ok);
+
         // Retain our read/write mapping of front index
         audio_utils_fifo fifo(FRAME_COUNT, FRAME_SIZE, data, *rearIndex, frontIndex);
         audio_utils_fifo_reader reader(fifo);
 
+        // The values of each writer must be read in order
+        int16_t lastValues[WRITERS] = {};
+        int done = 0;
+        int exitStatus = EXIT_SUCCESS;
         for (;;) {
             int16_t value;
             struct timespec timeout = {
@@ -171,17 +213,27 @@ int main(int argc __attribute__((unused)), char **argv __attribute__((unused)))
             switch (actual) {
             case 0:
                 break;
-            case 1:
+            case 1: {
                 printf("read %d\n", value);
-                if (value == 20) {
+                const int writerIndex = (value - 1) / WRITER_VALUES;
+                if (value < 1 || writerIndex >= WRITERS ||
+                        value != lastValues[writerIndex] + (lastValues[writerIndex] == 0 ?
+                                writerIndex * WRITER_VALUES + 1 : 1)) {
+                    printf("read unexpected value %d\n", value);
+                    exitStatus = EXIT_FAILURE;
                     goto out;
                 }
-                break;
+                lastValues[writerIndex] = value;
+                if (value == (writerIndex + 1) * WRITER_VALUES && ++done == WRITERS) {
+                    goto out;
+                }
+                } break;
             case -ETIMEDOUT:
                 printf("read timed out\n");
                 break;
             default:
                 printf("read unexpected actual = %zd\n", actual);
+                exitStatus = EXIT_FAILURE;
                 goto out;
             }
         }
@@ -189,17 +241,22 @@ out:
 
         (void) close(frontFd);
         (void) close(rearFd);
+        (void) close(reservedRearFd);
+        (void) close(commitsFd);
         (void) close(dataFd);
 
-        return EXIT_SUCCESS;
+        return exitStatus;
     }
 
     int status;
-    pid_t pid = waitpid(pidWriter, &status, 0);
-    if (pid == pidWriter) {
-        printf("writer exited with status %d\n", status);
-    } else {
-        printf("waitpid on writer = %d\n", pid);
+    pid_t pid;
+    for (int writerIndex = 0; writerIndex < WRITERS; writerIndex++) {
+        pid = waitpid(pidWriters[writerIndex], &status, 0);
+        if (pid == pidWriters[writerIndex]) {
+            printf("writer %d exited with status %d\n", writerIndex, status);
+        } else {
+            printf("waitpid on writer %d = %d\n", writerIndex, pid);
+        }
     }
     pid = waitpid(pidReader, &status, 0);
     if (pid == pidReader) {
@@ -208,19 +265,29 @@ out:
         printf("waitpid on reader = %d\n", pid);
     }
 
-    // next two index destructors must execute exactly once, so we do it in the parent
+    // next index and commit destructors must execute exactly once, so we do it in the parent
     frontIndex->~audio_utils_fifo_index();
     rearIndex->~audio_utils_fifo_index();
+    reservedRearIndex->~audio_utils_fifo_index();
+    for (int i = 0; i < FRAME_COUNT; i++) {
+        commits[i].~audio_utils_fifo_commit();
+    }
 
     int ok = munmap(frontIndex, sizeof(audio_utils_fifo_index));
     printf("parent unmap front ok=%d\n", ok);
     ok = munmap(rearIndex, sizeof(audio_utils_fifo_index));
     printf("parent unmap rear ok=%d\n", ok);
+    ok = munmap(reservedRearIndex, sizeof(audio_utils_fifo_index));
+    printf("parent unmap reserved rear ok=%d\n", ok);
+    ok = munmap(commits, COMMITS_SIZE);
+    printf("parent unmap commits ok=%d\n", ok);
     ok = munmap(data, BUFFER_SIZE);
     printf("parent unmap data ok=%d\n", ok);
 
     (void) close(frontFd);
     (void) close(rearFd);
+    (void) close(reservedRearFd);
+    (void) close(commitsFd);
     (void) close(dataFd);
 
     return EXIT_SUCCESS;
@@ -14,10 +14,15 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <errno.h>
+#include <limits.h>
+#include <memory>
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <vector>
 #include <audio_utils/fifo.h>
 
 extern "C" {
@@ -95,11 +100,297 @@ void *output_routine(void *arg)
     return NULL;
 }
 
+// Non-interactive stress test of audio_utils_fifo_multi_writer and audio_utils_fifo_multi_reader.
+// Each producer writes frames tagged with its number and a sequence number, and the consumers
+// check that every frame is read exactly once, and in sequence for each producer.
+// Optionally producer 0 stalls between obtain() and release() of its first slice, and the other
+// producers must then keep releasing frames until they have filled the FIFO.
+
+struct StressContext {
+    audio_utils_fifo *mFifo;
+    audio_utils_fifo_index *mReservedRear;
+    audio_utils_fifo_index *mReservedFront;
+    audio_utils_fifo_commit *mWriterCommits;
+    audio_utils_fifo_commit *mReaderCommits;
+    int mConsumers;
+    bool mStall;
+    uint32_t mFramesPerProducer;
+    std::vector<std::vector<std::atomic_uint_least8_t>> *mSeen;  // [producer][sequence]
+    std::atomic_uint_least64_t mRead;                            // total frames read
+    std::atomic_int mErrors;
+    std::atomic_bool mStalled;                                   // producer 0 is stalled
+    std::atomic_uint_least32_t mReleasedWhileStalled;            // by the other producers
+    std::atomic_int mProducersDone;
+};
+
+static const struct timespec kStressTimeout = { .tv_sec = 0, .tv_nsec = 100000000 };
+static const uint32_t kStressMaxChunk = 8;
+static const int kStallTimeoutMs = 2000;
+
+static uint32_t stressFrame(uint32_t producer, uint32_t sequence)
+{
+    return (producer << 24) | sequence;
+}
+
+struct StressProducer {
+    StressContext *mContext;
+    uint32_t mProducer;
+};
+
+// Called by producer 0 with its first slice obtained but not released, to check that the other
+// producers can release all of the frames which fit in the rest of the FIFO meanwhile.
+static void stressStall(StressContext *context, uint32_t obtained)
+{
+    const int others = (int) context->mSeen->size() - 1;
+    const uint32_t expected = context->mFifo->capacity() - obtained;
+    context->mStalled = true;
+    int ms = 0;
+    while (context->mReleasedWhileStalled < expected && context->mProducersDone < others &&
+            context->mErrors == 0 && ms < kStallTimeoutMs) {
+        usleep(1000);
+        ms++;
+    }
+    if (ms >= kStallTimeoutMs) {
+        printf("other producers released %u of %u frames while producer 0 was stalled\n",
+                (unsigned) context->mReleasedWhileStalled, expected);
+        context->mErrors++;
+    }
+    context->mStalled = false;
+}
+
+void *stress_producer_routine(void *arg)
+{
+    StressProducer *producer = (StressProducer *) arg;
+    StressContext *context = producer->mContext;
+    audio_utils_fifo_multi_writer writer(*context->mFifo, *context->mReservedRear,
+            context->mWriterCommits);
+    uint32_t *buffer = (uint32_t *) context->mFifo->buffer();
+    unsigned seed = producer->mProducer;
+    bool stall = context->mStall && producer->mProducer == 0;
+    // Stop when another thread has failed, as the frames we write may no longer be read.
+    for (uint32_t sequence = 0;
+            sequence < context->mFramesPerProducer && context->mErrors == 0; ) {
+        uint32_t chunk[kStressMaxChunk];
+        size_t count = 1 + rand_r(&seed) % kStressMaxChunk;
+        if (count > context->mFramesPerProducer - sequence) {
+            count = context->mFramesPerProducer - sequence;
+        }
+        ssize_t actual;
+        if (!stall && (rand_r(&seed) & 1)) {
+            for (size_t i = 0; i < count; i++) {
+                chunk[i] = stressFrame(producer->mProducer, sequence + i);
+            }
+            actual = writer.write(chunk, count, &kStressTimeout);
+        } else {
+            // obtain and release directly, sometimes in two parts
+            audio_utils_iovec iovec[2];
+            actual = writer.obtain(iovec, count, &kStressTimeout);
+            for (ssize_t i = 0; i < actual; i++) {
+                const uint32_t offset = i < iovec[0].mLength ?
+                        iovec[0].mOffset + i : iovec[1].mOffset + i - iovec[0].mLength;
+                buffer[offset] = stressFrame(producer->mProducer, sequence + i);
+            }
+            if (stall && actual > 0) {
+                stressStall(context, actual);
+                stall = false;
+            }
+            if (actual > 1 && (rand_r(&seed) & 1)) {
+                writer.release(1);
+                writer.release(actual - 1);
+            } else if (actual > 0) {
+                writer.release(actual);
+            }
+        }
+        if (actual > 0) {
+            sequence += actual;
+            if (context->mStalled && producer->mProducer != 0) {
+                context->mReleasedWhileStalled += actual;
+            }
+        } else if (actual != 0 && actual != -ETIMEDOUT && actual != -EWOULDBLOCK) {
+            printf("producer %u write actual = %zd\n", producer->mProducer, actual);
+            context->mErrors++;
+            break;
+        }
+    }
+    context->mProducersDone++;
+    return NULL;
+}
+
+// Checks a frame read by a consumer, where last[] is the last sequence seen by this consumer.
+static void stressCheck(StressContext *context, uint32_t frame, std::vector<int64_t>& last)
+{
+    const uint32_t producer = frame >> 24;
+    const uint32_t sequence = frame & 0xFFFFFF;
+    if (producer >= last.size() || sequence >= context->mFramesPerProducer) {
+        printf("consumer read corrupt frame %#x\n", frame);
+        context->mErrors++;
+        return;
+    }
+    if ((int64_t) sequence <= last[producer]) {
+        printf("consumer read producer %u sequence %u after %lld\n", producer, sequence,
+                (long long) last[producer]);
+        context->mErrors++;
+    }
+    last[producer] = sequence;
+    if ((*context->mSeen)[producer][sequence]++ != 0) {
+        printf("producer %u sequence %u read more than once\n", producer, sequence);
+        context->mErrors++;
+    }
+}
+
+void *stress_consumer_routine(void *arg)
+{
+    StressContext *context = (StressContext *) arg;
+    std::unique_ptr<audio_utils_fifo_provider> provider;
+    if (context->mConsumers > 1) {
+        provider.reset(new audio_utils_fifo_multi_reader(*context->mFifo,
+                *context->mReservedFront, context->mReaderCommits));
+    } else {
+        provider.reset(new audio_utils_fifo_reader(*context->mFifo, true /*throttlesWriter*/));
+    }
+    const uint32_t *buffer = (const uint32_t *) context->mFifo->buffer();
+    std::vector<int64_t> last(context->mSeen->size(), -1);
+    const uint64_t total = (uint64_t) context->mSeen->size() * context->mFramesPerProducer;
+    while (context->mRead < total && context->mErrors == 0) {
+        audio_utils_iovec iovec[2];
+        ssize_t actual = provider->obtain(iovec, kStressMaxChunk, &kStressTimeout);
+        if (actual > 0) {
+            for (uint32_t i = 0; i < iovec[0].mLength; i++) {
+                stressCheck(context, buffer[iovec[0].mOffset + i], last);
+            }
+            for (uint32_t i = 0; i < iovec[1].mLength; i++) {
+                stressCheck(context, buffer[iovec[1].mOffset + i], last);
+            }
+            provider->release(actual);
+            context->mRead += actual;
+        } else if (actual != 0 && actual != -ETIMEDOUT && actual != -EWOULDBLOCK) {
+            printf("consumer read actual = %zd\n", actual);
+            context->mErrors++;
+        }
+    }
+    return NULL;
+}
+
+static int stress(int producers, int consumers, uint32_t framesPerProducer, uint32_t frameCount,
+        bool stall)
+{
+    printf("stress %d producers, %d consumers, %u frames per producer, FIFO %u frames%s\n",
+            producers, consumers, framesPerProducer, frameCount,
+            stall ? ", producer 0 stalls" : "");
+    std::vector<uint32_t> fifoBuffer(frameCount);
+    audio_utils_fifo fifo(frameCount, sizeof(uint32_t), fifoBuffer.data(),
+            true /*throttlesWriter*/);
+    audio_utils_fifo_index reservedRear;
+    audio_utils_fifo_index reservedFront;
+    std::vector<audio_utils_fifo_commit> writerCommits(frameCount);
+    std::vector<audio_utils_fifo_commit> readerCommits(frameCount);
+    std::vector<std::vector<std::atomic_uint_least8_t>> seen(producers);
+    for (auto& s : seen) {
+        s = std::vector<std::atomic_uint_least8_t>(framesPerProducer);
+    }
+
+    StressContext context;
+    context.mFifo = &fifo;
+    context.mReservedRear = &reservedRear;
+    context.mReservedFront = &reservedFront;
+    context.mWriterCommits = writerCommits.data();
+    context.mReaderCommits = readerCommits.data();
+    context.mConsumers = consumers;
+    context.mStall = stall;
+    context.mFramesPerProducer = framesPerProducer;
+    context.mSeen = &seen;
+    context.mRead = 0;
+    context.mErrors = 0;
+    context.mStalled = false;
+    context.mReleasedWhileStalled = 0;
+    context.mProducersDone = 0;
+
+    std::vector<pthread_t> threads;
+    std::vector<StressProducer> producerArgs(producers);
+    for (int i = 0; i < consumers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, stress_consumer_routine, &context) == 0) {
+            threads.push_back(thread);
+        }
+    }
+    for (int i = 0; i < producers; i++) {
+        producerArgs[i] = { &context, (uint32_t) i };
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, stress_producer_routine, &producerArgs[i]) == 0) {
+            threads.push_back(thread);
+        }
+    }
+    for (pthread_t thread : threads) {
+        (void) pthread_join(thread, NULL);
+    }
+
+    for (int i = 0; i < producers; i++) {
+        for (uint32_t j = 0; j < framesPerProducer; j++) {
+            if (seen[i][j] != 1) {
+                printf("producer %d sequence %u read %d times\n", i, j, (int) seen[i][j]);
+                context.mErrors++;
+                break;
+            }
+        }
+    }
+    printf("%s: %llu frames read, %d errors\n", context.mErrors == 0 ? "PASS" : "FAIL",
+            (unsigned long long) context.mRead, (int) context.mErrors);
+    return context.mErrors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-p# [-c#] [-n#] [-f#] [-s]]\n"
+            "  without -p, echo the keyboard through three FIFOs interactively\n"
+            "  -p#  stress test with # producers\n"
+            "  -c#  and # consumers (default 1)\n"
+            "  -n#  of # frames per producer (default 1000000)\n"
+            "  -f#  through a FIFO of # frames (default 64)\n"
+            "  -s   with producer 0 stalled while holding its first slice\n", name);
+    return EXIT_FAILURE;
+}
+
 int main(int argc, char **argv)
 {
+    int producers = 0;
+    int consumers = 1;
+    uint32_t framesPerProducer = 1000000;
+    uint32_t frameCount = 64;
+    bool stall = false;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (arg[0] != '-') {
+            return usage(argv[0]);
+        }
+        switch (arg[1]) {
+        case 'c':   // number of consumers
+            consumers = atoi(&arg[2]);
+            break;
+        case 'f':   // FIFO frame count
+            frameCount = atoi(&arg[2]);
+            break;
+        case 'n':   // frames per producer
+            framesPerProducer = atoi(&arg[2]);
+            break;
+        case 'p':   // number of producers
+            producers = atoi(&arg[2]);
+            break;
+        case 's':   // stall producer 0
+            stall = true;
+            break;
+        default:
+            return usage(argv[0]);
+        }
+    }
+    if (producers > 0) {
+        if (consumers <= 0 || producers > 255 || framesPerProducer == 0 ||
+                framesPerProducer > 0xFFFFFF || frameCount == 0 || (stall && producers < 2)) {
+            return usage(argv[0]);
+        }
+        return stress(producers, consumers, framesPerProducer, frameCount, stall);
+    }
+
     set_conio_terminal_mode();
-    argc = argc + 0;
-    argv = &argv[0];
 
     char inputBuffer[16];
     audio_utils_fifo inputFifo(sizeof(inputBuffer) /*frameCount*/, 1 /*frameSize*/, inputBuffer,
@@ -18,6 +18,9 @@
 #define LOG_TAG "audio_utils_format_tests"
 #include <log/log.h>
 
+#include <errno.h>
+#include <vector>
+
 #include <audio_utils/format.h>
 #include <gtest/gtest.h>
 
@@ -176,3 +179,95 @@ INSTANTIATE_TEST_CASE_P(FormatVariation, FormatTest1p, ::testing::Values(
         AUDIO_FORMAT_PCM_32_BIT,
         AUDIO_FORMAT_PCM_8_24_BIT
     ));
+
+class FormatRemixTest : public testing::TestWithParam<
+        std::tuple<audio_format_t, audio_format_t,
+                std::pair<audio_channel_mask_t, audio_channel_mask_t>>>
+{
+};
+
+TEST_P(FormatRemixTest, memcpy_by_audio_format_remix)
+{
+    const auto param = GetParam();
+    const audio_format_t src_encoding = std::get<0>(param);
+    const audio_format_t dst_encoding = std::get<1>(param);
+    const audio_channel_mask_t src_mask = std::get<2>(param).first;
+    const audio_channel_mask_t dst_mask = std::get<2>(param).second;
+
+    audio_format_remix_plan_t plan;
+    const int status = audio_format_remix_plan_init(
+            &plan, dst_encoding, dst_mask, src_encoding, src_mask);
+    if (status != 0) {
+        // Only conversions between uncommon formats may be unsupported.
+        EXPECT_EQ(-EINVAL, status);
+        EXPECT_FALSE(is_common_src_format(src_encoding) || is_common_dst_format(dst_encoding));
+        printf("unsupported conversion src:%#x  dst:%#x\n", src_encoding, dst_encoding);
+        return;
+    }
+
+    // More frames than fit in the intermediate buffer, and not a multiple of the block.
+    constexpr size_t FRAMES = 1001;
+    const size_t src_channels = audio_channel_count_from_out_mask(src_mask);
+    const size_t dst_channels = audio_channel_count_from_out_mask(dst_mask);
+    const size_t src_sample_size = audio_bytes_per_sample(src_encoding);
+    const size_t dst_sample_size = audio_bytes_per_sample(dst_encoding);
+
+    std::vector<int16_t> orig_data(FRAMES * src_channels);
+    for (size_t i = 0; i < orig_data.size(); ++i) {
+        orig_data[i] = (int16_t)(i * 0x1003);
+    }
+    std::vector<uint8_t> src(orig_data.size() * src_sample_size);
+    memcpy_by_audio_format(src.data(), src_encoding,
+            orig_data.data(), AUDIO_FORMAT_PCM_16_BIT, orig_data.size());
+
+    std::vector<uint8_t> dst(FRAMES * dst_channels * dst_sample_size);
+    memcpy_by_audio_format_remix(dst.data(), src.data(), FRAMES, &plan);
+
+    // Reference: convert each destination sample separately.
+    int8_t idxary[AUDIO_FORMAT_REMIX_MAX_CHANNELS];
+    ASSERT_EQ(dst_channels, memcpy_by_index_array_initialization_from_channel_mask(
+            idxary, AUDIO_FORMAT_REMIX_MAX_CHANNELS, dst_mask, src_mask));
+    const float silence = 0.f;
+    std::vector<uint8_t> expected(dst.size());
+    for (size_t i = 0; i < FRAMES; ++i) {
+        for (size_t j = 0; j < dst_channels; ++j) {
+            uint8_t *sample = &expected[(i * dst_channels + j) * dst_sample_size];
+            if (idxary[j] < 0) {
+                memcpy_by_audio_format(sample, dst_encoding, &silence, AUDIO_FORMAT_PCM_FLOAT, 1);
+            } else {
+                memcpy_by_audio_format(sample, dst_encoding,
+                        &src[(i * src_channels + idxary[j]) * src_sample_size], src_encoding, 1);
+            }
+        }
+    }
+    EXPECT_EQ(expected, dst);
+}
+
+INSTANTIATE_TEST_CASE_P(FormatRemixVariations, FormatRemixTest, ::testing::Combine(
+    ::testing::Values(
+        AUDIO_FORMAT_PCM_8_BIT,
+        AUDIO_FORMAT_PCM_16_BIT,
+        AUDIO_FORMAT_PCM_FLOAT,
+        AUDIO_FORMAT_PCM_24_BIT_PACKED,
+        AUDIO_FORMAT_PCM_32_BIT,
+        AUDIO_FORMAT_PCM_8_24_BIT
+    ),
+    ::testing::Values(
+        AUDIO_FORMAT_PCM_8_BIT,
+        AUDIO_FORMAT_PCM_16_BIT,
+        AUDIO_FORMAT_PCM_FLOAT,
+        AUDIO_FORMAT_PCM_24_BIT_PACKED,
+        AUDIO_FORMAT_PCM_32_BIT,
+        AUDIO_FORMAT_PCM_8_24_BIT
+    ),
+    ::testing::Values(
+        std::make_pair(AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_STEREO),
+        std::make_pair(AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_MONO),
+        std::make_pair(AUDIO_CHANNEL_OUT_MONO, AUDIO_CHANNEL_OUT_STEREO),
+        std::make_pair(AUDIO_CHANNEL_OUT_5POINT1, AUDIO_CHANNEL_OUT_STEREO),
+        std::make_pair(AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_7POINT1),
+        std::make_pair(audio_channel_mask_for_index_assignment_from_count(4),
+                AUDIO_CHANNEL_OUT_STEREO),
+        std::make_pair(AUDIO_CHANNEL_OUT_QUAD,
+                audio_channel_mask_for_index_assignment_from_count(6))
+    )));
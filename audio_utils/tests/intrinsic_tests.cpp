@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include <audio_utils/intrinsic_utils.h>
 
 #include <gtest/gtest.h>
@@ -42,6 +44,20 @@ TYPED_TEST(IntrisicUtilsTest, vld1) {
     ASSERT_EQ(value, android::audio_utils::intrinsics::vld1<TypeParam>(&value));
 }
 
+TYPED_TEST(IntrisicUtilsTest, vmax) {
+    constexpr TypeParam a = 1.25f;
+    constexpr TypeParam b = -1.5f;
+    ASSERT_EQ(a, android::audio_utils::intrinsics::vmax(a, b));
+    ASSERT_EQ(a, android::audio_utils::intrinsics::vmax(b, a));
+}
+
+TYPED_TEST(IntrisicUtilsTest, vmin) {
+    constexpr TypeParam a = 1.25f;
+    constexpr TypeParam b = -1.5f;
+    ASSERT_EQ(b, android::audio_utils::intrinsics::vmin(a, b));
+    ASSERT_EQ(b, android::audio_utils::intrinsics::vmin(b, a));
+}
+
 TYPED_TEST(IntrisicUtilsTest, vmla) {
     constexpr TypeParam a = 2.125f;
     constexpr TypeParam b = 2.25f;
@@ -76,3 +92,137 @@ TYPED_TEST(IntrisicUtilsTest, vsub) {
     constexpr TypeParam result = a - b;
     ASSERT_EQ(result, android::audio_utils::intrinsics::vsub(a, b));
 }
+
+// Vector intrinsic tests which are run on the SIMD vector register types available
+// for the target (NEON on ARM, SSE/AVX on x86) as well as the composite struct types.
+template <typename V, typename D>
+struct VectorTypeParam {
+    using vector_type = V;
+    using element_type = D;
+    static constexpr size_t kLanes = sizeof(V) / sizeof(D);
+};
+
+template <typename P>
+class IntrisicUtilsVectorTest : public ::testing::Test {
+  protected:
+    using V = typename P::vector_type;
+    using D = typename P::element_type;
+    static constexpr size_t kLanes = P::kLanes;
+
+    // Stores the vector and checks each lane against the reference function.
+    template <typename F>
+    static void verify(const V& actual, F reference) {
+        D lanes[kLanes];
+        android::audio_utils::intrinsics::vst1(lanes, actual);
+        for (size_t i = 0; i < kLanes; ++i) {
+            ASSERT_EQ(reference(i), lanes[i]) << "lane " << i;
+        }
+    }
+
+    static D valueA(size_t i) { return D(0.25) + D(i); }
+    static D valueB(size_t i) { return D(0.5) - D(2 * i); }
+    static D valueC(size_t i) { return D(2.125) * D(i + 1); }
+
+    static V load(D (*value)(size_t)) {
+        D lanes[kLanes];
+        for (size_t i = 0; i < kLanes; ++i) lanes[i] = value(i);
+        return android::audio_utils::intrinsics::vld1<V>(lanes);
+    }
+};
+
+using VectorTypes = ::testing::Types<
+        VectorTypeParam<android::audio_utils::intrinsics::internal_array_t<float, 4>, float>,
+        VectorTypeParam<android::audio_utils::intrinsics::internal_array_t<float, 7>, float>,
+        VectorTypeParam<android::audio_utils::intrinsics::internal_array_t<double, 3>, double>
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+        , VectorTypeParam<float32x2_t, float>
+        , VectorTypeParam<float32x4_t, float>
+        , VectorTypeParam<android::audio_utils::intrinsics::internal_array_t<
+                float32x4_t, 2>, float>
+#endif
+#if defined(__SSE2__)
+        , VectorTypeParam<__m128, float>
+        , VectorTypeParam<__m128d, double>
+        , VectorTypeParam<android::audio_utils::intrinsics::internal_array_t<__m128, 2>, float>
+#endif
+#if defined(__AVX__)
+        , VectorTypeParam<__m256, float>
+        , VectorTypeParam<__m256d, double>
+#endif
+#if defined(__AVX512F__)
+        , VectorTypeParam<__m512, float>
+        , VectorTypeParam<__m512d, double>
+#endif
+        >;
+TYPED_TEST_CASE(IntrisicUtilsVectorTest, VectorTypes);
+
+TYPED_TEST(IntrisicUtilsVectorTest, vadd) {
+    using namespace android::audio_utils::intrinsics;
+    this->verify(vadd(this->load(this->valueA), this->load(this->valueB)),
+            [this](size_t i) { return this->valueA(i) + this->valueB(i); });
+}
+
+TYPED_TEST(IntrisicUtilsVectorTest, vdupn) {
+    using namespace android::audio_utils::intrinsics;
+    using V = typename TestFixture::V;
+    using D = typename TestFixture::D;
+    constexpr D value = 1.5;
+    this->verify(vdupn<V>(value), [](size_t) { return value; });
+}
+
+TYPED_TEST(IntrisicUtilsVectorTest, vld1_vst1) {
+    this->verify(this->load(this->valueC), [this](size_t i) { return this->valueC(i); });
+}
+
+TYPED_TEST(IntrisicUtilsVectorTest, vmax) {
+    using namespace android::audio_utils::intrinsics;
+    this->verify(vmax(this->load(this->valueA), this->load(this->valueB)),
+            [this](size_t i) { return std::max(this->valueA(i), this->valueB(i)); });
+}
+
+TYPED_TEST(IntrisicUtilsVectorTest, vmin) {
+    using namespace android::audio_utils::intrinsics;
+    this->verify(vmin(this->load(this->valueA), this->load(this->valueB)),
+            [this](size_t i) { return std::min(this->valueA(i), this->valueB(i)); });
+}
+
+TYPED_TEST(IntrisicUtilsVectorTest, vmla) {
+    using namespace android::audio_utils::intrinsics;
+    using D = typename TestFixture::D;
+    const auto a = this->load(this->valueA);
+    const auto b = this->load(this->valueB);
+    const auto c = this->load(this->valueC);
+    this->verify(vmla(c, a, b),
+            [this](size_t i) { return this->valueC(i) + this->valueA(i) * this->valueB(i); });
+
+    // lane (vector by scalar) variants.
+    constexpr D scalar = 0.75;
+    this->verify(vmla(c, a, scalar),
+            [this](size_t i) { return this->valueC(i) + this->valueA(i) * scalar; });
+    this->verify(vmla(c, scalar, a),
+            [this](size_t i) { return this->valueC(i) + scalar * this->valueA(i); });
+}
+
+TYPED_TEST(IntrisicUtilsVectorTest, vmul) {
+    using namespace android::audio_utils::intrinsics;
+    using D = typename TestFixture::D;
+    const auto a = this->load(this->valueA);
+    const auto b = this->load(this->valueB);
+    this->verify(vmul(a, b), [this](size_t i) { return this->valueA(i) * this->valueB(i); });
+
+    // lane (vector by scalar) variants.
+    constexpr D scalar = 1.25;
+    this->verify(vmul(a, scalar), [this](size_t i) { return this->valueA(i) * scalar; });
+    this->verify(vmul(scalar, a), [this](size_t i) { return scalar * this->valueA(i); });
+}
+
+TYPED_TEST(IntrisicUtilsVectorTest, vneg) {
+    using namespace android::audio_utils::intrinsics;
+    this->verify(vneg(this->load(this->valueB)), [this](size_t i) { return -this->valueB(i); });
+}
+
+TYPED_TEST(IntrisicUtilsVectorTest, vsub) {
+    using namespace android::audio_utils::intrinsics;
+    this->verify(vsub(this->load(this->valueA), this->load(this->valueB)),
+            [this](size_t i) { return this->valueA(i) - this->valueB(i); });
+}
@@ -18,6 +18,9 @@
 #define LOG_TAG "audio_utils_mel_aggregator_tests"
 
 #include <audio_utils/MelAggregator.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
@@ -125,6 +128,47 @@ TEST(MelAggregatorTest, CheckMelIntervalSplit) {
     });
 }
 
+TEST(MelAggregatorTest, AggregateBridgingNonOverlappingValues) {
+    MelAggregator aggregator{/* csdWindowSeconds */ 100};
+
+    aggregator.aggregateAndAddNewMelRecord(MelRecord(kTestPortId, {3.f, 3.f}, /* timestamp */0));
+    aggregator.aggregateAndAddNewMelRecord(MelRecord(kTestPortId, {3.f, 3.f}, /* timestamp */4));
+    aggregator.aggregateAndAddNewMelRecord(MelRecord(kTestPortId, {3.f, 3.f}, /* timestamp */8));
+    // overlaps the first two records, but not the third one
+    aggregator.aggregateAndAddNewMelRecord(MelRecord(kTestPortId, {3.f, 3.f, 3.f, 3.f},
+                                                     /* timestamp */1));
+
+    ASSERT_EQ(aggregator.getCachedMelRecordsSize(), size_t{2});
+    std::vector<MelRecord> records;
+    aggregator.foreachCachedMel([&records](const MelRecord &record) {
+        records.push_back(record);
+    });
+    EXPECT_EQ(records[0].timestamp, 0);
+    EXPECT_THAT(records[0].mels, Pointwise(FloatNear(kFloatError), {3.f, 6.f, 3.f, 3.f, 6.f, 3.f}));
+    EXPECT_EQ(records[1].timestamp, 8);
+    EXPECT_THAT(records[1].mels, Pointwise(FloatNear(kFloatError), {3.f, 3.f}));
+}
+
+TEST(MelAggregatorTest, CsdRecordsAreSortedByTimestamp) {
+    MelAggregator aggregator{/* csdWindowSeconds */ 100};
+
+    aggregator.aggregateAndAddNewMelRecord(MelRecord(kTestPortId,
+                                                     std::vector<float>(3, kCustomMelDbA),
+                                                     /* timestamp */10));
+    aggregator.aggregateAndAddNewMelRecord(MelRecord(kTestPortId,
+                                                     std::vector<float>(3, kCustomMelDbA),
+                                                     /* timestamp */0));
+    aggregator.aggregateAndAddNewMelRecord(MelRecord(kTestPortId,
+                                                     std::vector<float>(3, kCustomMelDbA),
+                                                     /* timestamp */20));
+
+    std::vector<int64_t> timestamps;
+    aggregator.foreachCsd([&timestamps](const CsdRecord &record) {
+        timestamps.push_back(record.timestamp);
+    });
+    EXPECT_THAT(timestamps, ElementsAre(0, 10, 20));
+}
+
 TEST(MelAggregatorTest, CsdRollingWindowDiscardsOldElements) {
     MelAggregator aggregator{/* csdWindowSeconds */ 3};
 
@@ -168,5 +212,140 @@ TEST(MelAggregatorTest, CsdReaches100PercWith80dB) {
     EXPECT_NEAR(aggregator.getCsd(), 1.f, kMelFloatError);
 }
 
+// Returns an aggregator with a week of CSD records from 2 devices playing 3 hours a day,
+// and cached MEL values below the CSD threshold.
+sp<MelAggregator> createWeekOfHistory() {
+    constexpr int64_t kSecondsPerDay = 24 * 3600;
+    auto aggregator = sp<MelAggregator>::make(7 * kSecondsPerDay);
+    for (int64_t day = 0; day < 7; ++day) {
+        for (int64_t t = 0; t < 3 * 3600; t += 3) {
+            for (audio_port_handle_t device = 0; device < 2; ++device) {
+                const float mel = 85.f + (t / 3 + device) % 10;
+                aggregator->aggregateAndAddNewMelRecord(MelRecord(device, {mel, mel, mel},
+                        day * kSecondsPerDay + t + device));
+            }
+        }
+    }
+    aggregator->aggregateAndAddNewMelRecord(MelRecord(kTestPortId, {80.f, 80.f},
+                                                      7 * kSecondsPerDay));
+    aggregator->aggregateAndAddNewMelRecord(MelRecord(kTestPortId, {80.f},
+                                                      7 * kSecondsPerDay + 10));
+    return aggregator;
+}
+
+void expectSameState(const MelAggregator& expected, const MelAggregator& actual) {
+    EXPECT_EQ(expected.serialize(), actual.serialize());
+    std::vector<int64_t> expectedTimestamps, actualTimestamps;
+    expected.foreachCsd([&](const CsdRecord& record) {
+        expectedTimestamps.push_back(record.timestamp);
+    });
+    actual.foreachCsd([&](const CsdRecord& record) {
+        actualTimestamps.push_back(record.timestamp);
+    });
+    EXPECT_EQ(expectedTimestamps, actualTimestamps);
+}
+
+TEST(MelAggregatorTest, SerializeRoundTripsLargeHistory) {
+    const auto aggregator = createWeekOfHistory();
+    ASSERT_GT(aggregator->getCsdRecordsSize(), size_t{1000});
+    ASSERT_GT(aggregator->getCachedMelRecordsSize(), size_t{0});
+
+    const std::vector<uint8_t> data = aggregator->serialize();
+    const auto state = MelAggregator::PersistedState::fromData(data.data(), data.size());
+    ASSERT_NE(state, nullptr);
+    EXPECT_EQ(state->getCsd(), aggregator->getCsd());
+    ASSERT_EQ(state->getCsdRecordsSize(), aggregator->getCsdRecordsSize());
+    size_t i = 0;
+    aggregator->foreachCsd([&](const CsdRecord& record) {
+        const CsdRecord persisted = state->getCsdRecord(i++);
+        EXPECT_EQ(persisted.timestamp, record.timestamp);
+        EXPECT_EQ(persisted.duration, record.duration);
+        EXPECT_EQ(persisted.value, record.value);
+        EXPECT_EQ(persisted.averageMel, record.averageMel);
+    });
+    ASSERT_EQ(state->getCachedMelRecordsSize(), aggregator->getCachedMelRecordsSize());
+    std::vector<float> expectedMels, mels;
+    aggregator->foreachCachedMel([&expectedMels](const MelRecord& record) {
+        expectedMels.insert(expectedMels.end(), record.mels.begin(), record.mels.end());
+    });
+    state->foreachCachedMel([&mels](const MelRecord& record) {
+        mels.insert(mels.end(), record.mels.begin(), record.mels.end());
+    });
+    EXPECT_THAT(mels, Pointwise(FloatNear(kMelFloatError), expectedMels));
+
+    MelAggregator restored{/* csdWindowSeconds */ 7 * 24 * 3600};
+    restored.aggregateAndAddNewMelRecord(MelRecord(kTestPortId, {100.f, 100.f}, 0));
+    restored.reset(*state);
+    EXPECT_EQ(restored.getCsd(), aggregator->getCsd());
+    expectSameState(*aggregator, restored);
+
+    // the restored aggregator continues as the original one
+    const MelRecord record(kTestPortId, std::vector<float>(600, 95.f), 8 * 24 * 3600);
+    EXPECT_EQ(restored.aggregateAndAddNewMelRecord(record).size(),
+              aggregator->aggregateAndAddNewMelRecord(record).size());
+    expectSameState(*aggregator, restored);
+}
+
+TEST(MelAggregatorTest, PersistedStateFromFile) {
+    const auto aggregator = createWeekOfHistory();
+    const std::vector<uint8_t> data = aggregator->serialize();
+    const std::string path = ::testing::TempDir() + "mel_aggregator_state";
+    FILE* file = fopen(path.c_str(), "w");
+    ASSERT_NE(file, nullptr);
+    ASSERT_EQ(fwrite(data.data(), 1, data.size(), file), data.size());
+    ASSERT_EQ(fclose(file), 0);
+
+    const auto state = MelAggregator::PersistedState::fromFile(path.c_str());
+    unlink(path.c_str());
+    ASSERT_NE(state, nullptr);
+    MelAggregator restored{/* csdWindowSeconds */ 7 * 24 * 3600};
+    restored.reset(*state);
+    expectSameState(*aggregator, restored);
+
+    EXPECT_EQ(MelAggregator::PersistedState::fromFile(path.c_str()), nullptr);
+}
+
+TEST(MelAggregatorTest, PersistedStateRejectsInvalidData) {
+    MelAggregator aggregator{/* csdWindowSeconds */ 100};
+    aggregator.aggregateAndAddNewMelRecord(MelRecord(kTestPortId,
+                                                     std::vector<float>(3, kCustomMelDbA),
+                                                     /* timestamp */10));
+    aggregator.aggregateAndAddNewMelRecord(MelRecord(kTestPortId,
+                                                     std::vector<float>(3, kCustomMelDbA),
+                                                     /* timestamp */20));
+    std::vector<uint8_t> data = aggregator.serialize();
+    ASSERT_NE(MelAggregator::PersistedState::fromData(data.data(), data.size()), nullptr);
+
+    EXPECT_EQ(MelAggregator::PersistedState::fromData(data.data(), 0), nullptr);
+    EXPECT_EQ(MelAggregator::PersistedState::fromData(data.data(), data.size() - 1), nullptr);
+    data.push_back(0);
+    EXPECT_EQ(MelAggregator::PersistedState::fromData(data.data(), data.size()), nullptr);
+    data.pop_back();
+
+    // newer version
+    std::vector<uint8_t> invalid = data;
+    invalid[4] += 1;
+    EXPECT_EQ(MelAggregator::PersistedState::fromData(invalid.data(), invalid.size()), nullptr);
+
+    // the second CSD record timestamp, after the 32 bytes header and the first record
+    invalid = data;
+    const int64_t timestamp = 0;
+    memcpy(&invalid[32 + 24], &timestamp, sizeof(timestamp));
+    EXPECT_EQ(MelAggregator::PersistedState::fromData(invalid.data(), invalid.size()), nullptr);
+
+    // the last MEL record, of 1 value, ends past INT64_MAX
+    const auto history = createWeekOfHistory();
+    size_t melValues = 0;
+    history->foreachCachedMel([&melValues](const MelRecord& record) {
+        melValues += record.mels.size();
+    });
+    invalid = history->serialize();
+    ASSERT_NE(MelAggregator::PersistedState::fromData(invalid.data(), invalid.size()), nullptr);
+    const int64_t lastTimestamp = INT64_MAX;
+    memcpy(&invalid[invalid.size() - melValues * sizeof(float) - 16], &lastTimestamp,
+           sizeof(lastTimestamp));
+    EXPECT_EQ(MelAggregator::PersistedState::fromData(invalid.data(), invalid.size()), nullptr);
+}
+
 }  // namespace
 }  // namespace android
@@ -18,12 +18,18 @@
 #define LOG_TAG "audio_utils_mel_processor_tests"
 
 #include <audio_utils/MelProcessor.h>
+#include <audio_utils/format.h>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <log/log.h>
@@ -192,6 +198,106 @@ TEST_P(MelProcessorFixtureTest, AttenuationCheck) {
     }
 }
 
+// Records the MEL values per device, and the threads delivering them.
+class MelCallbackRecorder : public MelProcessor::MelCallback {
+public:
+    void onNewMelValues(const std::vector<float>& mels, size_t offset, size_t length,
+                        audio_port_handle_t deviceId) const override {
+        std::lock_guard l(mLock);
+        auto& deviceMels = mMels[deviceId];
+        deviceMels.insert(deviceMels.end(), mels.begin() + offset, mels.begin() + offset + length);
+        mThreadIds.insert(std::this_thread::get_id());
+        mMelCount += length;
+        mCondVar.notify_all();
+    }
+
+    void onMomentaryExposure(float, audio_port_handle_t) const override {}
+
+    bool waitForMels(size_t count) const {
+        std::unique_lock l(mLock);
+        return mCondVar.wait_for(l, std::chrono::seconds(5), [&] { return mMelCount >= count; });
+    }
+
+    mutable std::mutex mLock;
+    mutable std::condition_variable mCondVar;
+    mutable std::map<audio_port_handle_t, std::vector<float>> mMels;
+    mutable std::set<std::thread::id> mThreadIds;
+    mutable size_t mMelCount = 0;
+};
+
+TEST(MelProcessorTest, SharedExecutorKeepsDeviceOrder) {
+    constexpr int32_t kSampleRate = 8000;
+    constexpr size_t kProcessorCount = 8;
+    constexpr size_t kSeconds = 10;
+    constexpr size_t kThreadCount = 2;
+    auto executor = sp<MelProcessor::MelExecutor>::make(kThreadCount,
+                                                        std::chrono::milliseconds(10));
+    ASSERT_EQ(kThreadCount, executor->getThreadCount());
+    auto callback = sp<MelCallbackRecorder>::make();
+
+    std::vector<sp<MelProcessor>> processors;
+    for (size_t i = 0; i < kProcessorCount; ++i) {
+        processors.push_back(sp<MelProcessor>::make(kSampleRate, 1, AUDIO_FORMAT_PCM_FLOAT,
+                callback, static_cast<audio_port_handle_t>(i), 100.f, 1 /* maxMelsCallback */,
+                executor));
+    }
+
+    // Each second is louder than the previous one, all above RS1 and below RS2.
+    for (size_t second = 0; second < kSeconds; ++second) {
+        std::vector<float> buffer;
+        appendSineWaveBuffer(buffer, 1000.0f, kSampleRate, kSampleRate,
+                             0.1f * powf(1.2f, second));
+        for (auto& processor : processors) {
+            EXPECT_GT(processor->process(buffer.data(), buffer.size() * sizeof(float)), 0);
+        }
+    }
+
+    ASSERT_TRUE(callback->waitForMels(kProcessorCount * kSeconds));
+    std::lock_guard l(callback->mLock);
+    EXPECT_LE(callback->mThreadIds.size(), kThreadCount);
+    ASSERT_EQ(kProcessorCount, callback->mMels.size());
+    for (const auto& [deviceId, mels] : callback->mMels) {
+        ASSERT_EQ(kSeconds, mels.size()) << "device " << deviceId;
+        for (size_t i = 1; i < mels.size(); ++i) {
+            EXPECT_GT(mels[i], mels[i - 1]) << "device " << deviceId << " second " << i;
+        }
+    }
+}
+
+TEST(MelProcessorTest, FormatsAreEquivalent) {
+    constexpr int32_t kSampleRate = 48000;
+    constexpr uint32_t kChannelCount = 2;
+    constexpr size_t kMelCount = 2;
+    constexpr float kMelAccuracy = 0.1f;
+    std::vector<float> floatBuffer;
+    appendSineWaveBuffer(floatBuffer, 1000.0f, kSampleRate * kChannelCount * kMelCount,
+                         kSampleRate * kChannelCount, 0.3f);
+
+    std::map<audio_format_t, std::vector<float>> formatMels;
+    for (audio_format_t format : {AUDIO_FORMAT_PCM_FLOAT, AUDIO_FORMAT_PCM_8_BIT,
+            AUDIO_FORMAT_PCM_16_BIT, AUDIO_FORMAT_PCM_24_BIT_PACKED,
+            AUDIO_FORMAT_PCM_8_24_BIT, AUDIO_FORMAT_PCM_32_BIT}) {
+        std::vector<uint8_t> buffer(floatBuffer.size() * audio_bytes_per_sample(format));
+        memcpy_by_audio_format(buffer.data(), format, floatBuffer.data(), AUDIO_FORMAT_PCM_FLOAT,
+                               floatBuffer.size());
+        auto callback = sp<MelCallbackRecorder>::make();
+        auto processor = sp<MelProcessor>::make(kSampleRate, kChannelCount, format, callback,
+                                                1, 100.f, kMelCount);
+        EXPECT_EQ(static_cast<int32_t>(buffer.size()),
+                  processor->process(buffer.data(), buffer.size()));
+        ASSERT_TRUE(callback->waitForMels(kMelCount)) << "format " << format;
+        std::lock_guard l(callback->mLock);
+        formatMels[format] = callback->mMels[1];
+    }
+
+    const auto& floatMels = formatMels[AUDIO_FORMAT_PCM_FLOAT];
+    ASSERT_EQ(kMelCount, floatMels.size());
+    for (const auto& [format, mels] : formatMels) {
+        EXPECT_THAT(mels, testing::Pointwise(testing::FloatNear(kMelAccuracy), floatMels))
+                << "format " << format;
+    }
+}
+
 // A-weight filter loses precision around Nyquist frequency
 // Splitting into multiple suites that are capable to have an accurate
 // estimation for a-weight frequency response.
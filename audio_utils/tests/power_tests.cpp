@@ -19,6 +19,9 @@
 
 #include <cmath>
 #include <math.h>
+#include <random>
+#include <string.h>
+#include <vector>
 
 #include <audio_utils/power.h>
 #include <gtest/gtest.h>
@@ -162,6 +165,79 @@ TEST(audio_utils_power, power_mono_ramp) {
     }
 }
 
+// Reference energy of each channel, computed in double from the integer samples.
+template <typename T, typename F>
+std::vector<double> energyReference(const T* samples, size_t frames, size_t channels,
+                                    F toDouble) {
+    std::vector<double> energies(channels);
+    for (size_t i = 0; i < frames * channels; ++i) {
+        const double amplitude = toDouble(samples[i]);
+        energies[i % channels] += amplitude * amplitude;
+    }
+    return energies;
+}
+
+template <typename T, typename F>
+void testAccumulateEnergy(audio_format_t format, const std::vector<T>& samples,
+                          size_t channels, F toDouble) {
+    // also check an odd number of frames, and accumulating to existing values.
+    for (size_t frames : { size_t{0}, size_t{1}, size_t{7}, samples.size() / channels }) {
+        const std::vector<double> expected =
+                energyReference(samples.data(), frames, channels, toDouble);
+        std::vector<float> energies(channels, 1.f);
+        audio_utils_accumulate_energy(samples.data(), format, frames * channels, channels,
+                                      energies.data());
+        for (size_t c = 0; c < channels; ++c) {
+            EXPECT_NEAR(expected[c] + 1., energies[c], (expected[c] + 1.) * 1e-4)
+                    << "format " << format << " channels " << channels
+                    << " frames " << frames << " channel " << c;
+        }
+    }
+}
+
+TEST(audio_utils_power, accumulate_energy) {
+    constexpr size_t kFrames = 1001;
+    constexpr size_t kMaxChannels = 18;  // beyond the 16 channels with a vector path
+    constexpr size_t kSamples = kFrames * kMaxChannels;
+    std::minstd_rand gen(42);
+    std::uniform_int_distribution<int32_t> dist(INT32_MIN, INT32_MAX);
+
+    std::vector<float> f_ary(kSamples);
+    std::vector<uint8_t> u8_ary(kSamples);
+    std::vector<int16_t> i16_ary(kSamples);
+    std::vector<int32_t> i32_ary(kSamples);
+    std::vector<int32_t> q8_23_ary(kSamples);
+    std::vector<uint8x3_t> p24_ary(kSamples);
+    for (size_t i = 0; i < kSamples; ++i) {
+        // vary the level of the channels
+        const int32_t value = dist(gen) >> (i % 5);
+        f_ary[i] = value / 2147483648.f;
+        u8_ary[i] = (value >> 24) + 0x80;
+        i16_ary[i] = value >> 16;
+        i32_ary[i] = value;
+        q8_23_ary[i] = value >> 8;
+        const int32_t p24_value = value >> 8;
+        memcpy(&p24_ary[i], &p24_value, sizeof(uint8x3_t));  // little endian
+    }
+
+    for (size_t channels = 1; channels <= kMaxChannels; ++channels) {
+        testAccumulateEnergy(AUDIO_FORMAT_PCM_FLOAT, f_ary, channels,
+                [](float f) { return double(f); });
+        testAccumulateEnergy(AUDIO_FORMAT_PCM_8_BIT, u8_ary, channels,
+                [](uint8_t u8) { return (u8 - 0x80) / 128.; });
+        testAccumulateEnergy(AUDIO_FORMAT_PCM_16_BIT, i16_ary, channels,
+                [](int16_t i16) { return i16 / 32768.; });
+        testAccumulateEnergy(AUDIO_FORMAT_PCM_32_BIT, i32_ary, channels,
+                [](int32_t i32) { return i32 / 2147483648.; });
+        testAccumulateEnergy(AUDIO_FORMAT_PCM_8_24_BIT, q8_23_ary, channels,
+                [](int32_t q8_23) { return q8_23 / 8388608.; });
+        testAccumulateEnergy(AUDIO_FORMAT_PCM_24_BIT_PACKED, p24_ary, channels,
+                [](const uint8x3_t& p24) {
+                    return int32_t(p24.c[0] << 8 | p24.c[1] << 16 | p24.c[2] << 24)
+                            / 2147483648.; });
+    }
+}
+
 TEST(audio_utils_power, power_from) {
     EXPECT_EQ(0.f, audio_utils_power_from_amplitude(1.f));
     EXPECT_EQ(-INFINITY, audio_utils_power_from_amplitude(0.f));
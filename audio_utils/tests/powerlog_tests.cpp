@@ -17,10 +17,13 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "audio_utils_powerlog_tests"
 
+#include <atomic>
 #include <audio_utils/PowerLog.h>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <log/log.h>
+#include <sstream>
+#include <thread>
 
 using namespace android;
 
@@ -128,3 +131,61 @@ TEST(audio_utils_powerlog, c) {
    12-31 16:00:00.000: [  -12.0 ] sum(-12.0)
      */
 }
+
+TEST(audio_utils_powerlog, multiple_entries_per_log) {
+    auto plog = std::make_unique<PowerLog>(
+            48000 /* sampleRate */,
+            1 /* channelCount */,
+            AUDIO_FORMAT_PCM_16_BIT,
+            100 /* entries */,
+            1 /* framesPerEntry */);
+
+    // each frame of the buffer is a separate entry.
+    const int16_t buffer[] = { 0x4000 /* half */, 0x2000 /* quarter */ };
+    plog->log(buffer, 2 /* frames */, 0 /* nowNs */);
+
+    const std::string s = plog->dumpToString(
+            "" /* prefix */, 0 /* lines */, 0 /* limitNs */, false /* logPlot */);
+    EXPECT_NE(std::string::npos, s.find("-6.0  -12.0")) << s;
+}
+
+TEST(audio_utils_powerlog, dump_while_logging) {
+    constexpr size_t kEntries = 100;
+    auto plog = std::make_unique<PowerLog>(
+            48000 /* sampleRate */,
+            1 /* channelCount */,
+            AUDIO_FORMAT_PCM_16_BIT,
+            kEntries,
+            1 /* framesPerEntry */);
+
+    const int16_t half = 0x4000;
+    std::atomic_bool done = false;
+    std::thread writer([&] {
+        // wrap around the entries many times while dumping.
+        for (int64_t nowNs = 1; nowNs <= 100 * (int64_t)kEntries; ++nowNs) {
+            plog->log(&half, 1 /* frame */, nowNs);
+        }
+        done = true;
+    });
+    size_t dumps = 0;
+    while (!done || dumps == 0) {
+        const std::string s = plog->dumpToString(
+                "" /* prefix */, 0 /* lines */, 0 /* limitNs */, false /* logPlot */);
+        // every entry of the snapshot has the logged power, skipping the header line.
+        std::istringstream lines(s);
+        std::string line;
+        std::getline(lines, line);
+        while (std::getline(lines, line)) {
+            // after the time "MM-DD hh:mm:ss.SSS: " up to the optional " ] sum(...)".
+            const size_t begin = line.find(": ");
+            ASSERT_NE(std::string::npos, begin) << s;
+            std::istringstream values(line.substr(begin + 2, line.find(']') - begin - 2));
+            for (std::string value; values >> value; ) {
+                if (value == "[") continue;
+                ASSERT_EQ("-6.0", value) << s;
+            }
+        }
+        ++dumps;
+    }
+    writer.join();
+}
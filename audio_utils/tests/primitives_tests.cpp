@@ -859,3 +859,82 @@ TEST(audio_utils_primitives, MemcpyToFloatFromFloatWithClamping) {
 
     ASSERT_EQ(dst, expected) << "src=" << testing::PrintToString(src);
 }
+
+// The memcpy_to_* converters may process full blocks with SIMD, followed by a scalar
+// remainder. Check them against the per-sample inline conversions for counts that are
+// not a multiple of any block size, with values that exercise rounding and clamping.
+TEST(audio_utils_primitives, MemcpyMatchesPerSampleConversion) {
+    constexpr size_t kMaxCount = 67;
+    std::vector<float> fsrc(kMaxCount);
+    for (size_t i = 0; i < kMaxCount; ++i) {
+        // Spans beyond [-1, 1] and hits exact half LSB values of 16 bit.
+        fsrc[i] = ((float)i - kMaxCount / 2) * (2.5f / kMaxCount) + 0.5f / (1 << 15);
+    }
+    std::vector<int32_t> i32src(kMaxCount);
+    for (size_t i = 0; i < kMaxCount; ++i) {
+        i32src[i] = (int32_t)(i * 0x9e3779b9u);  // covers the full int32 range
+    }
+
+    for (size_t count = 0; count <= kMaxCount; ++count) {
+        std::vector<int16_t> i16(count);
+        memcpy_to_i16_from_float(i16.data(), fsrc.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(clamp16_from_float(fsrc[i]), i16[i]) << "count=" << count << " i=" << i;
+        }
+
+        std::vector<uint8_t> u8(count);
+        memcpy_to_u8_from_float(u8.data(), fsrc.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(clamp8_from_float(fsrc[i]), u8[i]) << "count=" << count << " i=" << i;
+        }
+
+        std::vector<int32_t> q8_23(count);
+        memcpy_to_q8_23_from_float_with_clamp(q8_23.data(), fsrc.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(clamp24_from_float(fsrc[i]), q8_23[i]) << "count=" << count << " i=" << i;
+        }
+
+        std::vector<int32_t> i32(count);
+        memcpy_to_i32_from_float(i32.data(), fsrc.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(clamp32_from_float(fsrc[i]), i32[i]) << "count=" << count << " i=" << i;
+        }
+
+        std::vector<float> f(count);
+        memcpy_to_float_from_i32(f.data(), i32src.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(float_from_i32(i32src[i]), f[i]) << "count=" << count << " i=" << i;
+        }
+
+        std::vector<uint8_t> p24(count * 3);
+        memcpy_to_p24_from_i32(p24.data(), i32src.data(), count);
+        std::vector<int32_t> i32back(count);
+        memcpy_to_i32_from_p24(i32back.data(), p24.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(i32src[i] & ~0xff, i32back[i]) << "count=" << count << " i=" << i;
+        }
+    }
+}
+
+// Expanding converters work from the end of the buffer so that they may be used in place.
+TEST(audio_utils_primitives, MemcpyInPlaceExpanding) {
+    constexpr size_t kCount = 37;
+    std::vector<int16_t> i16src(kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+        i16src[i] = (int16_t)(i * 1871 - 32768);
+    }
+
+    std::vector<int32_t> buffer(kCount);  // large enough for float, int32 and p24
+    memcpy(buffer.data(), i16src.data(), kCount * sizeof(int16_t));
+    memcpy_to_float_from_i16((float *)buffer.data(), (int16_t *)buffer.data(), kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+        ASSERT_EQ(float_from_i16(i16src[i]), ((float *)buffer.data())[i]) << "i=" << i;
+    }
+
+    memcpy(buffer.data(), i16src.data(), kCount * sizeof(int16_t));
+    memcpy_to_p24_from_i16((uint8_t *)buffer.data(), (int16_t *)buffer.data(), kCount);
+    memcpy_to_i32_from_p24(buffer.data(), (uint8_t *)buffer.data(), kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+        ASSERT_EQ(i16src[i] << 16, buffer[i]) << "i=" << i;
+    }
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_resampler_tests"
+#include <log/log.h>
+
+#include <errno.h>
+#include <math.h>
+#include <vector>
+
+#include <audio_utils/primitives.h>
+#include <audio_utils/resampler.h>
+#include <gtest/gtest.h>
+#include <system/audio.h>
+
+static constexpr uint32_t kChannelCount = 2;
+static constexpr double kFrequency = 1000.;
+static constexpr double kAmplitude = 0.5;
+
+// Returns a stereo sine wave, with the right channel the inverse of the left channel.
+static std::vector<float> generateSine(uint32_t sampleRate, size_t frames) {
+    std::vector<float> sine(frames * kChannelCount);
+    for (size_t i = 0; i < frames; ++i) {
+        sine[i * kChannelCount] = kAmplitude * sin(2 * M_PI * kFrequency * i / sampleRate);
+        sine[i * kChannelCount + 1] = -sine[i * kChannelCount];
+    }
+    return sine;
+}
+
+// Resamples with resample_from_input_format() in chunks of the given size.
+static std::vector<float> resample(struct resampler_itfe *resampler,
+        const std::vector<float>& in, size_t chunkFrames) {
+    std::vector<float> out(in.size() * 8 + 1024);  // upsampling by at most 8
+    const size_t inFrames = in.size() / kChannelCount;
+    const size_t outCapacity = out.size() / kChannelCount;
+    size_t framesRd = 0;
+    size_t framesWr = 0;
+    while (framesRd < inFrames) {
+        size_t inFrameCount = std::min(chunkFrames, inFrames - framesRd);
+        size_t outFrameCount = std::min(chunkFrames, outCapacity - framesWr);
+        EXPECT_EQ(0, resampler->resample_from_input_format(resampler,
+                &in[framesRd * kChannelCount], &inFrameCount,
+                &out[framesWr * kChannelCount], &outFrameCount));
+        if (inFrameCount == 0 && outFrameCount == 0) {
+            ADD_FAILURE() << "no progress";
+            break;
+        }
+        framesRd += inFrameCount;
+        framesWr += outFrameCount;
+    }
+    out.resize(framesWr * kChannelCount);
+    return out;
+}
+
+// Returns the signal to noise ratio in dB of a resampled sine, excluding the start and end.
+static double sineSnr(const std::vector<float>& out, uint32_t outSampleRate) {
+    const size_t frames = out.size() / kChannelCount;
+    double signal = 0.;
+    double noise = 0.;
+    for (size_t i = frames / 4; i < frames * 3 / 4; ++i) {
+        // The first output frame is at input time 0.
+        const double expected = kAmplitude * sin(2 * M_PI * kFrequency * i / outSampleRate);
+        for (uint32_t channel = 0; channel < kChannelCount; ++channel) {
+            const double value = channel == 0 ? expected : -expected;
+            const double error = out[i * kChannelCount + channel] - value;
+            signal += value * value;
+            noise += error * error;
+        }
+    }
+    return 10. * log10(signal / noise);
+}
+
+TEST(resampler_tests, invalid_arguments) {
+    struct resampler_itfe *resampler;
+    EXPECT_EQ(-EINVAL, create_resampler_format(48000, 44100, kChannelCount,
+            AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_MAX, NULL, &resampler));
+    EXPECT_EQ(nullptr, resampler);
+    EXPECT_EQ(-EINVAL, create_resampler_format(48000, 44100, 0,
+            AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT, NULL, &resampler));
+    EXPECT_EQ(-EINVAL, create_resampler_format(0, 44100, kChannelCount,
+            AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT, NULL, &resampler));
+    EXPECT_EQ(-EINVAL, create_resampler_format(48000, 44100, kChannelCount,
+            AUDIO_FORMAT_PCM_8_BIT, RESAMPLER_QUALITY_DEFAULT, NULL, &resampler));
+    // too many phases
+    EXPECT_EQ(-EINVAL, create_resampler_format(11025, 192000, kChannelCount,
+            AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT, NULL, &resampler));
+
+    ASSERT_EQ(0, create_resampler_format(48000, 44100, kChannelCount,
+            AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT, NULL, &resampler));
+    int16_t buffer[kChannelCount];
+    size_t inFrameCount = 1;
+    size_t outFrameCount = 1;
+    // only 16 bit resamplers may be used with the int16_t methods
+    EXPECT_EQ(-EINVAL, resampler->resample_from_input(resampler,
+            buffer, &inFrameCount, buffer, &outFrameCount));
+    // no provider
+    EXPECT_EQ(-ENOSYS, resampler->resample_from_provider_format(resampler,
+            buffer, &outFrameCount));
+    EXPECT_EQ(0u, outFrameCount);
+    release_resampler(resampler);
+}
+
+class ResamplerQualityTest : public ::testing::TestWithParam<
+        std::tuple<uint32_t /* inSampleRate */, uint32_t /* outSampleRate */>> {
+};
+
+TEST_P(ResamplerQualityTest, sine_snr) {
+    const auto [inSampleRate, outSampleRate] = GetParam();
+    const std::vector<float> in = generateSine(inSampleRate, inSampleRate / 4);
+    for (uint32_t quality = RESAMPLER_QUALITY_MIN + 1; quality < RESAMPLER_QUALITY_MAX;
+            ++quality) {
+        struct resampler_itfe *resampler;
+        ASSERT_EQ(0, create_resampler_format(inSampleRate, outSampleRate, kChannelCount,
+                AUDIO_FORMAT_PCM_FLOAT, quality, NULL, &resampler));
+        const double snr = sineSnr(resample(resampler, in, 100), outSampleRate);
+        release_resampler(resampler);
+        ALOGD("%u to %u quality %u snr %f", inSampleRate, outSampleRate, quality, snr);
+        // a 1 kHz sine is in the passband at every quality
+        EXPECT_GT(snr, quality >= RESAMPLER_QUALITY_DEFAULT ? 80. : 60.) << "quality " << quality;
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        ResamplerQualityTestAll, ResamplerQualityTest,
+        ::testing::Values(
+                std::make_tuple(44100, 48000),
+                std::make_tuple(48000, 44100),
+                std::make_tuple(48000, 16000),
+                std::make_tuple(8000, 48000),
+                std::make_tuple(48000, 48000)));
+
+TEST(resampler_tests, formats) {
+    const uint32_t inSampleRate = 44100;
+    const uint32_t outSampleRate = 48000;
+    const std::vector<float> in = generateSine(inSampleRate, 4410);
+    struct resampler_itfe *resampler;
+    ASSERT_EQ(0, create_resampler_format(inSampleRate, outSampleRate, kChannelCount,
+            AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT, NULL, &resampler));
+    const std::vector<float> expected = resample(resampler, in, in.size());
+    release_resampler(resampler);
+    const size_t inFrames = in.size() / kChannelCount;
+
+    // 16 bit through the int16_t methods
+    std::vector<int16_t> in16(in.size());
+    memcpy_to_i16_from_float(in16.data(), in.data(), in.size());
+    std::vector<int16_t> out16(expected.size());
+    ASSERT_EQ(0, create_resampler_format(inSampleRate, outSampleRate, kChannelCount,
+            AUDIO_FORMAT_PCM_16_BIT, RESAMPLER_QUALITY_DEFAULT, NULL, &resampler));
+    size_t inFrameCount = inFrames;
+    size_t outFrameCount = expected.size() / kChannelCount;
+    ASSERT_EQ(0, resampler->resample_from_input(resampler,
+            in16.data(), &inFrameCount, out16.data(), &outFrameCount));
+    release_resampler(resampler);
+    ASSERT_EQ(expected.size() / kChannelCount, outFrameCount);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_NEAR(expected[i], float_from_i16(out16[i]), 2. / (1 << 15)) << "i " << i;
+    }
+
+    // 32 bit keeps the precision of float
+    std::vector<int32_t> in32(in.size());
+    memcpy_to_i32_from_float(in32.data(), in.data(), in.size());
+    std::vector<int32_t> out32(expected.size());
+    ASSERT_EQ(0, create_resampler_format(inSampleRate, outSampleRate, kChannelCount,
+            AUDIO_FORMAT_PCM_32_BIT, RESAMPLER_QUALITY_DEFAULT, NULL, &resampler));
+    inFrameCount = inFrames;
+    outFrameCount = expected.size() / kChannelCount;
+    ASSERT_EQ(0, resampler->resample_from_input_format(resampler,
+            in32.data(), &inFrameCount, out32.data(), &outFrameCount));
+    release_resampler(resampler);
+    ASSERT_EQ(expected.size() / kChannelCount, outFrameCount);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_NEAR(expected[i], float_from_i32(out32[i]), 1e-6) << "i " << i;
+    }
+}
+
+struct TestProvider {
+    struct resampler_buffer_provider provider;
+    const std::vector<float> *in;
+    size_t framesRd;
+    size_t chunkFrames;
+};
+
+static int getNextBuffer(struct resampler_buffer_provider *provider,
+        struct resampler_buffer *buffer) {
+    TestProvider *test = (TestProvider *) provider;
+    const size_t available = test->in->size() / kChannelCount - test->framesRd;
+    buffer->frame_count = std::min({buffer->frame_count, available, test->chunkFrames});
+    buffer->f32 = buffer->frame_count == 0 ? nullptr :
+            const_cast<float *>(&(*test->in)[test->framesRd * kChannelCount]);
+    return 0;
+}
+
+static void releaseBuffer(struct resampler_buffer_provider *provider,
+        struct resampler_buffer *buffer) {
+    TestProvider *test = (TestProvider *) provider;
+    test->framesRd += buffer->frame_count;
+}
+
+TEST(resampler_tests, provider) {
+    const uint32_t inSampleRate = 48000;
+    const uint32_t outSampleRate = 44100;
+    const std::vector<float> in = generateSine(inSampleRate, 4800);
+    struct resampler_itfe *resampler;
+    ASSERT_EQ(0, create_resampler_format(inSampleRate, outSampleRate, kChannelCount,
+            AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT, NULL, &resampler));
+    const std::vector<float> expected = resample(resampler, in, 1);
+    release_resampler(resampler);
+
+    TestProvider test{{getNextBuffer, releaseBuffer}, &in, 0, 37};
+    ASSERT_EQ(0, create_resampler_format(inSampleRate, outSampleRate, kChannelCount,
+            AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT, &test.provider, &resampler));
+    std::vector<float> out(expected.size());
+    size_t framesWr = 0;
+    while (framesWr < out.size() / kChannelCount) {
+        size_t outFrameCount = std::min((size_t) 111, out.size() / kChannelCount - framesWr);
+        ASSERT_EQ(0, resampler->resample_from_provider_format(resampler,
+                &out[framesWr * kChannelCount], &outFrameCount));
+        ASSERT_GT(outFrameCount, 0u);
+        framesWr += outFrameCount;
+    }
+    release_resampler(resampler);
+    EXPECT_EQ(expected, out);
+}
+
+TEST(resampler_tests, delay_ns) {
+    const uint32_t inSampleRate = 44100;
+    const uint32_t outSampleRate = 48000;
+    struct resampler_itfe *resampler;
+    ASSERT_EQ(0, create_resampler_format(inSampleRate, outSampleRate, kChannelCount,
+            AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT, NULL, &resampler));
+    EXPECT_EQ(0, resampler->delay_ns(resampler));
+
+    const std::vector<float> in = generateSine(inSampleRate, 1000);
+    std::vector<float> out(in.size() * 2);
+    int64_t framesRd = 0;
+    int64_t framesWr = 0;
+    for (size_t chunk = 1; chunk < 64; chunk += 7) {
+        size_t inFrameCount = chunk;
+        size_t outFrameCount = chunk;
+        ASSERT_EQ(0, resampler->resample_from_input_format(resampler,
+                in.data(), &inFrameCount, out.data(), &outFrameCount));
+        framesRd += inFrameCount;
+        framesWr += outFrameCount;
+        // from the input time of the next output frame to the end of the input consumed
+        const int64_t expected = (framesRd * outSampleRate - framesWr * inSampleRate)
+                * 1000000000 / ((int64_t) inSampleRate * outSampleRate);
+        EXPECT_EQ(expected, resampler->delay_ns(resampler)) << "chunk " << chunk;
+    }
+
+    resampler->reset(resampler);
+    EXPECT_EQ(0, resampler->delay_ns(resampler));
+    release_resampler(resampler);
+}
@@ -0,0 +1,344 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <system/camera_metadata.h>
+#include <system/camera_metadata_pool.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+/*
+Time to find each entry of a metadata buffer, and as many missing tags as a fourth of
+the entries, as done for the capture requests and results.
+
+The first argument is the number of entries, 60 for a typical capture request and 180
+for a capture result. The second argument is 0 for an unsorted buffer, 1 for a sorted
+one and 2 for an unsorted buffer allocated with allocate_indexed_camera_metadata().
+
+On a single core x86_64 host, median of 5 repetitions, before the tag index:
+
+BM_CameraMetadataFind/60/0        2135 ns
+BM_CameraMetadataFind/60/1         740 ns
+BM_CameraMetadataFind/180/0      13255 ns
+BM_CameraMetadataFind/180/1       2616 ns
+
+and with it:
+
+BM_CameraMetadataFind/60/0        1462 ns
+BM_CameraMetadataFind/60/1         801 ns
+BM_CameraMetadataFind/60/2         493 ns
+BM_CameraMetadataFind/180/0      11492 ns
+BM_CameraMetadataFind/180/1       2682 ns
+BM_CameraMetadataFind/180/2       1289 ns
+
+The time of an indexed lookup depends neither on the sort order nor on the number
+of entries.
+*/
+
+// Returns count tags of different sections, in random order.
+static std::vector<uint32_t> getTags(size_t count, std::minstd_rand& gen) {
+    std::vector<uint32_t> tags;
+    for (int i = 0; i < ANDROID_SECTION_COUNT; i++) {
+        for (uint32_t tag = camera_metadata_section_bounds[i][0];
+                tag < camera_metadata_section_bounds[i][1]; tag++) {
+            tags.push_back(tag);
+        }
+    }
+    std::shuffle(tags.begin(), tags.end(), gen);
+    tags.resize(std::min(count, tags.size()));
+    return tags;
+}
+
+static void BM_CameraMetadataFind(benchmark::State& state) {
+    const size_t entryCount = state.range(0);
+    const int mode = state.range(1);
+    std::minstd_rand gen(42);
+    // The missing tags come after the present ones.
+    const std::vector<uint32_t> tags = getTags(entryCount + entryCount / 4, gen);
+
+    camera_metadata_t* metadata = mode == 2
+            ? allocate_indexed_camera_metadata(entryCount, entryCount * 8)
+            : allocate_camera_metadata(entryCount, entryCount * 8);
+    const int64_t value = 0;
+    for (size_t i = 0; i < entryCount; ++i) {
+        add_camera_metadata_entry(metadata, tags[i], &value, 1);
+    }
+    if (mode == 1) sort_camera_metadata(metadata);
+
+    size_t found = 0;
+    for (auto _ : state) {
+        for (const uint32_t tag : tags) {
+            camera_metadata_ro_entry_t entry;
+            found += find_camera_metadata_ro_entry(metadata, tag, &entry) == 0;
+            benchmark::DoNotOptimize(entry);
+        }
+    }
+    if (found != entryCount * state.iterations()) {
+        state.SkipWithError("wrong find results");
+    }
+    state.SetItemsProcessed(state.iterations() * tags.size());
+    free_camera_metadata(metadata);
+}
+
+BENCHMARK(BM_CameraMetadataFind)->ArgsProduct({{60, 180}, {0, 1, 2}});
+
+/*
+Time to copy and sort a metadata buffer with entries added in random order, the argument
+is the number of entries.
+
+On a single core x86_64 host, median of 5 repetitions, with qsort():
+
+BM_CameraMetadataSort/60          1835 ns
+BM_CameraMetadataSort/180         8173 ns
+BM_CameraMetadataSort/400        13499 ns
+
+and with the insertion and radix sorts:
+
+BM_CameraMetadataSort/60           456 ns
+BM_CameraMetadataSort/180         2312 ns
+BM_CameraMetadataSort/400         3144 ns
+*/
+static void BM_CameraMetadataSort(benchmark::State& state) {
+    const size_t entryCount = state.range(0);
+    std::minstd_rand gen(42);
+    const std::vector<uint32_t> tags = getTags(entryCount, gen);
+
+    camera_metadata_t* unsorted = allocate_camera_metadata(entryCount, entryCount * 8);
+    const int64_t value = 0;
+    for (const uint32_t tag : tags) {
+        add_camera_metadata_entry(unsorted, tag, &value, 1);
+    }
+    const size_t size = get_camera_metadata_size(unsorted);
+    std::vector<uint64_t> buffer(size / sizeof(uint64_t));
+
+    for (auto _ : state) {
+        camera_metadata_t* metadata =
+                copy_camera_metadata(buffer.data(), size, unsorted);
+        sort_camera_metadata(metadata);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * entryCount);
+    free_camera_metadata(unsorted);
+}
+
+BENCHMARK(BM_CameraMetadataSort)->Arg(60)->Arg(180)->Arg(400);
+
+/*
+Time to rewrite the keys of a capture result, as a framework does for each result: the
+sizes of 40 entries change and 4 entries are deleted and added again. The first argument
+is the number of entries, the second is 1 with lazy compaction, 0 without.
+
+On a single core x86_64 host, median of 5 repetitions:
+
+BM_CameraMetadataRewrite/60/0        8721 ns
+BM_CameraMetadataRewrite/60/1        1931 ns
+BM_CameraMetadataRewrite/180/0      18883 ns
+BM_CameraMetadataRewrite/180/1       3136 ns
+
+Without lazy compaction, each size change moves the data behind the entry and rewrites
+the offsets of the following entries.
+*/
+static void BM_CameraMetadataRewrite(benchmark::State& state) {
+    const size_t entryCount = state.range(0);
+    const bool lazy = state.range(1) != 0;
+    constexpr size_t kUpdates = 40;
+    constexpr size_t kDeletes = 4;
+    constexpr size_t kMaxCount = 6;
+    std::minstd_rand gen(42);
+    const std::vector<uint32_t> tags = getTags(entryCount, gen);
+
+    // Room for all the entries with the largest data, and as much for the holes.
+    camera_metadata_t* metadata =
+            allocate_camera_metadata(entryCount, 2 * entryCount * kMaxCount * 8);
+    set_camera_metadata_lazy_compaction(metadata, lazy);
+    const std::vector<int64_t> data(kMaxCount);
+    for (const uint32_t tag : tags) {
+        add_camera_metadata_entry(metadata, tag, data.data(), kMaxCount - 2);
+    }
+
+    size_t frame = 0;
+    for (auto _ : state) {
+        const size_t count = kMaxCount - frame % 3;
+        for (size_t i = 0; i < kUpdates; ++i) {
+            const uint32_t tag = tags[(frame + i * 7) % entryCount];
+            camera_metadata_entry_t entry;
+            if (find_camera_metadata_entry(metadata, tag, &entry) != 0 ||
+                    update_camera_metadata_entry(metadata, entry.index, data.data(), count,
+                            nullptr) != 0) {
+                state.SkipWithError("update failed");
+                break;
+            }
+        }
+        for (size_t i = 0; i < kDeletes; ++i) {
+            const uint32_t tag = tags[(frame + i * 13) % entryCount];
+            camera_metadata_entry_t entry;
+            if (find_camera_metadata_entry(metadata, tag, &entry) != 0 ||
+                    delete_camera_metadata_entry(metadata, entry.index) != 0 ||
+                    add_camera_metadata_entry(metadata, tag, data.data(), count) != 0) {
+                state.SkipWithError("delete failed");
+                break;
+            }
+        }
+        ++frame;
+    }
+    state.SetItemsProcessed(state.iterations() * (kUpdates + kDeletes));
+    free_camera_metadata(metadata);
+}
+
+BENCHMARK(BM_CameraMetadataRewrite)->ArgsProduct({{60, 180}, {0, 1}});
+
+/*
+Cost of sending successive capture results, where only some of the entries change from
+one result to the next. The first argument is the number of entries, the second the
+number of changed entries. BM_CameraMetadataCopy copies each whole sorted result, and
+BM_CameraMetadataDiff creates the diff from the previous result and applies it, as the
+receiving side does. The bytes counter is the size of what is sent.
+
+On a single core x86_64 host, median of 5 repetitions:
+
+BM_CameraMetadataCopy/180/10        55.5 ns   bytes=5.184k
+BM_CameraMetadataCopy/180/40        69.2 ns   bytes=5.184k
+BM_CameraMetadataDiff/180/10        3821 ns   bytes=392
+BM_CameraMetadataDiff/180/40        4127 ns   bytes=1.128k
+
+The diff is 5 to 13 times smaller than the result, for about 2 us on each side, which
+pays off when the cost of sending a result grows with its size.
+*/
+
+// Returns two capture results of entryCount sorted entries, with changedCount different.
+static std::pair<camera_metadata_t*, camera_metadata_t*> createResults(size_t entryCount,
+        size_t changedCount) {
+    constexpr size_t kCount = 4;
+    std::minstd_rand gen(42);
+    const std::vector<uint32_t> tags = getTags(entryCount, gen);
+    camera_metadata_t* previous = allocate_camera_metadata(entryCount, entryCount * kCount * 8);
+    camera_metadata_t* next = allocate_camera_metadata(entryCount, entryCount * kCount * 8);
+    std::vector<int64_t> data(kCount);
+    for (size_t i = 0; i < entryCount; ++i) {
+        add_camera_metadata_entry(previous, tags[i], data.data(), kCount);
+        data[0] += i < changedCount;
+        add_camera_metadata_entry(next, tags[i], data.data(), kCount);
+    }
+    sort_camera_metadata(previous);
+    sort_camera_metadata(next);
+    return {previous, next};
+}
+
+static void BM_CameraMetadataCopy(benchmark::State& state) {
+    auto [previous, next] = createResults(state.range(0), state.range(1));
+    const size_t size = get_camera_metadata_compact_size(next);
+    std::vector<uint64_t> buffer(size / sizeof(uint64_t));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(copy_camera_metadata(buffer.data(), size, next));
+        benchmark::ClobberMemory();
+    }
+    state.counters["bytes"] = size;
+    free_camera_metadata(next);
+    free_camera_metadata(previous);
+}
+
+static void BM_CameraMetadataDiff(benchmark::State& state) {
+    auto [previous, next] = createResults(state.range(0), state.range(1));
+    size_t size = 0;
+    for (auto _ : state) {
+        camera_metadata_diff_t* diff = allocate_camera_metadata_diff(previous, next);
+        camera_metadata_t* applied = apply_camera_metadata_diff(previous, diff);
+        if (applied == nullptr) {
+            state.SkipWithError("cannot apply the diff");
+            break;
+        }
+        size = get_camera_metadata_diff_size(diff);
+        free_camera_metadata(applied);
+        free_camera_metadata_diff(diff);
+    }
+    state.counters["bytes"] = size;
+    free_camera_metadata(next);
+    free_camera_metadata(previous);
+}
+
+BENCHMARK(BM_CameraMetadataCopy)->ArgsProduct({{180}, {10, 40}});
+BENCHMARK(BM_CameraMetadataDiff)->ArgsProduct({{180}, {10, 40}});
+
+/*
+Allocation churn of capture results: each iteration clones a result of 120 to 240 entries,
+and frees the oldest of the 8 results in flight. The argument is 0 to clone from the heap,
+1 to clone from a camera_metadata_pool_t. The counters are the hit rate and fragmentation
+of the pool.
+
+On a single core x86_64 host with glibc, median of 9 repetitions:
+
+BM_CameraMetadataChurn/0         108 ns
+BM_CameraMetadataChurn/1        88.8 ns   fragmentation=0.128 hit_rate=1
+
+All the allocations but the first ones reuse a buffer. The pool saves the zeroing of
+the buffers, and the heap allocator calls, whose cost depends on the allocator and on
+the other allocations of the process.
+*/
+static void BM_CameraMetadataChurn(benchmark::State& state) {
+    const bool pooled = state.range(0) != 0;
+    constexpr size_t kInFlight = 8;
+    std::minstd_rand gen(42);
+    std::vector<camera_metadata_t*> results;
+    for (size_t entryCount = 120; entryCount <= 240; entryCount += 40) {
+        const std::vector<uint32_t> tags = getTags(entryCount, gen);
+        camera_metadata_t* result = allocate_camera_metadata(entryCount, entryCount * 32);
+        const std::vector<int64_t> data(4);
+        for (const uint32_t tag : tags) {
+            add_camera_metadata_entry(result, tag, data.data(), gen() % 5);
+        }
+        results.push_back(result);
+    }
+
+    camera_metadata_pool_t* pool = create_camera_metadata_pool(1 << 20);
+    std::vector<camera_metadata_t*> inFlight(kInFlight);
+    size_t frame = 0;
+    for (auto _ : state) {
+        camera_metadata_t*& slot = inFlight[frame % kInFlight];
+        if (pooled) {
+            release_camera_metadata_to_pool(pool, slot);
+            slot = clone_camera_metadata_from_pool(pool, results[frame % results.size()]);
+        } else {
+            free_camera_metadata(slot);
+            slot = clone_camera_metadata(results[frame % results.size()]);
+        }
+        ++frame;
+    }
+    if (pooled) {
+        camera_metadata_pool_stats_t stats;
+        get_camera_metadata_pool_stats(pool, &stats);
+        state.counters["hit_rate"] = (double)stats.hits / stats.allocations;
+        state.counters["fragmentation"] =
+                1. - (double)stats.outstanding_packet_bytes / stats.outstanding_bytes;
+    }
+    for (camera_metadata_t* result : inFlight) {
+        if (pooled) {
+            release_camera_metadata_to_pool(pool, result);
+        } else {
+            free_camera_metadata(result);
+        }
+    }
+    destroy_camera_metadata_pool(pool);
+    for (camera_metadata_t* result : results) {
+        free_camera_metadata(result);
+    }
+}
+
+BENCHMARK(BM_CameraMetadataChurn)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
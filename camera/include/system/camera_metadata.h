@@ -149,6 +149,15 @@ extern const char* camera_metadata_type_names[NUM_TYPES];
 struct camera_metadata;
 typedef struct camera_metadata camera_metadata_t;
 
+/**
+ * A diff between two packets of metadata, with the entries added, removed and
+ * changed from one to the other. Like a packet, it is contiguous in memory,
+ * with size in bytes given by get_camera_metadata_diff_size(), so it can be
+ * sent to another process instead of the whole next packet.
+ */
+struct camera_metadata_diff;
+typedef struct camera_metadata_diff camera_metadata_diff_t;
+
 /**
  * Functions for manipulating camera metadata
  * =============================================================================
@@ -202,9 +211,35 @@ camera_metadata_t *place_camera_metadata(void *dst, size_t dst_size,
         size_t entry_capacity,
         size_t data_capacity);
 
+/**
+ * Allocate a new camera_metadata structure like allocate_camera_metadata(), but
+ * with room for a hash table from tags to entries after the data, so that
+ * find_camera_metadata_entry() takes constant time whether the entries are
+ * sorted or not. The table is kept up to date by adding, appending, updating,
+ * deleting and sorting entries, and by clone_camera_metadata(). It is not
+ * part of the compact size, so copy_camera_metadata() does not keep it.
+ *
+ * Returns NULL if entry_capacity is too large to be indexed.
+ */
+ANDROID_API
+camera_metadata_t *allocate_indexed_camera_metadata(size_t entry_capacity,
+        size_t data_capacity);
+
+/**
+ * Place an indexed camera metadata structure, see
+ * allocate_indexed_camera_metadata(), into an existing buffer of at least
+ * calculate_indexed_camera_metadata_size() bytes. Otherwise the same as
+ * place_camera_metadata().
+ */
+ANDROID_API
+camera_metadata_t *place_indexed_camera_metadata(void *dst, size_t dst_size,
+        size_t entry_capacity,
+        size_t data_capacity);
+
 /**
  * Free a camera_metadata structure. Should only be used with structures
- * allocated with allocate_camera_metadata().
+ * allocated with allocate_camera_metadata() or
+ * allocate_indexed_camera_metadata().
  */
 ANDROID_API
 void free_camera_metadata(camera_metadata_t *metadata);
@@ -217,6 +252,15 @@ ANDROID_API
 size_t calculate_camera_metadata_size(size_t entry_count,
         size_t data_count);
 
+/**
+ * Calculate the buffer size needed for an indexed metadata structure of
+ * entry_count metadata entries, needing a total of data_count bytes of extra
+ * data storage. Returns 0 if entry_count is too large to be indexed.
+ */
+ANDROID_API
+size_t calculate_indexed_camera_metadata_size(size_t entry_count,
+        size_t data_count);
+
 /**
  * Get current size of entire metadata structure in bytes, including reserved
  * but unused space.
@@ -392,7 +436,8 @@ int get_camera_metadata_ro_entry(const camera_metadata_t *src,
  *
  * If multiple entries with the same tag exist, does not have any guarantees on
  * which is returned. To speed up searching for tags, sort the metadata
- * structure first by calling sort_camera_metadata().
+ * structure first by calling sort_camera_metadata(), or allocate it with
+ * allocate_indexed_camera_metadata().
  */
 ANDROID_API
 int find_camera_metadata_entry(camera_metadata_t *src,
@@ -409,9 +454,9 @@ int find_camera_metadata_ro_entry(const camera_metadata_t *src,
 
 /**
  * Delete an entry at given index. This is an expensive operation, since it
- * requires repacking entries and possibly entry data. This also invalidates any
- * existing camera_metadata_entry.data pointers to this buffer. Sorting is
- * maintained.
+ * requires repacking entries and possibly entry data, unless lazy compaction is
+ * enabled. This also invalidates any existing camera_metadata_entry.data
+ * pointers to this buffer. Sorting is maintained.
  */
 ANDROID_API
 int delete_camera_metadata_entry(camera_metadata_t *dst,
@@ -419,8 +464,9 @@ int delete_camera_metadata_entry(camera_metadata_t *dst,
 
 /**
  * Updates a metadata entry with new data. If the data size is changing, may
- * need to adjust the data array, making this an O(N) operation. If the data
- * size is the same or still fits in the entry space, this is O(1). Maintains
+ * need to adjust the data array, making this an O(N) operation, or O(1)
+ * amortized with lazy compaction. If the data size is the same or still fits
+ * in the entry space, this is O(1). Maintains
  * sorting, but invalidates camera_metadata_entry instances that point to the
  * updated entry. If a non-NULL value is passed in to entry, the entry structure
  * is updated to match the new buffer state.  Returns a non-zero value if there
@@ -433,6 +479,102 @@ int update_camera_metadata_entry(camera_metadata_t *dst,
         size_t data_count,
         camera_metadata_entry_t *updated_entry);
 
+/**
+ * Enable or disable lazy data compaction. When enabled, deleting an entry or
+ * changing the size of its data leaves a hole in the data instead of moving the
+ * data of the other entries, so that its cost no longer grows with the data
+ * and the number of entries, besides moving the entries that follow a deleted
+ * one. The holes are reclaimed by compacting the data, which happens when they
+ * make up more than half of the data, when more room is needed, or with
+ * compact_camera_metadata().
+ *
+ * The holes are not included in get_camera_metadata_data_count() nor in
+ * get_camera_metadata_compact_size(), and copy_camera_metadata() and
+ * clone_camera_metadata() leave them behind. A compact copy has lazy
+ * compaction disabled.
+ *
+ * Disabling lazy compaction compacts the data first, and returns a non-0
+ * value if that fails, as does a NULL dst.
+ */
+ANDROID_API
+int set_camera_metadata_lazy_compaction(camera_metadata_t *dst, int enabled);
+
+/**
+ * Reclaim the holes in the data left with lazy compaction. This invalidates
+ * any existing camera_metadata_entry.data pointers to this buffer. Does
+ * nothing if lazy compaction is disabled.
+ *
+ * Returns 0 on success. A non-0 value is returned on error.
+ */
+ANDROID_API
+int compact_camera_metadata(camera_metadata_t *dst);
+
+/**
+ * Allocate the diff from base to next: the tags of base that are not in next,
+ * and the entries of next that are not in base or whose type, count or data
+ * differ. Entries are matched by tag, so neither packet may have several
+ * entries with the same tag. The diff can be freed with
+ * free_camera_metadata_diff().
+ *
+ * Both packets are walked in tag order in a single pass, which only compares
+ * the data of the entries they have in common, and copies that of the changes.
+ * Unsorted packets are sorted into a temporary copy of their entries first.
+ *
+ * Returns NULL if a packet has several entries with the same tag, or on
+ * allocation failure.
+ */
+ANDROID_API
+camera_metadata_diff_t *allocate_camera_metadata_diff(const camera_metadata_t *base,
+        const camera_metadata_t *next);
+
+/**
+ * Free a diff allocated with allocate_camera_metadata_diff().
+ */
+ANDROID_API
+void free_camera_metadata_diff(camera_metadata_diff_t *diff);
+
+/**
+ * Get the size in bytes of a diff, 0 for a NULL diff.
+ */
+ANDROID_API
+size_t get_camera_metadata_diff_size(const camera_metadata_diff_t *diff);
+
+/**
+ * Get the number of entries added, the number of tags removed, and the number
+ * of entries changed by a diff. Any of the counts can be NULL.
+ */
+ANDROID_API
+int get_camera_metadata_diff_counts(const camera_metadata_diff_t *diff,
+        size_t *added,
+        size_t *removed,
+        size_t *changed);
+
+/**
+ * Validate that a diff of diff_size bytes, for example received from another
+ * process, is well formed, and that its changes are a valid packet of metadata.
+ * The diff must be aligned to get_camera_metadata_alignment().
+ *
+ * Returns 0 if the diff is valid, a non-0 value otherwise.
+ */
+ANDROID_API
+int validate_camera_metadata_diff(const camera_metadata_diff_t *diff,
+        size_t diff_size);
+
+/**
+ * Allocate the packet resulting from applying a valid diff to base: the entries
+ * of base but the removed ones, with the added and changed entries of the diff.
+ * If base is the base of the diff, the result has the same entries as the next
+ * packet of the diff, and its vendor id, but is sorted and compact. It can be
+ * freed with free_camera_metadata().
+ *
+ * Returns NULL if the diff does not apply to base, that is if base does not
+ * have the removed or changed entries of the diff, or has the added ones, or on
+ * allocation failure.
+ */
+ANDROID_API
+camera_metadata_t *apply_camera_metadata_diff(const camera_metadata_t *base,
+        const camera_metadata_diff_t *diff);
+
 /**
  * Retrieve human-readable name of section the tag is in. Returns NULL if
  * no such tag is defined. Returns NULL for tags in the vendor section, unless
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_MEDIA_INCLUDE_ANDROID_CAMERA_METADATA_POOL_H
+#define SYSTEM_MEDIA_INCLUDE_ANDROID_CAMERA_METADATA_POOL_H
+
+#include <stddef.h>
+#include <system/camera_metadata.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A pool of camera metadata buffers, for packets that are allocated and freed
+ * at a high rate, such as capture results.
+ *
+ * The buffers are grouped in size classes, 4 per doubling of size, and a
+ * released buffer is kept for the next allocation of its size class instead of
+ * being freed, up to a maximum number of bytes kept by the pool. Packets are
+ * placed in the buffers with place_camera_metadata(), and are ordinary packets,
+ * except that they must be released with release_camera_metadata_to_pool()
+ * instead of free_camera_metadata().
+ *
+ * A pool can be used from several threads.
+ */
+struct camera_metadata_pool;
+typedef struct camera_metadata_pool camera_metadata_pool_t;
+
+/**
+ * Statistics of a pool. The hit rate of the pool is hits / allocations, and
+ * the fragmentation of the outstanding buffers, the fraction of their bytes
+ * lost to the rounding up to a size class, is
+ * 1 - outstanding_packet_bytes / outstanding_bytes.
+ */
+typedef struct camera_metadata_pool_stats {
+    // Buffers allocated from the pool
+    size_t allocations;
+    // Allocations that reused a released buffer
+    size_t hits;
+    // Buffers allocated and not released yet, and the bytes of the buffers and
+    // of the packets placed in them
+    size_t outstanding_count;
+    size_t outstanding_bytes;
+    size_t outstanding_packet_bytes;
+    // Released buffers kept for reuse, and their bytes
+    size_t cached_count;
+    size_t cached_bytes;
+} camera_metadata_pool_stats_t;
+
+/**
+ * Create a pool that keeps up to max_cached_bytes bytes of released buffers for
+ * reuse. Returns NULL on allocation failure.
+ */
+ANDROID_API
+camera_metadata_pool_t *create_camera_metadata_pool(size_t max_cached_bytes);
+
+/**
+ * Destroy a pool and free the buffers it keeps. All the buffers allocated from
+ * the pool must have been released; if not, the pool is not destroyed, so that
+ * they can still be released, and an error is logged.
+ */
+ANDROID_API
+void destroy_camera_metadata_pool(camera_metadata_pool_t *pool);
+
+/**
+ * Allocate a camera_metadata structure from the pool, with the same capacities
+ * and initial state as allocate_camera_metadata(). Packets larger than the
+ * largest size class, 4 MiB, are allocated from the heap, and are never kept.
+ */
+ANDROID_API
+camera_metadata_t *allocate_camera_metadata_from_pool(camera_metadata_pool_t *pool,
+        size_t entry_capacity,
+        size_t data_capacity);
+
+/**
+ * Allocate a compact copy of src from the pool, as made by
+ * copy_camera_metadata().
+ */
+ANDROID_API
+camera_metadata_t *clone_camera_metadata_from_pool(camera_metadata_pool_t *pool,
+        const camera_metadata_t *src);
+
+/**
+ * Release a packet allocated from the pool, for its buffer to be reused or
+ * freed. Releasing a packet allocated from another pool logs an error, and
+ * leaves the packet alone. Releasing a packet that was not allocated from a
+ * pool, such as one from allocate_camera_metadata(), is undefined, as the pool
+ * reads the header it keeps in front of its packets.
+ */
+ANDROID_API
+void release_camera_metadata_to_pool(camera_metadata_pool_t *pool,
+        camera_metadata_t *metadata);
+
+/**
+ * Get the statistics of the pool since its creation.
+ */
+ANDROID_API
+int get_camera_metadata_pool_stats(camera_metadata_pool_t *pool,
+        camera_metadata_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MEDIA_INCLUDE_ANDROID_CAMERA_METADATA_POOL_H */
@@ -89,6 +89,10 @@ typedef uint32_t metadata_size_t;
  *
  * In short, the entries and data are contiguous in memory after the metadata
  * header.
+ *
+ * With FLAG_LAZY_COMPACTION, the data may also contain holes left by deleted
+ * and resized entries, hole_count bytes in total, that are not referenced by
+ * any entry.
  */
 #define METADATA_ALIGNMENT ((size_t) 4)
 struct camera_metadata {
@@ -101,7 +105,7 @@ struct camera_metadata {
     metadata_size_t          data_count;
     metadata_size_t          data_capacity;
     metadata_uptrdiff_t      data_start; // Offset from camera_metadata
-    uint32_t                 padding;    // padding to 8 bytes boundary
+    metadata_size_t          hole_count; // Unused data bytes, see FLAG_LAZY_COMPACTION
     metadata_vendor_id_t     vendor_id;
 };
 
@@ -177,7 +181,74 @@ _Static_assert(sizeof(camera_metadata_t) == 48,
 #define CURRENT_METADATA_VERSION 1
 
 /** Flag definitions */
-#define FLAG_SORTED 0x00000001
+#define FLAG_SORTED           0x00000001
+#define FLAG_TAG_INDEX        0x00000002
+#define FLAG_LAZY_COMPACTION  0x00000004
+
+/**
+ * An optional hash table from tags to entry indices, placed right after the
+ * data of packets created with allocate_indexed_camera_metadata() or
+ * place_indexed_camera_metadata(), and flagged with FLAG_TAG_INDEX:
+ *
+ *   |-----------------------------------------------|
+ *   | free space for                                |
+ *   | (data_capacity-data_count) bytes              |
+ *   |-----------------------------------------------|
+ *   | camera_metadata_tag_index_t                   |
+ *   | slot_count slots                              |
+ *   |-----------------------------------------------|
+ *
+ * The table is open addressed with linear probing, and has at least twice as
+ * many slots as the entry capacity, so probe sequences stay short. Each slot
+ * holds 1 + the index of the first entry with a given tag, or 0 if empty.
+ *
+ * The index is only trusted by the packet it was built for, whose address is
+ * recorded in owner. A copy of the packet made with memcpy(), or received from
+ * another process, rebuilds the index before modifying it and is searched
+ * without it until then.
+ */
+#define TAG_INDEX_ALIGNMENT ((size_t) 8)
+#define TAG_INDEX_MIN_SLOTS ((size_t) 8)
+typedef struct camera_metadata_tag_index {
+    uint64_t owner;
+    uint32_t slot_count;
+    uint32_t reserved;
+    uint32_t slots[];
+} camera_metadata_tag_index_t;
+
+_Static_assert(sizeof(camera_metadata_tag_index_t) == 16,
+         "Size of camera_metadata_tag_index_t must be 16");
+
+/**
+ * A diff from a packet of metadata, base, to another one, next, created with
+ * allocate_camera_metadata_diff(). It is contiguous in memory, like a packet:
+ *
+ *   |-----------------------------------------------|
+ *   | camera_metadata_diff_t                        |
+ *   |-----------------------------------------------|
+ *   | removed_tags[removed_count]                   |
+ *   |-----------------------------------------------|
+ *   | camera_metadata_t of the changes              |
+ *   |                                               |
+ *   |-----------------------------------------------|
+ *
+ * The removed tags are those of base that are not in next, in increasing
+ * order. The changes are a compact, sorted packet with the entries of next that
+ * are not in base, or whose values differ, changed_count of which replace an
+ * entry of base. It has the vendor id of next.
+ */
+struct camera_metadata_diff {
+    metadata_size_t          size;
+    uint32_t                 version;
+    metadata_size_t          base_entry_count;
+    metadata_size_t          removed_count;
+    metadata_size_t          changed_count;
+    metadata_uptrdiff_t      changes_start; // Offset from camera_metadata_diff
+    uint32_t                 removed_tags[];
+};
+
+_Static_assert(sizeof(camera_metadata_diff_t) == 24,
+         "Size of camera_metadata_diff_t must be 24");
 
 /** Tag information */
 
@@ -216,6 +287,228 @@ static uint8_t *get_data(const camera_metadata_t *metadata) {
     return (uint8_t*)metadata + metadata->data_start;
 }
 
+// Returns the number of slots of the tag index for entry_capacity entries, or
+// 0 if the capacity is too large to be indexed.
+static size_t calculate_tag_index_slot_count(size_t entry_capacity) {
+    if (entry_capacity > UINT32_MAX / 8) return 0;
+    size_t slot_count = TAG_INDEX_MIN_SLOTS;
+    while (slot_count < 2 * entry_capacity) {
+        slot_count <<= 1;
+    }
+    return slot_count;
+}
+
+static size_t calculate_tag_index_size(size_t entry_capacity) {
+    size_t slot_count = calculate_tag_index_slot_count(entry_capacity);
+    if (slot_count == 0) return 0;
+    return sizeof(camera_metadata_tag_index_t) + sizeof(uint32_t[slot_count]);
+}
+
+// Returns the offset of the tag index from metadata, right after the data.
+static uint64_t get_tag_index_start(const camera_metadata_t *metadata) {
+    uint64_t data_end = (uint64_t)metadata->data_start + metadata->data_capacity;
+    return (data_end + TAG_INDEX_ALIGNMENT - 1) & ~(uint64_t)(TAG_INDEX_ALIGNMENT - 1);
+}
+
+// Returns where the tag index of metadata is stored, or NULL if metadata has no
+// room for one.
+static camera_metadata_tag_index_t *get_tag_index_location(
+        const camera_metadata_t *metadata) {
+    if (!(metadata->flags & FLAG_TAG_INDEX)) return NULL;
+    uint64_t index_size = calculate_tag_index_size(metadata->entry_capacity);
+    uint64_t index_start = get_tag_index_start(metadata);
+    if (index_size == 0 || index_start + index_size > metadata->size) return NULL;
+    return (camera_metadata_tag_index_t*)((uint8_t*)metadata + index_start);
+}
+
+// Returns the tag index of metadata, or NULL if it has none that can be trusted.
+// This is on the path of every find, so the slot count is only checked to keep
+// the probes within the packet and to leave empty slots.
+static camera_metadata_tag_index_t *get_tag_index(
+        const camera_metadata_t *metadata) {
+    if (!(metadata->flags & FLAG_TAG_INDEX)) return NULL;
+    uint64_t index_start = get_tag_index_start(metadata);
+    if (index_start + sizeof(camera_metadata_tag_index_t) > metadata->size) return NULL;
+    camera_metadata_tag_index_t *index =
+            (camera_metadata_tag_index_t*)((uint8_t*)metadata + index_start);
+    uint64_t slot_count = index->slot_count;
+    if (index->owner != (uintptr_t)metadata ||
+            (slot_count & (slot_count - 1)) != 0 ||
+            slot_count < 2 * (uint64_t)metadata->entry_capacity ||
+            slot_count < TAG_INDEX_MIN_SLOTS ||
+            index_start + sizeof(camera_metadata_tag_index_t) +
+                    slot_count * sizeof(uint32_t) > metadata->size) {
+        return NULL;
+    }
+    return index;
+}
+
+static uint32_t get_tag_index_slot(const camera_metadata_tag_index_t *index,
+        uint32_t tag) {
+    // Fibonacci hashing, tags of a section only differ in their low bits.
+    uint32_t hash = tag * 0x9E3779B1u;
+    return (hash >> (32 - __builtin_ctz(index->slot_count))) &
+            (index->slot_count - 1);
+}
+
+static void insert_tag_index_entry(const camera_metadata_t *metadata,
+        camera_metadata_tag_index_t *index, uint32_t entry_index) {
+    const camera_metadata_buffer_entry_t *entries = get_entries(metadata);
+    const uint32_t tag = entries[entry_index].tag;
+    const uint32_t mask = index->slot_count - 1;
+    // The load factor is at most 1/2, so there is always an empty slot.
+    for (uint32_t slot = get_tag_index_slot(index, tag);; slot = (slot + 1) & mask) {
+        uint32_t value = index->slots[slot];
+        if (value == 0) {
+            index->slots[slot] = entry_index + 1;
+            return;
+        }
+        // Entries are inserted by increasing index, keep the first one.
+        if (entries[value - 1].tag == tag) return;
+    }
+}
+
+static int find_tag_index_entry(const camera_metadata_t *metadata,
+        const camera_metadata_tag_index_t *index, uint32_t tag,
+        uint32_t *entry_index) {
+    const camera_metadata_buffer_entry_t *entries = get_entries(metadata);
+    const uint32_t mask = index->slot_count - 1;
+    uint32_t slot = get_tag_index_slot(index, tag);
+    for (uint32_t probes = 0; probes < index->slot_count; probes++) {
+        uint32_t value = index->slots[slot];
+        if (value == 0) break;
+        if (value <= metadata->entry_count && entries[value - 1].tag == tag) {
+            *entry_index = value - 1;
+            return OK;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NOT_FOUND;
+}
+
+static void rebuild_tag_index(camera_metadata_t *metadata,
+        camera_metadata_tag_index_t *index) {
+    index->owner = (uintptr_t)metadata;
+    index->slot_count = calculate_tag_index_slot_count(metadata->entry_capacity);
+    index->reserved = 0;
+    memset(index->slots, 0, sizeof(uint32_t[index->slot_count]));
+    for (uint32_t i = 0; i < metadata->entry_count; i++) {
+        insert_tag_index_entry(metadata, index, i);
+    }
+}
+
+// Returns the tag index of metadata about to be modified, rebuilding it first if
+// it was not built for this packet, or NULL if metadata is not indexed.
+static camera_metadata_tag_index_t *get_tag_index_for_update(
+        camera_metadata_t *metadata) {
+    camera_metadata_tag_index_t *index = get_tag_index_location(metadata);
+    if (index == NULL) {
+        metadata->flags &= ~FLAG_TAG_INDEX;
+        return NULL;
+    }
+    if (get_tag_index(metadata) == NULL) {
+        rebuild_tag_index(metadata, index);
+    }
+    return index;
+}
+
+// Returns the bytes of data of metadata referenced by its entries, not counting
+// the holes left by lazy compaction.
+static size_t get_live_data_count(const camera_metadata_t *metadata) {
+    if (!(metadata->flags & FLAG_LAZY_COMPACTION) ||
+            metadata->hole_count > metadata->data_count) {
+        return metadata->data_count;
+    }
+    return metadata->data_count - metadata->hole_count;
+}
+
+#define NO_ENTRY_INDEX SIZE_MAX
+
+// Returns the bytes of data referenced by the entries of metadata but skip_index.
+static size_t calculate_live_data_count(const camera_metadata_t *metadata,
+        size_t skip_index) {
+    const camera_metadata_buffer_entry_t *entry = get_entries(metadata);
+    size_t data_count = 0;
+    for (size_t i = 0; i < metadata->entry_count; i++, entry++) {
+        if (i == skip_index) continue;
+        data_count += calculate_camera_metadata_entry_data_size(entry->type,
+                entry->count);
+    }
+    return data_count;
+}
+
+/**
+ * Moves the data of all the entries but skip_index to the start of the data,
+ * removing the holes. The data of skip_index is dropped, for it to be replaced.
+ * This costs O(entry_count + data_count).
+ */
+static int compact_data(camera_metadata_t *dst, size_t skip_index) {
+    uint8_t *data = NULL;
+    if (dst->data_count != 0) {
+        data = malloc(dst->data_count);
+        if (data == NULL) return ERROR;
+        memcpy(data, get_data(dst), dst->data_count);
+    }
+    camera_metadata_buffer_entry_t *entry = get_entries(dst);
+    size_t data_count = 0;
+    for (size_t i = 0; i < dst->entry_count; i++, entry++) {
+        size_t data_bytes = calculate_camera_metadata_entry_data_size(entry->type,
+                entry->count);
+        if (data_bytes == 0 || i == skip_index) continue;
+        memcpy(get_data(dst) + data_count, data + entry->data.offset, data_bytes);
+        entry->data.offset = data_count;
+        data_count += data_bytes;
+    }
+    free(data);
+    dst->data_count = data_count;
+    dst->hole_count = 0;
+    return OK;
+}
+
+// Compacts dst if it needs data_bytes more bytes and compacting can make room.
+static void make_data_room(camera_metadata_t *dst, size_t data_bytes) {
+    if ((dst->flags & FLAG_LAZY_COMPACTION) && dst->hole_count != 0 &&
+            data_bytes > dst->data_capacity - dst->data_count) {
+        compact_data(dst, NO_ENTRY_INDEX);
+    }
+}
+
+// Compacts dst once holes are more than half of its data and larger than its
+// entries, which bounds the cost of a compaction by that of writing the holes:
+// each delete or update costs O(1) amortized, besides its own data.
+static void compact_data_if_fragmented(camera_metadata_t *dst) {
+    if (dst->hole_count > dst->data_count / 2 &&
+            dst->hole_count > sizeof(camera_metadata_buffer_entry_t[dst->entry_count])) {
+        compact_data(dst, NO_ENTRY_INDEX);
+    }
+}
+
+/**
+ * Copies the entries of src after the entry_count entries of dst, and their data
+ * after the data_count bytes of data of dst, without the holes of src. Does not
+ * update the counts of dst. Returns the number of bytes of data copied in
+ * data_bytes, or ERROR if they do not fit.
+ */
+static int copy_packed_entries(camera_metadata_t *dst,
+        const camera_metadata_t *src, size_t *data_bytes) {
+    const camera_metadata_buffer_entry_t *src_entry = get_entries(src);
+    camera_metadata_buffer_entry_t *entry = get_entries(dst) + dst->entry_count;
+    size_t data_count = dst->data_count;
+    for (size_t i = 0; i < src->entry_count; i++, src_entry++, entry++) {
+        *entry = *src_entry;
+        size_t entry_bytes = calculate_camera_metadata_entry_data_size(entry->type,
+                entry->count);
+        if (entry_bytes == 0) continue;
+        if (entry_bytes > dst->data_capacity - data_count) return ERROR;
+        memcpy(get_data(dst) + data_count, get_data(src) + src_entry->data.offset,
+                entry_bytes);
+        entry->data.offset = data_count;
+        data_count += entry_bytes;
+    }
+    *data_bytes = data_count - dst->data_count;
+    return OK;
+}
+
 size_t get_camera_metadata_alignment() {
     return METADATA_PACKET_ALIGNMENT;
 }
@@ -242,6 +535,13 @@ camera_metadata_t *allocate_copy_camera_metadata_checked(
         free(buffer);
         return NULL;
     }
+    // Never trust the tag index of the source
+    camera_metadata_tag_index_t *index = get_tag_index_location(metadata);
+    if (index != NULL) {
+        rebuild_tag_index(metadata, index);
+    } else {
+        metadata->flags &= ~FLAG_TAG_INDEX;
+    }
 
     return metadata;
 }
@@ -290,11 +590,51 @@ camera_metadata_t *place_camera_metadata(void *dst,
     size_t data_unaligned = (uint8_t*)(get_entries(metadata) +
             metadata->entry_capacity) - (uint8_t*)metadata;
     metadata->data_start = ALIGN_TO(data_unaligned, DATA_ALIGNMENT);
+    metadata->hole_count = 0;
     metadata->vendor_id = CAMERA_METADATA_INVALID_VENDOR_ID;
 
     assert(validate_camera_metadata_structure(metadata, NULL) == OK);
     return metadata;
 }
+
+camera_metadata_t *allocate_indexed_camera_metadata(size_t entry_capacity,
+                                                    size_t data_capacity) {
+    size_t memory_needed = calculate_indexed_camera_metadata_size(entry_capacity,
+                                                                  data_capacity);
+    if (memory_needed == 0) return NULL;
+    void *buffer = calloc(1, memory_needed);
+    camera_metadata_t *metadata = place_indexed_camera_metadata(
+        buffer, memory_needed, entry_capacity, data_capacity);
+    if (!metadata) {
+        free(buffer);
+    }
+    return metadata;
+}
+
+camera_metadata_t *place_indexed_camera_metadata(void *dst,
+                                                 size_t dst_size,
+                                                 size_t entry_capacity,
+                                                 size_t data_capacity) {
+    if (dst == NULL) return NULL;
+
+    size_t memory_needed = calculate_indexed_camera_metadata_size(entry_capacity,
+                                                                  data_capacity);
+    if (memory_needed == 0 || memory_needed > dst_size) {
+      ALOGE("%s: Memory needed to place indexed camera metadata (%zu) > dst size (%zu)",
+              __FUNCTION__, memory_needed, dst_size);
+      return NULL;
+    }
+
+    camera_metadata_t *metadata = place_camera_metadata(dst, dst_size,
+                                                        entry_capacity, data_capacity);
+    metadata->size = memory_needed;
+    metadata->flags |= FLAG_TAG_INDEX;
+    rebuild_tag_index(metadata, get_tag_index_location(metadata));
+
+    assert(validate_camera_metadata_structure(metadata, NULL) == OK);
+    return metadata;
+}
+
 void free_camera_metadata(camera_metadata_t *metadata) {
     free(metadata);
 }
@@ -313,6 +653,14 @@ size_t calculate_camera_metadata_size(size_t entry_count,
     return memory_needed;
 }
 
+size_t calculate_indexed_camera_metadata_size(size_t entry_count,
+                                              size_t data_count) {
+    size_t index_size = calculate_tag_index_size(entry_count);
+    if (index_size == 0) return 0;
+    // The tag index starts right after the data, which is aligned enough
+    return calculate_camera_metadata_size(entry_count, data_count) + index_size;
+}
+
 size_t get_camera_metadata_size(const camera_metadata_t *metadata) {
     if (metadata == NULL) return ERROR;
 
@@ -323,7 +671,7 @@ size_t get_camera_metadata_compact_size(const camera_metadata_t *metadata) {
     if (metadata == NULL) return ERROR;
 
     return calculate_camera_metadata_size(metadata->entry_count,
-                                          metadata->data_count);
+                                          get_live_data_count(metadata));
 }
 
 size_t get_camera_metadata_entry_count(const camera_metadata_t *metadata) {
@@ -335,7 +683,7 @@ size_t get_camera_metadata_entry_capacity(const camera_metadata_t *metadata) {
 }
 
 size_t get_camera_metadata_data_count(const camera_metadata_t *metadata) {
-    return metadata->data_count;
+    return get_live_data_count(metadata);
 }
 
 size_t get_camera_metadata_data_capacity(const camera_metadata_t *metadata) {
@@ -353,18 +701,31 @@ camera_metadata_t* copy_camera_metadata(void *dst, size_t dst_size,
       return NULL;
     }
 
+    const size_t data_count = get_live_data_count(src);
     camera_metadata_t *metadata =
-        place_camera_metadata(dst, dst_size, src->entry_count, src->data_count);
+        place_camera_metadata(dst, dst_size, src->entry_count, data_count);
 
-    metadata->flags = src->flags;
-    metadata->entry_count = src->entry_count;
-    metadata->data_count = src->data_count;
+    // The compact copy has no holes, nor room for a tag index
+    metadata->flags = src->flags & ~(FLAG_TAG_INDEX | FLAG_LAZY_COMPACTION);
     metadata->vendor_id = src->vendor_id;
 
-    memcpy(get_entries(metadata), get_entries(src),
-            sizeof(camera_metadata_buffer_entry_t[metadata->entry_count]));
-    memcpy(get_data(metadata), get_data(src),
-            sizeof(uint8_t[metadata->data_count]));
+    if (data_count != src->data_count) {
+        size_t data_bytes;
+        if (copy_packed_entries(metadata, src, &data_bytes) != OK) {
+            ALOGE("%s: Entry data does not fit in %zu bytes", __FUNCTION__, data_count);
+            return NULL;
+        }
+        metadata->entry_count = src->entry_count;
+        metadata->data_count = data_bytes;
+    } else {
+        metadata->entry_count = src->entry_count;
+        metadata->data_count = src->data_count;
+
+        memcpy(get_entries(metadata), get_entries(src),
+                sizeof(camera_metadata_buffer_entry_t[metadata->entry_count]));
+        memcpy(get_data(metadata), get_data(src),
+                sizeof(uint8_t[metadata->data_count]));
+    }
 
     assert(validate_camera_metadata_structure(metadata, NULL) == OK);
     return metadata;
@@ -608,7 +969,6 @@ int append_camera_metadata(camera_metadata_t *dst,
     if (src->data_count + dst->data_count < src->data_count) return ERROR;
     // Check for space
     if (dst->entry_capacity < src->entry_count + dst->entry_count) return ERROR;
-    if (dst->data_capacity < src->data_count + dst->data_count) return ERROR;
 
     if ((dst->vendor_id != CAMERA_METADATA_INVALID_VENDOR_ID) &&
             (src->vendor_id != CAMERA_METADATA_INVALID_VENDOR_ID)) {
@@ -619,16 +979,27 @@ int append_camera_metadata(camera_metadata_t *dst,
         }
     }
 
-    memcpy(get_entries(dst) + dst->entry_count, get_entries(src),
-            sizeof(camera_metadata_buffer_entry_t[src->entry_count]));
-    memcpy(get_data(dst) + dst->data_count, get_data(src),
-            sizeof(uint8_t[src->data_count]));
-    if (dst->data_count != 0) {
-        camera_metadata_buffer_entry_t *entry = get_entries(dst) + dst->entry_count;
-        for (size_t i = 0; i < src->entry_count; i++, entry++) {
-            if ( calculate_camera_metadata_entry_data_size(entry->type,
-                            entry->count) > 0 ) {
-                entry->data.offset += dst->data_count;
+    const size_t src_data_count = get_live_data_count(src);
+    make_data_room(dst, src_data_count);
+    if (dst->data_capacity < src_data_count + dst->data_count) return ERROR;
+
+    camera_metadata_tag_index_t *index = get_tag_index_for_update(dst);
+    size_t data_bytes = src->data_count;
+    if (src_data_count != src->data_count) {
+        // Leave the holes of src behind
+        if (copy_packed_entries(dst, src, &data_bytes) != OK) return ERROR;
+    } else {
+        memcpy(get_entries(dst) + dst->entry_count, get_entries(src),
+                sizeof(camera_metadata_buffer_entry_t[src->entry_count]));
+        memcpy(get_data(dst) + dst->data_count, get_data(src),
+                sizeof(uint8_t[src->data_count]));
+        if (dst->data_count != 0) {
+            camera_metadata_buffer_entry_t *entry = get_entries(dst) + dst->entry_count;
+            for (size_t i = 0; i < src->entry_count; i++, entry++) {
+                if ( calculate_camera_metadata_entry_data_size(entry->type,
+                                entry->count) > 0 ) {
+                    entry->data.offset += dst->data_count;
+                }
             }
         }
     }
@@ -641,8 +1012,13 @@ int append_camera_metadata(camera_metadata_t *dst,
     } else {
         // Src is empty, keep dst sorted state
     }
+    if (index != NULL) {
+        for (uint32_t i = 0; i < src->entry_count; i++) {
+            insert_tag_index_entry(dst, index, dst->entry_count + i);
+        }
+    }
     dst->entry_count += src->entry_count;
-    dst->data_count += src->data_count;
+    dst->data_count += data_bytes;
 
     if (dst->vendor_id == CAMERA_METADATA_INVALID_VENDOR_ID) {
         dst->vendor_id = src->vendor_id;
@@ -655,9 +1031,13 @@ int append_camera_metadata(camera_metadata_t *dst,
 camera_metadata_t *clone_camera_metadata(const camera_metadata_t *src) {
     int res;
     if (src == NULL) return NULL;
-    camera_metadata_t *clone = allocate_camera_metadata(
-        get_camera_metadata_entry_count(src),
-        get_camera_metadata_data_count(src));
+    camera_metadata_t *clone = (src->flags & FLAG_TAG_INDEX) ?
+        allocate_indexed_camera_metadata(
+            get_camera_metadata_entry_count(src),
+            get_camera_metadata_data_count(src)) :
+        allocate_camera_metadata(
+            get_camera_metadata_entry_count(src),
+            get_camera_metadata_data_count(src));
     if (clone != NULL) {
         res = append_camera_metadata(clone, src);
         if (res != OK) {
@@ -681,10 +1061,12 @@ static int add_camera_metadata_entry_raw(camera_metadata_t *dst,
 
     size_t data_bytes =
             calculate_camera_metadata_entry_data_size(type, data_count);
+    make_data_room(dst, data_bytes);
     if (data_bytes + dst->data_count > dst->data_capacity) return ERROR;
 
     size_t data_payload_bytes =
             data_count * camera_metadata_type_size[type];
+    camera_metadata_tag_index_t *index = get_tag_index_for_update(dst);
     camera_metadata_buffer_entry_t *entry = get_entries(dst) + dst->entry_count;
     memset(entry, 0, sizeof(camera_metadata_buffer_entry_t));
     entry->tag = tag;
@@ -700,6 +1082,9 @@ static int add_camera_metadata_entry_raw(camera_metadata_t *dst,
                 data_payload_bytes);
         dst->data_count += data_bytes;
     }
+    if (index != NULL) {
+        insert_tag_index_entry(dst, index, dst->entry_count);
+    }
     dst->entry_count++;
     dst->flags &= ~FLAG_SORTED;
     assert(validate_camera_metadata_structure(dst, NULL) == OK);
@@ -724,23 +1109,84 @@ int add_camera_metadata_entry(camera_metadata_t *dst,
             data_count);
 }
 
-static int compare_entry_tags(const void *p1, const void *p2) {
-    uint32_t tag1 = ((camera_metadata_buffer_entry_t*)p1)->tag;
-    uint32_t tag2 = ((camera_metadata_buffer_entry_t*)p2)->tag;
-    return  tag1 < tag2 ? -1 :
-            tag1 == tag2 ? 0 :
-            1;
+#define INSERTION_SORT_MAX_ENTRIES 32
+
+static void insertion_sort_entries(camera_metadata_buffer_entry_t *entries,
+        size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        if (entries[i - 1].tag <= entries[i].tag) continue;
+        camera_metadata_buffer_entry_t entry = entries[i];
+        size_t j = i;
+        do {
+            entries[j] = entries[j - 1];
+            j--;
+        } while (j > 0 && entries[j - 1].tag > entry.tag);
+        entries[j] = entry;
+    }
+}
+
+/**
+ * Stable sort of the entries by tag. Packets are often built in tag order, or
+ * close to it, and are small, which insertion sort handles best. Larger ones
+ * use a least significant digit radix sort on the tag bytes, skipping the bytes
+ * that are the same for all tags, typically 2 of the 4.
+ */
+static void sort_entries(camera_metadata_buffer_entry_t *entries, size_t count) {
+    // Insertion sort costs a pass over the entries per out of order run.
+    size_t descents = 0;
+    for (size_t i = 1; i < count; i++) {
+        if (entries[i - 1].tag > entries[i].tag) descents++;
+    }
+    if (descents == 0) return;
+
+    camera_metadata_buffer_entry_t *temp = NULL;
+    if (count > INSERTION_SORT_MAX_ENTRIES && descents > INSERTION_SORT_MAX_ENTRIES) {
+        temp = malloc(sizeof(camera_metadata_buffer_entry_t[count]));
+    }
+    if (temp == NULL) {
+        insertion_sort_entries(entries, count);
+        return;
+    }
+
+    camera_metadata_buffer_entry_t *src = entries;
+    camera_metadata_buffer_entry_t *dst = temp;
+    for (unsigned shift = 0; shift < 32; shift += 8) {
+        size_t offsets[256] = {0};
+        for (size_t i = 0; i < count; i++) {
+            offsets[(src[i].tag >> shift) & 0xFF]++;
+        }
+        if (offsets[(src[0].tag >> shift) & 0xFF] == count) continue;
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 256; digit++) {
+            size_t digit_count = offsets[digit];
+            offsets[digit] = offset;
+            offset += digit_count;
+        }
+        for (size_t i = 0; i < count; i++) {
+            dst[offsets[(src[i].tag >> shift) & 0xFF]++] = src[i];
+        }
+        camera_metadata_buffer_entry_t *sorted = dst;
+        dst = src;
+        src = sorted;
+    }
+    if (src != entries) {
+        memcpy(entries, src, sizeof(camera_metadata_buffer_entry_t[count]));
+    }
+    free(temp);
 }
 
 int sort_camera_metadata(camera_metadata_t *dst) {
     if (dst == NULL) return ERROR;
     if (dst->flags & FLAG_SORTED) return OK;
 
-    qsort(get_entries(dst), dst->entry_count,
-            sizeof(camera_metadata_buffer_entry_t),
-            compare_entry_tags);
+    sort_entries(get_entries(dst), dst->entry_count);
     dst->flags |= FLAG_SORTED;
 
+    camera_metadata_tag_index_t *index = get_tag_index_location(dst);
+    if (index != NULL) {
+        rebuild_tag_index(dst, index);
+    }
+
     assert(validate_camera_metadata_structure(dst, NULL) == OK);
     return OK;
 }
@@ -779,18 +1225,25 @@ int find_camera_metadata_entry(camera_metadata_t *src,
     if (src == NULL) return ERROR;
 
     uint32_t index;
-    if (src->flags & FLAG_SORTED) {
-        // Sorted entries, do a binary search
-        camera_metadata_buffer_entry_t *search_entry = NULL;
-        camera_metadata_buffer_entry_t key;
-        key.tag = tag;
-        search_entry = bsearch(&key,
-                get_entries(src),
-                src->entry_count,
-                sizeof(camera_metadata_buffer_entry_t),
-                compare_entry_tags);
-        if (search_entry == NULL) return NOT_FOUND;
-        index = search_entry - get_entries(src);
+    const camera_metadata_tag_index_t *tag_index = get_tag_index(src);
+    if (tag_index != NULL) {
+        // Indexed entries, look up the hash table
+        if (find_tag_index_entry(src, tag_index, tag, &index) != OK) {
+            return NOT_FOUND;
+        }
+    } else if (src->flags & FLAG_SORTED) {
+        // Sorted entries, do a binary search for the first one with the tag
+        const camera_metadata_buffer_entry_t *entries = get_entries(src);
+        const camera_metadata_buffer_entry_t *first = entries;
+        uint32_t length = src->entry_count;
+        if (length == 0) return NOT_FOUND;
+        while (length > 1) {
+            uint32_t half = length / 2;
+            first = first[half - 1].tag < tag ? first + half : first;
+            length -= half;
+        }
+        if (first->tag != tag) return NOT_FOUND;
+        index = first - entries;
     } else {
         // Not sorted, linear search
         camera_metadata_buffer_entry_t *search_entry = get_entries(src);
@@ -823,7 +1276,10 @@ int delete_camera_metadata_entry(camera_metadata_t *dst,
     size_t data_bytes = calculate_camera_metadata_entry_data_size(entry->type,
             entry->count);
 
-    if (data_bytes > 0) {
+    if (data_bytes > 0 && (dst->flags & FLAG_LAZY_COMPACTION)) {
+        // Leave a hole
+        dst->hole_count += data_bytes;
+    } else if (data_bytes > 0) {
         // Shift data buffer to overwrite deleted data
         uint8_t *start = get_data(dst) + entry->data.offset;
         uint8_t *end = start + data_bytes;
@@ -849,6 +1305,16 @@ int delete_camera_metadata_entry(camera_metadata_t *dst,
             (dst->entry_count - index - 1) );
     dst->entry_count -= 1;
 
+    if (dst->flags & FLAG_LAZY_COMPACTION) {
+        compact_data_if_fragmented(dst);
+    }
+
+    // All the following entries moved, which is as costly to reflect as a rebuild
+    camera_metadata_tag_index_t *tag_index = get_tag_index_location(dst);
+    if (tag_index != NULL) {
+        rebuild_tag_index(dst, tag_index);
+    }
+
     assert(validate_camera_metadata_structure(dst, NULL) == OK);
     return OK;
 }
@@ -872,7 +1338,29 @@ int update_camera_metadata_entry(camera_metadata_t *dst,
     size_t entry_bytes =
             calculate_camera_metadata_entry_data_size(entry->type,
                     entry->count);
-    if (data_bytes != entry_bytes) {
+    if (data_bytes != entry_bytes && (dst->flags & FLAG_LAZY_COMPACTION)) {
+        if (data_bytes > dst->data_capacity - dst->data_count) {
+            // Only compacting, without the old data, can make room
+            size_t live_bytes = calculate_live_data_count(dst, index);
+            if (live_bytes > dst->data_capacity ||
+                    data_bytes > dst->data_capacity - live_bytes) {
+                // No room
+                return ERROR;
+            }
+            if (compact_data(dst, index) != OK) return ERROR;
+        } else {
+            // Leave a hole
+            dst->hole_count += entry_bytes;
+        }
+
+        if (data_bytes != 0) {
+            // Append new data
+            entry->data.offset = dst->data_count;
+
+            memcpy(get_data(dst) + entry->data.offset, data, data_payload_bytes);
+            dst->data_count += data_bytes;
+        }
+    } else if (data_bytes != entry_bytes) {
         // May need to shift/add to data array
         if (dst->data_capacity < dst->data_count + data_bytes - entry_bytes) {
             // No room
@@ -912,13 +1400,18 @@ int update_camera_metadata_entry(camera_metadata_t *dst,
     }
 
     if (data_bytes == 0) {
-        // Data fits into entry
+        // Data fits into entry, clear the old offset, as for a new entry
+        entry->data.offset = 0;
         memcpy(entry->data.value, data,
                 data_payload_bytes);
     }
 
     entry->count = data_count;
 
+    if (dst->flags & FLAG_LAZY_COMPACTION) {
+        compact_data_if_fragmented(dst);
+    }
+
     if (updated_entry != NULL) {
         get_camera_metadata_entry(dst,
                 index,
@@ -929,6 +1422,335 @@ int update_camera_metadata_entry(camera_metadata_t *dst,
     return OK;
 }
 
+int set_camera_metadata_lazy_compaction(camera_metadata_t *dst, int enabled) {
+    if (dst == NULL) return ERROR;
+
+    if (enabled) {
+        if (!(dst->flags & FLAG_LAZY_COMPACTION)) {
+            dst->hole_count = 0;
+            dst->flags |= FLAG_LAZY_COMPACTION;
+        }
+        return OK;
+    }
+    if (compact_camera_metadata(dst) != OK) return ERROR;
+    dst->flags &= ~FLAG_LAZY_COMPACTION;
+    return OK;
+}
+
+int compact_camera_metadata(camera_metadata_t *dst) {
+    if (dst == NULL) return ERROR;
+    if (!(dst->flags & FLAG_LAZY_COMPACTION) || dst->hole_count == 0) return OK;
+
+    int res = compact_data(dst, NO_ENTRY_INDEX);
+    assert(validate_camera_metadata_structure(dst, NULL) == OK);
+    return res;
+}
+
+/**
+ * Returns the entries of metadata in tag order: its own entries if it is
+ * sorted, otherwise a sorted copy to be freed by the caller. Returns NULL if
+ * the copy cannot be allocated, or if several entries have the same tag, for
+ * which there is no diff.
+ */
+static camera_metadata_buffer_entry_t *get_entries_in_tag_order(
+        const camera_metadata_t *metadata) {
+    camera_metadata_buffer_entry_t *entries = get_entries(metadata);
+    if (!(metadata->flags & FLAG_SORTED) && metadata->entry_count > 1) {
+        size_t entries_size = sizeof(camera_metadata_buffer_entry_t[metadata->entry_count]);
+        camera_metadata_buffer_entry_t *sorted = malloc(entries_size);
+        if (sorted == NULL) return NULL;
+        memcpy(sorted, entries, entries_size);
+        sort_entries(sorted, metadata->entry_count);
+        entries = sorted;
+    }
+    for (size_t i = 1; i < metadata->entry_count; i++) {
+        if (entries[i - 1].tag == entries[i].tag) {
+            ALOGE("%s: Duplicate tag %#" PRIx32, __FUNCTION__, entries[i].tag);
+            if (entries != get_entries(metadata)) free(entries);
+            return NULL;
+        }
+    }
+    return entries;
+}
+
+static int entry_values_equal(const camera_metadata_t *a,
+        const camera_metadata_buffer_entry_t *entry_a,
+        const camera_metadata_t *b,
+        const camera_metadata_buffer_entry_t *entry_b) {
+    if (entry_a->type != entry_b->type || entry_a->count != entry_b->count) return 0;
+    size_t data_payload_bytes = entry_a->count * camera_metadata_type_size[entry_a->type];
+    if (data_payload_bytes <= 4) {
+        return memcmp(entry_a->data.value, entry_b->data.value, data_payload_bytes) == 0;
+    }
+    return memcmp(get_data(a) + entry_a->data.offset, get_data(b) + entry_b->data.offset,
+            data_payload_bytes) == 0;
+}
+
+// Appends src_entry of src and its data to dst, which must have room for them.
+static void copy_entry(camera_metadata_t *dst, const camera_metadata_t *src,
+        const camera_metadata_buffer_entry_t *src_entry) {
+    camera_metadata_buffer_entry_t *entry = get_entries(dst) + dst->entry_count++;
+    *entry = *src_entry;
+    size_t data_bytes = calculate_camera_metadata_entry_data_size(entry->type,
+            entry->count);
+    if (data_bytes != 0) {
+        memcpy(get_data(dst) + dst->data_count, get_data(src) + src_entry->data.offset,
+                data_bytes);
+        entry->data.offset = dst->data_count;
+        dst->data_count += data_bytes;
+    }
+}
+
+static size_t calculate_diff_changes_start(size_t removed_count) {
+    return ALIGN_TO(sizeof(camera_metadata_diff_t) + sizeof(uint32_t[removed_count]),
+            METADATA_PACKET_ALIGNMENT);
+}
+
+static camera_metadata_t *get_diff_changes(const camera_metadata_diff_t *diff) {
+    return (camera_metadata_t*)((uint8_t*)diff + diff->changes_start);
+}
+
+typedef struct diff_counts {
+    size_t removed;
+    size_t changed;
+    size_t added;
+    size_t data_count;
+} diff_counts_t;
+
+/**
+ * Walks the entries of base and next in tag order, a single pass over both, and
+ * counts the removed tags and the changed and added entries, with their data.
+ * If diff is not NULL, also records them in it, which must have room for them.
+ */
+static void walk_camera_metadata_diff(const camera_metadata_t *base,
+        const camera_metadata_buffer_entry_t *base_entries,
+        const camera_metadata_t *next,
+        const camera_metadata_buffer_entry_t *next_entries,
+        diff_counts_t *counts,
+        camera_metadata_diff_t *diff) {
+    memset(counts, 0, sizeof(diff_counts_t));
+    size_t i = 0;
+    size_t j = 0;
+    while (i < base->entry_count || j < next->entry_count) {
+        if (j == next->entry_count ||
+                (i < base->entry_count && base_entries[i].tag < next_entries[j].tag)) {
+            if (diff != NULL) diff->removed_tags[counts->removed] = base_entries[i].tag;
+            counts->removed++;
+            i++;
+            continue;
+        }
+        const camera_metadata_buffer_entry_t *entry = next_entries + j++;
+        if (i < base->entry_count && base_entries[i].tag == entry->tag) {
+            if (entry_values_equal(base, base_entries + i++, next, entry)) continue;
+            counts->changed++;
+        } else {
+            counts->added++;
+        }
+        counts->data_count += calculate_camera_metadata_entry_data_size(entry->type,
+                entry->count);
+        if (diff != NULL) copy_entry(get_diff_changes(diff), next, entry);
+    }
+}
+
+camera_metadata_diff_t *allocate_camera_metadata_diff(const camera_metadata_t *base,
+        const camera_metadata_t *next) {
+    if (base == NULL || next == NULL) return NULL;
+
+    camera_metadata_buffer_entry_t *base_entries = get_entries_in_tag_order(base);
+    camera_metadata_buffer_entry_t *next_entries = get_entries_in_tag_order(next);
+    camera_metadata_diff_t *diff = NULL;
+    if (base_entries != NULL && next_entries != NULL) {
+        diff_counts_t counts;
+        walk_camera_metadata_diff(base, base_entries, next, next_entries, &counts, NULL);
+        size_t changes_start = calculate_diff_changes_start(counts.removed);
+        size_t changes_size = calculate_camera_metadata_size(counts.changed + counts.added,
+                counts.data_count);
+        if (changes_size <= UINT32_MAX - changes_start) {
+            diff = calloc(1, changes_start + changes_size);
+        }
+        if (diff != NULL) {
+            diff->size = changes_start + changes_size;
+            diff->version = CURRENT_METADATA_VERSION;
+            diff->base_entry_count = base->entry_count;
+            diff->removed_count = counts.removed;
+            diff->changed_count = counts.changed;
+            diff->changes_start = changes_start;
+            camera_metadata_t *changes = place_camera_metadata(get_diff_changes(diff),
+                    changes_size, counts.changed + counts.added, counts.data_count);
+            walk_camera_metadata_diff(base, base_entries, next, next_entries, &counts, diff);
+            changes->flags |= FLAG_SORTED;
+            changes->vendor_id = next->vendor_id;
+            assert(validate_camera_metadata_diff(diff, diff->size) == OK);
+        }
+    }
+    if (base_entries != get_entries(base)) free(base_entries);
+    if (next_entries != get_entries(next)) free(next_entries);
+    return diff;
+}
+
+void free_camera_metadata_diff(camera_metadata_diff_t *diff) {
+    free(diff);
+}
+
+size_t get_camera_metadata_diff_size(const camera_metadata_diff_t *diff) {
+    if (diff == NULL) return 0;
+
+    return diff->size;
+}
+
+int get_camera_metadata_diff_counts(const camera_metadata_diff_t *diff,
+        size_t *added,
+        size_t *removed,
+        size_t *changed) {
+    if (diff == NULL) return ERROR;
+
+    if (added != NULL) {
+        *added = get_diff_changes(diff)->entry_count - diff->changed_count;
+    }
+    if (removed != NULL) *removed = diff->removed_count;
+    if (changed != NULL) *changed = diff->changed_count;
+    return OK;
+}
+
+int validate_camera_metadata_diff(const camera_metadata_diff_t *diff,
+        size_t diff_size) {
+    if (diff == NULL) {
+        ALOGE("%s: diff is null!", __FUNCTION__);
+        return ERROR;
+    }
+    if ((uintptr_t)diff % METADATA_PACKET_ALIGNMENT != 0) {
+        ALOGE("%s: Diff pointer %p is not aligned", __FUNCTION__, diff);
+        return ERROR;
+    }
+    if (diff_size < sizeof(camera_metadata_diff_t) || diff->size > diff_size) {
+        ALOGE("%s: Diff size (%zu) is too small", __FUNCTION__, diff_size);
+        return ERROR;
+    }
+    if (diff->version != CURRENT_METADATA_VERSION) {
+        ALOGE("%s: Unknown diff version %" PRIu32, __FUNCTION__, diff->version);
+        return ERROR;
+    }
+    if (diff->removed_count > (diff->size - sizeof(camera_metadata_diff_t)) / sizeof(uint32_t) ||
+            diff->changes_start != calculate_diff_changes_start(diff->removed_count) ||
+            diff->changes_start > diff->size) {
+        ALOGE("%s: Removed tags (%" PRIu32 ") overflow the diff", __FUNCTION__,
+                diff->removed_count);
+        return ERROR;
+    }
+
+    const camera_metadata_t *changes = get_diff_changes(diff);
+    size_t changes_size = diff->size - diff->changes_start;
+    if (validate_camera_metadata_structure(changes, &changes_size) != OK) {
+        ALOGE("%s: Changes are invalid", __FUNCTION__);
+        return ERROR;
+    }
+    if (!(changes->flags & FLAG_SORTED) || diff->changed_count > changes->entry_count ||
+            diff->base_entry_count < diff->removed_count + diff->changed_count) {
+        ALOGE("%s: Changes do not match the diff", __FUNCTION__);
+        return ERROR;
+    }
+
+    // Merged, the removed tags and the tags of the changes must be strictly
+    // increasing: each in order, unique, and not both removed and changed.
+    const camera_metadata_buffer_entry_t *entries = get_entries(changes);
+    uint32_t previous_tag = 0;
+    for (size_t i = 0, j = 0; i < diff->removed_count || j < changes->entry_count; ) {
+        uint32_t tag;
+        if (j == changes->entry_count ||
+                (i < diff->removed_count && diff->removed_tags[i] <= entries[j].tag)) {
+            tag = diff->removed_tags[i++];
+        } else {
+            tag = entries[j++].tag;
+        }
+        if (i + j > 1 && tag <= previous_tag) {
+            ALOGE("%s: Tag %#" PRIx32 " is out of order or repeated", __FUNCTION__, tag);
+            return ERROR;
+        }
+        previous_tag = tag;
+    }
+    return OK;
+}
+
+/**
+ * Walks the entries of base in tag order along with the removed tags and the
+ * changes of diff, and counts the entries and data of the next packet. If next
+ * is not NULL, also copies them to it, which must have room for them.
+ * Returns ERROR if diff does not apply to base, that is if a removed or changed
+ * tag is not in base, or an added one is.
+ */
+static int merge_camera_metadata_diff(const camera_metadata_t *base,
+        const camera_metadata_buffer_entry_t *base_entries,
+        const camera_metadata_diff_t *diff,
+        camera_metadata_t *next,
+        size_t *entry_count,
+        size_t *data_count) {
+    const camera_metadata_t *changes = get_diff_changes(diff);
+    const camera_metadata_buffer_entry_t *changes_entries = get_entries(changes);
+    size_t i = 0;
+    size_t removed = 0;
+    size_t change = 0;
+    size_t changed = 0;
+    *entry_count = 0;
+    *data_count = 0;
+    while (i < base->entry_count || change < changes->entry_count) {
+        const camera_metadata_t *src = changes;
+        const camera_metadata_buffer_entry_t *entry;
+        if (i == base->entry_count || (change < changes->entry_count &&
+                changes_entries[change].tag < base_entries[i].tag)) {
+            entry = changes_entries + change++;
+        } else {
+            entry = base_entries + i++;
+            if (removed < diff->removed_count && diff->removed_tags[removed] <= entry->tag) {
+                if (diff->removed_tags[removed] != entry->tag) return ERROR;
+                removed++;
+                continue;
+            }
+            if (change < changes->entry_count && changes_entries[change].tag == entry->tag) {
+                entry = changes_entries + change++;
+                changed++;
+            } else {
+                src = base;
+            }
+        }
+        (*entry_count)++;
+        *data_count += calculate_camera_metadata_entry_data_size(entry->type, entry->count);
+        if (next != NULL) copy_entry(next, src, entry);
+    }
+    if (removed != diff->removed_count || changed != diff->changed_count) return ERROR;
+    return OK;
+}
+
+camera_metadata_t *apply_camera_metadata_diff(const camera_metadata_t *base,
+        const camera_metadata_diff_t *diff) {
+    if (base == NULL || diff == NULL) return NULL;
+    if (base->entry_count != diff->base_entry_count) {
+        ALOGE("%s: Diff is for a base of %" PRIu32 " entries, not %" PRIu32,
+                __FUNCTION__, diff->base_entry_count, base->entry_count);
+        return NULL;
+    }
+
+    camera_metadata_buffer_entry_t *base_entries = get_entries_in_tag_order(base);
+    if (base_entries == NULL) return NULL;
+
+    camera_metadata_t *next = NULL;
+    size_t entry_count;
+    size_t data_count;
+    if (merge_camera_metadata_diff(base, base_entries, diff, NULL, &entry_count,
+            &data_count) != OK) {
+        ALOGE("%s: Diff does not apply to the base", __FUNCTION__);
+    } else {
+        next = allocate_camera_metadata(entry_count, data_count);
+    }
+    if (next != NULL) {
+        merge_camera_metadata_diff(base, base_entries, diff, next, &entry_count, &data_count);
+        next->flags |= FLAG_SORTED;
+        next->vendor_id = get_diff_changes(diff)->vendor_id;
+        assert(validate_camera_metadata_structure(next, NULL) == OK);
+    }
+    if (base_entries != get_entries(base)) free(base_entries);
+    return next;
+}
+
 static const vendor_tag_ops_t *vendor_tag_ops = NULL;
 static const struct vendor_tag_cache_ops *vendor_cache_ops = NULL;
 
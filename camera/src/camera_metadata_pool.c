@@ -0,0 +1,272 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "camera_metadata_pool"
+
+#include <system/camera_metadata_pool.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <log/log.h>
+
+#define OK              0
+#define ERROR           1
+
+#define ALIGN_TO(val, alignment) \
+    (((uintptr_t)(val) + ((alignment) - 1)) & ~((alignment) - 1))
+
+/**
+ * Size classes: a class for up to 2^MIN_BLOCK_SHIFT bytes, then
+ * CLASSES_PER_DOUBLING classes evenly spaced between each power of 2, up to
+ * 2^MAX_BLOCK_SHIFT bytes. Rounding up to a class wastes less than 20% of a
+ * buffer.
+ */
+#define MIN_BLOCK_SHIFT 8
+#define MAX_BLOCK_SHIFT 22
+#define CLASSES_PER_DOUBLING_SHIFT 2
+#define CLASSES_PER_DOUBLING (1 << CLASSES_PER_DOUBLING_SHIFT)
+#define SIZE_CLASS_COUNT \
+    (1 + (MAX_BLOCK_SHIFT - MIN_BLOCK_SHIFT) * CLASSES_PER_DOUBLING)
+#define NO_SIZE_CLASS UINT32_MAX
+
+#define BLOCK_MAGIC 0x6d706f6fu
+
+/**
+ * The header of each buffer, followed by the packet:
+ *
+ *   |-----------------------------------------------|
+ *   | pool_block_t                                  |
+ *   |-----------------------------------------------|
+ *   | camera_metadata_t                             |
+ *   | ...                                           |
+ *   |-----------------------------------------------|
+ *
+ * A released buffer kept by the pool is linked in the list of its size class
+ * through next.
+ */
+typedef struct pool_block {
+    struct pool_block       *next;
+    camera_metadata_pool_t  *pool;
+    uint32_t                 size_class;
+    uint32_t                 magic;
+} pool_block_t;
+
+#define BLOCK_HEADER_SIZE ALIGN_TO(sizeof(pool_block_t), sizeof(uint64_t))
+
+struct camera_metadata_pool {
+    pthread_mutex_t               lock;
+    size_t                        max_cached_bytes;
+    pool_block_t                 *free_blocks[SIZE_CLASS_COUNT];
+    camera_metadata_pool_stats_t  stats;
+};
+
+// Returns the size class of buffers of size bytes, or NO_SIZE_CLASS if too large.
+static uint32_t get_size_class(size_t size) {
+    if (size <= ((size_t)1 << MIN_BLOCK_SHIFT)) return 0;
+    if (size > ((size_t)1 << MAX_BLOCK_SHIFT)) return NO_SIZE_CLASS;
+    // 2^shift < size <= 2^(shift + 1)
+    unsigned shift = 63 - __builtin_clzll((unsigned long long)(size - 1));
+    size_t step = ((size - 1) >> (shift - CLASSES_PER_DOUBLING_SHIFT)) &
+            (CLASSES_PER_DOUBLING - 1);
+    return 1 + (shift - MIN_BLOCK_SHIFT) * CLASSES_PER_DOUBLING + step;
+}
+
+static size_t get_size_class_size(uint32_t size_class) {
+    if (size_class == 0) return (size_t)1 << MIN_BLOCK_SHIFT;
+    unsigned shift = MIN_BLOCK_SHIFT + (size_class - 1) / CLASSES_PER_DOUBLING;
+    size_t step = (size_class - 1) % CLASSES_PER_DOUBLING + 1;
+    return ((size_t)1 << shift) + (step << (shift - CLASSES_PER_DOUBLING_SHIFT));
+}
+
+static camera_metadata_t *get_block_metadata(pool_block_t *block) {
+    return (camera_metadata_t*)((uint8_t*)block + BLOCK_HEADER_SIZE);
+}
+
+static pool_block_t *get_metadata_block(camera_metadata_t *metadata) {
+    return (pool_block_t*)((uint8_t*)metadata - BLOCK_HEADER_SIZE);
+}
+
+camera_metadata_pool_t *create_camera_metadata_pool(size_t max_cached_bytes) {
+    camera_metadata_pool_t *pool = calloc(1, sizeof(camera_metadata_pool_t));
+    if (pool == NULL) return NULL;
+    if (pthread_mutex_init(&pool->lock, NULL) != 0) {
+        free(pool);
+        return NULL;
+    }
+    pool->max_cached_bytes = max_cached_bytes;
+    return pool;
+}
+
+void destroy_camera_metadata_pool(camera_metadata_pool_t *pool) {
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->lock);
+    size_t outstanding_count = pool->stats.outstanding_count;
+    pthread_mutex_unlock(&pool->lock);
+    if (outstanding_count != 0) {
+        ALOGE("%s: %zu buffers are not released, not destroying the pool", __FUNCTION__,
+                outstanding_count);
+        return;
+    }
+    for (uint32_t size_class = 0; size_class < SIZE_CLASS_COUNT; size_class++) {
+        pool_block_t *block = pool->free_blocks[size_class];
+        while (block != NULL) {
+            pool_block_t *next = block->next;
+            free(block);
+            block = next;
+        }
+    }
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+// Removes a buffer from the outstanding ones, when it is not returned to the caller.
+static void untrack_buffer(camera_metadata_pool_t *pool, size_t memory_needed,
+        size_t block_size) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.outstanding_count--;
+    pool->stats.outstanding_bytes -= block_size;
+    pool->stats.outstanding_packet_bytes -= memory_needed;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Returns a buffer of at least memory_needed bytes for a packet, reusing a
+ * released one of the same size class if any, and its size in block_size.
+ * Returns NULL on allocation failure.
+ */
+static camera_metadata_t *acquire_buffer(camera_metadata_pool_t *pool,
+        size_t memory_needed,
+        size_t *block_size) {
+    uint32_t size_class = get_size_class(memory_needed);
+    *block_size = size_class == NO_SIZE_CLASS ?
+            memory_needed : get_size_class_size(size_class);
+
+    pthread_mutex_lock(&pool->lock);
+    pool_block_t *block = NULL;
+    if (size_class != NO_SIZE_CLASS && pool->free_blocks[size_class] != NULL) {
+        block = pool->free_blocks[size_class];
+        pool->free_blocks[size_class] = block->next;
+        pool->stats.cached_count--;
+        pool->stats.cached_bytes -= *block_size;
+        pool->stats.hits++;
+    }
+    pool->stats.allocations++;
+    pool->stats.outstanding_count++;
+    pool->stats.outstanding_bytes += *block_size;
+    pool->stats.outstanding_packet_bytes += memory_needed;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (block == NULL) {
+        block = malloc(BLOCK_HEADER_SIZE + *block_size);
+        if (block == NULL) {
+            untrack_buffer(pool, memory_needed, *block_size);
+            return NULL;
+        }
+        block->pool = pool;
+        block->size_class = size_class;
+        block->magic = BLOCK_MAGIC;
+    }
+    block->next = NULL;
+    return get_block_metadata(block);
+}
+
+camera_metadata_t *allocate_camera_metadata_from_pool(camera_metadata_pool_t *pool,
+        size_t entry_capacity,
+        size_t data_capacity) {
+    if (pool == NULL) return NULL;
+
+    size_t memory_needed = calculate_camera_metadata_size(entry_capacity, data_capacity);
+    size_t block_size;
+    camera_metadata_t *metadata = acquire_buffer(pool, memory_needed, &block_size);
+    if (metadata == NULL) return NULL;
+    // Zeroed, as by allocate_camera_metadata(), so that the packet does not
+    // carry the data of the previous one in its padding.
+    memset(metadata, 0, memory_needed);
+    return place_camera_metadata(metadata, block_size, entry_capacity, data_capacity);
+}
+
+camera_metadata_t *clone_camera_metadata_from_pool(camera_metadata_pool_t *pool,
+        const camera_metadata_t *src) {
+    if (pool == NULL || src == NULL) return NULL;
+
+    size_t memory_needed = get_camera_metadata_compact_size(src);
+    size_t block_size;
+    camera_metadata_t *metadata = acquire_buffer(pool, memory_needed, &block_size);
+    if (metadata == NULL) return NULL;
+    // A compact copy writes the whole packet, with the padding of src, so there
+    // is no need to zero it first.
+    camera_metadata_t *clone = copy_camera_metadata(metadata, block_size, src);
+    if (clone == NULL) {
+        // No packet was placed in the buffer, so its sizes are not read from
+        // it as by release_camera_metadata_to_pool().
+        pool_block_t *block = get_metadata_block(metadata);
+        untrack_buffer(pool, memory_needed, block_size);
+        block->magic = 0;
+        free(block);
+    }
+    return clone;
+}
+
+void release_camera_metadata_to_pool(camera_metadata_pool_t *pool,
+        camera_metadata_t *metadata) {
+    if (pool == NULL || metadata == NULL) return;
+
+    // The header of a packet not allocated from a pool is out of its buffer, so
+    // only packets of another pool are reliably detected.
+    pool_block_t *block = get_metadata_block(metadata);
+    if (block->magic != BLOCK_MAGIC || block->pool != pool ||
+            (block->size_class >= SIZE_CLASS_COUNT && block->size_class != NO_SIZE_CLASS)) {
+        ALOGE("%s: Metadata %p was not allocated from pool %p", __FUNCTION__, metadata, pool);
+        return;
+    }
+    size_t memory_needed = get_camera_metadata_size(metadata);
+    size_t block_size = block->size_class == NO_SIZE_CLASS ?
+            memory_needed : get_size_class_size(block->size_class);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.outstanding_count--;
+    pool->stats.outstanding_bytes -= block_size;
+    pool->stats.outstanding_packet_bytes -= memory_needed;
+    bool cache = block->size_class != NO_SIZE_CLASS &&
+            block_size <= pool->max_cached_bytes - pool->stats.cached_bytes;
+    if (cache) {
+        block->next = pool->free_blocks[block->size_class];
+        pool->free_blocks[block->size_class] = block;
+        pool->stats.cached_count++;
+        pool->stats.cached_bytes += block_size;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!cache) {
+        block->magic = 0;
+        free(block);
+    }
+}
+
+int get_camera_metadata_pool_stats(camera_metadata_pool_t *pool,
+        camera_metadata_pool_stats_t *stats) {
+    if (pool == NULL || stats == NULL) return ERROR;
+
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+    return OK;
+}
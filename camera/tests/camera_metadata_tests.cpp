@@ -21,11 +21,13 @@
 
 #include <vector>
 #include <algorithm>
+#include <random>
 
 #include <gtest/gtest.h>
 #include <log/log.h>
 
 #include "system/camera_metadata.h"
+#include "system/camera_metadata_pool.h"
 #include "camera_metadata_hidden.h"
 
 #include "camera_metadata_tests_fake_vendor.h"
@@ -1904,3 +1906,527 @@ TEST(camera_metadata, buffer_alignment) {
     delete[] dst;
     FINISH_USING_CAMERA_METADATA(m);
 }
+
+static std::vector<uint32_t> get_all_tags() {
+    std::vector<uint32_t> tags;
+    for (int i = 0; i < ANDROID_SECTION_COUNT; i++) {
+        for (uint32_t tag = camera_metadata_section_bounds[i][0];
+                tag < camera_metadata_section_bounds[i][1]; tag++) {
+            tags.push_back(tag);
+        }
+    }
+    return tags;
+}
+
+// Expects the same find results for all tags from metadata m as from reference.
+static void expect_same_finds(const camera_metadata_t *reference, const camera_metadata_t *m,
+        const std::vector<uint32_t> &tags) {
+    for (uint32_t tag : tags) {
+        camera_metadata_ro_entry_t e1, e2;
+        int result = find_camera_metadata_ro_entry(reference, tag, &e1);
+        ASSERT_EQ(result, find_camera_metadata_ro_entry(m, tag, &e2)) << "tag " << tag;
+        if (result == OK) {
+            EXPECT_EQ(e1.index, e2.index) << "tag " << tag;
+            EXPECT_EQ(tag, e2.tag);
+        }
+    }
+}
+
+TEST(camera_metadata, indexed_find) {
+    const size_t entry_capacity = 300;
+    const size_t data_capacity = entry_capacity * 3 * 8;
+    const std::vector<uint32_t> all_tags = get_all_tags();
+    // Fewer tags than the capacity, so that there are duplicates.
+    const std::vector<uint32_t> tags(all_tags.begin(), all_tags.begin() + 200);
+    uint8_t data[3 * 8] = {0};
+
+    camera_metadata_t *m = allocate_camera_metadata(entry_capacity, data_capacity);
+    camera_metadata_t *mi = allocate_indexed_camera_metadata(entry_capacity, data_capacity);
+    ASSERT_NE((void*)NULL, (void*)mi);
+    EXPECT_EQ(calculate_indexed_camera_metadata_size(entry_capacity, data_capacity),
+            get_camera_metadata_size(mi));
+    EXPECT_LT(calculate_camera_metadata_size(entry_capacity, data_capacity),
+            get_camera_metadata_size(mi));
+
+    std::minstd_rand gen(42);
+    for (int i = 0; i < 2000; i++) {
+        const size_t entry_count = get_camera_metadata_entry_count(m);
+        const size_t operation = gen() % 16;
+        if (operation < 8 && entry_count < entry_capacity) {
+            const uint32_t tag = tags[gen() % tags.size()];
+            const size_t count = 1 + gen() % 3;
+            ASSERT_EQ(OK, add_camera_metadata_entry(m, tag, data, count));
+            ASSERT_EQ(OK, add_camera_metadata_entry(mi, tag, data, count));
+        } else if (operation < 12 && entry_count > 0) {
+            const size_t index = gen() % entry_count;
+            ASSERT_EQ(OK, delete_camera_metadata_entry(m, index));
+            ASSERT_EQ(OK, delete_camera_metadata_entry(mi, index));
+        } else if (operation < 14 && entry_count > 0) {
+            const size_t index = gen() % entry_count;
+            const size_t count = 1 + gen() % 3;
+            ASSERT_EQ(OK, update_camera_metadata_entry(m, index, data, count, NULL));
+            ASSERT_EQ(OK, update_camera_metadata_entry(mi, index, data, count, NULL));
+        } else if (operation < 15) {
+            ASSERT_EQ(OK, sort_camera_metadata(m));
+            ASSERT_EQ(OK, sort_camera_metadata(mi));
+        } else if (entry_count + 2 <= entry_capacity) {
+            camera_metadata_t *src = allocate_camera_metadata(2, 2 * 3 * 8);
+            for (int j = 0; j < 2; j++) {
+                ASSERT_EQ(OK, add_camera_metadata_entry(src, tags[gen() % tags.size()],
+                        data, 3));
+            }
+            ASSERT_EQ(OK, append_camera_metadata(m, src));
+            ASSERT_EQ(OK, append_camera_metadata(mi, src));
+            free_camera_metadata(src);
+        }
+        ASSERT_EQ(get_camera_metadata_entry_count(m), get_camera_metadata_entry_count(mi));
+        expect_same_finds(m, mi, all_tags);
+    }
+
+    FINISH_USING_CAMERA_METADATA(mi);
+    FINISH_USING_CAMERA_METADATA(m);
+}
+
+TEST(camera_metadata, indexed_copies) {
+    const size_t entry_capacity = 100;
+    const size_t data_capacity = entry_capacity * 8;
+    const std::vector<uint32_t> all_tags = get_all_tags();
+    const int64_t value = 1;
+
+    camera_metadata_t *mi = allocate_indexed_camera_metadata(entry_capacity, data_capacity);
+    for (size_t i = 0; i < entry_capacity / 2; i++) {
+        ASSERT_EQ(OK, add_camera_metadata_entry(mi, all_tags[(i * 7) % all_tags.size()],
+                &value, 1));
+    }
+
+    // A copy does not use the index until it is modified.
+    size_t mi_size = get_camera_metadata_size(mi);
+    std::vector<uint64_t> buffer(mi_size / sizeof(uint64_t));
+    memcpy(buffer.data(), mi, mi_size);
+    camera_metadata_t *m2 = reinterpret_cast<camera_metadata_t*>(buffer.data());
+    EXPECT_EQ(OK, validate_camera_metadata_structure(m2, &mi_size));
+    expect_same_finds(mi, m2, all_tags);
+    ASSERT_EQ(OK, add_camera_metadata_entry(m2, all_tags[1], &value, 1));
+    ASSERT_EQ(OK, add_camera_metadata_entry(mi, all_tags[1], &value, 1));
+    expect_same_finds(mi, m2, all_tags);
+
+    // A stale index is not used either.
+    ASSERT_EQ(OK, delete_camera_metadata_entry(m2, 0));
+    memcpy(mi, m2, mi_size);
+    expect_same_finds(m2, mi, all_tags);
+
+    camera_metadata_t *checked = allocate_copy_camera_metadata_checked(mi, mi_size);
+    ASSERT_NE((void*)NULL, (void*)checked);
+    EXPECT_EQ(mi_size, get_camera_metadata_size(checked));
+    expect_same_finds(mi, checked, all_tags);
+
+    camera_metadata_t *clone = clone_camera_metadata(mi);
+    ASSERT_NE((void*)NULL, (void*)clone);
+    EXPECT_EQ(calculate_indexed_camera_metadata_size(get_camera_metadata_entry_count(mi),
+                    get_camera_metadata_data_count(mi)),
+            get_camera_metadata_size(clone));
+    expect_same_finds(mi, clone, all_tags);
+
+    const size_t compact_size = get_camera_metadata_compact_size(mi);
+    std::vector<uint64_t> compact_buffer(compact_size / sizeof(uint64_t));
+    camera_metadata_t *compact = copy_camera_metadata(compact_buffer.data(), compact_size, mi);
+    ASSERT_NE((void*)NULL, (void*)compact);
+    EXPECT_EQ(compact_size, get_camera_metadata_size(compact));
+    EXPECT_EQ(OK, validate_camera_metadata_structure(compact, &compact_size));
+    expect_same_finds(mi, compact, all_tags);
+
+    FINISH_USING_CAMERA_METADATA(clone);
+    FINISH_USING_CAMERA_METADATA(checked);
+    FINISH_USING_CAMERA_METADATA(mi);
+}
+
+TEST(camera_metadata, sort_metadata_stable) {
+    std::vector<uint32_t> tags = get_all_tags();
+    tags.erase(std::find(tags.begin(), tags.end(), ANDROID_SENSOR_SENSITIVITY));
+    const size_t duplicate_interval = tags.size() / 10;
+    const size_t entry_capacity = tags.size() + tags.size() / duplicate_interval + 1;
+    camera_metadata_t *m = allocate_camera_metadata(entry_capacity, entry_capacity * 8);
+    std::shuffle(tags.begin(), tags.end(), std::minstd_rand(42));
+
+    const int64_t value = 0;
+    for (size_t i = 0; i < tags.size(); i++) {
+        ASSERT_EQ(OK, add_camera_metadata_entry(m, tags[i], &value, 1));
+        if (i % duplicate_interval == 0) {
+            const int32_t sensitivity = i;
+            ASSERT_EQ(OK, add_camera_metadata_entry(m, ANDROID_SENSOR_SENSITIVITY,
+                    &sensitivity, 1));
+        }
+    }
+    ASSERT_EQ(OK, sort_camera_metadata(m));
+
+    camera_metadata_ro_entry_t previous, entry;
+    ASSERT_EQ(OK, get_camera_metadata_ro_entry(m, 0, &previous));
+    for (size_t i = 1; i < get_camera_metadata_entry_count(m); i++) {
+        ASSERT_EQ(OK, get_camera_metadata_ro_entry(m, i, &entry));
+        ASSERT_LE(previous.tag, entry.tag);
+        if (previous.tag == ANDROID_SENSOR_SENSITIVITY && entry.tag == previous.tag) {
+            // Duplicates keep the order they were added in
+            EXPECT_LT(previous.data.i32[0], entry.data.i32[0]);
+        }
+        previous = entry;
+    }
+
+    // The first of the duplicates is found
+    ASSERT_EQ(OK, find_camera_metadata_ro_entry(m, ANDROID_SENSOR_SENSITIVITY, &entry));
+    EXPECT_EQ(0, entry.data.i32[0]);
+
+    FINISH_USING_CAMERA_METADATA(m);
+}
+
+// Expects the same entries and data in metadata m as in reference.
+static void expect_same_entries(const camera_metadata_t *reference, const camera_metadata_t *m) {
+    ASSERT_EQ(get_camera_metadata_entry_count(reference), get_camera_metadata_entry_count(m));
+    EXPECT_EQ(get_camera_metadata_data_count(reference), get_camera_metadata_data_count(m));
+    for (size_t i = 0; i < get_camera_metadata_entry_count(reference); i++) {
+        camera_metadata_ro_entry_t e1, e2;
+        ASSERT_EQ(OK, get_camera_metadata_ro_entry(reference, i, &e1));
+        ASSERT_EQ(OK, get_camera_metadata_ro_entry(m, i, &e2));
+        EXPECT_EQ(e1.tag, e2.tag);
+        ASSERT_EQ(e1.type, e2.type);
+        ASSERT_EQ(e1.count, e2.count);
+        EXPECT_EQ(0, memcmp(e1.data.u8, e2.data.u8,
+                        camera_metadata_type_size[e1.type] * e1.count)) << "entry " << i;
+    }
+}
+
+TEST(camera_metadata, lazy_compaction) {
+    const size_t entry_capacity = 100;
+    const size_t data_capacity = 2000;
+    const std::vector<uint32_t> all_tags = get_all_tags();
+    std::vector<uint32_t> tags;
+    for (uint32_t tag : all_tags) {
+        if (get_camera_metadata_tag_type(tag) == TYPE_INT64) tags.push_back(tag);
+    }
+    std::vector<int64_t> data(8);
+
+    camera_metadata_t *m = allocate_camera_metadata(entry_capacity, data_capacity);
+    camera_metadata_t *lazy = allocate_camera_metadata(entry_capacity, data_capacity);
+    ASSERT_EQ(OK, set_camera_metadata_lazy_compaction(lazy, true));
+
+    std::minstd_rand gen(42);
+    for (int i = 0; i < 3000; i++) {
+        const size_t entry_count = get_camera_metadata_entry_count(m);
+        const size_t operation = gen() % 8;
+        const size_t count = gen() % data.size();
+        for (auto &value : data) value = gen();
+        if (operation < 3 && entry_count < entry_capacity) {
+            const uint32_t tag = tags[gen() % tags.size()];
+            const int result = add_camera_metadata_entry(m, tag, data.data(), count);
+            ASSERT_EQ(result, add_camera_metadata_entry(lazy, tag, data.data(), count));
+        } else if (operation < 5 && entry_count > 0) {
+            const size_t index = gen() % entry_count;
+            ASSERT_EQ(OK, delete_camera_metadata_entry(m, index));
+            ASSERT_EQ(OK, delete_camera_metadata_entry(lazy, index));
+        } else if (operation < 7 && entry_count > 0) {
+            const size_t index = gen() % entry_count;
+            camera_metadata_entry_t e1, e2;
+            const int result = update_camera_metadata_entry(m, index, data.data(), count, &e1);
+            ASSERT_EQ(result, update_camera_metadata_entry(lazy, index, data.data(), count, &e2));
+            if (result == OK) {
+                ASSERT_EQ(e1.count, e2.count);
+                EXPECT_EQ(0, memcmp(e1.data.u8, e2.data.u8, e1.count * sizeof(int64_t)));
+            }
+        } else if (entry_count > 0) {
+            camera_metadata_t *src = allocate_camera_metadata(1, 8 * sizeof(int64_t));
+            ASSERT_EQ(OK, add_camera_metadata_entry(src, tags[gen() % tags.size()],
+                    data.data(), count));
+            const int result = append_camera_metadata(m, src);
+            ASSERT_EQ(result, append_camera_metadata(lazy, src));
+            free_camera_metadata(src);
+        }
+        expect_same_entries(m, lazy);
+        EXPECT_EQ(get_camera_metadata_compact_size(m), get_camera_metadata_compact_size(lazy));
+        ASSERT_EQ(OK, validate_camera_metadata_structure(lazy, NULL));
+    }
+
+    // The compact copies and clones have no holes
+    const size_t compact_size = get_camera_metadata_compact_size(lazy);
+    std::vector<uint64_t> buffer(compact_size / sizeof(uint64_t));
+    camera_metadata_t *copy = copy_camera_metadata(buffer.data(), compact_size, lazy);
+    ASSERT_NE((void*)NULL, (void*)copy);
+    EXPECT_EQ(compact_size, get_camera_metadata_size(copy));
+    EXPECT_EQ(OK, validate_camera_metadata_structure(copy, &compact_size));
+    expect_same_entries(m, copy);
+
+    camera_metadata_t *clone = clone_camera_metadata(lazy);
+    ASSERT_NE((void*)NULL, (void*)clone);
+    EXPECT_EQ(compact_size, get_camera_metadata_size(clone));
+    expect_same_entries(m, clone);
+
+    camera_metadata_t *m2 = allocate_camera_metadata(entry_capacity, data_capacity);
+    ASSERT_EQ(OK, append_camera_metadata(m2, lazy));
+    EXPECT_EQ(get_camera_metadata_data_count(m), get_camera_metadata_data_count(m2));
+    expect_same_entries(m, m2);
+
+    ASSERT_EQ(OK, compact_camera_metadata(lazy));
+    expect_same_entries(m, lazy);
+    ASSERT_EQ(OK, set_camera_metadata_lazy_compaction(lazy, false));
+    expect_same_entries(m, lazy);
+
+    FINISH_USING_CAMERA_METADATA(m2);
+    FINISH_USING_CAMERA_METADATA(clone);
+    FINISH_USING_CAMERA_METADATA(lazy);
+    FINISH_USING_CAMERA_METADATA(m);
+}
+
+TEST(camera_metadata, lazy_compaction_makes_room) {
+    const int64_t data[4] = {1, 2, 3, 4};
+    camera_metadata_t *m = allocate_camera_metadata(2, sizeof(data) * 2);
+    ASSERT_EQ(OK, set_camera_metadata_lazy_compaction(m, true));
+
+    ASSERT_EQ(OK, add_camera_metadata_entry(m, ANDROID_SENSOR_EXPOSURE_TIME, data, 4));
+    ASSERT_EQ(OK, add_camera_metadata_entry(m, ANDROID_SENSOR_FRAME_DURATION, data, 2));
+    // The old data of the entry leaves a hole, and a compaction makes room
+    ASSERT_EQ(OK, update_camera_metadata_entry(m, 1, data, 4, NULL));
+    EXPECT_EQ(sizeof(data) * 2, get_camera_metadata_data_count(m));
+    // There is no room, even after a compaction
+    camera_metadata_entry_t entry;
+    EXPECT_EQ(ERROR, update_camera_metadata_entry(m, 0, data, 5, NULL));
+    ASSERT_EQ(OK, get_camera_metadata_entry(m, 0, &entry));
+    EXPECT_EQ((size_t)4, entry.count);
+    EXPECT_EQ(4, entry.data.i64[3]);
+
+    ASSERT_EQ(OK, delete_camera_metadata_entry(m, 0));
+    EXPECT_EQ(sizeof(data), get_camera_metadata_data_count(m));
+    ASSERT_EQ(OK, add_camera_metadata_entry(m, ANDROID_SENSOR_EXPOSURE_TIME, data, 4));
+    ASSERT_EQ(OK, get_camera_metadata_entry(m, 0, &entry));
+    EXPECT_EQ(ANDROID_SENSOR_FRAME_DURATION, entry.tag);
+    EXPECT_EQ(4, entry.data.i64[3]);
+
+    FINISH_USING_CAMERA_METADATA(m);
+}
+
+// Adds the entries of tags to m, each with a random count and random data.
+static void add_random_entries(camera_metadata_t *m, const std::vector<uint32_t> &tags,
+        std::minstd_rand &gen) {
+    std::vector<uint8_t> data(8 * sizeof(int64_t));
+    for (uint32_t tag : tags) {
+        for (uint8_t &byte : data) byte = gen();
+        ASSERT_EQ(OK, add_camera_metadata_entry(m, tag, data.data(), gen() % 9));
+    }
+}
+
+TEST(camera_metadata, diff_and_apply) {
+    std::vector<uint32_t> all_tags = get_all_tags();
+    std::minstd_rand gen(42);
+    std::shuffle(all_tags.begin(), all_tags.end(), gen);
+    const size_t entry_count = 100;
+    const size_t data_capacity = entry_count * 8 * sizeof(int64_t);
+
+    for (bool sorted : {true, false}) {
+        // next keeps the first 80 tags of base, changes 10 of them, and adds 20
+        std::vector<uint32_t> tags(all_tags.begin(), all_tags.begin() + entry_count);
+        camera_metadata_t *base = allocate_camera_metadata(entry_count, data_capacity);
+        add_random_entries(base, tags, gen);
+        camera_metadata_t *next = allocate_camera_metadata(entry_count, data_capacity);
+        for (size_t i = 0; i < 80; i++) {
+            camera_metadata_ro_entry_t entry;
+            ASSERT_EQ(OK, get_camera_metadata_ro_entry(base, i, &entry));
+            if (i % 8 == 0) {
+                // Change the count, or only the data
+                std::vector<uint8_t> data(entry.data.u8, entry.data.u8 +
+                        entry.count * camera_metadata_type_size[entry.type]);
+                if (i % 16 == 0 || data.empty()) {
+                    data.resize(data.size() + camera_metadata_type_size[entry.type]);
+                } else {
+                    data.back() ^= 1;
+                }
+                ASSERT_EQ(OK, add_camera_metadata_entry(next, entry.tag, data.data(),
+                                data.size() / camera_metadata_type_size[entry.type]));
+            } else {
+                ASSERT_EQ(OK, add_camera_metadata_entry(next, entry.tag, entry.data.u8,
+                                entry.count));
+            }
+        }
+        add_random_entries(next, std::vector<uint32_t>(all_tags.begin() + entry_count,
+                        all_tags.begin() + entry_count + 20), gen);
+        set_camera_metadata_vendor_id(next, 0x1234);
+        if (sorted) {
+            ASSERT_EQ(OK, sort_camera_metadata(base));
+            ASSERT_EQ(OK, sort_camera_metadata(next));
+        }
+
+        camera_metadata_diff_t *diff = allocate_camera_metadata_diff(base, next);
+        ASSERT_NE((void*)NULL, (void*)diff);
+        const size_t diff_size = get_camera_metadata_diff_size(diff);
+        EXPECT_EQ(OK, validate_camera_metadata_diff(diff, diff_size));
+        EXPECT_LT(diff_size, get_camera_metadata_compact_size(next) / 2);
+        size_t added, removed, changed;
+        ASSERT_EQ(OK, get_camera_metadata_diff_counts(diff, &added, &removed, &changed));
+        EXPECT_EQ(20u, added);
+        EXPECT_EQ(20u, removed);
+        EXPECT_EQ(10u, changed);
+
+        // The diff can be copied, as when sent to another process
+        std::vector<uint64_t> buffer(diff_size / sizeof(uint64_t));
+        memcpy(buffer.data(), diff, diff_size);
+        free_camera_metadata_diff(diff);
+        diff = reinterpret_cast<camera_metadata_diff_t*>(buffer.data());
+        ASSERT_EQ(OK, validate_camera_metadata_diff(diff, diff_size));
+
+        camera_metadata_t *applied = apply_camera_metadata_diff(base, diff);
+        ASSERT_NE((void*)NULL, (void*)applied);
+        EXPECT_EQ(OK, validate_camera_metadata_structure(applied, NULL));
+        EXPECT_EQ(get_camera_metadata_compact_size(applied), get_camera_metadata_size(applied));
+        EXPECT_EQ(0x1234u, get_camera_metadata_vendor_id(applied));
+        ASSERT_EQ(OK, sort_camera_metadata(next));
+        expect_same_entries(next, applied);
+
+        // The diff from next to the result is empty
+        camera_metadata_diff_t *empty = allocate_camera_metadata_diff(next, applied);
+        ASSERT_NE((void*)NULL, (void*)empty);
+        ASSERT_EQ(OK, get_camera_metadata_diff_counts(empty, &added, &removed, &changed));
+        EXPECT_EQ(0u, added + removed + changed);
+        free_camera_metadata_diff(empty);
+
+        // The diff does not apply to the next packet
+        EXPECT_EQ(NULL, apply_camera_metadata_diff(applied, diff));
+
+        free_camera_metadata(applied);
+        free_camera_metadata(next);
+        free_camera_metadata(base);
+    }
+}
+
+TEST(camera_metadata, diff_invalid) {
+    std::vector<uint32_t> tags = get_all_tags();
+    tags.resize(10);
+    std::minstd_rand gen(42);
+    camera_metadata_t *base = allocate_camera_metadata(20, 1000);
+    add_random_entries(base, tags, gen);
+    camera_metadata_t *next = allocate_camera_metadata(20, 1000);
+    add_random_entries(next, std::vector<uint32_t>(tags.begin() + 5, tags.end()), gen);
+
+    camera_metadata_diff_t *diff = allocate_camera_metadata_diff(base, next);
+    ASSERT_NE((void*)NULL, (void*)diff);
+    const size_t diff_size = get_camera_metadata_diff_size(diff);
+    EXPECT_NE(OK, validate_camera_metadata_diff(diff, diff_size - 1));
+    EXPECT_NE(OK, validate_camera_metadata_diff(NULL, diff_size));
+
+    // The removed tags are after the header, and must be in increasing order
+    uint32_t *removed_tags = reinterpret_cast<uint32_t*>(
+            reinterpret_cast<uint8_t*>(diff) + 6 * sizeof(uint32_t));
+    std::swap(removed_tags[0], removed_tags[1]);
+    EXPECT_NE(OK, validate_camera_metadata_diff(diff, diff_size));
+    std::swap(removed_tags[0], removed_tags[1]);
+    EXPECT_EQ(OK, validate_camera_metadata_diff(diff, diff_size));
+
+    // A base missing removed tags
+    camera_metadata_t *other = allocate_camera_metadata(20, 1000);
+    add_random_entries(other, std::vector<uint32_t>(tags.begin() + 1, tags.end()), gen);
+    add_random_entries(other, std::vector<uint32_t>(1, get_all_tags().back()), gen);
+    EXPECT_EQ(NULL, apply_camera_metadata_diff(other, diff));
+    free_camera_metadata(other);
+    free_camera_metadata_diff(diff);
+
+    // No diff with several entries for a tag
+    add_random_entries(next, std::vector<uint32_t>(1, tags.back()), gen);
+    EXPECT_EQ(NULL, allocate_camera_metadata_diff(base, next));
+
+    free_camera_metadata(next);
+    free_camera_metadata(base);
+}
+
+TEST(camera_metadata, pool_reuse) {
+    camera_metadata_pool_t *pool = create_camera_metadata_pool(1 << 20);
+    ASSERT_NE((void*)NULL, (void*)pool);
+
+    camera_metadata_t *m = allocate_camera_metadata_from_pool(pool, 10, 100);
+    ASSERT_NE((void*)NULL, (void*)m);
+    EXPECT_EQ(calculate_camera_metadata_size(10, 100), get_camera_metadata_size(m));
+    EXPECT_EQ(OK, validate_camera_metadata_structure(m, NULL));
+    add_test_metadata(m, 5);
+    camera_metadata_pool_stats_t stats;
+    ASSERT_EQ(OK, get_camera_metadata_pool_stats(pool, &stats));
+    EXPECT_EQ(1u, stats.allocations);
+    EXPECT_EQ(0u, stats.hits);
+    EXPECT_EQ(1u, stats.outstanding_count);
+    EXPECT_EQ(get_camera_metadata_size(m), stats.outstanding_packet_bytes);
+    EXPECT_GE(stats.outstanding_bytes, stats.outstanding_packet_bytes);
+    release_camera_metadata_to_pool(pool, m);
+
+    // A packet of the same size class reuses the buffer, and is zeroed
+    camera_metadata_t *m2 = allocate_camera_metadata_from_pool(pool, 10, 96);
+    EXPECT_EQ(m, m2);
+    EXPECT_EQ(0u, get_camera_metadata_entry_count(m2));
+    const size_t header_size = calculate_camera_metadata_size(0, 0);
+    std::vector<uint8_t> zeros(get_camera_metadata_size(m2) - header_size);
+    EXPECT_EQ(0, memcmp(zeros.data(), reinterpret_cast<uint8_t*>(m2) + header_size,
+                    zeros.size()));
+    ASSERT_EQ(OK, get_camera_metadata_pool_stats(pool, &stats));
+    EXPECT_EQ(2u, stats.allocations);
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(0u, stats.cached_count);
+
+    // A clone is a compact copy
+    add_test_metadata(m2, 5);
+    camera_metadata_t *clone = clone_camera_metadata_from_pool(pool, m2);
+    ASSERT_NE((void*)NULL, (void*)clone);
+    EXPECT_EQ(get_camera_metadata_compact_size(m2), get_camera_metadata_size(clone));
+    expect_same_entries(m2, clone);
+
+    release_camera_metadata_to_pool(pool, clone);
+    release_camera_metadata_to_pool(pool, m2);
+    ASSERT_EQ(OK, get_camera_metadata_pool_stats(pool, &stats));
+    EXPECT_EQ(0u, stats.outstanding_count);
+    EXPECT_EQ(0u, stats.outstanding_bytes);
+    EXPECT_EQ(0u, stats.outstanding_packet_bytes);
+    EXPECT_EQ(2u, stats.cached_count);
+    destroy_camera_metadata_pool(pool);
+}
+
+TEST(camera_metadata, pool_size_classes) {
+    camera_metadata_pool_t *pool = create_camera_metadata_pool(1 << 20);
+    std::vector<camera_metadata_t*> packets;
+    for (size_t data_capacity = 0; data_capacity < 20000; data_capacity += 97) {
+        camera_metadata_t *m = allocate_camera_metadata_from_pool(pool, 10, data_capacity);
+        ASSERT_NE((void*)NULL, (void*)m);
+        // The buffer is written up to its end
+        memset(m, 0xFF, get_camera_metadata_size(m));
+        packets.push_back(m);
+    }
+    camera_metadata_pool_stats_t stats;
+    ASSERT_EQ(OK, get_camera_metadata_pool_stats(pool, &stats));
+    EXPECT_EQ(packets.size(), stats.outstanding_count);
+    // Less than 20% of the buffers are lost to the size classes
+    EXPECT_GT(stats.outstanding_packet_bytes, stats.outstanding_bytes * 4 / 5);
+
+    // A packet larger than the size classes is not kept
+    camera_metadata_t *large = allocate_camera_metadata_from_pool(pool, 10, 8 << 20);
+    ASSERT_NE((void*)NULL, (void*)large);
+    release_camera_metadata_to_pool(pool, large);
+    ASSERT_EQ(OK, get_camera_metadata_pool_stats(pool, &stats));
+    EXPECT_EQ(0u, stats.cached_count);
+
+    // Nor are the buffers over the maximum of the pool
+    for (camera_metadata_t *m : packets) {
+        release_camera_metadata_to_pool(pool, m);
+    }
+    ASSERT_EQ(OK, get_camera_metadata_pool_stats(pool, &stats));
+    EXPECT_EQ(0u, stats.outstanding_count);
+    EXPECT_LE(stats.cached_bytes, 1u << 20);
+    EXPECT_LT(stats.cached_count, packets.size());
+    destroy_camera_metadata_pool(pool);
+}
+
+TEST(camera_metadata, pool_wrong_pool) {
+    camera_metadata_pool_t *pool = create_camera_metadata_pool(1 << 20);
+    camera_metadata_pool_t *other = create_camera_metadata_pool(1 << 20);
+    camera_metadata_t *m = allocate_camera_metadata_from_pool(pool, 10, 100);
+
+    // Left alone by the other pool, and keeps its pool alive
+    release_camera_metadata_to_pool(other, m);
+    destroy_camera_metadata_pool(other);
+    destroy_camera_metadata_pool(pool);
+    camera_metadata_pool_stats_t stats;
+    ASSERT_EQ(OK, get_camera_metadata_pool_stats(pool, &stats));
+    EXPECT_EQ(1u, stats.outstanding_count);
+
+    release_camera_metadata_to_pool(pool, m);
+    destroy_camera_metadata_pool(pool);
+}